@@ -0,0 +1,82 @@
+#ifndef ARQ_H
+#define ARQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "packet.h"
+#include "interface/pconfig.h"
+#include "utils/time_utils.h"
+
+// Callback for when a unicast data packet is acknowledged or runs out of retries
+typedef void (*arq_delivery_callback_t)(void *ctx, uint8_t dest_addr, uint8_t id, bool delivered);
+
+typedef struct
+{
+    bool in_use;
+    bool retransmit_due; ///< Timer expired, waiting for the orchestrator to send it again
+    uint8_t retries;     ///< Number of times this packet has been retransmitted
+    HAL_timer_t timer;   ///< Retransmit timer, restarted with a longer timeout on every retry
+    packet_t packet;
+} arq_slot_t;
+
+typedef struct
+{
+    bool in_use;
+    uint8_t addr;
+    uint32_t last_used; ///< For evicting the least recently used peer
+
+    uint8_t next_tx_id; ///< Next id in our sequence space towards this peer
+    uint8_t tx_session; ///< Names our sequence towards this peer, a new one whenever it restarts at 0
+    bool tx_synced;     ///< Peer acknowledged something of tx_session, so it no longer needs to be sent
+
+    bool rx_valid;       ///< Set once we've received anything from this peer
+    uint8_t rx_session;  ///< Session rx_history belongs to, 0 if the peer hasn't sent one yet
+    uint8_t rx_highest;  ///< Highest id received from this peer
+    uint32_t rx_history; ///< Bit n set = id (rx_highest - n) has been received
+
+    uint8_t pending_acks[pconfigARQ_MAX_ACK_IDS]; ///< Ids waiting to be acknowledged in one frame
+    uint8_t pending_ack_count;
+    HAL_timer_t ack_timer; ///< Holds ACKs back briefly so several ids share one frame
+} arq_peer_t;
+
+typedef struct
+{
+    uint8_t address; ///< Our own address, used as the source of ACK frames
+
+    arq_slot_t window[pconfigARQ_WINDOW_SIZE]; ///< Unacknowledged packets in flight
+    arq_peer_t peers[pconfigARQ_MAX_PEERS];    ///< Per-destination sequence and receive state
+    uint32_t use_counter;
+    uint8_t session_counter; ///< Keeps sessions started in one run apart
+
+    arq_delivery_callback_t delivery_callback;
+    void *delivery_ctx; ///< Passed back to delivery_callback
+
+    struct
+    {
+        uint32_t retransmissions;
+        uint32_t delivered;
+        uint32_t failed;
+        uint32_t acks_sent;
+        uint32_t acks_received;
+        uint32_t duplicates;
+    } stats;
+} arq_handle_t;
+
+int arq_init(arq_handle_t *handle, uint8_t address, arq_delivery_callback_t delivery_callback, void *delivery_ctx);
+int arq_task(arq_handle_t *handle);
+
+uint8_t arq_next_id(arq_handle_t *handle, uint8_t dest_addr);
+bool arq_window_available(arq_handle_t *handle);
+int arq_track(arq_handle_t *handle, const packet_t *packet);
+int arq_set_session(arq_handle_t *handle, packet_t *packet); // Just before each transmission of our own unicast data
+
+bool arq_retransmission_pending(arq_handle_t *handle);
+int arq_get_retransmission(arq_handle_t *handle, packet_t *packet);
+
+bool arq_ack_pending(arq_handle_t *handle);
+int arq_get_ack(arq_handle_t *handle, packet_t *packet);
+
+bool arq_handle_data(arq_handle_t *handle, const packet_t *packet);
+int arq_handle_ack(arq_handle_t *handle, const packet_t *packet);
+
+#endif // ARQ_H
@@ -1,11 +1,13 @@
 #ifndef ADC_BSP_H
 #define ADC_BSP_H
 
-#include "utils/circular_buffer.h"
+#include "utils/block_ring.h"
 
-int adc_bsp_init(int sample_rate);
+// The ring is the decoder's input. A DMA or capture thread BSP keeps it from init and commits
+// blocks as they fill, a polled BSP fills them from adc_bsp_get_data instead.
+int adc_bsp_init(int sample_rate, block_ring_t *ring);
 int adc_bsp_task();
 bool adc_bsp_data_available();
-int adc_bsp_get_data(circular_buffer_t *buffer);
+int adc_bsp_get_data(block_ring_t *ring);
 
-#endif // ADC_BSP_H
\ No newline at end of file
+#endif // ADC_BSP_H
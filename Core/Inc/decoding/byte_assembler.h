@@ -18,11 +18,16 @@ typedef struct
     unsigned char current_byte;
     int bits_collected;
 
+    uint8_t rate_byte; // Rate byte sent unstuffed after the sync word
+    int rate_bits;
+
     bit_unstuffer_t bit_unstuffer;
+    uint16_t stuffed_bits; // Stuffed bits removed since the sync word
 
     enum
     {
         BYTE_ASSEMBLER_WAITING_FOR_PREAMBLE,
+        BYTE_ASSEMBLER_READING_RATE,
         BYTE_ASSEMBLER_ASSEMBLING,
     } state;
 } byte_assembler_handle_t;
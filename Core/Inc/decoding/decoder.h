@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "utils/circular_buffer.h"
+#include "utils/block_ring.h"
 #include "utils/fsk_utils.h"
 #include "packet_decoder.h"
 
@@ -28,13 +29,21 @@ typedef struct
     void *bit_decoder_handle;
     void *byte_decoder_handle;
     packet_decoder_t packet_decoder;
+    uint64_t sync_sample; ///< Input sample the current frame's sync word ended on
 
-    circular_buffer_t input_buffer; ///< Buffer for incoming ADC samples or bits, depending on the bit decoder
-    uint16_t input_array[pconfigSAMPLES_PER_SYMBOL * pconfigDECODER_BUFFER_SYMBOL_COUNT];
+    block_ring_t input_ring; ///< Blocks of ADC samples, filled in place by the ADC BSP and decoded in place
+    uint16_t *input_array;   ///< Caller-provided storage for input_ring
+    size_t input_size;       ///< Samples input_array holds
+    bool shared_input;       ///< Samples reach the bit decoder through an FSK bank, input_ring stays unused
 
     circular_buffer_t output_buffer; ///< Buffer for decoded packets ready to be consumed by the application
     packet_t output_array[pconfigDECODER_OUTPUT_BUFFER_SIZE];
 
+    struct
+    {
+        stat_counter_t sync_words; ///< Preambles found in the bit stream
+    } stats;
+
     enum
     {
         DECODER_STATE_UNINITIALIZED,
@@ -49,19 +58,25 @@ int decoder_deinit(decoder_handle_t *handle);
 
 int decoder_set_byte_decoder(decoder_handle_t *handle, byte_decoder_e type, void *byte_decoder_handle);
 int decoder_set_bit_decoder(decoder_handle_t *handle, bit_decoder_e type, void *bit_decoder_handle);
+int decoder_set_input_buffer(decoder_handle_t *handle, uint16_t *buffer, size_t samples); // Before the first decoder_task call, split into pconfigDECODER_INPUT_BLOCKS blocks
+int decoder_set_shared_input(decoder_handle_t *handle);                                  // Instead of an input buffer, for decoders an FSK bank feeds
 int decoder_task(decoder_handle_t *handle);
 
-int decoder_process_samples(decoder_handle_t *handle, const uint16_t *samples, size_t num_samples);
+int decoder_process_samples(decoder_handle_t *handle, const uint16_t *samples, size_t num_samples); // Copies into input_ring, BSPs can fill it directly instead
 int decoder_process_bit(decoder_handle_t *handle, bool bit);
 int decoder_process_byte(decoder_handle_t *handle, unsigned char byte);
 int decoder_process_packet(decoder_handle_t *handle, packet_t *packet);
 int decoder_sync_word_detected(decoder_handle_t *handle);
+int decoder_rate_detected(decoder_handle_t *handle, fsk_rate_e rate);
 
 bool decoder_has_packet(decoder_handle_t *handle);
 int decoder_get_packet(decoder_handle_t *handle, packet_t *packet);
 bool decoder_busy(decoder_handle_t *handle);
 
 bool decoder_signal_detected(decoder_handle_t *handle); // Active RX signal
-int decoder_reset(decoder_handle_t *handle); // Resets byte and packet assemblers, but does not clear the input buffer. Useful for resyncing after a lost packet.
+float decoder_channel_energy(decoder_handle_t *handle); // In-band energy, input full scale units
+float decoder_channel_level(decoder_handle_t *handle);  // In-band energy over the idle channel's, as a ratio, used for carrier sensing
+float decoder_snr(decoder_handle_t *handle);            // Average SNR since the last sync word, stamped on decoded packets
+int decoder_reset(decoder_handle_t *handle); // Resets byte and packet assemblers and the symbol rate, but does not clear the input buffer. Useful for resyncing after a lost packet.
 
 #endif // DECODER_H
\ No newline at end of file
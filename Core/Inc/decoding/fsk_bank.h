@@ -0,0 +1,52 @@
+#ifndef FSK_BANK_H
+#define FSK_BANK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "decoding/decoder.h"
+#include "decoding/fsk_decoder.h"
+#include "decoding/byte_assembler.h"
+#include "dsp/front_end.h"
+#include "utils/block_ring.h"
+#include "interface/pconfig.h"
+#include "interface/peregrine-constellation.h"
+
+// Several tone pairs decoded from one ADC. The samples go through one front end, and each
+// block out of it is decoded by every channel in turn while it's still in cache. Channels
+// keep their own filters, symbol clock, squelch and idle detector, and feed their own byte
+// and packet assembler, so frames on different pairs can overlap in time.
+typedef struct
+{
+    decoder_handle_t decoder; // Byte and packet assembly, packets decoded on this pair come out of it
+    fsk_decoder_handle_t fsk_decoder;
+    byte_assembler_handle_t byte_assembler;
+} fsk_bank_channel_t;
+
+typedef struct
+{
+    pc_config_t config;    // Rate, sample rate and format, and threshold of every channel, the tones are per channel
+    front_end_t front_end; // Shared by every channel
+
+    block_ring_t input_ring; // Blocks of ADC samples, filled in place by the ADC BSP
+    float samples[FSK_BLOCK_SIZE]; // Out of the front end, decoded by each channel in turn
+
+    fsk_bank_channel_t channels[pconfigFSK_BANK_MAX_CHANNELS];
+    size_t channel_count;
+
+    enum
+    {
+        FSK_BANK_STATE_UNINITIALIZED,
+        FSK_BANK_STATE_INITIALIZING,
+        FSK_BANK_STATE_RUNNING,
+    } state;
+} fsk_bank_t;
+
+int fsk_bank_init(fsk_bank_t *bank, const pc_config_t *config); // config->sample_rate has to be set
+int fsk_bank_add_channel(fsk_bank_t *bank, int freq_0, int freq_1); // Before the first fsk_bank_task call
+int fsk_bank_set_input_buffer(fsk_bank_t *bank, uint16_t *buffer, size_t samples);
+int fsk_bank_task(fsk_bank_t *bank);
+
+int fsk_bank_process_samples(fsk_bank_t *bank, const uint16_t *samples, size_t count); // Copies into input_ring, BSPs can fill it directly instead
+decoder_handle_t *fsk_bank_channel(fsk_bank_t *bank, size_t index); // NULL past the last channel
+
+#endif // FSK_BANK_H
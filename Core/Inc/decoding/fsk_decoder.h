@@ -7,6 +7,26 @@
 #include "utils/circular_buffer.h"
 #include "decoding/decoder.h"
 #include "dsp/filters.h"
+#include "dsp/front_end.h"
+#include "utils/goertzel.h"
+#include "interface/pconfig.h"
+
+#define FSK_WAKE_WINDOW_MAX (256) // Longest idle detector window in samples, sizes the history replayed on waking
+#define FSK_BLOCK_SIZE (64)       // Samples filtered at a time, the threshold crossings in a block fit one 64-bit mask
+
+// Filter, envelope and squelch state at the start of a block, so the block can be filtered
+// again from a decision that changed how it's filtered (a rate switch, a frame starting or ending)
+typedef struct
+{
+    biquad_t bp1200_1, bp1200_2;
+    biquad_t bp2200_1, bp2200_2;
+    env_metric_t env_metric;
+    float squelch_energy;
+    float noise_floor;
+    bool carrier;
+    bool floor_settled;
+    int carrier_samples;
+} fsk_filter_state_t;
 
 typedef struct fsk_decoder_handle
 {
@@ -14,6 +34,8 @@ typedef struct fsk_decoder_handle
     {
         int symbol_sample_size;  // Size of the ADC sample buffer
         int sample_rate;            // Sample rate of the ADC
+        pc_sample_format_e sample_format; // Format the ADC delivers samples in
+        int baud_rate;              // Configured symbol rate, 0 takes it as sample_rate / symbol_sample_size
         int buffer_symbol_count; // Number of symbols to buffer for processing
         float power_threshold;      // Power threshold for detecting bits
         float freq_0;               // Frequency representing bit 0
@@ -22,13 +44,77 @@ typedef struct fsk_decoder_handle
 
     bool signal_detected;
     bool edge_detected;
-    int half_symbol_sample_size;
-    int metric_ticker;
+    int symbol_sample_size;   // Whole samples per symbol at the current rate, configs.symbol_sample_size is the base rate
+    float samples_per_symbol; // Exact samples per symbol at the current rate, needn't be whole
+    float filter_delay;       // Samples the tone filters and envelope lag behind the input at the current rate
+    int weak_bits;            // Bit decisions in a row that didn't clear the power threshold
     float prev_metric;
+
+    // Symbol clock, a PI loop locked onto the metric's threshold crossings
+    float symbol_phase; // Symbols since the last boundary in the filtered signal, the bit is decided at 0.5
+    float symbol_step;  // Phase per sample, 1 / samples_per_symbol corrected by clock_offset
+    float clock_offset; // Integrated timing error, how much faster the sender's clock runs than ours
+    int timing_edges;   // Edges the clock was set to since the signal was detected
+
+    // Squelch, bits are only decided on while the in-band energy stands clear of the noise floor
+    bool carrier;             // Squelch open
+    float squelch_energy;     // Channel energy smoothed over about a symbol, input full scale units
+    float noise_floor;        // Low end of squelch_energy while no signal is decoded, input full scale units
+    float squelch_alpha;      // squelch_energy smoothing
+    float floor_alpha;        // How fast the floor follows the energy down
+    float floor_rise;         // Factor the floor climbs by per sample while the energy is above it
+    float floor_carrier_rise; // The same once the squelch has been open floor_hold samples, after the floor has settled
+    int floor_hold;           // Samples the squelch is open for before the floor climbs at floor_carrier_rise
+    int carrier_samples;      // Samples the squelch has been open for
+    bool floor_settled;       // The squelch has closed on the noise since init
+
+    // Idle channel detector, keeps the tone filters asleep while there's no energy at the tones
+    bool asleep;                 // Only the front end and the detector run
+    goertzel_t wake_0, wake_1;   // Tone energy over the current window
+    int wake_window;             // Samples per window, a base rate symbol up to FSK_WAKE_WINDOW_MAX
+    int wake_count;              // Samples into the current window
+    float wake_energy;           // Tone energy of the last window, input full scale units
+    float wake_level;            // Average wake_energy while no signal is decoded
+    float wake_alpha;            // wake_level smoothing, per window
+    float wake_history[2 * FSK_WAKE_WINDOW_MAX]; // The last two windows out of the front end, replayed into the filters on waking
+    int history_index;           // Oldest sample in wake_history
+
+    front_end_t front_end; // DC blocker and AGC ahead of the tone filters
     env_metric_t env_metric;
     biquad_t bp1200_1, bp1200_2;
     biquad_t bp2200_1, bp2200_2;
 
+    uint64_t sample_index; // Samples given to the decoder, stamps sync words
+
+    // A block of samples through the filters, envelopes and squelch, walked from one crossing or decision to the next
+    struct
+    {
+        float samples[FSK_BLOCK_SIZE];    // Out of the front end
+        float metric[FSK_BLOCK_SIZE + 1]; // [0] is the last metric of the block before
+        float env_0[FSK_BLOCK_SIZE];      // freq_0 tone envelope
+        float env_1[FSK_BLOCK_SIZE];      // freq_1 tone envelope
+        bool carrier[FSK_BLOCK_SIZE];     // Squelch open
+#if pconfig_DEBUG_RECORDING_ENABLED
+        float filtered_0[FSK_BLOCK_SIZE];
+        float filtered_1[FSK_BLOCK_SIZE];
+#endif
+        fsk_filter_state_t start; // State before sample start_index
+        int start_index;
+    } block;
+
+    // Per-bit measurements accumulated since the last sync word
+    float snr_db_sum;      // Tone envelope SNR
+    float tone_0_sum;      // freq_0 tone envelope
+    float tone_1_sum;      // freq_1 tone envelope
+    float margin_sum;      // How far the metric cleared the power threshold
+    uint32_t snr_bits;     // Bits accumulated in the sums
+
+    struct
+    {
+        stat_counter_t samples;      // ADC samples given to the decoder
+        stat_counter_t idle_samples; // of which the tone filters slept through
+    } stats;
+
     enum
     {
         FSK_DECODER_STATE_UNINITIALIZED,
@@ -43,13 +129,28 @@ int fsk_decoder_deinit(fsk_decoder_handle_t *handle);
 
 int fsk_decoder_set_symbol_sample_size(fsk_decoder_handle_t *handle, size_t _symbol_sample_size, size_t _buffer_symbol_count);
 int fsk_decoder_set_sample_rate(fsk_decoder_handle_t *handle, int sample_rate);
+int fsk_decoder_set_sample_format(fsk_decoder_handle_t *handle, pc_sample_format_e sample_format);
 int fsk_decoder_set_frequencies(fsk_decoder_handle_t *handle, float freq_0, float freq_1);
 int fsk_decoder_set_power_threshold(fsk_decoder_handle_t *handle, float _threshold);
+int fsk_decoder_set_symbol_rate(fsk_decoder_handle_t *handle, int baud_rate);
 int fsk_decoder_reset_symbol_timing(fsk_decoder_handle_t *handle);
+int fsk_decoder_set_baud_rate(fsk_decoder_handle_t *handle, int baud_rate);
+int fsk_decoder_reset_baud_rate(fsk_decoder_handle_t *handle);
+int fsk_decoder_base_baud_rate(fsk_decoder_handle_t *handle);
 
 int fsk_decoder_task(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
 bool fsk_decoder_busy(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
+int fsk_decoder_demodulate(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const front_end_t *front_end,
+                           const uint16_t *raw, const float *samples, size_t count); // Samples out of a front end shared with other decoders
 
 bool fsk_decoder_signal_detected(fsk_decoder_handle_t *handle);
+float fsk_decoder_channel_energy(fsk_decoder_handle_t *handle);
+float fsk_decoder_noise_floor(fsk_decoder_handle_t *handle);
+float fsk_decoder_channel_level(fsk_decoder_handle_t *handle);
+float fsk_decoder_snr(fsk_decoder_handle_t *handle);
+int fsk_decoder_tone_levels(fsk_decoder_handle_t *handle, float *tone_0, float *tone_1);
+float fsk_decoder_metric_margin(fsk_decoder_handle_t *handle);
+uint64_t fsk_decoder_symbol_end_sample(fsk_decoder_handle_t *handle); // Input sample the last decided symbol ended on
+int fsk_decoder_reset_frame_metrics(fsk_decoder_handle_t *handle);
 
 #endif // FSK_DECODER_H
@@ -2,13 +2,22 @@
 #define PACKET_DECODER_H
 
 #include "../packet.h"
+#include "utils/stats.h"
 
 typedef struct
 {
     void *ctx;                                                  ///< Pointer to the decoder context
-    uint8_t packet_buffer[sizeof(((packet_t *)NULL)->content)]; ///< Buffer to hold incoming packet data
-    size_t packet_buffer_index;                                 ///< Current index in the packet buffer
-    packet_t current_packet;                                    ///< Current packet being processed
+    uint8_t packet_buffer[PACKET_SIZE]; ///< Buffer to hold incoming packet data
+    size_t packet_buffer_index;         ///< Current index in the packet buffer
+    size_t header_size;                 ///< Header plus the extensions its flags announce
+    packet_t current_packet;            ///< Current packet being processed
+
+    struct
+    {
+        stat_counter_t crc_passed;      ///< Frames handed on to the decoder
+        stat_counter_t crc_failed;      ///< Complete frames dropped for a CRC mismatch
+        stat_counter_t length_rejected; ///< Headers dropped for announcing more than pconfigMAX_PAYLOAD_SIZE
+    } stats;
 
     enum
     {
@@ -0,0 +1,47 @@
+#ifndef DSP_FRONT_END_H
+#define DSP_FRONT_END_H
+
+#include <stdint.h>
+#include <math.h>
+#include "interface/peregrine-constellation.h"
+
+// First stage of the receive chain. ADC samples arrive in whatever format the BSP delivers
+// and leave as floats around 0 with their DC offset removed and their level held steady by
+// an AGC, so the tone filters see the same signal whatever the hardware and volume.
+typedef struct
+{
+    uint16_t flip;    // Turns signed samples into offset binary
+    float offset;     // Mid-scale of the format once offset binary
+    float scale;      // Full scale of the format to 1.0
+
+    float dc;         // Running DC offset, full scale units
+    float dc_alpha;   // DC blocker smoothing
+    float level;      // Running mean magnitude after the DC blocker, full scale units
+    float level_alpha;
+    float gain;       // AGC gain currently applied
+    uint16_t countdown; // Samples until the gain follows the level again
+} front_end_t;
+
+int front_end_init(front_end_t *front_end, pc_sample_format_e format, float sample_rate);
+void front_end_update_gain(front_end_t *front_end);
+
+/**
+ * @brief Converts a sample, removes its DC offset and applies the AGC gain
+ */
+static inline float front_end_process(front_end_t *front_end, uint16_t sample)
+{
+    float x = ((float)(uint16_t)(sample ^ front_end->flip) - front_end->offset) * front_end->scale;
+
+    front_end->dc += front_end->dc_alpha * (x - front_end->dc);
+    x -= front_end->dc;
+
+    front_end->level += front_end->level_alpha * (fabsf(x) - front_end->level);
+    if (--front_end->countdown == 0)
+    {
+        front_end_update_gain(front_end);
+    }
+
+    return x * front_end->gain;
+}
+
+#endif // DSP_FRONT_END_H
@@ -0,0 +1,10 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+int compression_compress(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_capacity, size_t *output_len);
+int compression_decompress(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_capacity, size_t *output_len);
+
+#endif // COMPRESSION_H
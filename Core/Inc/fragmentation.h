@@ -0,0 +1,74 @@
+#ifndef FRAGMENTATION_H
+#define FRAGMENTATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "packet.h"
+#include "interface/pconfig.h"
+#include "utils/time_utils.h"
+
+#define FRAGMENTATION_MAX_FRAGMENTS ((pconfigMAX_MESSAGE_SIZE + pconfigMAX_PAYLOAD_SIZE - 1) / pconfigMAX_PAYLOAD_SIZE)
+
+// Fragment offsets are index * pconfigMAX_PAYLOAD_SIZE, a partial last payload would leave the slot too short for them
+_Static_assert(pconfigMAX_MESSAGE_SIZE % pconfigMAX_PAYLOAD_SIZE == 0, "pconfigMAX_MESSAGE_SIZE must be a multiple of pconfigMAX_PAYLOAD_SIZE");
+
+typedef enum
+{
+    FRAGMENTATION_TX_NOT_TRACKED = 0, //< Id doesn't belong to a fragmented message
+    FRAGMENTATION_TX_IN_PROGRESS,     //< Other fragments of the message are still outstanding
+    FRAGMENTATION_TX_DELIVERED,       //< Every fragment of the message was acknowledged
+    FRAGMENTATION_TX_FAILED,          //< A fragment ran out of retries, reported once per message
+} fragmentation_tx_status_e;
+
+typedef struct
+{
+    bool in_use;
+    uint8_t src_addr;
+    uint8_t message_id;
+    uint8_t count;
+    uint8_t received_count;
+    uint8_t received[(FRAGMENTATION_MAX_FRAGMENTS + 7) / 8]; ///< Bit per fragment index
+    size_t length;                                         ///< Known once the last fragment arrives
+    HAL_timer_t timer;                                     ///< Gives up on the message if it doesn't complete in time
+    uint8_t data[pconfigMAX_MESSAGE_SIZE];
+} fragmentation_rx_slot_t;
+
+typedef struct
+{
+    bool in_use;
+    bool failed; ///< Already reported as failed, remaining results are swallowed
+    uint8_t dest_addr;
+    uint8_t first_id; ///< Packet id of fragment 0, fragments use consecutive ids
+    uint8_t count;
+    uint8_t reported_count;
+} fragmentation_tx_slot_t;
+
+typedef struct
+{
+    uint8_t next_message_id;
+
+    fragmentation_rx_slot_t rx_slots[pconfigREASSEMBLY_SLOTS];
+    fragmentation_tx_slot_t tx_slots[pconfigFRAGMENTED_TX_MESSAGES];
+
+    struct
+    {
+        uint32_t reassembled;
+        uint32_t timed_out;
+        uint32_t evicted; ///< Incomplete messages dropped to make room for a new one
+    } stats;
+} fragmentation_handle_t;
+
+int fragmentation_init(fragmentation_handle_t *handle);
+int fragmentation_task(fragmentation_handle_t *handle);
+
+uint8_t fragmentation_count(size_t length);
+uint8_t fragmentation_next_message_id(fragmentation_handle_t *handle);
+
+int fragmentation_reassemble(fragmentation_handle_t *handle, const packet_t *packet, uint8_t *message, size_t *message_length);
+
+bool fragmentation_tx_available(fragmentation_handle_t *handle);
+int fragmentation_track_tx(fragmentation_handle_t *handle, uint8_t dest_addr, uint8_t first_id, uint8_t count);
+int fragmentation_tx_result(fragmentation_handle_t *handle, uint8_t dest_addr, uint8_t id, bool delivered, fragmentation_tx_status_e *status, uint8_t *first_id);
+
+#endif // FRAGMENTATION_H
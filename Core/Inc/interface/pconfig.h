@@ -4,16 +4,56 @@
 #define pconfigFCC_CALLSIGN "KM7DEJ"   // FCC Callsign if using amateur bands
 #define pconfigCALLSIGN_INTERVAL_M (9) // Callsign broadcasting interval
 #define pconfigDEVICE_ADDRESS (0x01)   // 8-bit address for this device
+#define pconfigBROADCAST_ADDRESS (0x00) // Destination address heard by every node, never acknowledged
 
 #define pconfigMAX_PAYLOAD_SIZE 32 // Maximum payload size
 
+// Fragmentation of messages larger than pconfigMAX_PAYLOAD_SIZE
+#define pconfigMAX_MESSAGE_SIZE (512)          // Largest message pc_send_message accepts, a multiple of pconfigMAX_PAYLOAD_SIZE, at most 255 fragments
+#define pconfigREASSEMBLY_SLOTS (4)            // Messages reassembled at once, RAM used is slots * pconfigMAX_MESSAGE_SIZE
+#define pconfigREASSEMBLY_TIMEOUT_MS (60000)   // Partial messages are dropped after this, should outlast the ARQ retries
+#define pconfigFRAGMENTED_TX_MESSAGES (4)      // Fragmented unicast messages awaiting a delivery report
+
+// Payload compression
+#define pconfigCOMPRESSION_ENABLED (1)    // Compress messages before sending when it makes them smaller
+#define pconfigCOMPRESSION_MIN_SIZE (8)   // Messages shorter than this aren't worth the CPU time
+
 #define pconfigRX_BUFFER_SIZE 128 // Number of packets that can be buffered for reception
-#define pconfigTX_BUFFER_SIZE 128 // Number of packets that can be buffered for transmission
+
+// TX scheduling, one queue per traffic class
+#define pconfigTX_CONTROL_QUEUE_SIZE (8)                         // ACKs and other link control frames
+#define pconfigTX_BEACON_QUEUE_SIZE (2)                          // Callsign beacons
+#define pconfigTX_RELAY_QUEUE_SIZE (32)                          // Packets forwarded for other nodes
+#define pconfigTX_APPLICATION_QUEUE_SIZE (32)                    // Locally originated data, pc_send_message reports queue full past this
+#define pconfigTX_RELAY_QUANTUM (2 * pconfigMAX_PAYLOAD_SIZE)       // Bytes of relay traffic per round robin turn, must be > 0
+#define pconfigTX_APPLICATION_QUANTUM (2 * pconfigMAX_PAYLOAD_SIZE) // Bytes of application traffic per round robin turn, must be > 0
 
 #define pconfigMAX_RETRIES 5            // Number of retries before giving up
 #define pconfigBACKOFF_BASE_TIME_MS 100 // Base time to wait before retrying
 #define pconfigBACKOFF_MAX_TIME_MS 1000 // Maximum time to wait before retrying
 
+// Reliable delivery (ARQ) for unicast data
+#define pconfigARQ_WINDOW_SIZE (4)       // Unacknowledged packets allowed in flight at once
+#define pconfigARQ_MAX_PEERS (8)         // Destinations/sources we keep sequence state for
+#define pconfigARQ_MAX_ACK_IDS (8)       // Ids acknowledged by a single ACK frame
+#define pconfigARQ_ACK_DELAY_MS (200)    // How long to hold an ACK back so more ids can share it
+#define pconfigARQ_ACK_TIMEOUT_MS (4000) // Time to wait for an ACK before retransmitting, backoff is added per retry
+
+// Channel access (CSMA/CA)
+#define pconfigCSMA_LISTEN_TIME_MS (20)        // Channel must be idle this long before transmitting
+#define pconfigCSMA_ENERGY_THRESHOLD (4.0f)    // In-band energy this far over the noise floor means the channel is busy, 6 dB like the squelch
+
+// Multi-hop routing and relaying
+#define pconfigROUTE_ADVERT_INTERVAL_S (60)      // Shortest time between advertisements of the whole routing table
+#define pconfigROUTE_ADVERT_MAX_INTERVAL_S (900)  // Longest, big tables in busy neighborhoods are stretched up to this, at most 2550
+#define pconfigROUTE_ADVERT_SHARE_PERCENT (10)    // Channel time the neighborhood's whole table advertisements should take at most
+#define pconfigROUTE_UPDATE_DELAY_S (5)           // Lost routes are advertised this long after the first is lost, with any others lost meanwhile
+#define pconfigROUTE_TIMEOUT_S (200)              // Routes and neighbors not refreshed for this long are dropped, or 3 of the neighbor's advert intervals if longer
+#define pconfigROUTE_MAX_NEIGHBORS (16)     // Directly heard nodes we keep link quality for
+#define pconfigROUTE_MIN_SNR_DB (10.0f)     // Links weaker than this cost an extra hop
+#define pconfigRELAY_CACHE_SIZE (32)        // Flooded packets remembered for duplicate suppression
+#define pconfigRELAY_CACHE_TIME_MS (3000)   // How long a flooded packet is remembered, must stay below pconfigARQ_ACK_TIMEOUT_MS
+
 #define pconfigTTL 10 // Default Time To Live for packets, can be adjusted based on network size and requirements
 
 // Default Encoder/Decoder Configurations
@@ -24,13 +64,23 @@
 #define pconfigMODEM_FREQ_0 (1200)
 #define pconfigMODEM_FREQ_1 (2200)
 
+// Adaptive data rate, frames to a single next hop go out at 2x or 3x pconfigBAUD_RATE when the link allows it
+#define pconfigADAPTIVE_RATE_ENABLED (1)
+#define pconfigRATE_2X_MIN_SNR_DB (16.5f)      // Link SNR, as measured at the base rate, needed for 2x
+#define pconfigRATE_3X_MIN_SNR_DB (17.3f)      // Link SNR, as measured at the base rate, needed for 3x
+#define pconfigRATE_MIN_DELIVERY_RATIO (0.9f)  // Lossy links stay at the base rate whatever their SNR
+
+#define pconfigSAMPLE_FORMAT (PC_SAMPLE_FORMAT_U12) // Format the ADC BSP delivers samples in
 #define pconfigFSK_POWER_THRESHOLD (0.5f)      // Power threshold for FSK decoding (tune based on testing environment)
 #define pconfigDECODER_BUFFER_SYMBOL_COUNT (32) // Multiple of symbol size
+#define pconfigDECODER_INPUT_BLOCKS (2)         // Blocks the decoder input is split into, 2 = ping-pong halves for a DMA half/complete interrupt
 #define pconfigDECODER_OUTPUT_BUFFER_SIZE (10)  // Number of packets that can be buffered for the application to read
+#define pconfigFSK_BANK_MAX_CHANNELS (4)        // Tone pairs an FSK bank decodes from one ADC, each costs a decoder, byte and packet assembler
 
 // Modem
-#define pconfigMODEM_TX_BUFFER_SIZE (pconfigMAX_PAYLOAD_SIZE * 2) // Buffer for outgoing data to be transmitted, should be multiple of max payload size
-#define pconfigPTT_DELAY_MS (500)                                 // Delay between setting PTT high and starting transmission to allow hardware to stabilize
+#define pconfigMAX_FRAMES_PER_KEYING (4)                                                        // Queued packets sent back to back under one PTT keying
+#define pconfigMODEM_TX_BUFFER_SIZE (pconfigMAX_PAYLOAD_SIZE * 2 * pconfigMAX_FRAMES_PER_KEYING) // Buffer for outgoing data to be transmitted, should be multiple of max payload size
+#define pconfigPTT_DELAY_MS (500)                                                               // Delay between setting PTT high and starting transmission to allow hardware to stabilize
 
 // Sampling rates & symbol sizes
 #define OVERSAMPLING_FACTOR (3)
@@ -45,5 +95,9 @@
 
 // DEBUG CONFIGURATIONS
 #define pconfig_DEBUG_RECORDING_ENABLED (0) // Enables ADC & filter recording for debugging purposes, can be used to generate test data for unit tests
+#ifndef pconfigTRACE_ENABLED
+#define pconfigTRACE_ENABLED (0)            // Timestamps received frames at each pipeline stage, see pc_trace_dump. Compiled out when 0, builds can pass -DpconfigTRACE_ENABLED=1
+#endif
+#define pconfigTRACE_BUFFER_SIZE (256)      // Trace events kept, the oldest are overwritten
 
 #endif // pconfig_H
\ No newline at end of file
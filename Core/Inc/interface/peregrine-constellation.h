@@ -4,22 +4,100 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 // Error codes
 typedef enum {
     PC_SUCCESS = 0,
-    PC_ERROR_INVALID_HANDLE
+    PC_ERROR_INVALID_HANDLE,
+    PC_ERROR_QUEUE_FULL,        // TX queue is full, try again after pc_task has had time to send
+    PC_ERROR_MESSAGE_TOO_LARGE, // Message is larger than pconfigMAX_MESSAGE_SIZE
+    PC_ERROR_INVALID_CONFIG     // Parameter out of range, nothing was changed
 } pc_error_e;
 
+// Format the ADC BSP delivers samples in, all of them carried in a uint16_t
+typedef enum {
+    PC_SAMPLE_FORMAT_U12 = 0, // 12-bit ADC, 0-4095 centered on 2048
+    PC_SAMPLE_FORMAT_U16,     // 16-bit ADC, 0-65535 centered on 32768
+    PC_SAMPLE_FORMAT_S16      // Signed 16-bit sound card samples cast to uint16_t
+} pc_sample_format_e;
+
 typedef void (*message_callback_t)(const uint8_t *data, size_t len, uint8_t src_addr);
 
+// Reports whether a unicast message was acknowledged (delivered = true) or gave up after pconfigMAX_RETRIES
+typedef void (*send_callback_t)(uint8_t dest_addr, uint8_t message_id, bool delivered);
+
+// Modem and node parameters, pc_default_config() fills in the compile-time profile from pconfig.h.
+// Only the decoder input buffer is sized from it. The packet queues, the modem TX buffer
+// (pconfigMODEM_TX_BUFFER_SIZE), the RX packet buffer (pconfigRX_BUFFER_SIZE) and the reassembly
+// slots (pconfigREASSEMBLY_SLOTS of pconfigMAX_MESSAGE_SIZE) stay compile-time, inside the handle.
+typedef struct pc_config
+{
+    uint8_t device_address;             // 8-bit address for this device
+    int baud_rate;                      // Base symbol rate, faster link rates are multiples of it
+    int freq_0;                         // Tone for bit 0 in Hz
+    int freq_1;                         // Tone for bit 1 in Hz
+    int sample_rate;                    // ADC sample rate in Hz, 0 = derived from the tones and baud rate
+    pc_sample_format_e sample_format;   // Format of the ADC samples, DC offset and level are tracked whatever it is
+    float fsk_power_threshold;          // Tone metric needed to decode a bit
+    float csma_energy_threshold;        // In-band energy over the noise floor, as a ratio, above which the channel is busy
+    size_t decoder_buffer_symbol_count; // Symbols of ADC samples buffered ahead of the decoder
+    uint32_t ptt_delay_ms;              // Delay between keying up and the first symbol
+} pc_config_t;
+
+// Counters since pc_init, cheap enough to stay on in production. Each one is read atomically,
+// but they aren't sampled at the same instant, so related counters can be off by a frame.
+typedef struct pc_stats
+{
+    uint32_t samples_processed;  // ADC samples run through the demodulator
+    uint32_t samples_idle;       // of which the channel was quiet and the tone filters slept through
+    uint32_t preambles_detected; // Sync words found in the bit stream
+    uint32_t frames_crc_passed;  // Received frames with a valid CRC
+    uint32_t frames_crc_failed;  // Received frames dropped for a CRC mismatch
+    uint32_t length_rejects;     // Received headers dropped for an impossible payload length
+    uint32_t buffer_overflows;   // Samples or packets dropped because a buffer was full
+    uint32_t frames_sent;        // Frames transmitted
+    uint32_t airtime_ms;         // Time spent keyed up
+    uint32_t backoffs;           // Times the channel was busy and transmission backed off
+} pc_stats_t;
+
 typedef struct pc_handle pc_handle_t;
 
-// Initialize the library with the node address
-pc_handle_t *pc_init(message_callback_t callback);
+// Fill in the default profile from pconfig.h
+void pc_default_config(pc_config_t *config);
+
+// Bytes pc_init needs for a config (NULL = default profile), 0 if the config is invalid
+size_t pc_required_memory(const pc_config_t *config);
+
+// Initialize the library, config = NULL uses the default profile. All state is placed in memory,
+// which must hold pc_required_memory(config) bytes and outlive the handle. memory = NULL allocates it once from the heap.
+pc_handle_t *pc_init(const pc_config_t *config, message_callback_t callback, void *memory, size_t memory_size);
+
+// Shut the library down. Memory pc_init allocated is freed, memory the caller passed in is theirs to reuse.
+// The handle is invalid afterwards
+pc_error_e pc_deinit(pc_handle_t *handle);
+
+// Set the callback for delivery status of unicast messages
+pc_error_e pc_set_send_callback(pc_handle_t *handle, send_callback_t callback);
+
+// Send a message, split into several packets if needed. message_id (optional) receives the id later reported to the send callback
+pc_error_e pc_send_message(pc_handle_t *handle, uint8_t dest_addr, const uint8_t *payload, size_t payload_length, uint8_t *message_id);
+
+// Change the tones at runtime, the decoder filters are redesigned before the next sample
+pc_error_e pc_set_frequencies(pc_handle_t *handle, int freq_0, int freq_1);
+
+// Change the bit decision threshold at runtime
+pc_error_e pc_set_power_threshold(pc_handle_t *handle, float threshold);
+
+// Change the carrier sense threshold at runtime
+pc_error_e pc_set_csma_threshold(pc_handle_t *handle, float threshold);
+
+// Read the counters, safe to call from another thread than pc_task
+pc_error_e pc_get_stats(pc_handle_t *handle, pc_stats_t *stats);
 
-// Send a message
-pc_error_e pc_send_message(pc_handle_t *handle, uint8_t dest_addr, const uint8_t *payload, size_t payload_length);
+// Write the frame latency trace as Chrome trace JSON, snprintf style: returns the full length even if size was too small.
+// Needs pconfigTRACE_ENABLED, otherwise the trace is empty
+size_t pc_trace_dump(char *buffer, size_t size);
 
 // Update function to be called periodically to handle retries
 void pc_task(pc_handle_t *handle);
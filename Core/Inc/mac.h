@@ -0,0 +1,40 @@
+#ifndef MAC_H
+#define MAC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "utils/time_utils.h"
+#include "utils/stats.h"
+
+typedef enum mac_state
+{
+    MAC_STATE_IDLE,    ///< Nothing waiting to be sent
+    MAC_STATE_LISTEN,  ///< Sensing the channel before transmitting
+    MAC_STATE_BACKOFF, ///< Waiting out a random backoff after finding the channel busy
+    MAC_STATE_CLEAR,   ///< Channel has been idle for the full listen window
+} mac_state_e;
+
+typedef struct
+{
+    mac_state_e state;
+
+    HAL_timer_t listen_timer;  ///< Channel must stay idle this long before we transmit
+    HAL_timer_t backoff_timer; ///< Random delay after the channel was found busy
+    uint8_t backoff_exponent;  ///< Binary exponential backoff stage, reset after every transmission
+
+    uint32_t rng_state; ///< xorshift32 state used to pick backoff delays
+
+    struct
+    {
+        stat_counter_t attempts;      ///< Number of times the channel was sensed on behalf of a pending frame
+        stat_counter_t collisions;    ///< Number of times the channel was found busy and a backoff started
+        stat_counter_t transmissions; ///< Number of times the MAC granted access to the channel
+    } stats;
+} mac_handle_t;
+
+int mac_init(mac_handle_t *handle, uint32_t seed);
+bool mac_clear_to_send(mac_handle_t *handle, bool channel_busy);
+int mac_transmission_started(mac_handle_t *handle);
+int mac_reset(mac_handle_t *handle);
+
+#endif // MAC_H
@@ -8,7 +8,21 @@
 #include "utils/circular_buffer.h"
 #include "utils/time_utils.h"
 #include "utils/bit_unpacker.h"
+#include "utils/arena.h"
 #include "encoding/bit_stuffer.h"
+#include "interface/peregrine-constellation.h"
+
+#define MODEM_SYNC_WORD_SIZE (2)                                          // Preamble bytes in front of every frame
+#define MODEM_RATE_SIZE (1)                                               // Rate byte following the sync word
+#define MODEM_FRAME_HEADER_SIZE (MODEM_SYNC_WORD_SIZE + MODEM_RATE_SIZE) // Sent at the base rate without bit stuffing
+
+// One frame within a transmission, several can go out under one PTT keying
+typedef struct
+{
+    uint16_t length;           ///< Bytes in the TX buffer belonging to this frame, including the sync word
+    uint16_t unstuffed_length; ///< Leading bytes sent without bit stuffing at the base rate (the frame header)
+    fsk_rate_e rate;           ///< Rate the rest of the frame is sent at
+} modem_frame_t;
 
 typedef enum modem_state
 {
@@ -21,6 +35,7 @@ typedef enum modem_state
 typedef struct
 {
     modem_state_e state;
+    pc_config_t config; ///< Tones, rates and thresholds, sample_rate is always filled in
 
     // Orchestrator ctx
     void *orchestrator_ctx;
@@ -35,21 +50,40 @@ typedef struct
     HAL_timer_t ptt_timer;       //< Delay between setting PTT high and starting transmission to allow hardware to stabilize
     circular_buffer_t tx_buffer; ///< Buffer for outgoing data to be transmitted
     uint8_t tx_array[pconfigMODEM_TX_BUFFER_SIZE];
+    circular_buffer_t tx_frame_buffer; ///< Boundaries of the frames queued in tx_buffer
+    modem_frame_t tx_frame_array[pconfigMAX_FRAMES_PER_KEYING];
     bool transmitting;           ///< Flag to indicate if the modem is currently transmitting
 
     bit_unpacker_t bit_unpacker; ///< Bit unpacker for converting byte stream to bits for transmission
     bit_stuffer_t bit_stuffer;   ///< Bit stuffer for inserting stuffed bits during transmission
 
-    uint8_t preamble_sent; ///< Counter for how many preamble bits have been sent so far
+    uint32_t frame_bits_remaining; ///< Data bits left in the frame being sent, stuffed bits not included
+    uint32_t preamble_remaining;   ///< Frame header bits left before bit stuffing starts
+    fsk_rate_e frame_rate;         ///< Rate of the frame being sent
+    uint64_t keyed_at_us;          ///< When PTT went high for the current transmission
+
+    struct
+    {
+        stat_counter_t frames_sent; ///< Frames started on air
+        stat_counter_t airtime_ms;  ///< Time spent keyed up, PTT delay included
+    } stats;
 } modem_handle_t;
 
-int modem_init(modem_handle_t *handle, void *orchestrator_ctx);
+size_t modem_required_memory(const pc_config_t *config); // Arena space modem_init needs beyond the handle
+int modem_init(modem_handle_t *handle, const pc_config_t *config, arena_t *arena, void *orchestrator_ctx);
+int modem_set_frequencies(modem_handle_t *handle, int freq_0, int freq_1);
+int modem_set_power_threshold(modem_handle_t *handle, float threshold);
+int modem_set_csma_threshold(modem_handle_t *handle, float threshold);
 
 int modem_send_raw(modem_handle_t *handle, circular_buffer_t *cb);
 int modem_send_packet(modem_handle_t *handle, const packet_t *packet);
+int modem_queue_packet(modem_handle_t *handle, const packet_t *packet, fsk_rate_e rate); // Add to next transmission without keying up
+bool modem_can_queue_packet(modem_handle_t *handle);
+int modem_start_tx(modem_handle_t *handle);
 bool modem_rx_busy(modem_handle_t *handle); // actively receiving
 bool modem_tx_busy(modem_handle_t *handle); // actively transmitting
 bool modem_busy(modem_handle_t *handle);    // rx or tx busy
+bool modem_channel_busy(modem_handle_t *handle); // carrier or in-band energy present
 int modem_task(modem_handle_t *handle);
 
 #endif // MODEM_H
\ No newline at end of file
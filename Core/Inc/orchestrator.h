@@ -5,26 +5,50 @@
 #include "interface/pconfig.h"
 #include "utils/time_utils.h"
 #include "modem.h"
+#include "mac.h"
+#include "arq.h"
+#include "tx_scheduler.h"
+#include "fragmentation.h"
+#include "routing.h"
 
 // Callback type for when a packet is received and decoded, allowing the application to process it
 typedef void (*rx_callback_t)(const uint8_t *data, size_t len, uint8_t src_addr);
 
+// Callback for when a unicast message is acknowledged (delivered = true) or runs out of retries
+typedef void (*tx_callback_t)(uint8_t dest_addr, uint8_t id, bool delivered);
+
 typedef struct orchestrator_handle
 {
+    uint8_t address;           //< Our node address
     modem_handle_t modem;      //< Modem handle for managing RX/TX timing, tones, PTT, and such
+    mac_handle_t mac;          //< Channel access (listen-before-talk and backoff)
+    arq_handle_t arq;          //< Acknowledgements and retransmission of unicast data
+    fragmentation_handle_t fragmentation; //< Splitting and reassembly of messages larger than one packet
+    routing_handle_t routing;  //< Next hop selection and relaying
     rx_callback_t rx_callback; //< Callback for when a data packet is received and decoded for the application layer
+    tx_callback_t tx_callback; //< Callback for delivery status of unicast messages
 
     circular_buffer_t rx_packet_buffer; //< Inbound packets
     packet_t rx_packet_array[pconfigRX_BUFFER_SIZE];
-    circular_buffer_t tx_packet_buffer; //< Outbound packets
-    packet_t tx_packet_array[pconfigTX_BUFFER_SIZE];
+    tx_scheduler_t tx_scheduler; //< Outbound packets, queued per traffic class
 
     HAL_timer_t beacon_timer;
+    uint8_t broadcast_id; //< Id counter for broadcast packets, unicast ids come from the ARQ
+    uint8_t rx_message[pconfigMAX_MESSAGE_SIZE]; //< Reassembled message handed to the RX callback
+#if pconfigCOMPRESSION_ENABLED
+    uint8_t tx_compressed[pconfigMAX_MESSAGE_SIZE];   //< Compressed message being split into packets
+    uint8_t rx_decompressed[pconfigMAX_MESSAGE_SIZE]; //< Decompressed message handed to the RX callback
+#endif
 } orchestrator_handle_t;
 
-int orchestrator_init(orchestrator_handle_t *handle, rx_callback_t rx_callback);
+size_t orchestrator_required_memory(const pc_config_t *config);
+int orchestrator_init(orchestrator_handle_t *handle, const pc_config_t *config, arena_t *arena, rx_callback_t rx_callback);
+
+int orchestrator_set_tx_callback(orchestrator_handle_t *handle, tx_callback_t tx_callback);
+
+bool orchestrator_can_send(orchestrator_handle_t *handle, size_t len, uint8_t dest_addr);
 
-int orchestrator_send(orchestrator_handle_t *handle, const uint8_t *data, size_t len, uint8_t dest_addr);
+int orchestrator_send(orchestrator_handle_t *handle, const uint8_t *data, size_t len, uint8_t dest_addr, uint8_t *id);
 
 int orchestrator_task(orchestrator_handle_t *handle);
 
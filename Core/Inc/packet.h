@@ -12,13 +12,31 @@
         sizeof(uint8_t) + /* dest_addr */      \
         sizeof(uint8_t) + /* id */             \
         sizeof(uint8_t) + /* ttl/type byte */  \
+        sizeof(uint8_t) + /* flags */          \
         sizeof(uint8_t) + /* payload_length */ \
         sizeof(uint16_t)  /* crc */            \
     )
 
-#define PACKET_SIZE          \
-    (                        \
-        PACKET_HEADER_SIZE + \
+// Header extension following the header when PACKET_FLAG_FRAGMENT is set
+#define PACKET_FRAGMENT_EXTENSION_SIZE       \
+    (                                        \
+        sizeof(uint8_t) + /* message_id */   \
+        sizeof(uint8_t) + /* index */        \
+        sizeof(uint8_t)   /* count */        \
+    )
+
+// Header extension following the fragment extension when PACKET_FLAG_NEXT_HOP is set
+#define PACKET_NEXT_HOP_EXTENSION_SIZE (sizeof(uint8_t))
+
+// Header extension following the next hop extension when PACKET_FLAG_SESSION is set
+#define PACKET_SESSION_EXTENSION_SIZE (sizeof(uint8_t))
+
+#define PACKET_MAX_EXTENSION_SIZE (PACKET_FRAGMENT_EXTENSION_SIZE + PACKET_NEXT_HOP_EXTENSION_SIZE + PACKET_SESSION_EXTENSION_SIZE)
+
+#define PACKET_SIZE                 \
+    (                               \
+        PACKET_HEADER_SIZE +        \
+        PACKET_MAX_EXTENSION_SIZE + \
         pconfigMAX_PAYLOAD_SIZE)
 
 typedef enum
@@ -26,8 +44,17 @@ typedef enum
     PACKET_TYPE_BEACON = 0x0, //< Broadcasts callsign to satisfy the FCC
     PACKET_TYPE_DATA = 0x1,   //< Application layer data
     PACKET_TYPE_ACK = 0x2,    //< Acknowledgement for data packet received
+    PACKET_TYPE_ROUTE = 0x3,  //< Route advertisement for neighbors, never relayed
 } packet_type_e;
 
+typedef enum
+{
+    PACKET_FLAG_FRAGMENT = 0x01,   //< Payload is one piece of a larger message, fragment extension follows the header
+    PACKET_FLAG_COMPRESSED = 0x02, //< Message was compressed before fragmenting, see encoding/compression.h
+    PACKET_FLAG_NEXT_HOP = 0x04,   //< Only the node named in the next hop extension relays this packet, otherwise it's flooded
+    PACKET_FLAG_SESSION = 0x08,    //< Sender's ARQ session follows, sent until the destination first acknowledges it, see arq.h
+} packet_flag_e;
+
 typedef struct
 {
     /**
@@ -35,7 +62,17 @@ typedef struct
      */
     struct
     {
-
+        // Measured while receiving, all 0 for locally built packets
+        float snr_db;          //< Average tone envelope SNR over the packet's bits
+        uint64_t sync_sample;  //< Decoder input sample the sync word ended on, corrected for filter delay
+        uint64_t sync_time_us; //< When the sync word ended on the air, in time_bsp_get_us time
+        float tone_0_level;    //< Average envelope power of the freq_0 tone over the packet's bits, a signal strength proxy
+        float tone_1_level;    //< Average envelope power of the freq_1 tone over the packet's bits
+        float metric_margin;   //< Average of how far the bit decisions cleared the power threshold
+        uint16_t stuffed_bits; //< Stuffed bits removed from the frame
+#if pconfigTRACE_ENABLED
+        uint32_t trace_id; //< Ties the frame's trace events together, 0 for locally built packets
+#endif
     } metadata;
 
     /**
@@ -48,13 +85,27 @@ typedef struct
         uint8_t id;
         uint8_t ttl : 4;
         uint8_t type : 4;
+        uint8_t flags; //< packet_flag_e bits, also decide which header extensions are on the wire
         uint8_t payload_length;
         uint16_t crc;
+
+        struct
+        {
+            uint8_t message_id; //< Same for every fragment of a message from one source
+            uint8_t index;
+            uint8_t count;
+        } fragment; //< Only valid with PACKET_FLAG_FRAGMENT
+
+        uint8_t next_hop; //< Only valid with PACKET_FLAG_NEXT_HOP
+        uint8_t session;  //< Only valid with PACKET_FLAG_SESSION
+
         uint8_t payload[pconfigMAX_PAYLOAD_SIZE];
     } content;
 } packet_t;
 
 uint16_t calculate_crc(const packet_t *packet);
+size_t packet_extension_size(uint8_t flags);
+int packet_set_fragment(packet_t *packet, uint8_t message_id, uint8_t index, uint8_t count);
 int initialize_packet(packet_t *packet, packet_type_e packet_type, uint16_t src_addr, uint16_t dest_addr, uint8_t id, const uint8_t *payload, size_t payload_length);
 void print_packet(const packet_t *packet);
 #endif // PACKET_H
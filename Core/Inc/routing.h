@@ -0,0 +1,88 @@
+#ifndef ROUTING_H
+#define ROUTING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "packet.h"
+#include "interface/pconfig.h"
+#include "utils/time_utils.h"
+
+#define ROUTING_TABLE_SIZE (256)      // One entry per 8-bit address
+#define ROUTING_METRIC_INFINITY (0xFF) // No route
+
+typedef struct
+{
+    uint8_t next_hop;
+    uint8_t metric;      ///< Sum of link costs to the destination, ROUTING_METRIC_INFINITY if unknown
+    bool withdrawn;      ///< Lost since the last whole table, which advertises it as unreachable once
+    bool changed;        ///< Withdrawn and waiting for the next update, which goes out ahead of the whole table
+    uint32_t updated_ms; ///< Last time an advertisement confirmed this route, or when it was withdrawn
+} routing_entry_t;
+
+typedef struct
+{
+    bool in_use;
+    uint8_t addr;
+    bool seq_valid;
+    uint8_t last_seq;      ///< Id of the last route advertisement heard, gaps are counted as losses
+    float delivery_ratio;  ///< Smoothed fraction of advertisements received, covers CRC failures and collisions
+    float snr_db;          ///< Smoothed tone envelope SNR of packets heard from this neighbor
+    uint16_t advert_interval_s; ///< How often it advertises its whole table, 0 until it has said
+    uint32_t last_heard_ms;
+} routing_neighbor_t;
+
+typedef struct
+{
+    bool in_use;
+    uint8_t src_addr;
+    uint8_t id;
+    uint16_t identity; ///< CRC over the fields relays don't change
+    uint32_t seen_ms;
+} routing_seen_t;
+
+typedef struct
+{
+    uint8_t address; ///< Our own address
+    int baud_rate;   ///< Base rate adverts go out at, their airtime sets advert_interval_s
+
+    routing_entry_t routes[ROUTING_TABLE_SIZE];
+    routing_neighbor_t neighbors[pconfigROUTE_MAX_NEIGHBORS];
+
+    routing_seen_t seen[pconfigRELAY_CACHE_SIZE]; ///< Recently seen flooded packets
+    size_t seen_next;
+
+    HAL_timer_t advert_timer;    ///< Runs for advert_interval_s between whole table advertisements
+    uint16_t advert_interval_s;  ///< Stretched past pconfigROUTE_ADVERT_INTERVAL_S as the table and neighborhood grow
+    HAL_timer_t update_timer;    ///< Holds withdrawals back pconfigROUTE_UPDATE_DELAY_S so they share advertisements
+    bool update_scheduled;       ///< update_timer is running
+    bool advert_pending;         ///< Set for each round until every entry in it has been advertised
+    bool advert_full;            ///< The round carries the whole table, otherwise only withdrawals
+    uint16_t advert_cursor;      ///< Next table entry to advertise
+    uint8_t advert_seq;
+
+    struct
+    {
+        uint32_t relayed;
+        uint32_t flooded;
+        uint32_t duplicates;
+        uint32_t ttl_expired;
+        uint32_t adverts_sent;
+        uint32_t adverts_received;
+    } stats;
+} routing_handle_t;
+
+int routing_init(routing_handle_t *handle, uint8_t address, int baud_rate);
+int routing_task(routing_handle_t *handle);
+
+int routing_handle_packet(routing_handle_t *handle, const packet_t *packet);
+bool routing_seen_before(routing_handle_t *handle, const packet_t *packet);
+bool routing_relay(routing_handle_t *handle, const packet_t *packet, packet_t *relay);
+
+int routing_next_hop(routing_handle_t *handle, uint8_t dest_addr, uint8_t *next_hop);
+int routing_set_next_hop(routing_handle_t *handle, packet_t *packet);
+int routing_link_quality(routing_handle_t *handle, uint8_t neighbor_addr, float *snr_db, float *delivery_ratio);
+
+bool routing_advert_pending(routing_handle_t *handle);
+int routing_get_advert(routing_handle_t *handle, packet_t *packet);
+
+#endif // ROUTING_H
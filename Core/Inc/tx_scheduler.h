@@ -0,0 +1,58 @@
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "packet.h"
+#include "interface/pconfig.h"
+#include "utils/circular_buffer.h"
+
+typedef enum
+{
+    TX_CLASS_CONTROL = 0, //< Link control (ACKs, routing), always sent first
+    TX_CLASS_BEACON,      //< Callsign beacons, sent ahead of any data
+    TX_CLASS_RELAY,       //< Packets forwarded on behalf of other nodes
+    TX_CLASS_APPLICATION, //< Locally originated application data
+    TX_CLASS_COUNT
+} tx_class_e;
+
+// Lets the owner hold back the packet at the head of a queue (e.g. while the ARQ window is full)
+typedef bool (*tx_eligible_callback_t)(const packet_t *packet, void *ctx);
+
+typedef struct
+{
+    circular_buffer_t buffer;
+    int32_t deficit;  //< Bytes this queue may still send in the current round robin turn
+    uint32_t quantum; //< Bytes added to the deficit every turn, 0 for strict priority queues
+} tx_queue_t;
+
+typedef struct
+{
+    tx_queue_t queues[TX_CLASS_COUNT];
+    tx_class_e drr_current; //< Queue whose round robin turn it is
+
+    tx_eligible_callback_t eligible_callback;
+    void *eligible_ctx;
+
+    packet_t control_array[pconfigTX_CONTROL_QUEUE_SIZE];
+    packet_t beacon_array[pconfigTX_BEACON_QUEUE_SIZE];
+    packet_t relay_array[pconfigTX_RELAY_QUEUE_SIZE];
+    packet_t application_array[pconfigTX_APPLICATION_QUEUE_SIZE];
+
+    struct
+    {
+        uint32_t sent[TX_CLASS_COUNT];
+        uint32_t rejected[TX_CLASS_COUNT]; //< Pushes refused because the queue was full
+    } stats;
+} tx_scheduler_t;
+
+int tx_scheduler_init(tx_scheduler_t *handle, tx_eligible_callback_t eligible_callback, void *eligible_ctx);
+
+int tx_scheduler_push(tx_scheduler_t *handle, tx_class_e tx_class, const packet_t *packet);
+bool tx_scheduler_full(tx_scheduler_t *handle, tx_class_e tx_class);
+size_t tx_scheduler_space(tx_scheduler_t *handle, tx_class_e tx_class);
+
+bool tx_scheduler_pending(tx_scheduler_t *handle);
+int tx_scheduler_pop(tx_scheduler_t *handle, packet_t *packet);
+
+#endif // TX_SCHEDULER_H
@@ -0,0 +1,22 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGNMENT (_Alignof(max_align_t))
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Bump allocator over caller-provided memory, nothing is freed individually
+typedef struct
+{
+    uint8_t *base; // Start of the memory, aligned
+    size_t size;   // Usable bytes from base
+    size_t used;   // Bytes handed out so far
+} arena_t;
+
+int arena_init(arena_t *arena, void *memory, size_t size);
+void *arena_alloc(arena_t *arena, size_t size);
+size_t arena_remaining(const arena_t *arena);
+
+#endif // ARENA_H
@@ -0,0 +1,42 @@
+#ifndef BLOCK_RING_H
+#define BLOCK_RING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "utils/stats.h"
+
+#define BLOCK_RING_MAX_BLOCKS (8)
+
+// Single producer, single consumer ring of fixed-size blocks over caller memory. The producer
+// (a DMA interrupt, a capture thread or a polled BSP) fills a block in place and commits it,
+// the consumer works through it in place and releases it. With two blocks it's a ping-pong
+// buffer. Each side only writes its own index, the blocks change hands through their lengths.
+typedef struct
+{
+    void *buffer;        // Caller memory, block_count * block_size elements
+    size_t element_size; // Size of each element
+    size_t block_size;   // Elements per block
+    size_t block_count;  // Blocks in the ring, at most BLOCK_RING_MAX_BLOCKS
+
+    atomic_size_t lengths[BLOCK_RING_MAX_BLOCKS]; // Elements committed to each block, 0 = free for the producer
+
+    size_t write_block; // Producer only, the block being filled
+    size_t read_block;  // Consumer only, the oldest committed block
+
+    stat_counter_t overflows; // Elements the producer dropped for want of a free block, see block_ring_drop
+} block_ring_t;
+
+int block_ring_init(block_ring_t *ring, void *buffer, size_t element_size, size_t block_size, size_t block_count);
+
+// Producer side
+void *block_ring_acquire(block_ring_t *ring, size_t *capacity);
+int block_ring_commit(block_ring_t *ring, size_t count);
+void block_ring_drop(block_ring_t *ring, size_t count); // Counts elements discarded because acquire found no free block
+
+// Consumer side
+const void *block_ring_peek(block_ring_t *ring, size_t *count);
+int block_ring_release(block_ring_t *ring);
+bool block_ring_is_empty(block_ring_t *ring);
+
+#endif // BLOCK_RING_H
@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include "utils/stats.h"
 
 typedef struct
 {
@@ -14,6 +15,7 @@ typedef struct
     size_t max;          // Maximum number of elements in the buffer
     bool full;           // Flag to indicate if the buffer is full
     bool dynamic;        // Flag to indicate if the buffer was dynamically allocated
+    stat_counter_t overflows; // Pushes dropped because the buffer was full
 } circular_buffer_t;
 
 int circular_buffer_static_init(circular_buffer_t *cb, void *buffer, size_t element_size, size_t max);
@@ -1,6 +1,23 @@
 #ifndef FSK_UTILS_H
 #define FSK_UTILS_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+// Symbol rates a frame can be sent at, as multiples of the configured base baud rate.
+// The sync word and rate byte always go out at FSK_RATE_BASE.
+typedef enum
+{
+    FSK_RATE_BASE,
+    FSK_RATE_2X,
+    FSK_RATE_3X,
+    FSK_RATE_COUNT,
+} fsk_rate_e;
+
 int calculate_sample_rate(double f1, double f2, double baud);
 
+int fsk_rate_baud(int base_baud_rate, fsk_rate_e rate);
+uint8_t fsk_rate_encode(fsk_rate_e rate);
+int fsk_rate_decode(uint8_t byte, fsk_rate_e *rate);
+
 #endif // FSK_UTILS_H
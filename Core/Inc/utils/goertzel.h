@@ -7,4 +7,29 @@
 int goertzel_compute_power(const uint16_t *samples, int num_samples, float target_freq, float sample_rate, float *power);
 int goertzel_compute_power_circular_buff(const circular_buffer_t *cb, int num_samples, float target_freq, float sample_rate, float *power);
 
+// Goertzel fed one sample at a time, for blocks that don't sit in one buffer
+typedef struct
+{
+    float coeff; // 2 cos(2 pi f / fs)
+    float s1, s2;
+} goertzel_t;
+
+void goertzel_init(goertzel_t *g, float target_freq, float sample_rate);
+
+static inline void goertzel_process(goertzel_t *g, float x)
+{
+    float s = x + g->coeff * g->s1 - g->s2;
+    g->s2 = g->s1;
+    g->s1 = s;
+}
+
+// Power of the block fed since the last call, starts the next block
+static inline float goertzel_finish(goertzel_t *g)
+{
+    float power = g->s2 * g->s2 + g->s1 * g->s1 - g->coeff * g->s1 * g->s2;
+    g->s1 = 0.0f;
+    g->s2 = 0.0f;
+    return power;
+}
+
 #endif // GOERTZEL_H
\ No newline at end of file
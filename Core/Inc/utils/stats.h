@@ -0,0 +1,16 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Counters bumped by the task or ISR that owns them and read from anywhere through pc_get_stats.
+// Relaxed ordering keeps each update a single atomic add, every counter is exact on its own
+// but a snapshot of several isn't taken at one instant.
+typedef atomic_uint_least32_t stat_counter_t;
+
+#define STAT_INC(counter) atomic_fetch_add_explicit(&(counter), 1, memory_order_relaxed)
+#define STAT_ADD(counter, n) atomic_fetch_add_explicit(&(counter), (n), memory_order_relaxed)
+#define STAT_GET(counter) ((uint32_t)atomic_load_explicit(&(counter), memory_order_relaxed))
+
+#endif // STATS_H
@@ -17,5 +17,6 @@ typedef struct
 void time_utils_start(HAL_timer_t *timer, uint64_t duration_us);
 bool time_utils_done(HAL_timer_t *timer);
 void time_utils_reset(HAL_timer_t *timer);
+void time_utils_set_duration(HAL_timer_t *timer, uint64_t duration_us);
 
 #endif // TIME_UTILS_H
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "interface/pconfig.h"
+
+// Pipeline boundaries a received frame is stamped at
+typedef enum
+{
+    TRACE_STAGE_SYNC_DETECTED, ///< Sync word found, the frame gets its trace id here
+    TRACE_STAGE_HEADER_PARSED, ///< Header passed the payload length check
+    TRACE_STAGE_CRC_VALIDATED, ///< Last byte in and the CRC matched, pushed to the decoder output buffer
+    TRACE_STAGE_QUEUED,        ///< Taken out of the decoder and pushed to the orchestrator RX buffer
+    TRACE_STAGE_DELIVERED,     ///< Handled by pc_task, rx_callback included for data addressed to us
+    TRACE_STAGE_COUNT,
+} trace_stage_e;
+
+#if pconfigTRACE_ENABLED
+
+typedef struct
+{
+    uint64_t timestamp_us;
+    uint32_t frame; ///< Trace id of the frame, 0 is never used
+    uint8_t stage;  ///< trace_stage_e
+} trace_event_t;
+
+void trace_frame_start(uint32_t *frame);
+void trace_record(trace_stage_e stage, uint32_t frame);
+
+#define TRACE_FRAME_START(packet) trace_frame_start(&(packet)->metadata.trace_id)
+#define TRACE_FRAME(stage, packet) trace_record((stage), (packet)->metadata.trace_id)
+
+#else
+
+#define TRACE_FRAME_START(packet) ((void)0)
+#define TRACE_FRAME(stage, packet) ((void)0)
+
+#endif // pconfigTRACE_ENABLED
+
+// Microsecond timestamp source, the orchestrator installs time_bsp_get_us
+typedef uint64_t (*trace_clock_t)(void);
+
+void trace_set_clock(trace_clock_t clock); // Always available, events are stamped 0 until a clock is set
+size_t trace_dump_chrome_json(char *buffer, size_t size); // Always available, writes an empty trace when compiled out
+void trace_clear(void);
+
+#endif // TRACE_H
@@ -0,0 +1,544 @@
+/**
+ * @file arq.c
+ *
+ * @author Diamond42474
+ *
+ * Reliable delivery for unicast data packets. Every destination gets its own
+ * sequence space over the packet id. Up to pconfigARQ_WINDOW_SIZE packets can
+ * be in flight at once, each with a retransmit timer that backs off on every
+ * retry. Receivers collect the ids they've seen and acknowledge several of
+ * them in one short ACK frame.
+ *
+ * Ids alone can't tell a sender that restarted at 0 from one retransmitting,
+ * so every sequence also gets a session. It's sent in the header until the
+ * destination acknowledges something, and a receiver seeing a session it
+ * doesn't hold history for starts that peer over.
+ */
+#include "arq.h"
+
+#include <string.h>
+#include "c-logger.h"
+#include "bsp/time_bsp.h"
+
+#define ARQ_HISTORY_BITS (32) // Width of arq_peer_t.rx_history
+
+static arq_peer_t *_get_peer(arq_handle_t *handle, uint8_t addr, bool create);
+static uint8_t _new_session(arq_handle_t *handle, uint8_t addr);
+static void _start_retransmit_timer(arq_slot_t *slot);
+static bool _record_rx_id(arq_peer_t *peer, uint8_t id);
+static void _queue_ack(arq_peer_t *peer, uint8_t id);
+
+/**
+ * @brief Initializes the ARQ layer
+ *
+ * @param handle pointer to ARQ handle
+ * @param address our own address, used as the source of ACK frames
+ * @param delivery_callback called when a unicast packet is acknowledged or gives up, may be NULL
+ * @param delivery_ctx passed back to delivery_callback
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int arq_init(arq_handle_t *handle, uint8_t address, arq_delivery_callback_t delivery_callback, void *delivery_ctx)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    memset(handle, 0, sizeof(arq_handle_t));
+
+    handle->address = address;
+    handle->delivery_callback = delivery_callback;
+    handle->delivery_ctx = delivery_ctx;
+
+    return 0;
+}
+
+/**
+ * @brief Checks retransmit timers, giving up on packets that ran out of retries
+ *
+ * @param handle pointer to ARQ handle
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int arq_task(arq_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    for (size_t i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        arq_slot_t *slot = &handle->window[i];
+        if (!slot->in_use || slot->retransmit_due || !time_utils_done(&slot->timer))
+        {
+            continue;
+        }
+
+        if (slot->retries >= pconfigMAX_RETRIES)
+        {
+            LOG_WARN("Packet %d to 0x%02X was never acknowledged", slot->packet.content.id, slot->packet.content.dest_addr);
+            slot->in_use = false;
+            handle->stats.failed++;
+            if (handle->delivery_callback)
+            {
+                handle->delivery_callback(handle->delivery_ctx, slot->packet.content.dest_addr, slot->packet.content.id, false);
+            }
+            continue;
+        }
+
+        slot->retransmit_due = true;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Allocates the next id in the sequence space towards a destination
+ *
+ * @param handle pointer to ARQ handle
+ * @param dest_addr destination of the packet
+ *
+ * @return id to put in the packet
+ */
+uint8_t arq_next_id(arq_handle_t *handle, uint8_t dest_addr)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return 0;
+    }
+
+    arq_peer_t *peer = _get_peer(handle, dest_addr, true);
+    return peer->next_tx_id++;
+}
+
+/**
+ * @brief Checks if another unicast packet may be put in flight
+ *
+ * @param handle pointer to ARQ handle
+ *
+ * @return true if there is a free slot in the window
+ */
+bool arq_window_available(arq_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    for (size_t i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        if (!handle->window[i].in_use)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Takes a window slot for a unicast packet that is about to be transmitted
+ *
+ * @param handle pointer to ARQ handle
+ * @param packet packet being transmitted
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int arq_track(arq_handle_t *handle, const packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    for (size_t i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        arq_slot_t *slot = &handle->window[i];
+        if (slot->in_use)
+        {
+            continue;
+        }
+
+        slot->in_use = true;
+        slot->retransmit_due = false;
+        slot->retries = 0;
+        slot->packet = *packet;
+        _start_retransmit_timer(slot);
+        return 0;
+    }
+
+    LOG_ERROR("ARQ window is full");
+    return -1;
+}
+
+/**
+ * @brief Sends our session towards the packet's destination until the destination has acknowledged it
+ *
+ * @note Called on every transmission, retransmissions included, so packets sent before the first
+ *       ACK stop carrying the session once it arrives.
+ *
+ * @param handle pointer to ARQ handle
+ * @param packet unicast data packet from us, its flags and CRC are updated
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int arq_set_session(arq_handle_t *handle, packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    arq_peer_t *peer = _get_peer(handle, packet->content.dest_addr, true);
+    if (peer->tx_synced)
+    {
+        packet->content.flags &= ~PACKET_FLAG_SESSION;
+    }
+    else
+    {
+        packet->content.flags |= PACKET_FLAG_SESSION;
+        packet->content.session = peer->tx_session;
+    }
+    packet->content.crc = calculate_crc(packet);
+
+    return 0;
+}
+
+bool arq_retransmission_pending(arq_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    for (size_t i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        if (handle->window[i].in_use && handle->window[i].retransmit_due)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Gets a packet whose retransmit timer expired and restarts its timer
+ *
+ * @param handle pointer to ARQ handle
+ * @param packet filled with the packet to send again
+ *
+ * @return error code: 0 = successful, -1 = failed or nothing to retransmit
+ */
+int arq_get_retransmission(arq_handle_t *handle, packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    for (size_t i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        arq_slot_t *slot = &handle->window[i];
+        if (!slot->in_use || !slot->retransmit_due)
+        {
+            continue;
+        }
+
+        slot->retransmit_due = false;
+        slot->retries++;
+        _start_retransmit_timer(slot);
+        handle->stats.retransmissions++;
+
+        LOG_DEBUG("Retransmitting packet %d to 0x%02X (retry %d)", slot->packet.content.id, slot->packet.content.dest_addr, slot->retries);
+        *packet = slot->packet;
+        return 0;
+    }
+
+    return -1;
+}
+
+bool arq_ack_pending(arq_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    for (size_t i = 0; i < pconfigARQ_MAX_PEERS; i++)
+    {
+        arq_peer_t *peer = &handle->peers[i];
+        if (peer->in_use && peer->pending_ack_count > 0 &&
+            (peer->pending_ack_count >= pconfigARQ_MAX_ACK_IDS || time_utils_done(&peer->ack_timer)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Builds a selective ACK frame for the next peer with acknowledgements due
+ *
+ * @note The payload of an ACK frame is the list of ids being acknowledged.
+ *
+ * @param handle pointer to ARQ handle
+ * @param packet filled with the ACK frame
+ *
+ * @return error code: 0 = successful, -1 = failed or no ACK due
+ */
+int arq_get_ack(arq_handle_t *handle, packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    for (size_t i = 0; i < pconfigARQ_MAX_PEERS; i++)
+    {
+        arq_peer_t *peer = &handle->peers[i];
+        if (!peer->in_use || peer->pending_ack_count == 0 ||
+            (peer->pending_ack_count < pconfigARQ_MAX_ACK_IDS && !time_utils_done(&peer->ack_timer)))
+        {
+            continue;
+        }
+
+        if (initialize_packet(packet, PACKET_TYPE_ACK, handle->address, peer->addr, 0, peer->pending_acks, peer->pending_ack_count))
+        {
+            LOG_ERROR("Failed to create ACK packet");
+            return -1;
+        }
+
+        peer->pending_ack_count = 0;
+        handle->stats.acks_sent++;
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Records a unicast data packet addressed to us and schedules its ACK
+ *
+ * @note Duplicates are still acknowledged since the sender probably missed our last ACK. A session
+ *       we have no history for means the sender's ids started over, so earlier ones are forgotten.
+ *
+ * @param handle pointer to ARQ handle
+ * @param packet received data packet
+ *
+ * @return true if the packet is new and should be delivered, false if it's a duplicate
+ */
+bool arq_handle_data(arq_handle_t *handle, const packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return false;
+    }
+
+    arq_peer_t *peer = _get_peer(handle, packet->content.src_addr, true);
+
+    if ((packet->content.flags & PACKET_FLAG_SESSION) && packet->content.session != peer->rx_session)
+    {
+        if (peer->rx_valid)
+        {
+            LOG_INFO("0x%02X started session 0x%02X, forgetting its earlier ids", peer->addr, packet->content.session);
+        }
+        peer->rx_valid = false;
+        peer->rx_session = packet->content.session;
+    }
+
+    bool fresh = _record_rx_id(peer, packet->content.id);
+    if (!fresh)
+    {
+        LOG_DEBUG("Duplicate packet %d from 0x%02X", packet->content.id, packet->content.src_addr);
+        handle->stats.duplicates++;
+    }
+
+    _queue_ack(peer, packet->content.id);
+
+    return fresh;
+}
+
+/**
+ * @brief Releases every window slot acknowledged by an ACK frame
+ *
+ * @param handle pointer to ARQ handle
+ * @param packet received ACK frame
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int arq_handle_ack(arq_handle_t *handle, const packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    handle->stats.acks_received++;
+
+    arq_peer_t *peer = _get_peer(handle, packet->content.src_addr, false);
+
+    for (size_t i = 0; i < packet->content.payload_length; i++)
+    {
+        uint8_t id = packet->content.payload[i];
+
+        for (size_t j = 0; j < pconfigARQ_WINDOW_SIZE; j++)
+        {
+            arq_slot_t *slot = &handle->window[j];
+            if (!slot->in_use || slot->packet.content.dest_addr != packet->content.src_addr || slot->packet.content.id != id)
+            {
+                continue;
+            }
+
+            slot->in_use = false;
+            handle->stats.delivered++;
+            if (peer)
+            {
+                peer->tx_synced = true; // It has seen our session
+            }
+            if (handle->delivery_callback)
+            {
+                handle->delivery_callback(handle->delivery_ctx, slot->packet.content.dest_addr, id, true);
+            }
+        }
+    }
+
+    return 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static arq_peer_t *_get_peer(arq_handle_t *handle, uint8_t addr, bool create)
+{
+    arq_peer_t *oldest = &handle->peers[0];
+
+    for (size_t i = 0; i < pconfigARQ_MAX_PEERS; i++)
+    {
+        arq_peer_t *peer = &handle->peers[i];
+        if (peer->in_use && peer->addr == addr)
+        {
+            peer->last_used = ++handle->use_counter;
+            return peer;
+        }
+        if (!peer->in_use)
+        {
+            oldest = peer;
+        }
+        else if (oldest->in_use && peer->last_used < oldest->last_used)
+        {
+            oldest = peer;
+        }
+    }
+
+    if (!create)
+    {
+        return NULL;
+    }
+
+    // Evict the least recently used peer
+    memset(oldest, 0, sizeof(arq_peer_t));
+    oldest->in_use = true;
+    oldest->addr = addr;
+    oldest->last_used = ++handle->use_counter;
+    oldest->tx_session = _new_session(handle, addr);
+    time_utils_start(&oldest->ack_timer, pconfigARQ_ACK_DELAY_MS * ONE_MS);
+
+    return oldest;
+}
+
+/**
+ * @brief Picks a session for a sequence starting at 0
+ *
+ * @note The counter keeps sessions apart within a run, the clock across restarts. A restarted
+ *       sender still lands on the session the receiver holds about 1 time in 255.
+ */
+static uint8_t _new_session(arq_handle_t *handle, uint8_t addr)
+{
+    uint64_t now_us = time_bsp_get_us();
+    uint8_t session = (uint8_t)(++handle->session_counter ^ addr ^ now_us ^ (now_us >> 8) ^ (now_us >> 16));
+
+    return session ? session : 1; // 0 means no session
+}
+
+static void _start_retransmit_timer(arq_slot_t *slot)
+{
+    uint32_t backoff_ms = pconfigBACKOFF_BASE_TIME_MS << slot->retries;
+    if (backoff_ms > pconfigBACKOFF_MAX_TIME_MS)
+    {
+        backoff_ms = pconfigBACKOFF_MAX_TIME_MS;
+    }
+
+    time_utils_start(&slot->timer, (uint64_t)(pconfigARQ_ACK_TIMEOUT_MS + backoff_ms) * ONE_MS);
+}
+
+static bool _record_rx_id(arq_peer_t *peer, uint8_t id)
+{
+    int8_t diff = (int8_t)(id - peer->rx_highest);
+
+    if (!peer->rx_valid || diff <= -ARQ_HISTORY_BITS)
+    {
+        // First packet from this peer, or so far behind that the peer probably restarted
+        peer->rx_valid = true;
+        peer->rx_highest = id;
+        peer->rx_history = 1;
+        return true;
+    }
+
+    if (diff > 0)
+    {
+        peer->rx_history = (diff >= ARQ_HISTORY_BITS) ? 0 : peer->rx_history << diff;
+        peer->rx_history |= 1;
+        peer->rx_highest = id;
+        return true;
+    }
+
+    uint32_t mask = 1UL << (-diff);
+    if (peer->rx_history & mask)
+    {
+        return false;
+    }
+
+    peer->rx_history |= mask;
+    return true;
+}
+
+static void _queue_ack(arq_peer_t *peer, uint8_t id)
+{
+    for (size_t i = 0; i < peer->pending_ack_count; i++)
+    {
+        if (peer->pending_acks[i] == id)
+        {
+            return; // Already going out in the next ACK
+        }
+    }
+
+    if (peer->pending_ack_count >= pconfigARQ_MAX_ACK_IDS)
+    {
+        LOG_WARN("ACK list for 0x%02X is full, dropping id %d", peer->addr, id);
+        return;
+    }
+
+    if (peer->pending_ack_count == 0)
+    {
+        time_utils_reset(&peer->ack_timer);
+    }
+
+    peer->pending_acks[peer->pending_ack_count++] = id;
+}
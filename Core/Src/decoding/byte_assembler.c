@@ -8,6 +8,7 @@
 // Prvate function declarations
 static uint16_t swap16(uint16_t v);
 static int _process_bit(byte_assembler_handle_t *handle, decoder_handle_t *ctx, bool bit);
+static int _process_rate_bit(byte_assembler_handle_t *handle, decoder_handle_t *ctx, bool bit);
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // PUBLIC FUNCTIONS
@@ -99,6 +100,10 @@ int byte_assembler_reset(byte_assembler_handle_t *handle)
     handle->bits_collected = 0;
     handle->preamble_buffer = 0;
     handle->preamble_found = false;
+    handle->rate_byte = 0;
+    handle->rate_bits = 0;
+    handle->stuffed_bits = 0;
+    handle->state = BYTE_ASSEMBLER_WAITING_FOR_PREAMBLE;
 
     return 0;
 }
@@ -121,6 +126,8 @@ static int _process_bit(byte_assembler_handle_t *handle, decoder_handle_t *ctx,
     {
     case BYTE_ASSEMBLER_WAITING_FOR_PREAMBLE:
 
+        break;
+    case BYTE_ASSEMBLER_READING_RATE:
         break;
     case BYTE_ASSEMBLER_ASSEMBLING:
         break;
@@ -151,7 +158,10 @@ static int _process_bit(byte_assembler_handle_t *handle, decoder_handle_t *ctx,
         uint8_t lo = preamble & 0xFF;
 
         bit_unstuffer_reset(&handle->bit_unstuffer); // Reset bit unstuffer state for new packet
-        handle->state = BYTE_ASSEMBLER_ASSEMBLING;
+        handle->stuffed_bits = 0;
+        handle->rate_byte = 0;
+        handle->rate_bits = 0;
+        handle->state = BYTE_ASSEMBLER_READING_RATE;
         if(decoder_sync_word_detected(ctx))
         {
             LOG_ERROR("Failed to notify decoder of sync word");
@@ -166,11 +176,17 @@ static int _process_bit(byte_assembler_handle_t *handle, decoder_handle_t *ctx,
         return 0;
     }
 
+    if (handle->state == BYTE_ASSEMBLER_READING_RATE)
+    {
+        return _process_rate_bit(handle, ctx, bit);
+    }
+
     bool valid; 
     bit_unstuffer_process(&handle->bit_unstuffer, bit, &bit, &valid);
     if (!valid)
     {
         LOG_DEBUG("Bit was a stuffed bit, discarded");
+        handle->stuffed_bits++;
         return 0; // Stuffed bit, ignore
     }
 
@@ -195,6 +211,36 @@ failed:
     return ret;
 }
 
+/**
+ * @brief Collects the rate byte, it's sent at the base rate without bit stuffing like the sync word
+ */
+static int _process_rate_bit(byte_assembler_handle_t *handle, decoder_handle_t *ctx, bool bit)
+{
+    handle->rate_byte = (handle->rate_byte << 1) | (bit & 0x01);
+    handle->rate_bits++;
+
+    if (handle->rate_bits < 8)
+    {
+        return 0;
+    }
+
+    fsk_rate_e rate;
+    if (fsk_rate_decode(handle->rate_byte, &rate))
+    {
+        LOG_DEBUG("Invalid rate byte 0x%02X, waiting for next sync word", handle->rate_byte);
+        return byte_assembler_reset(handle);
+    }
+
+    handle->state = BYTE_ASSEMBLER_ASSEMBLING;
+    if (decoder_rate_detected(ctx, rate))
+    {
+        LOG_ERROR("Failed to notify decoder of rate");
+        return -1;
+    }
+
+    return 0;
+}
+
 static uint16_t swap16(uint16_t v)
 {
     return (v >> 8) | (v << 8);
@@ -8,12 +8,15 @@
  */
 #include "decoding/decoder.h"
 
+#include <string.h>
 #include "c-logger.h"
 #include "decoding/fsk_decoder.h"
 #include "decoding/byte_assembler.h"
+#include "utils/trace.h"
 
 static void _handle_sub_tasks(decoder_handle_t *handle);
 static bool _sub_tasks_busy(decoder_handle_t *handle);
+static void _stamp_metadata(decoder_handle_t *handle, packet_t *packet);
 
 /**
  * @brief Initializes decoder
@@ -35,6 +38,11 @@ int decoder_init(decoder_handle_t *handle)
 
     handle->bit_decoder_handle = NULL;
     handle->byte_decoder_handle = NULL;
+    handle->input_array = NULL;
+    handle->input_size = 0;
+    handle->shared_input = false;
+    handle->sync_sample = 0;
+    memset(&handle->stats, 0, sizeof(handle->stats));
 
     if (packet_decoder_init(&handle->packet_decoder, handle))
     {
@@ -131,6 +139,80 @@ failed:
     return ret;
 }
 
+/**
+ * @brief Sets the storage for incoming samples, the decoder doesn't allocate any itself
+ *
+ * @note The storage is split into pconfigDECODER_INPUT_BLOCKS blocks for input_ring, which is
+ *       ready for the ADC BSP to fill as soon as this returns.
+ *
+ * @param handle pointer to decoder handle
+ * @param buffer storage for the input buffer, owned by the caller for the decoder's lifetime
+ * @param samples number of samples buffer holds, should cover a few symbols for timing recovery
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int decoder_set_input_buffer(decoder_handle_t *handle, uint16_t *buffer, size_t samples)
+{
+    if (!handle || !buffer)
+    {
+        LOG_ERROR("Decoder handle or buffer is NULL");
+        return -1;
+    }
+
+    if (samples < pconfigDECODER_INPUT_BLOCKS)
+    {
+        LOG_ERROR("Input buffer needs at least %d samples", pconfigDECODER_INPUT_BLOCKS);
+        return -1;
+    }
+
+    if (handle->state != DECODER_STATE_INITIALIZING)
+    {
+        LOG_ERROR("Input buffer is already in use");
+        return -1;
+    }
+
+    // Samples that don't divide evenly into the blocks go unused
+    if (block_ring_init(&handle->input_ring, buffer, sizeof(uint16_t), samples / pconfigDECODER_INPUT_BLOCKS, pconfigDECODER_INPUT_BLOCKS))
+    {
+        LOG_ERROR("Failed to initialize decoder input ring");
+        return -1;
+    }
+
+    handle->input_array = buffer;
+    handle->input_size = samples;
+
+    return 0;
+}
+
+/**
+ * @brief Has the decoder take its samples from an FSK bank instead of an input buffer of its own
+ *
+ * @note The bank runs the samples through the bit decoder, decoder_task only keeps the rest of
+ *       the pipeline going and input_ring stays empty.
+ *
+ * @param handle pointer to decoder handle
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int decoder_set_shared_input(decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Decoder handle is NULL");
+        return -1;
+    }
+
+    if (handle->state != DECODER_STATE_INITIALIZING || handle->input_array)
+    {
+        LOG_ERROR("Decoder input is already set");
+        return -1;
+    }
+
+    handle->shared_input = true;
+
+    return 0;
+}
+
 int decoder_task(decoder_handle_t *handle)
 {
     int ret = 0;
@@ -151,10 +233,10 @@ int decoder_task(decoder_handle_t *handle)
     case DECODER_STATE_INITIALIZING:
         LOG_INFO("Initializing decoder...");
 
-        // Input buffer takes in 12-bit samples as uint16_t
-        if (circular_buffer_static_init(&handle->input_buffer, &handle->input_array, sizeof(uint16_t), sizeof(handle->input_array) / sizeof(uint16_t)))
+        // Input ring takes in 12-bit samples as uint16_t, set up by decoder_set_input_buffer
+        if (!handle->input_array && !handle->shared_input)
         {
-            LOG_ERROR("Failed to initialize decoder input buffer");
+            LOG_ERROR("Decoder input buffer isn't set");
             ret = -1;
             handle->state = DECODER_STATE_UNINITIALIZED;
             goto failed;
@@ -213,14 +295,30 @@ int decoder_process_samples(decoder_handle_t *handle, const uint16_t *samples, s
         return -1;
     }
 
-    for (size_t i = 0; i < num_samples; i++)
+    if (handle->shared_input)
     {
-        if (circular_buffer_push(&handle->input_buffer, (uint16_t *)&samples[i]))
+        LOG_ERROR("Decoder takes its samples from an FSK bank");
+        return -1;
+    }
+
+    // Copy through the same blocks an ADC BSP would fill in place
+    size_t copied = 0;
+    while (copied < num_samples)
+    {
+        size_t capacity;
+        uint16_t *block = block_ring_acquire(&handle->input_ring, &capacity);
+        if (!block)
         {
-            LOG_ERROR("Failed to push sample to input buffer");
+            LOG_ERROR("Input buffer is full, dropped %zu samples", num_samples - copied);
+            block_ring_drop(&handle->input_ring, num_samples - copied);
             ret = -1;
             goto failed;
         }
+
+        size_t count = num_samples - copied < capacity ? num_samples - copied : capacity;
+        memcpy(block, &samples[copied], count * sizeof(uint16_t));
+        block_ring_commit(&handle->input_ring, count);
+        copied += count;
     }
 
     handle->state = DECODER_STATE_PROCESSING;
@@ -315,6 +413,8 @@ int decoder_process_packet(decoder_handle_t *handle, packet_t *packet)
         return -1;
     }
 
+    _stamp_metadata(handle, packet);
+
     // Push packet to output buffer
     if (circular_buffer_push(&handle->output_buffer, packet))
     {
@@ -343,11 +443,65 @@ int decoder_sync_word_detected(decoder_handle_t *handle)
         return -1;
     }
 
+    STAT_INC(handle->stats.sync_words);
+
     if (packet_decoder_reset(&handle->packet_decoder))
     {
         LOG_ERROR("Failed to reset packet decoder");
         return -1;
     }
+    TRACE_FRAME_START(&handle->packet_decoder.current_packet);
+
+    // Link quality is measured per packet, starting at its sync word
+    if (handle->bit_decoder == BIT_DECODER_FSK)
+    {
+        fsk_decoder_handle_t *fsk_decoder = (fsk_decoder_handle_t *)handle->bit_decoder_handle;
+        handle->sync_sample = fsk_decoder_symbol_end_sample(fsk_decoder);
+        if (fsk_decoder_reset_frame_metrics(fsk_decoder))
+        {
+            LOG_ERROR("Failed to reset frame metrics");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Switches the bit decoder to the rate announced after the sync word
+ *
+ * @param handle pointer to decoder handle
+ * @param rate rate the rest of the frame is sent at
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int decoder_rate_detected(decoder_handle_t *handle, fsk_rate_e rate)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    switch (handle->bit_decoder)
+    {
+    case BIT_DECODER_FSK:
+    {
+        fsk_decoder_handle_t *fsk_decoder = (fsk_decoder_handle_t *)handle->bit_decoder_handle;
+        if (fsk_decoder_set_baud_rate(fsk_decoder, fsk_rate_baud(fsk_decoder_base_baud_rate(fsk_decoder), rate)))
+        {
+            LOG_ERROR("Failed to set FSK decoder baud rate");
+            return -1;
+        }
+        break;
+    }
+    case BIT_DECODER_NONE:
+        // No bit decoder set
+        break;
+    default:
+        LOG_ERROR("Unknown bit decoder type");
+        return -1;
+    }
 
     return 0;
 }
@@ -450,6 +604,75 @@ bool decoder_signal_detected(decoder_handle_t *handle)
     }
 }
 
+float decoder_channel_energy(decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return 0.0f;
+    }
+
+    switch (handle->bit_decoder)
+    {
+    case BIT_DECODER_FSK:
+        return fsk_decoder_channel_energy((fsk_decoder_handle_t *)handle->bit_decoder_handle);
+        break;
+    case BIT_DECODER_NONE:
+        // No bit decoder set
+        return 0.0f;
+        break;
+    default:
+        LOG_ERROR("Unknown bit decoder type");
+        return 0.0f;
+    }
+}
+
+float decoder_channel_level(decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return 0.0f;
+    }
+
+    switch (handle->bit_decoder)
+    {
+    case BIT_DECODER_FSK:
+        return fsk_decoder_channel_level((fsk_decoder_handle_t *)handle->bit_decoder_handle);
+        break;
+    case BIT_DECODER_NONE:
+        // No bit decoder set
+        return 0.0f;
+        break;
+    default:
+        LOG_ERROR("Unknown bit decoder type");
+        return 0.0f;
+    }
+}
+
+float decoder_snr(decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return 0.0f;
+    }
+
+    switch (handle->bit_decoder)
+    {
+    case BIT_DECODER_FSK:
+        return fsk_decoder_snr((fsk_decoder_handle_t *)handle->bit_decoder_handle);
+        break;
+    case BIT_DECODER_NONE:
+        // No bit decoder set
+        return 0.0f;
+        break;
+    default:
+        LOG_ERROR("Unknown bit decoder type");
+        return 0.0f;
+    }
+}
+
 int decoder_reset(decoder_handle_t *handle)
 {
     if (!handle)
@@ -478,9 +701,39 @@ int decoder_reset(decoder_handle_t *handle)
         return -1;
     }
 
+    // Next sync word comes at the base rate
+    if (handle->bit_decoder == BIT_DECODER_FSK && fsk_decoder_reset_baud_rate((fsk_decoder_handle_t *)handle->bit_decoder_handle))
+    {
+        LOG_ERROR("Failed to reset FSK decoder baud rate");
+        return -1;
+    }
+
     return 0;
 }
 
+// Fills in what was measured receiving the packet, the time is left to whoever knows the clock
+static void _stamp_metadata(decoder_handle_t *handle, packet_t *packet)
+{
+    packet->metadata.snr_db = decoder_snr(handle);
+    packet->metadata.sync_sample = handle->sync_sample;
+    packet->metadata.sync_time_us = 0;
+    packet->metadata.tone_0_level = 0.0f;
+    packet->metadata.tone_1_level = 0.0f;
+    packet->metadata.metric_margin = 0.0f;
+    packet->metadata.stuffed_bits = 0;
+
+    if (handle->bit_decoder == BIT_DECODER_FSK)
+    {
+        fsk_decoder_handle_t *fsk_decoder = (fsk_decoder_handle_t *)handle->bit_decoder_handle;
+        fsk_decoder_tone_levels(fsk_decoder, &packet->metadata.tone_0_level, &packet->metadata.tone_1_level);
+        packet->metadata.metric_margin = fsk_decoder_metric_margin(fsk_decoder);
+    }
+    if (handle->byte_decoder == BYTE_DECODER_BIT_STUFFING)
+    {
+        packet->metadata.stuffed_bits = ((byte_assembler_handle_t *)handle->byte_decoder_handle)->stuffed_bits;
+    }
+}
+
 static void _handle_sub_tasks(decoder_handle_t *handle)
 {
     // Handle bit decoder task
@@ -0,0 +1,339 @@
+/**
+ * @file fsk_bank.c
+ *
+ * @author Diamond42474
+ *
+ * Decodes several FSK tone pairs sharing one ADC. The samples are
+ * converted, DC blocked and levelled once, then every channel's decoder
+ * takes the same block out of the front end, each into its own byte and
+ * packet assembler.
+ */
+#include "decoding/fsk_bank.h"
+
+#include <string.h>
+#include "c-logger.h"
+
+static int _init_channel(fsk_bank_t *bank, fsk_bank_channel_t *channel, int freq_0, int freq_1);
+static int _process_block(fsk_bank_t *bank, const uint16_t *samples, size_t count);
+
+/**
+ * @brief Initializes an FSK bank without any channels
+ *
+ * @param bank Pointer to the bank
+ * @param config Rate, sample rate and format, and power threshold of every channel, the tones are ignored
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_bank_init(fsk_bank_t *bank, const pc_config_t *config)
+{
+    if (!bank || !config)
+    {
+        LOG_ERROR("FSK bank or config is NULL");
+        return -1;
+    }
+
+    if (config->sample_rate <= 0 || config->baud_rate <= 0 || config->sample_rate / config->baud_rate < 2)
+    {
+        LOG_ERROR("FSK bank needs a sample rate of at least twice the baud rate");
+        return -1;
+    }
+
+    memset(bank, 0, sizeof(*bank));
+    bank->config = *config;
+
+    if (front_end_init(&bank->front_end, config->sample_format, (float)config->sample_rate))
+    {
+        LOG_ERROR("Failed to init FSK bank front end");
+        return -1;
+    }
+
+    bank->state = FSK_BANK_STATE_INITIALIZING;
+
+    return 0;
+}
+
+/**
+ * @brief Adds a tone pair to decode
+ *
+ * @note Pairs shouldn't overlap each other's tone filters, which pass FSK_MIN_FILTER_HALF_BANDWIDTH
+ *       or more either side of each tone.
+ *
+ * @param bank Pointer to the bank
+ * @param freq_0 Tone for bit 0 in Hz
+ * @param freq_1 Tone for bit 1 in Hz
+ *
+ * @return the channel's index, -1 = failure
+ */
+int fsk_bank_add_channel(fsk_bank_t *bank, int freq_0, int freq_1)
+{
+    if (!bank)
+    {
+        LOG_ERROR("FSK bank is NULL");
+        return -1;
+    }
+
+    if (bank->state != FSK_BANK_STATE_INITIALIZING)
+    {
+        LOG_ERROR("Channels can only be added before the FSK bank runs");
+        return -1;
+    }
+
+    if (bank->channel_count == pconfigFSK_BANK_MAX_CHANNELS)
+    {
+        LOG_ERROR("FSK bank already has %d channels", pconfigFSK_BANK_MAX_CHANNELS);
+        return -1;
+    }
+
+    if (_init_channel(bank, &bank->channels[bank->channel_count], freq_0, freq_1))
+    {
+        LOG_ERROR("Failed to init FSK bank channel %d/%d Hz", freq_0, freq_1);
+        return -1;
+    }
+
+    return (int)bank->channel_count++;
+}
+
+/**
+ * @brief Sets the storage for incoming samples, split into pconfigDECODER_INPUT_BLOCKS blocks like a decoder's
+ *
+ * @param bank Pointer to the bank
+ * @param buffer Storage for the input ring, owned by the caller for the bank's lifetime
+ * @param samples Number of samples buffer holds
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_bank_set_input_buffer(fsk_bank_t *bank, uint16_t *buffer, size_t samples)
+{
+    if (!bank || !buffer)
+    {
+        LOG_ERROR("FSK bank or buffer is NULL");
+        return -1;
+    }
+
+    if (samples < pconfigDECODER_INPUT_BLOCKS)
+    {
+        LOG_ERROR("Input buffer needs at least %d samples", pconfigDECODER_INPUT_BLOCKS);
+        return -1;
+    }
+
+    if (bank->state != FSK_BANK_STATE_INITIALIZING)
+    {
+        LOG_ERROR("Input buffer is already in use");
+        return -1;
+    }
+
+    if (block_ring_init(&bank->input_ring, buffer, sizeof(uint16_t), samples / pconfigDECODER_INPUT_BLOCKS, pconfigDECODER_INPUT_BLOCKS))
+    {
+        LOG_ERROR("Failed to initialize FSK bank input ring");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Brings the channels up, then decodes whatever samples are waiting
+ *
+ * @param bank Pointer to the bank
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_bank_task(fsk_bank_t *bank)
+{
+    int ret = 0;
+
+    if (!bank)
+    {
+        LOG_ERROR("FSK bank is NULL");
+        return -1;
+    }
+
+    switch (bank->state)
+    {
+    case FSK_BANK_STATE_UNINITIALIZED:
+        LOG_ERROR("FSK bank is uninitialized");
+        ret = -1;
+        break;
+    case FSK_BANK_STATE_INITIALIZING:
+    {
+        if (bank->channel_count == 0 || !bank->input_ring.buffer)
+        {
+            LOG_ERROR("FSK bank needs channels and an input buffer");
+            ret = -1;
+            break;
+        }
+
+        // The channels' decoders set up their buffers and then their FSK decoders' filters over a couple of tasks
+        bool ready = true;
+        for (size_t i = 0; i < bank->channel_count; i++)
+        {
+            if (decoder_task(&bank->channels[i].decoder))
+            {
+                LOG_ERROR("Failed to init FSK bank channel %zu", i);
+                ret = -1;
+            }
+            ready &= bank->channels[i].fsk_decoder.state != FSK_DECODER_STATE_INITIALIZING;
+        }
+        if (ready)
+        {
+            bank->state = FSK_BANK_STATE_RUNNING;
+            LOG_INFO("FSK bank running with %zu channels", bank->channel_count);
+        }
+        break;
+    }
+    case FSK_BANK_STATE_RUNNING:
+    {
+        // Blocks are decoded where the ADC BSP wrote them and handed back once done
+        const uint16_t *block;
+        size_t count;
+        while ((block = block_ring_peek(&bank->input_ring, &count)) != NULL)
+        {
+            if (_process_block(bank, block, count))
+            {
+                ret = -1;
+            }
+
+            if (block_ring_release(&bank->input_ring))
+            {
+                LOG_ERROR("Failed to release FSK bank input block");
+                return -1;
+            }
+        }
+        break;
+    }
+    default:
+        LOG_ERROR("Unknown FSK bank state");
+        ret = -1;
+        break;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Copies samples into the input ring, for sources that can't fill it in place
+ *
+ * @param bank Pointer to the bank
+ * @param samples ADC samples
+ * @param count Number of samples
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_bank_process_samples(fsk_bank_t *bank, const uint16_t *samples, size_t count)
+{
+    if (!bank || !samples || count == 0)
+    {
+        LOG_ERROR("Invalid arguments to fsk_bank_process_samples");
+        return -1;
+    }
+
+    if (!bank->input_ring.buffer)
+    {
+        LOG_ERROR("FSK bank input buffer isn't set");
+        return -1;
+    }
+
+    size_t copied = 0;
+    while (copied < count)
+    {
+        size_t capacity;
+        uint16_t *block = block_ring_acquire(&bank->input_ring, &capacity);
+        if (!block)
+        {
+            LOG_ERROR("FSK bank input is full, dropped %zu samples", count - copied);
+            block_ring_drop(&bank->input_ring, count - copied);
+            return -1;
+        }
+
+        size_t n = count - copied < capacity ? count - copied : capacity;
+        memcpy(block, &samples[copied], n * sizeof(uint16_t));
+        block_ring_commit(&bank->input_ring, n);
+        copied += n;
+    }
+
+    return 0;
+}
+
+decoder_handle_t *fsk_bank_channel(fsk_bank_t *bank, size_t index)
+{
+    if (!bank || index >= bank->channel_count)
+    {
+        LOG_ERROR("No FSK bank channel %zu", index);
+        return NULL;
+    }
+
+    return &bank->channels[index].decoder;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static int _init_channel(fsk_bank_t *bank, fsk_bank_channel_t *channel, int freq_0, int freq_1)
+{
+    const pc_config_t *config = &bank->config;
+
+    if (decoder_init(&channel->decoder) || decoder_set_shared_input(&channel->decoder))
+    {
+        LOG_ERROR("Failed to init channel decoder");
+        return -1;
+    }
+
+    if (fsk_decoder_init(&channel->fsk_decoder) ||
+        fsk_decoder_set_symbol_sample_size(&channel->fsk_decoder, (size_t)(config->sample_rate / config->baud_rate), config->decoder_buffer_symbol_count) ||
+        fsk_decoder_set_sample_rate(&channel->fsk_decoder, config->sample_rate) ||
+        fsk_decoder_set_sample_format(&channel->fsk_decoder, config->sample_format) ||
+        fsk_decoder_set_symbol_rate(&channel->fsk_decoder, config->baud_rate) ||
+        fsk_decoder_set_frequencies(&channel->fsk_decoder, (float)freq_0, (float)freq_1) ||
+        fsk_decoder_set_power_threshold(&channel->fsk_decoder, config->fsk_power_threshold) ||
+        decoder_set_bit_decoder(&channel->decoder, BIT_DECODER_FSK, &channel->fsk_decoder))
+    {
+        LOG_ERROR("Failed to set up channel FSK decoder");
+        return -1;
+    }
+
+    if (byte_assembler_init(&channel->byte_assembler) ||
+        byte_assembler_set_preamble(&channel->byte_assembler, pconfigPREAMBLE_BYTE_1 << 8 | pconfigPREAMBLE_BYTE_2) ||
+        decoder_set_byte_decoder(&channel->decoder, BYTE_DECODER_BIT_STUFFING, &channel->byte_assembler))
+    {
+        LOG_ERROR("Failed to set up channel byte assembler");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Runs a block of ADC samples through the shared front end and every channel
+ *
+ * @note The front end runs once per sample whatever the number of channels, and each channel
+ *       works through the same FSK_BLOCK_SIZE floats in turn, so they're read from cache.
+ */
+static int _process_block(fsk_bank_t *bank, const uint16_t *samples, size_t count)
+{
+    int ret = 0;
+
+    for (size_t i = 0; i < count; i += FSK_BLOCK_SIZE)
+    {
+        size_t n = count - i < FSK_BLOCK_SIZE ? count - i : FSK_BLOCK_SIZE;
+
+        front_end_t front_end = bank->front_end;
+        for (size_t j = 0; j < n; j++)
+        {
+            bank->samples[j] = front_end_process(&front_end, samples[i + j]);
+        }
+        bank->front_end = front_end;
+
+        for (size_t c = 0; c < bank->channel_count; c++)
+        {
+            fsk_bank_channel_t *channel = &bank->channels[c];
+            if (fsk_decoder_demodulate(&channel->fsk_decoder, &channel->decoder, &bank->front_end, &samples[i], bank->samples, n))
+            {
+                LOG_ERROR("Failed to decode FSK bank channel %zu", c);
+                ret = -1;
+            }
+        }
+    }
+
+    return ret;
+}
@@ -9,14 +9,55 @@
 #include "c-logger.h"
 #include "utils/circular_buffer.h"
 #include "dsp/filters.h"
+#include "dsp/front_end.h"
 #include "interface/debug.h"
 
 static int _process_samples(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
 static size_t _calculate_window_offset(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
 static float _calculate_quality(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
 static int _update_symbol_timing(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
-static int _process_sample(uint16_t sample, fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
+static int _process_block(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const uint16_t *samples, size_t count, uint32_t *idle);
+static int _process_chunk(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const uint16_t *raw, const float *samples, int count, uint32_t *idle);
+static int _chunk_size(fsk_decoder_handle_t *handle, size_t remaining);
+static void _watch_tones(fsk_decoder_handle_t *handle, const float *samples, int count);
+static int _demodulate_block(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const float *samples, int count, uint64_t first_index);
+static void _filter_block(fsk_decoder_handle_t *handle, const float *samples, int from, int to);
+static uint64_t _find_crossings(fsk_decoder_handle_t *handle, int count);
+static int _samples_to_decision(fsk_decoder_handle_t *handle);
+static int _decide(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, int index, float metric, float prev_metric);
+static void _refilter(fsk_decoder_handle_t *handle, const float *samples, int from, int count, bool signal_detected);
+static void _save_filters(fsk_decoder_handle_t *handle, int index);
+static void _restore_filters(fsk_decoder_handle_t *handle);
 static int _process_afsk_samples(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
+static void _accumulate_frame_metrics(fsk_decoder_handle_t *handle, float metric, float env_0, float env_1);
+static void _track_edge(fsk_decoder_handle_t *handle, float edge_phase);
+static float _base_samples_per_symbol(fsk_decoder_handle_t *handle);
+static void _apply_symbol_sample_size(fsk_decoder_handle_t *handle, float samples_per_symbol);
+static float _input_energy(fsk_decoder_handle_t *handle, float envelope);
+static void _finish_window(fsk_decoder_handle_t *handle);
+static int _wake(fsk_decoder_handle_t *handle, decoder_handle_t *ctx);
+static void _reconfigure(fsk_decoder_handle_t *handle);
+
+#define FSK_SNR_MAX_DB (40.0f)                    // Caps a single bit's SNR when the other tone's envelope is ~0
+#define FSK_MIN_FILTER_HALF_BANDWIDTH (200.0f)    // Tone filter half bandwidth at low baud rates
+#define FSK_FILTER_HALF_BANDWIDTH_PER_BAUD (0.8f) // Faster keying needs wider filters to pass its sidebands
+#define FSK_ENVELOPE_TAU (0.001f)                 // Envelope smoothing at the configured rate, shrinks with the symbol at faster rates
+#define FSK_MAX_WEAK_BITS (8)                     // Weak bit decisions in a row that end a faster frame
+#define FSK_TIMING_KP (0.5f)                      // Share of an edge's timing error taken out of the symbol phase at once
+#define FSK_TIMING_KI (0.02f)                     // Share of an edge's timing error added to the clock offset
+#define FSK_MAX_CLOCK_OFFSET (0.01f)              // Sender and ADC clocks further apart than this are noise, not drift
+#define FSK_TIMING_ACQUIRE_EDGES (1)              // Edges after the signal is detected that still set the phase outright
+#define FSK_TIMING_MAX_ERROR (0.25f)              // Edges further than this from a boundary, in symbols, set the phase outright
+#define FSK_SQUELCH_OPEN_RATIO (4.0f)             // In-band energy this far over the noise floor opens the squelch, 6 dB
+#define FSK_SQUELCH_CLOSE_RATIO (2.0f)            // and below this it closes again, 3 dB
+#define FSK_SQUELCH_SYMBOLS (0.25f)               // Squelch energy smoothing in base rate symbols, short enough to open before the first decision
+#define FSK_NOISE_FLOOR_FALL_TAU (0.05f)          // The floor follows quieter channels this quickly
+#define FSK_NOISE_FLOOR_RISE_DB (20.0f)           // and climbs toward louder ones this many dB per second
+#define FSK_NOISE_FLOOR_CARRIER_RISE_DB (1.0f)    // or this many once the squelch has been open a while, so frames we don't decode aren't learned as noise
+#define FSK_NOISE_FLOOR_HOLD_SYMBOLS (4.0f)       // Base rate symbols the squelch stays open for before that, far longer than a noise peak
+#define FSK_NOISE_FLOOR_MIN (1e-9f)               // Below a 12-bit ADC's quantization noise, the squelch starts open
+#define FSK_WAKE_RATIO (2.0f)                     // Tone energy over a window this far above the idle channel's wakes the filters, 3 dB, well before the squelch would open
+#define FSK_WAKE_LEVEL_TAU (1.0f)                 // Idle channel tone energy averaging, slow enough to hold steady over single windows
 
 /**
  * @brief Initializes the FSK decoder handle with default values.
@@ -108,6 +149,7 @@ int fsk_decoder_set_symbol_sample_size(fsk_decoder_handle_t *handle, size_t _sym
 
     handle->configs.symbol_sample_size = _symbol_sample_size;
     handle->configs.buffer_symbol_count = _buffer_symbol_count;
+    _reconfigure(handle);
 
     return 0;
 }
@@ -135,6 +177,35 @@ int fsk_decoder_set_sample_rate(fsk_decoder_handle_t *handle, int sample_rate)
     }
 
     handle->configs.sample_rate = sample_rate;
+    _reconfigure(handle);
+
+    return 0;
+}
+
+/**
+ * @brief Sets the format the ADC delivers samples in
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ * @param sample_format Format of the samples in the input ring.
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_decoder_set_sample_format(fsk_decoder_handle_t *handle, pc_sample_format_e sample_format)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return -1;
+    }
+
+    if (sample_format < PC_SAMPLE_FORMAT_U12 || sample_format > PC_SAMPLE_FORMAT_S16)
+    {
+        LOG_ERROR("Invalid sample format %d", (int)sample_format);
+        return -1;
+    }
+
+    handle->configs.sample_format = sample_format;
+    _reconfigure(handle);
 
     return 0;
 }
@@ -175,6 +246,7 @@ int fsk_decoder_set_frequencies(fsk_decoder_handle_t *handle, float _freq_0, flo
 
     handle->configs.freq_0 = _freq_0;
     handle->configs.freq_1 = _freq_1;
+    _reconfigure(handle);
 
 failed:
     return ret;
@@ -215,6 +287,132 @@ failed:
     return ret;
 }
 
+/**
+ * @brief Sets the configured symbol rate exactly
+ *
+ * @note Without it the rate is taken as sample_rate / symbol_sample_size, which loses the
+ *       fraction when the sample rate isn't a whole multiple of the baud rate. Symbol timing
+ *       runs at fractional sample phase, so the sample rate doesn't have to be one.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ * @param baud_rate Symbols per second at the base rate (must be greater than 0).
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_decoder_set_symbol_rate(fsk_decoder_handle_t *handle, int baud_rate)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return -1;
+    }
+
+    if (baud_rate <= 0)
+    {
+        LOG_ERROR("Invalid baud rate: %d", baud_rate);
+        return -1;
+    }
+
+    handle->configs.baud_rate = baud_rate;
+    _reconfigure(handle);
+
+    return 0;
+}
+
+/**
+ * @brief Switches to another symbol rate mid-stream, used after a frame's rate byte
+ *
+ * @note Filter and envelope state is kept so the switch doesn't cause a transient,
+ *       only their coefficients follow the new rate. The decoder falls back to the
+ *       base rate by itself when the signal drops.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ * @param baud_rate The new symbol rate, must leave at least 2 samples per symbol.
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_decoder_set_baud_rate(fsk_decoder_handle_t *handle, int baud_rate)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return -1;
+    }
+
+    if (handle->state == FSK_DECODER_STATE_UNINITIALIZED || handle->state == FSK_DECODER_STATE_INITIALIZING)
+    {
+        LOG_ERROR("FSK decoder isn't initialized");
+        return -1;
+    }
+
+    if (baud_rate <= 0 || handle->configs.sample_rate / baud_rate < 2)
+    {
+        LOG_ERROR("Invalid baud rate: %d", baud_rate);
+        return -1;
+    }
+
+    float samples_per_symbol = (float)handle->configs.sample_rate / (float)baud_rate;
+    if (samples_per_symbol != handle->samples_per_symbol)
+    {
+        LOG_DEBUG("Switching to %d baud", baud_rate);
+        _apply_symbol_sample_size(handle, samples_per_symbol);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Goes back to the configured symbol rate
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_decoder_reset_baud_rate(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return -1;
+    }
+
+    if (handle->state == FSK_DECODER_STATE_UNINITIALIZED || handle->state == FSK_DECODER_STATE_INITIALIZING)
+    {
+        return 0; // Initialization sets the configured rate anyway
+    }
+
+    float samples_per_symbol = _base_samples_per_symbol(handle);
+    if (handle->samples_per_symbol != samples_per_symbol)
+    {
+        _apply_symbol_sample_size(handle, samples_per_symbol);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Configured symbol rate, the one frames start at
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return baud rate, 0 if the decoder isn't configured
+ */
+int fsk_decoder_base_baud_rate(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return 0;
+    }
+
+    if (handle->configs.baud_rate)
+    {
+        return handle->configs.baud_rate;
+    }
+
+    return handle->configs.symbol_sample_size ? handle->configs.sample_rate / handle->configs.symbol_sample_size : 0;
+}
+
 /**
  * @brief Main task function for the FSK decoder. This should be called periodically to process incoming samples and decode bits.
  *
@@ -241,12 +439,39 @@ int fsk_decoder_task(fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
         break;
     case FSK_DECODER_STATE_INITIALIZING:
         handle->state = FSK_DECODER_STATE_IDLE;
-        float gap = 200;
+        float gap = FSK_MIN_FILTER_HALF_BANDWIDTH;
         init_bandpass_4th(handle->configs.freq_0 - gap, handle->configs.freq_0 + gap, handle->configs.sample_rate, &handle->bp1200_1, &handle->bp1200_2);
         init_bandpass_4th(handle->configs.freq_1 - gap, handle->configs.freq_1 + gap, handle->configs.sample_rate, &handle->bp2200_1, &handle->bp2200_2);
-        env_metric_init(&handle->env_metric, (float)handle->configs.sample_rate, 0.001f);
-        handle->half_symbol_sample_size = handle->configs.symbol_sample_size / 2;
+        env_metric_init(&handle->env_metric, (float)handle->configs.sample_rate, FSK_ENVELOPE_TAU);
+        front_end_init(&handle->front_end, handle->configs.sample_format, (float)handle->configs.sample_rate);
+        float dt = 1.0f / (float)handle->configs.sample_rate;
+        handle->squelch_alpha = 1.0f / (FSK_SQUELCH_SYMBOLS * _base_samples_per_symbol(handle) + 1.0f);
+        handle->floor_alpha = dt / (FSK_NOISE_FLOOR_FALL_TAU + dt);
+        handle->floor_rise = powf(10.0f, FSK_NOISE_FLOOR_RISE_DB * dt / 10.0f);
+        handle->floor_carrier_rise = powf(10.0f, FSK_NOISE_FLOOR_CARRIER_RISE_DB * dt / 10.0f);
+        handle->noise_floor = FSK_NOISE_FLOOR_MIN;
+        handle->floor_hold = (int)(FSK_NOISE_FLOOR_HOLD_SYMBOLS * _base_samples_per_symbol(handle));
+        handle->floor_settled = false;
+        handle->carrier_samples = 0;
+        handle->squelch_energy = 0.0f;
+        handle->carrier = false;
+        handle->wake_window = (int)fminf(_base_samples_per_symbol(handle), (float)FSK_WAKE_WINDOW_MAX);
+        float window_dt = (float)handle->wake_window * dt;
+        goertzel_init(&handle->wake_0, handle->configs.freq_0, (float)handle->configs.sample_rate);
+        goertzel_init(&handle->wake_1, handle->configs.freq_1, (float)handle->configs.sample_rate);
+        handle->wake_alpha = window_dt / (FSK_WAKE_LEVEL_TAU + window_dt);
+        handle->wake_level = 0.0f;
+        handle->wake_energy = 0.0f;
+        handle->wake_count = 0;
+        handle->history_index = 0;
+        handle->asleep = false;
+        handle->clock_offset = 0.0f;
+        handle->timing_edges = 0;
+        _apply_symbol_sample_size(handle, _base_samples_per_symbol(handle));
+        handle->symbol_phase = 0.0f;
         handle->prev_metric = 0.0f;
+        handle->signal_detected = false;
+        handle->edge_detected = false;
         LOG_INFO("FSK decoder initialized with symbol_sample_size=%d, buffer_symbol_count=%d, \nsample_rate=%d, freq_0=%.1f, freq_1=%.1f, power_threshold=%.2f",
                  handle->configs.symbol_sample_size,
                  handle->configs.buffer_symbol_count,
@@ -257,14 +482,14 @@ int fsk_decoder_task(fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
         LOG_INFO("FSK decoder initialized");
         break;
     case FSK_DECODER_STATE_IDLE:
-        if (!circular_buffer_is_empty(&ctx->input_buffer))
+        if (!block_ring_is_empty(&ctx->input_ring))
         {
             handle->state = FSK_DECODER_STATE_DECODING;
         }
         break;
     case FSK_DECODER_STATE_DECODING:
     {
-        if (circular_buffer_count(&ctx->input_buffer) < 1)
+        if (block_ring_is_empty(&ctx->input_ring))
         {
             handle->state = FSK_DECODER_STATE_IDLE;
             break;
@@ -282,6 +507,56 @@ failed:
     return ret;
 }
 
+/**
+ * @brief Decodes samples that already went through a front end shared with other decoders
+ *
+ * @note For decoders listening to the same ADC on different tones (an FSK bank). The decoder's
+ *       own front end and ctx's input ring go unused, the shared front end's gain still scales
+ *       the squelch and link measurements back to the input.
+ *
+ * @param handle Pointer to the FSK decoder handle, initialized by fsk_decoder_task()
+ * @param ctx Decoder the bits go to
+ * @param front_end Front end the samples came out of
+ * @param raw The ADC samples, only recorded
+ * @param samples The same samples out of the front end
+ * @param count Samples to decode
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_decoder_demodulate(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const front_end_t *front_end,
+                           const uint16_t *raw, const float *samples, size_t count)
+{
+    int ret = 0;
+
+    if (!handle || !ctx || !front_end || !raw || !samples)
+    {
+        LOG_ERROR("Invalid parameters for FSK demodulate");
+        return -1;
+    }
+
+    if (handle->state == FSK_DECODER_STATE_UNINITIALIZED || handle->state == FSK_DECODER_STATE_INITIALIZING)
+    {
+        LOG_ERROR("FSK decoder isn't initialized");
+        return -1;
+    }
+
+    handle->front_end.gain = front_end->gain;
+
+    uint32_t idle = 0;
+    for (size_t i = 0; i < count;)
+    {
+        int n = _chunk_size(handle, count - i);
+        _watch_tones(handle, &samples[i], n);
+        ret |= _process_chunk(handle, ctx, &raw[i], &samples[i], n, &idle);
+        i += (size_t)n;
+    }
+
+    STAT_ADD(handle->stats.samples, (uint32_t)count);
+    STAT_ADD(handle->stats.idle_samples, idle);
+
+    return ret;
+}
+
 bool fsk_decoder_busy(fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
 {
     if (!handle)
@@ -290,7 +565,7 @@ bool fsk_decoder_busy(fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
         return false;
     }
 
-    return circular_buffer_count(&ctx->input_buffer) >= (size_t)handle->configs.symbol_sample_size * handle->configs.buffer_symbol_count;
+    return !block_ring_is_empty(&ctx->input_ring);
 }
 
 bool fsk_decoder_signal_detected(fsk_decoder_handle_t *handle)
@@ -304,53 +579,488 @@ bool fsk_decoder_signal_detected(fsk_decoder_handle_t *handle)
     return handle->signal_detected;
 }
 
-int _process_sample(uint16_t sample, fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
+/**
+ * @brief Returns the in-band energy seen by the tone filters
+ *
+ * @note This is the sum of both tone envelopes, so it rises as soon as either tone
+ *       is on the air, well before a full symbol can be decoded. The AGC gain is
+ *       taken back out, so it's in input full scale units whatever the volume.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return in-band envelope energy
+ */
+float fsk_decoder_channel_energy(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return 0.0f;
+    }
+
+    // The envelopes stop with the filters, the idle detector still hears the channel
+    if (handle->asleep)
+    {
+        return handle->wake_energy;
+    }
+
+    return _input_energy(handle, handle->env_metric.env1200 + handle->env_metric.env2200);
+}
+
+/**
+ * @brief Estimated in-band noise with no signal on the air, what the squelch opens against
+ *
+ * @note The floor starts low enough that the squelch is open, and climbs to the channel's
+ *       noise within a few seconds of idle channel.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return noise floor, in the units of fsk_decoder_channel_energy
+ */
+float fsk_decoder_noise_floor(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return 0.0f;
+    }
+
+    return handle->noise_floor;
+}
+
+/**
+ * @brief Returns how far the in-band energy stands over the idle channel's
+ *
+ * @note Awake, this is the squelch's energy over the noise floor, what the squelch opens on.
+ *       Asleep, the idle detector's last window over the average of its idle windows, the
+ *       ratio that wakes the filters.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return in-band energy over the idle channel's, 1 on a quiet channel
+ */
+float fsk_decoder_channel_level(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return 0.0f;
+    }
+
+    if (handle->asleep)
+    {
+        return handle->wake_level > 0.0f ? handle->wake_energy / handle->wake_level : 0.0f;
+    }
+
+    return handle->squelch_energy / handle->noise_floor;
+}
+
+/**
+ * @brief Average SNR of the bits decoded since the last reset
+ *
+ * @note Per bit, the tone that was decided on is the signal and the other tone's
+ *       envelope is the noise, so this is the margin the bit decisions had.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return SNR in dB, 0 if no bits were decoded
+ */
+float fsk_decoder_snr(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return 0.0f;
+    }
+
+    if (handle->snr_bits == 0)
+    {
+        return 0.0f;
+    }
+
+    return handle->snr_db_sum / (float)handle->snr_bits;
+}
+
+/**
+ * @brief Average tone envelopes of the bits decoded since the last reset
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ * @param tone_0 Receives the freq_0 envelope, 0 if no bits were decoded
+ * @param tone_1 Receives the freq_1 envelope, 0 if no bits were decoded
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int fsk_decoder_tone_levels(fsk_decoder_handle_t *handle, float *tone_0, float *tone_1)
+{
+    if (!handle || !tone_0 || !tone_1)
+    {
+        LOG_ERROR("FSK decoder handle or levels are NULL");
+        return -1;
+    }
+
+    *tone_0 = handle->snr_bits ? handle->tone_0_sum / (float)handle->snr_bits : 0.0f;
+    *tone_1 = handle->snr_bits ? handle->tone_1_sum / (float)handle->snr_bits : 0.0f;
+
+    return 0;
+}
+
+/**
+ * @brief Average distance of the bit decisions since the last reset past the power threshold
+ *
+ * @note Negative when decisions were made below the threshold, as faster frames allow.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return Margin in metric units, 0 if no bits were decoded
+ */
+float fsk_decoder_metric_margin(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return 0.0f;
+    }
+
+    return handle->snr_bits ? handle->margin_sum / (float)handle->snr_bits : 0.0f;
+}
+
+/**
+ * @brief Input sample the symbol being decided ends on
+ *
+ * @note Meant for the bit callbacks. A decision is made half a symbol into the filtered
+ *       symbol, which lags the input by the filter delay, and the symbol clock says how
+ *       far that decision is from the end of the symbol.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ *
+ * @return Sample index, counted from the first sample the decoder was given
+ */
+uint64_t fsk_decoder_symbol_end_sample(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return 0;
+    }
+
+    float remaining = (1.0f - handle->symbol_phase) / handle->symbol_step - handle->filter_delay;
+    int64_t end = (int64_t)handle->sample_index + (int64_t)lroundf(remaining);
+
+    return end > 0 ? (uint64_t)end : 0;
+}
+
+int fsk_decoder_reset_frame_metrics(fsk_decoder_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("FSK decoder handle is NULL");
+        return -1;
+    }
+
+    handle->snr_db_sum = 0.0f;
+    handle->tone_0_sum = 0.0f;
+    handle->tone_1_sum = 0.0f;
+    handle->margin_sum = 0.0f;
+    handle->snr_bits = 0;
+
+    return 0;
+}
+
+int _process_afsk_samples(fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
 {
-    // Turn DC 12bit sample into float centered around 0
-    float normalized_sample = ((float)sample - 2048.0f) / 2048.0f;
+    int ret = 0;
 
-    float filtered_1200_1 = biquad_process(&handle->bp1200_1, normalized_sample);
-    float filtered_1200 = biquad_process(&handle->bp1200_2, filtered_1200_1);
-    float filtered_2200_1 = biquad_process(&handle->bp2200_1, normalized_sample);
-    float filtered_2200 = biquad_process(&handle->bp2200_2, filtered_2200_1);
+    if (!handle || !ctx)
+    {
+        LOG_ERROR("FSK decoder handle or context is NULL");
+        return -1;
+    }
 
-    float metric = env_metric_process(&handle->env_metric, filtered_1200, filtered_2200);
-    if (metric >= handle->configs.power_threshold && handle->prev_metric < handle->configs.power_threshold)
+    // Blocks are decoded where the ADC BSP wrote them and handed back once done
+    const uint16_t *block;
+    size_t count;
+    uint32_t processed = 0;
+    uint32_t idle = 0;
+    while ((block = block_ring_peek(&ctx->input_ring, &count)) != NULL)
     {
-        LOG_DEBUG("Rising edge detected: metric = %f", metric);
-        handle->edge_detected = true;
-        handle->metric_ticker = 0; // Reset timer on rising edge
+        _process_block(handle, ctx, block, count, &idle);
+        processed += (uint32_t)count;
+
+        if (block_ring_release(&ctx->input_ring))
+        {
+            LOG_ERROR("Failed to release input block");
+            ret = -1;
+            goto failed;
+        }
     }
-    else if (metric < -handle->configs.power_threshold && handle->prev_metric >= -handle->configs.power_threshold)
+
+failed:
+    STAT_ADD(handle->stats.samples, processed); // Once per batch, not per sample
+    STAT_ADD(handle->stats.idle_samples, idle);
+    return ret;
+}
+
+/**
+ * @brief Runs ADC samples through the front end and the rest of the decoder
+ *
+ * @param idle Incremented by the samples the tone filters slept through
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+static int _process_block(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const uint16_t *samples, size_t count, uint32_t *idle)
+{
+    int ret = 0;
+
+    for (size_t i = 0; i < count;)
     {
-        LOG_DEBUG("Falling edge detected: metric = %f", metric);
-        handle->edge_detected = true;
-        handle->metric_ticker = 0; // Reset timer on falling edge
+        int n = _chunk_size(handle, count - i);
+
+        // Float centered around 0 at a steady level whatever the ADC and the volume, and the
+        // idle detector's two Goertzel bins, in one pass. State in locals, the stores into
+        // the handle's arrays would otherwise reload it every sample.
+        float *block = handle->block.samples;
+        front_end_t front_end = handle->front_end;
+        goertzel_t wake_0 = handle->wake_0, wake_1 = handle->wake_1;
+        int history_index = handle->history_index;
+        int history_size = 2 * handle->wake_window;
+        for (int j = 0; j < n; j++)
+        {
+            float x = front_end_process(&front_end, samples[i + j]);
+            block[j] = x;
+            handle->wake_history[history_index] = x;
+            history_index = history_index + 1 < history_size ? history_index + 1 : 0;
+            goertzel_process(&wake_0, x);
+            goertzel_process(&wake_1, x);
+        }
+        handle->front_end = front_end;
+        handle->wake_0 = wake_0;
+        handle->wake_1 = wake_1;
+        handle->history_index = history_index;
+
+        ret |= _process_chunk(handle, ctx, &samples[i], block, n, idle);
+        i += (size_t)n;
     }
 
+    return ret;
+}
+
+/**
+ * @brief Runs samples the idle detector has seen through the demodulator, unless the channel is idle
+ *
+ * @note Chunks end on the idle detector's window boundaries, so sleeping and waking are only
+ *       decided on between chunks.
+ *
+ * @param raw The ADC samples, only recorded
+ * @param samples The same samples out of the front end
+ * @param count Samples in the chunk, from _chunk_size()
+ * @param idle Incremented by the samples the tone filters slept through
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+static int _process_chunk(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const uint16_t *raw, const float *samples, int count, uint32_t *idle)
+{
+    int ret = 0;
+
+    uint64_t first_index = handle->sample_index + 1;
+    handle->sample_index += (uint64_t)count;
+    handle->wake_count += count;
+
+    bool window_done = handle->wake_count == handle->wake_window;
+    if (window_done)
+    {
+        handle->wake_count = 0;
+    }
+
+    if (handle->asleep)
+    {
+        *idle += (uint32_t)count;
+        if (window_done)
+        {
+            _finish_window(handle);
+        }
+        if (window_done && handle->wake_energy >= FSK_WAKE_RATIO * handle->wake_level)
+        {
+            ret |= _wake(handle, ctx);
+        }
+        return ret;
+    }
+
+    ret |= _demodulate_block(handle, ctx, samples, count, first_index);
+
 #if pconfig_DEBUG_RECORDING_ENABLED
-    debug_handle_recording(sample, filtered_1200, filtered_2200, metric);
+    // Recordings want every sample's filter outputs, so the filters never sleep while recording
+    for (int i = 0; i < count; i++)
+    {
+        debug_handle_recording(raw[i], handle->block.filtered_0[i], handle->block.filtered_1[i], handle->block.metric[i + 1]);
+    }
+    if (window_done)
+    {
+        _finish_window(handle);
+    }
+#else
+    (void)raw;
+    if (window_done)
+    {
+        _finish_window(handle);
+
+        // Nothing on the channel and nothing being decoded, the filters can wait for the detector
+        if (!handle->carrier && !handle->signal_detected && handle->wake_energy < FSK_WAKE_RATIO * handle->wake_level)
+        {
+            handle->asleep = true;
+        }
+    }
 #endif
 
-    handle->prev_metric = metric;
+    return ret;
+}
+
+/**
+ * @brief Samples to take next, no more than a block and not past the end of the idle detector's window
+ */
+static int _chunk_size(fsk_decoder_handle_t *handle, size_t remaining)
+{
+    int n = handle->wake_window - handle->wake_count;
+    n = n < FSK_BLOCK_SIZE ? n : FSK_BLOCK_SIZE;
+    return (size_t)n < remaining ? n : (int)remaining;
+}
+
+/**
+ * @brief Feeds the idle detector's history and Goertzel bins, for samples out of a shared front end
+ */
+static void _watch_tones(fsk_decoder_handle_t *handle, const float *samples, int count)
+{
+    goertzel_t wake_0 = handle->wake_0, wake_1 = handle->wake_1;
+    int history_index = handle->history_index;
+    int history_size = 2 * handle->wake_window;
+    for (int i = 0; i < count; i++)
+    {
+        handle->wake_history[history_index] = samples[i];
+        history_index = history_index + 1 < history_size ? history_index + 1 : 0;
+        goertzel_process(&wake_0, samples[i]);
+        goertzel_process(&wake_1, samples[i]);
+    }
+    handle->wake_0 = wake_0;
+    handle->wake_1 = wake_1;
+    handle->history_index = history_index;
+}
+
+/**
+ * @brief Demodulates a block of samples out of the front end
+ *
+ * @note The filters, envelopes and squelch run over the whole block first, with nothing in
+ *       their loop that depends on the signal. The threshold crossings are then found in one
+ *       pass, and only the samples with a crossing or a decision on them get looked at one
+ *       by one, the symbol clock is moved over the stretches between them in a single step.
+ *
+ * @param samples Samples out of the front end
+ * @param count Samples in the block, at most FSK_BLOCK_SIZE
+ * @param first_index Sample index of the first one
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+static int _demodulate_block(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, const float *samples, int count, uint64_t first_index)
+{
+    int ret = 0;
+    float threshold = handle->configs.power_threshold;
+
+    handle->block.metric[0] = handle->prev_metric;
+    _save_filters(handle, 0);
+    _filter_block(handle, samples, 0, count);
+    uint64_t crossings = _find_crossings(handle, count);
 
-    if ((handle->metric_ticker >= handle->half_symbol_sample_size) && (handle->edge_detected || handle->signal_detected))
+    for (int i = 0; i < count;)
     {
-        if (metric >= handle->configs.power_threshold)
+        uint64_t ahead = crossings & (~0ULL << i);
+        int edge = ahead ? __builtin_ctzll(ahead) : count;
+        int next = i + _samples_to_decision(handle) - 1;
+        next = edge < next ? edge : next;
+        if (next >= count)
         {
-            LOG_DEBUG("1: %f", metric);
-            handle->signal_detected = true;
-            if (decoder_process_bit(ctx, true))
-            {
-                LOG_ERROR("Failed to process decoded bit");
-                return -1;
-            }
+            handle->symbol_phase += (float)(count - i) * handle->symbol_step;
+            break;
+        }
+
+        handle->symbol_phase += (float)(next - i + 1) * handle->symbol_step;
+        handle->sample_index = first_index + (uint64_t)next;
+        i = next + 1;
+
+        float metric = handle->block.metric[next + 1];
+        float prev_metric = handle->block.metric[next];
+        if (next == edge)
+        {
+            bool rising = metric >= threshold;
+            LOG_DEBUG("%s edge detected: metric = %f", rising ? "Rising" : "Falling", metric);
+            handle->edge_detected = true;
+
+            // Where between this sample and the last the metric crossed, so the edge isn't rounded to a whole sample
+            float level = rising ? threshold : -threshold;
+            float since = (metric - level) / (metric - prev_metric);
+            _track_edge(handle, handle->symbol_phase - since * handle->symbol_step);
+        }
+
+        if (handle->symbol_phase < 0.5f)
+        {
+            continue;
         }
-        else if (metric < -handle->configs.power_threshold)
+
+        float samples_per_symbol = handle->samples_per_symbol;
+        bool signal_detected = handle->signal_detected;
+        if (_decide(handle, ctx, next, metric, prev_metric))
         {
-            LOG_DEBUG("0: %f", metric);
+            ret = -1;
+        }
+
+        // The rest of the block went through the filters at the old rate, or with the noise floor
+        // still following a channel that now carries a frame (or the other way around)
+        if (handle->samples_per_symbol != samples_per_symbol || handle->signal_detected != signal_detected)
+        {
+            _refilter(handle, samples, next + 1, count, signal_detected);
+            crossings = _find_crossings(handle, count);
+        }
+    }
+
+    handle->prev_metric = handle->block.metric[count];
+    handle->sample_index = first_index + (uint64_t)count - 1;
+
+    return ret;
+}
+
+/**
+ * @brief Decides the bit at the middle of a symbol
+ *
+ * @param index Sample in the block the decision falls on
+ * @param metric Metric at that sample
+ * @param prev_metric Metric at the sample before
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+static int _decide(fsk_decoder_handle_t *handle, decoder_handle_t *ctx, int index, float metric, float prev_metric)
+{
+    float threshold = handle->configs.power_threshold;
+
+    // A decision can switch the rate (rate byte), the symbol it ends was still sent at the old rate
+    float symbol_step = handle->symbol_step;
+    float filter_delay = handle->filter_delay;
+
+    if (handle->edge_detected || handle->signal_detected)
+    {
+        // The middle of the symbol fell between two samples, decide on the metric there
+        float past = fminf((handle->symbol_phase - 0.5f) / symbol_step, 1.0f);
+        float decision = metric - past * (metric - prev_metric);
+
+        bool strong = decision >= threshold || decision < -threshold;
+        handle->weak_bits = strong ? 0 : handle->weak_bits + 1;
+
+        // Within the short symbols of a faster frame the envelopes don't always get far enough apart to clear
+        // the threshold, so bits go to whichever tone is stronger and only a run of weak ones means the signal is gone
+        bool fast = handle->samples_per_symbol != _base_samples_per_symbol(handle);
+        if (handle->block.carrier[index] && (strong || (fast && handle->weak_bits < FSK_MAX_WEAK_BITS)))
+        {
+            bool bit = decision >= 0.0f;
+            LOG_DEBUG("%d: %f", bit, decision);
             handle->signal_detected = true;
-            if (decoder_process_bit(ctx, false))
+            _accumulate_frame_metrics(handle, decision, handle->block.env_0[index], handle->block.env_1[index]);
+            if (decoder_process_bit(ctx, bit))
             {
                 LOG_ERROR("Failed to process decoded bit");
                 return -1;
@@ -359,39 +1069,351 @@ int _process_sample(uint16_t sample, fsk_decoder_handle_t *handle, decoder_handl
         else
         {
             handle->signal_detected = false;
+            handle->clock_offset = 0.0f; // The next frame's sender has its own clock
+            handle->timing_edges = 0;
+
+            // Frame is over (or lost), the next one starts at the base rate
+            if (fast)
+            {
+                _apply_symbol_sample_size(handle, _base_samples_per_symbol(handle));
+            }
         }
 
         handle->edge_detected = false;
-        handle->metric_ticker = -handle->half_symbol_sample_size; // Set to negative so we wait a full symbol period before measuring again
     }
-    handle->metric_ticker++;
+
+    // The next boundary is half an old symbol away. After a rate switch the filters also show
+    // the signal sooner (or later), and the symbols after it are counted at the new rate.
+    float to_boundary = (1.0f - handle->symbol_phase) / symbol_step - (filter_delay - handle->filter_delay);
+    handle->symbol_phase = -to_boundary * handle->symbol_step;
 
     return 0;
 }
 
-int _process_afsk_samples(fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
+// Everything here is already at hand at the decision, a handful of adds per bit
+static void _accumulate_frame_metrics(fsk_decoder_handle_t *handle, float metric, float env_0, float env_1)
 {
-    int ret = 0;
+    float signal = fmaxf(env_0, env_1);
+    float noise = fminf(env_0, env_1) + 1e-9f;
 
-    if (!handle || !ctx)
+    float snr_db = 10.0f * log10f(signal / noise);
+    handle->snr_db_sum += (snr_db > FSK_SNR_MAX_DB) ? FSK_SNR_MAX_DB : snr_db;
+    handle->tone_0_sum += _input_energy(handle, env_0);
+    handle->tone_1_sum += _input_energy(handle, env_1);
+    handle->margin_sum += fabsf(metric) - handle->configs.power_threshold;
+    handle->snr_bits++;
+}
+
+/**
+ * @brief Pulls the symbol clock toward a threshold crossing of the metric
+ *
+ * @note Until a signal is detected each edge sets the phase outright, and so do the first
+ *       after it, since the edge out of silence comes sooner than one between tones. After
+ *       that an edge close to a boundary only moves it part of the way, so jitter on one edge
+ *       doesn't throw the decisions off, and the integrated error follows a sender whose clock
+ *       runs fast or slow through the runs of equal bits that have no edges at all. An edge
+ *       nowhere near a boundary is noise or a new signal and sets the phase like the first.
+ *
+ * @param handle Pointer to the FSK decoder handle.
+ * @param edge_phase Symbol phase at the crossing, 0 when it lands on the expected boundary
+ */
+static void _track_edge(fsk_decoder_handle_t *handle, float edge_phase)
+{
+    if (!handle->signal_detected || handle->timing_edges < FSK_TIMING_ACQUIRE_EDGES || fabsf(edge_phase) > FSK_TIMING_MAX_ERROR)
     {
-        LOG_ERROR("FSK decoder handle or context is NULL");
-        return -1;
+        handle->symbol_phase -= edge_phase;
+        handle->timing_edges += handle->signal_detected;
+        return;
     }
 
-    uint16_t sample;
-    static int count = 0;
-    while (circular_buffer_is_empty(&ctx->input_buffer) == false)
+    handle->symbol_phase -= FSK_TIMING_KP * edge_phase;
+    handle->clock_offset = fminf(fmaxf(handle->clock_offset - FSK_TIMING_KI * edge_phase, -FSK_MAX_CLOCK_OFFSET), FSK_MAX_CLOCK_OFFSET);
+    handle->symbol_step = (1.0f + handle->clock_offset) / handle->samples_per_symbol;
+}
+
+static float _base_samples_per_symbol(fsk_decoder_handle_t *handle)
+{
+    if (handle->configs.baud_rate)
     {
-        if (circular_buffer_pop(&ctx->input_buffer, &sample))
+        return (float)handle->configs.sample_rate / (float)handle->configs.baud_rate;
+    }
+
+    return (float)handle->configs.symbol_sample_size;
+}
+
+/**
+ * @brief Sets symbol timing, tone filter bandwidth and envelope smoothing for a symbol rate
+ */
+static void _apply_symbol_sample_size(fsk_decoder_handle_t *handle, float samples_per_symbol)
+{
+    float sample_rate = (float)handle->configs.sample_rate;
+    float baud_rate = sample_rate / samples_per_symbol;
+
+    float gap = fmaxf(FSK_MIN_FILTER_HALF_BANDWIDTH, FSK_FILTER_HALF_BANDWIDTH_PER_BAUD * baud_rate);
+    design_bandpass_biquad(handle->configs.freq_0 - gap, handle->configs.freq_0 + gap, sample_rate, &handle->bp1200_1.c);
+    handle->bp1200_2.c = handle->bp1200_1.c;
+    design_bandpass_biquad(handle->configs.freq_1 - gap, handle->configs.freq_1 + gap, sample_rate, &handle->bp2200_1.c);
+    handle->bp2200_2.c = handle->bp2200_1.c;
+
+    float tau = FSK_ENVELOPE_TAU * samples_per_symbol / _base_samples_per_symbol(handle);
+    handle->env_metric.alpha = (1.0f / sample_rate) / (tau + 1.0f / sample_rate);
+
+    // Group delay of the two bandpass stages at the tones, plus the envelope lag
+    handle->filter_delay = (1.0f / ((float)M_PI * gap) + tau) * sample_rate;
+    handle->samples_per_symbol = samples_per_symbol;
+    handle->symbol_sample_size = (int)samples_per_symbol;
+    handle->symbol_step = (1.0f + handle->clock_offset) / samples_per_symbol;
+    handle->weak_bits = 0;
+}
+
+/**
+ * @brief Takes the AGC gain back out of an envelope, so levels compare against input full scale
+ */
+static float _input_energy(fsk_decoder_handle_t *handle, float envelope)
+{
+    return envelope / (handle->front_end.gain * handle->front_end.gain);
+}
+
+/**
+ * @brief Runs part of a block through the tone filters, the envelopes and the squelch
+ *
+ * @note Straight line code with the state in locals, nothing in the loop depends on the signal.
+ *       The squelch follows the noise floor while no signal is decoded and opens on energy well
+ *       above it. The floor falls quickly and climbs slowly, so it sits near the quiet end of the
+ *       noise rather than its average and noise peaks stay under the open ratio. Once the squelch
+ *       has been open longer than a noise peak it climbs slower still, so a frame we can't decode
+ *       isn't taken for noise and carrier sense keeps hearing it. It's left alone during a frame.
+ *
+ * @param from First sample of the block to filter
+ * @param to One past the last
+ */
+static void _filter_block(fsk_decoder_handle_t *handle, const float *samples, int from, int to)
+{
+    biquad_t bp1200_1 = handle->bp1200_1, bp1200_2 = handle->bp1200_2;
+    biquad_t bp2200_1 = handle->bp2200_1, bp2200_2 = handle->bp2200_2;
+    env_metric_t env_metric = handle->env_metric;
+    float squelch_energy = handle->squelch_energy;
+    float noise_floor = handle->noise_floor;
+    bool carrier = handle->carrier;
+    bool settled = handle->floor_settled;
+    int carrier_samples = handle->carrier_samples;
+
+    // The AGC gain only moves every few samples and over about a second, a block sees one gain
+    float to_input = _input_energy(handle, 1.0f);
+    float squelch_alpha = handle->squelch_alpha;
+    float floor_alpha = handle->floor_alpha;
+    float floor_rise = handle->floor_rise;
+    float floor_carrier_rise = handle->floor_carrier_rise;
+    int floor_hold = handle->floor_hold;
+    bool learn = !handle->signal_detected;
+
+    float *metric = handle->block.metric;
+    float *env_0 = handle->block.env_0;
+    float *env_1 = handle->block.env_1;
+    bool *carriers = handle->block.carrier;
+    for (int i = from; i < to; i++)
+    {
+        float filtered_1200 = biquad_process(&bp1200_2, biquad_process(&bp1200_1, samples[i]));
+        float filtered_2200 = biquad_process(&bp2200_2, biquad_process(&bp2200_1, samples[i]));
+        metric[i + 1] = env_metric_process(&env_metric, filtered_1200, filtered_2200);
+        env_0[i] = env_metric.env1200;
+        env_1[i] = env_metric.env2200;
+#if pconfig_DEBUG_RECORDING_ENABLED
+        handle->block.filtered_0[i] = filtered_1200;
+        handle->block.filtered_1[i] = filtered_2200;
+#endif
+
+        float energy = (env_metric.env1200 + env_metric.env2200) * to_input;
+        squelch_energy += squelch_alpha * (energy - squelch_energy);
+        if (learn)
         {
-            LOG_ERROR("Failed to pop sample from circular buffer");
-            ret = -1;
-            goto failed;
+            float rise = settled && carrier_samples > floor_hold ? floor_carrier_rise : floor_rise;
+            noise_floor = squelch_energy < noise_floor ? noise_floor + floor_alpha * (squelch_energy - noise_floor)
+                                                       : noise_floor * rise;
+            noise_floor = fmaxf(noise_floor, FSK_NOISE_FLOOR_MIN);
         }
-        _process_sample(sample, handle, ctx);
+
+        float ratio = carrier ? FSK_SQUELCH_CLOSE_RATIO : FSK_SQUELCH_OPEN_RATIO;
+        carrier = squelch_energy >= ratio * noise_floor;
+        carriers[i] = carrier;
+        carrier_samples = carrier ? carrier_samples + 1 : 0;
+        settled |= !carrier;
+    }
+
+    handle->bp1200_1 = bp1200_1;
+    handle->bp1200_2 = bp1200_2;
+    handle->bp2200_1 = bp2200_1;
+    handle->bp2200_2 = bp2200_2;
+    handle->env_metric = env_metric;
+    handle->squelch_energy = squelch_energy;
+    handle->noise_floor = noise_floor;
+    handle->carrier = carrier;
+    handle->floor_settled = settled;
+    handle->carrier_samples = carrier_samples;
+}
+
+/**
+ * @brief Marks the samples of a block where the metric crosses the power threshold either way
+ *
+ * @note No branches, so it vectorizes. Walking the set bits is all the per-crossing work left.
+ *
+ * @return bit i set when the metric crossed at sample i
+ */
+static uint64_t _find_crossings(fsk_decoder_handle_t *handle, int count)
+{
+    const float *metric = handle->block.metric;
+    float threshold = handle->configs.power_threshold;
+    uint64_t crossings = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        bool rising = (metric[i + 1] >= threshold) & (metric[i] < threshold);
+        bool falling = (metric[i + 1] < -threshold) & (metric[i] >= -threshold);
+        crossings |= (uint64_t)(rising | falling) << i;
+    }
+
+    return crossings;
+}
+
+/**
+ * @brief Samples until the symbol clock reaches the middle of the symbol, if no edge moves it first
+ *
+ * @return 1 when the next sample is the decision
+ */
+static int _samples_to_decision(fsk_decoder_handle_t *handle)
+{
+    int samples = (int)ceilf((0.5f - handle->symbol_phase) / handle->symbol_step);
+    return samples > 1 ? samples : 1;
+}
+
+/**
+ * @brief Filters the rest of a block again after a decision changed the rate or the squelch
+ *
+ * @note The filters already ran past the decision, so they're taken back to the start of the block,
+ *       run up to the decision as they were, and only then given the new rate. Happens a few times a frame.
+ *
+ * @param from Sample after the decision
+ * @param signal_detected Whether a signal was detected before the decision
+ */
+static void _refilter(fsk_decoder_handle_t *handle, const float *samples, int from, int count, bool signal_detected)
+{
+    biquad_coeffs_t bp1200 = handle->bp1200_1.c;
+    biquad_coeffs_t bp2200 = handle->bp2200_1.c;
+    float env_alpha = handle->env_metric.alpha;
+    bool detected = handle->signal_detected;
+
+    _restore_filters(handle);
+    handle->signal_detected = signal_detected;
+    _filter_block(handle, samples, handle->block.start_index, from);
+
+    handle->bp1200_1.c = bp1200;
+    handle->bp1200_2.c = bp1200;
+    handle->bp2200_1.c = bp2200;
+    handle->bp2200_2.c = bp2200;
+    handle->env_metric.alpha = env_alpha;
+    handle->signal_detected = detected;
+    _save_filters(handle, from);
+    _filter_block(handle, samples, from, count);
+}
+
+static void _save_filters(fsk_decoder_handle_t *handle, int index)
+{
+    fsk_filter_state_t *start = &handle->block.start;
+
+    start->bp1200_1 = handle->bp1200_1;
+    start->bp1200_2 = handle->bp1200_2;
+    start->bp2200_1 = handle->bp2200_1;
+    start->bp2200_2 = handle->bp2200_2;
+    start->env_metric = handle->env_metric;
+    start->squelch_energy = handle->squelch_energy;
+    start->noise_floor = handle->noise_floor;
+    start->carrier = handle->carrier;
+    start->floor_settled = handle->floor_settled;
+    start->carrier_samples = handle->carrier_samples;
+    handle->block.start_index = index;
+}
+
+static void _restore_filters(fsk_decoder_handle_t *handle)
+{
+    const fsk_filter_state_t *start = &handle->block.start;
+
+    handle->bp1200_1 = start->bp1200_1;
+    handle->bp1200_2 = start->bp1200_2;
+    handle->bp2200_1 = start->bp2200_1;
+    handle->bp2200_2 = start->bp2200_2;
+    handle->env_metric = start->env_metric;
+    handle->squelch_energy = start->squelch_energy;
+    handle->noise_floor = start->noise_floor;
+    handle->carrier = start->carrier;
+    handle->floor_settled = start->floor_settled;
+    handle->carrier_samples = start->carrier_samples;
+}
+
+/**
+ * @brief Measures the tone energy of a completed idle detector window
+ *
+ * @note A window's energy is compared against the average of the idle channel's, and while
+ *       asleep the squelch's floor moves with that average so it still fits the channel on waking.
+ */
+static void _finish_window(fsk_decoder_handle_t *handle)
+{
+    // A tone of amplitude A comes out of a bin at (A N / 2)^2, scaled to the envelopes' A^2 / 2
+    float n = (float)handle->wake_window;
+    float power = goertzel_finish(&handle->wake_0) + goertzel_finish(&handle->wake_1);
+    handle->wake_energy = _input_energy(handle, 2.0f * power / (n * n));
+
+    // A carrier we don't decode isn't the idle channel either, once it has lasted longer than a noise peak
+    bool held = handle->floor_settled && handle->carrier_samples > handle->floor_hold;
+    if (!handle->signal_detected && !held)
+    {
+        float level = handle->wake_level + handle->wake_alpha * (handle->wake_energy - handle->wake_level);
+        if (handle->asleep)
+        {
+            handle->noise_floor = fmaxf(handle->noise_floor * level / handle->wake_level, FSK_NOISE_FLOOR_MIN);
+        }
+        handle->wake_level = level;
+    }
+}
+
+/**
+ * @brief Restarts the tone filters on the last two detector windows
+ *
+ * @note The tones can have started anywhere in the window that woke the filters, and the one
+ *       before holds what led up to them, so the symbol clock sees the first edge as if the
+ *       filters had never stopped. They pick up from the quiet channel they went to sleep on,
+ *       starting them from zero instead would drag the squelch's floor down on every wake.
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+static int _wake(fsk_decoder_handle_t *handle, decoder_handle_t *ctx)
+{
+    int ret = 0;
+
+    handle->asleep = false;
+    handle->edge_detected = false;
+
+    // Oldest first, in blocks that don't wrap around the history. Stamps still count from the sample each one was.
+    int count = 2 * handle->wake_window;
+    uint64_t first_index = handle->sample_index - (uint64_t)count + 1;
+    for (int i = 0; i < count;)
+    {
+        int start = (handle->history_index + i) % count;
+        int n = count - start < count - i ? count - start : count - i;
+        n = n < FSK_BLOCK_SIZE ? n : FSK_BLOCK_SIZE;
+        ret |= _demodulate_block(handle, ctx, &handle->wake_history[start], n, first_index + (uint64_t)i);
+        i += n;
     }
 
-failed:
     return ret;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Redesigns the filters and symbol timing from the configs on the next task call, once initialized
+ */
+static void _reconfigure(fsk_decoder_handle_t *handle)
+{
+    if (handle->state == FSK_DECODER_STATE_IDLE || handle->state == FSK_DECODER_STATE_DECODING)
+    {
+        handle->state = FSK_DECODER_STATE_INITIALIZING;
+    }
+}
@@ -2,9 +2,12 @@
 
 #include "decoding/decoder.h"
 #include "c-logger.h"
+#include "utils/trace.h"
 #include <string.h>
 
 static void _process_header(packet_decoder_t *handle);
+static void _process_extensions(packet_decoder_t *handle);
+static void _finish_packet(packet_decoder_t *handle);
 
 int packet_decoder_init(packet_decoder_t *handle, void *ctx)
 {
@@ -15,6 +18,7 @@ int packet_decoder_init(packet_decoder_t *handle, void *ctx)
 
     handle->ctx = ctx;
     handle->state = PACKET_DECODER_STATE_WAITING_FOR_HEADER;
+    memset(&handle->stats, 0, sizeof(handle->stats));
 
     return 0;
 }
@@ -55,39 +59,31 @@ int packet_decoder_process_byte(packet_decoder_t *handle, unsigned char byte)
             if (handle->current_packet.content.payload_length > pconfigMAX_PAYLOAD_SIZE)
             {
                 LOG_ERROR("Invalid payload length: %d", handle->current_packet.content.payload_length);
+                STAT_INC(handle->stats.length_rejected);
                 decoder_reset(handle->ctx); // Resets byte decoder so we wait for next sync word
                 packet_decoder_reset(handle);
                 handle->state = PACKET_DECODER_STATE_WAITING_FOR_HEADER;
                 return -1;
             }
 
+            handle->header_size = PACKET_HEADER_SIZE + packet_extension_size(handle->current_packet.content.flags);
+            TRACE_FRAME(TRACE_STAGE_HEADER_PARSED, &handle->current_packet);
+
             LOG_DEBUG("Header received and validated, waiting for payload");
             handle->state = PACKET_DECODER_STATE_WAITING_FOR_PAYLOAD;
+
+            // A frame with no payload or extensions (an ACK) ends with its header, there's no next byte to wait for
+            if (handle->packet_buffer_index >= handle->header_size + handle->current_packet.content.payload_length)
+            {
+                _finish_packet(handle);
+            }
         }
         break;
     case PACKET_DECODER_STATE_WAITING_FOR_PAYLOAD:
         // Check if we have received the full payload
-        if (handle->packet_buffer_index >= PACKET_HEADER_SIZE + handle->current_packet.content.payload_length)
+        if (handle->packet_buffer_index >= handle->header_size + handle->current_packet.content.payload_length)
         {
-            // Copy payload data
-            for (size_t i = 0; i < handle->current_packet.content.payload_length; i++)
-            {
-                handle->current_packet.content.payload[i] = handle->packet_buffer[PACKET_HEADER_SIZE + i];
-            }
-
-            // Check CRC
-            if (handle->current_packet.content.crc == calculate_crc(&handle->current_packet))
-            {
-                LOG_DEBUG("CRC Validated");
-                decoder_process_packet(handle->ctx, &handle->current_packet);
-            }
-            else
-            {
-                LOG_INFO("CRC didn't match");
-            }
-            decoder_reset(handle->ctx);
-            packet_decoder_reset(handle); // Technically this is done by decoder_reset, but just to be safe
-            handle->state = PACKET_DECODER_STATE_WAITING_FOR_HEADER;
+            _finish_packet(handle);
         }
         break;
     default:
@@ -107,6 +103,10 @@ int packet_decoder_reset(packet_decoder_t *handle)
     }
 
     handle->packet_buffer_index = 0;
+    handle->header_size = PACKET_HEADER_SIZE;
+    // A new sync word can arrive mid-frame (e.g. back to back frames after a corrupted one),
+    // so always start over from the header
+    handle->state = PACKET_DECODER_STATE_WAITING_FOR_HEADER;
     // Clear current packet
     memset(&handle->current_packet, 0, sizeof(packet_t));
 
@@ -126,6 +126,57 @@ static void _process_header(packet_decoder_t *handle)
     handle->current_packet.content.id = handle->packet_buffer[2];
     handle->current_packet.content.ttl = handle->packet_buffer[3] >> 4;
     handle->current_packet.content.type = handle->packet_buffer[3] & 0x0F;
-    handle->current_packet.content.payload_length = handle->packet_buffer[4];
-    handle->current_packet.content.crc = (handle->packet_buffer[5] << 8) | handle->packet_buffer[6];
+    handle->current_packet.content.flags = handle->packet_buffer[4];
+    handle->current_packet.content.payload_length = handle->packet_buffer[5];
+    handle->current_packet.content.crc = (handle->packet_buffer[6] << 8) | handle->packet_buffer[7];
+}
+
+// Checks the CRC of a complete frame, hands it on if it passes and starts over
+static void _finish_packet(packet_decoder_t *handle)
+{
+    _process_extensions(handle);
+
+    // Copy payload data
+    for (size_t i = 0; i < handle->current_packet.content.payload_length; i++)
+    {
+        handle->current_packet.content.payload[i] = handle->packet_buffer[handle->header_size + i];
+    }
+
+    // Check CRC
+    if (handle->current_packet.content.crc == calculate_crc(&handle->current_packet))
+    {
+        LOG_DEBUG("CRC Validated");
+        STAT_INC(handle->stats.crc_passed);
+        TRACE_FRAME(TRACE_STAGE_CRC_VALIDATED, &handle->current_packet);
+        decoder_process_packet(handle->ctx, &handle->current_packet);
+    }
+    else
+    {
+        LOG_INFO("CRC didn't match");
+        STAT_INC(handle->stats.crc_failed);
+    }
+    decoder_reset(handle->ctx);
+    packet_decoder_reset(handle); // Technically this is done by decoder_reset, but just to be safe
+    handle->state = PACKET_DECODER_STATE_WAITING_FOR_HEADER;
+}
+
+static void _process_extensions(packet_decoder_t *handle)
+{
+    size_t index = PACKET_HEADER_SIZE;
+
+    // Same order as the serializer
+    if (handle->current_packet.content.flags & PACKET_FLAG_FRAGMENT)
+    {
+        handle->current_packet.content.fragment.message_id = handle->packet_buffer[index++];
+        handle->current_packet.content.fragment.index = handle->packet_buffer[index++];
+        handle->current_packet.content.fragment.count = handle->packet_buffer[index++];
+    }
+    if (handle->current_packet.content.flags & PACKET_FLAG_NEXT_HOP)
+    {
+        handle->current_packet.content.next_hop = handle->packet_buffer[index++];
+    }
+    if (handle->current_packet.content.flags & PACKET_FLAG_SESSION)
+    {
+        handle->current_packet.content.session = handle->packet_buffer[index++];
+    }
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+/**
+ * @file front_end.c
+ *
+ * @author Diamond42474
+ *
+ * Sample conversion, DC blocking and AGC ahead of the tone filters. The
+ * gain follows a running mean magnitude over about a second and only moves
+ * every few samples. A faster AGC would still be settling at the start of
+ * each frame, and the tone filters ring with every gain step just as the
+ * symbol clock is being set.
+ */
+#include "dsp/front_end.h"
+
+#include "c-logger.h"
+
+#define FRONT_END_DC_TAU (0.02f)       // DC blocker time constant, its corner sits around 8 Hz, far below the tones
+#define FRONT_END_AGC_TAU (1.0f)       // Level tracking, follows the radio's volume rather than a frame's first symbols
+#define FRONT_END_TARGET_LEVEL (0.25f) // Mean magnitude the AGC aims for, a tone peaking at 0.4 of full scale
+#define FRONT_END_MIN_GAIN (0.1f)
+#define FRONT_END_MAX_GAIN (100.0f)    // Only noise is left to amplify in silence
+#define FRONT_END_GAIN_INTERVAL (32)   // Samples between gain updates, spares a division per sample
+
+/**
+ * @brief Sets up the front end for a sample format
+ *
+ * @param front_end Pointer to the front end
+ * @param format Format the ADC BSP delivers samples in
+ * @param sample_rate Sample rate in Hz
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int front_end_init(front_end_t *front_end, pc_sample_format_e format, float sample_rate)
+{
+    if (!front_end || sample_rate <= 0.0f)
+    {
+        LOG_ERROR("Invalid parameters for front end init");
+        return -1;
+    }
+
+    switch (format)
+    {
+    case PC_SAMPLE_FORMAT_U12:
+        front_end->flip = 0;
+        front_end->offset = 2048.0f;
+        break;
+    case PC_SAMPLE_FORMAT_U16:
+        front_end->flip = 0;
+        front_end->offset = 32768.0f;
+        break;
+    case PC_SAMPLE_FORMAT_S16:
+        front_end->flip = 0x8000; // Two's complement to offset binary
+        front_end->offset = 32768.0f;
+        break;
+    default:
+        LOG_ERROR("Unknown sample format %d", (int)format);
+        return -1;
+    }
+    front_end->scale = 1.0f / front_end->offset;
+
+    float dt = 1.0f / sample_rate;
+    front_end->dc = 0.0f;
+    front_end->dc_alpha = dt / (FRONT_END_DC_TAU + dt);
+    front_end->level = FRONT_END_TARGET_LEVEL;
+    front_end->level_alpha = dt / (FRONT_END_AGC_TAU + dt);
+    front_end->gain = 1.0f;
+    front_end->countdown = FRONT_END_GAIN_INTERVAL;
+
+    return 0;
+}
+
+void front_end_update_gain(front_end_t *front_end)
+{
+    float gain = FRONT_END_TARGET_LEVEL / (front_end->level + 1e-9f);
+    front_end->gain = fminf(fmaxf(gain, FRONT_END_MIN_GAIN), FRONT_END_MAX_GAIN);
+    front_end->countdown = FRONT_END_GAIN_INTERVAL;
+}
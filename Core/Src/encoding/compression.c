@@ -0,0 +1,218 @@
+/**
+ * @file compression.c
+ *
+ * @author Diamond42474
+ *
+ * LZSS compression for message payloads. Short messages don't have enough
+ * history of their own to compress, so the window is primed with a static
+ * dictionary of strings that show up in our status and telemetry messages.
+ * Both ends share the dictionary, it lives in flash and no RAM is needed
+ * beyond the input and output buffers.
+ *
+ * Format: a control byte announces the next 8 items, LSB first. A set bit is
+ * a literal byte, a clear bit is a 2 byte match holding a 12-bit distance
+ * back into dictionary + output and a 4-bit length.
+ */
+#include "encoding/compression.h"
+
+#include <string.h>
+#include "c-logger.h"
+
+#define COMPRESSION_MIN_MATCH (3)
+#define COMPRESSION_MAX_MATCH (COMPRESSION_MIN_MATCH + 0x0F)
+#define COMPRESSION_MAX_DISTANCE (0x0FFF)
+#define COMPRESSION_MATCH_SIZE (2)
+
+// Shared by every node, changing it breaks decoding of messages from nodes running older firmware
+static const char dictionary[] =
+    "0123456789.-+ ,:;=/%()[]{}\"'\r\n"
+    "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ "
+    "true false null ERROR WARN INFO FAIL error fault alarm "
+    "latitude longitude altitude heading speed gps fix sats "
+    "pressure hPa humidity % wind rain lux uv "
+    "voltage current power mA mV V W battery charge solar "
+    "uptime time date ms s min hour count seq id node addr "
+    "rssi snr signal noise link status state mode online offline "
+    "temp temperature C F OK ok, \"id\":\"status\":\"temp\":\"batt\":\"value\":";
+
+#define DICTIONARY_SIZE (sizeof(dictionary) - 1)
+
+static uint8_t _window_byte(const uint8_t *data, size_t index);
+
+/**
+ * @brief Compresses a buffer
+ *
+ * @param input data to compress
+ * @param input_len length of input
+ * @param output receives the compressed data
+ * @param output_capacity size of output, pass less than input_len to give up as soon as compression doesn't pay off
+ * @param output_len receives the compressed length
+ *
+ * @return error code: 0 = successful, -1 = failed (including the output not fitting)
+ */
+int compression_compress(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_capacity, size_t *output_len)
+{
+    if (!input || !output || !output_len)
+    {
+        LOG_ERROR("Invalid parameters for compression");
+        return -1;
+    }
+
+    size_t pos = 0;
+    size_t out = 0;
+    size_t control = 0;
+    uint8_t item = 0;
+
+    while (pos < input_len)
+    {
+        if (item == 0)
+        {
+            if (out >= output_capacity)
+            {
+                return -1;
+            }
+            control = out++;
+            output[control] = 0;
+        }
+
+        // Longest match in the window, positions are in dictionary + input space
+        size_t current = DICTIONARY_SIZE + pos;
+        size_t start = (current > COMPRESSION_MAX_DISTANCE) ? current - COMPRESSION_MAX_DISTANCE : 0;
+        size_t max_len = (input_len - pos < COMPRESSION_MAX_MATCH) ? input_len - pos : COMPRESSION_MAX_MATCH;
+        size_t best_len = 0;
+        size_t best_distance = 0;
+
+        for (size_t candidate = start; candidate < current && best_len < max_len; candidate++)
+        {
+            size_t len = 0;
+            while (len < max_len && _window_byte(input, candidate + len) == input[pos + len])
+            {
+                len++;
+            }
+
+            if (len > best_len)
+            {
+                best_len = len;
+                best_distance = current - candidate;
+            }
+        }
+
+        if (best_len >= COMPRESSION_MIN_MATCH)
+        {
+            if (out + COMPRESSION_MATCH_SIZE > output_capacity)
+            {
+                return -1;
+            }
+            output[out++] = (uint8_t)(best_distance >> 4);
+            output[out++] = (uint8_t)(((best_distance & 0x0F) << 4) | (best_len - COMPRESSION_MIN_MATCH));
+            pos += best_len;
+        }
+        else
+        {
+            if (out >= output_capacity)
+            {
+                return -1;
+            }
+            output[control] |= (1 << item);
+            output[out++] = input[pos++];
+        }
+
+        item = (item + 1) % 8;
+    }
+
+    *output_len = out;
+
+    return 0;
+}
+
+/**
+ * @brief Decompresses a buffer produced by compression_compress
+ *
+ * @param input compressed data
+ * @param input_len length of input
+ * @param output receives the original data
+ * @param output_capacity size of output
+ * @param output_len receives the original length
+ *
+ * @return error code: 0 = successful, -1 = failed (corrupt input or output too small)
+ */
+int compression_decompress(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_capacity, size_t *output_len)
+{
+    if (!input || !output || !output_len)
+    {
+        LOG_ERROR("Invalid parameters for decompression");
+        return -1;
+    }
+
+    size_t pos = 0;
+    size_t out = 0;
+
+    while (pos < input_len)
+    {
+        uint8_t control = input[pos++];
+
+        for (uint8_t item = 0; item < 8 && pos < input_len; item++)
+        {
+            if (control & (1 << item))
+            {
+                if (out >= output_capacity)
+                {
+                    LOG_ERROR("Decompressed data doesn't fit");
+                    return -1;
+                }
+                output[out++] = input[pos++];
+                continue;
+            }
+
+            if (pos + COMPRESSION_MATCH_SIZE > input_len)
+            {
+                LOG_ERROR("Truncated match");
+                return -1;
+            }
+
+            size_t distance = ((size_t)input[pos] << 4) | (input[pos + 1] >> 4);
+            size_t len = (input[pos + 1] & 0x0F) + COMPRESSION_MIN_MATCH;
+            pos += COMPRESSION_MATCH_SIZE;
+
+            size_t current = DICTIONARY_SIZE + out;
+            if (distance == 0 || distance > current)
+            {
+                LOG_ERROR("Invalid match");
+                return -1;
+            }
+            if (out + len > output_capacity)
+            {
+                LOG_ERROR("Decompressed data doesn't fit");
+                return -1;
+            }
+
+            // Byte by byte, a match may overlap what it is producing
+            for (size_t i = 0; i < len; i++)
+            {
+                output[out] = _window_byte(output, current - distance + i);
+                out++;
+            }
+        }
+    }
+
+    *output_len = out;
+
+    return 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+/**
+ * @brief Byte at an index into the dictionary followed by data
+ */
+static uint8_t _window_byte(const uint8_t *data, size_t index)
+{
+    if (index < DICTIONARY_SIZE)
+    {
+        return (uint8_t)dictionary[index];
+    }
+
+    return data[index - DICTIONARY_SIZE];
+}
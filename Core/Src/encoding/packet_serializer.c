@@ -11,7 +11,7 @@ int packet_serializer_serialize(const packet_t *packet, circular_buffer_t *outpu
         return -1;
     }
 
-    uint8_t tmp[PACKET_HEADER_SIZE];
+    uint8_t tmp[PACKET_HEADER_SIZE + PACKET_MAX_EXTENSION_SIZE];
     memset(tmp, 0, sizeof(tmp));
 
     // Push header fields
@@ -19,12 +19,30 @@ int packet_serializer_serialize(const packet_t *packet, circular_buffer_t *outpu
     tmp[1] = packet->content.dest_addr;
     tmp[2] = packet->content.id;
     tmp[3] = (packet->content.ttl << 4) | (packet->content.type & 0x0F);
-    tmp[4] = packet->content.payload_length;
-    tmp[5] = (packet->content.crc >> 8) & 0xFF;
-    tmp[6] = packet->content.crc & 0xFF;
+    tmp[4] = packet->content.flags;
+    tmp[5] = packet->content.payload_length;
+    tmp[6] = (packet->content.crc >> 8) & 0xFF;
+    tmp[7] = packet->content.crc & 0xFF;
+
+    // Header extensions, in flag bit order
+    size_t header_size = PACKET_HEADER_SIZE;
+    if (packet->content.flags & PACKET_FLAG_FRAGMENT)
+    {
+        tmp[header_size++] = packet->content.fragment.message_id;
+        tmp[header_size++] = packet->content.fragment.index;
+        tmp[header_size++] = packet->content.fragment.count;
+    }
+    if (packet->content.flags & PACKET_FLAG_NEXT_HOP)
+    {
+        tmp[header_size++] = packet->content.next_hop;
+    }
+    if (packet->content.flags & PACKET_FLAG_SESSION)
+    {
+        tmp[header_size++] = packet->content.session;
+    }
 
     // Push packet header to output buffer
-    for (size_t i = 0; i < PACKET_HEADER_SIZE; i++)
+    for (size_t i = 0; i < header_size; i++)
     {
         if (circular_buffer_push(output, &tmp[i]))
         {
@@ -0,0 +1,346 @@
+/**
+ * @file fragmentation.c
+ *
+ * @author Diamond42474
+ *
+ * Splitting of messages larger than pconfigMAX_PAYLOAD_SIZE into fragments
+ * and putting them back together on the receiving end. Every fragment but the
+ * last carries a full payload, so a fragment's offset follows from its index.
+ * Reassembly happens in a fixed pool of pconfigREASSEMBLY_SLOTS buffers; a
+ * message that doesn't complete within pconfigREASSEMBLY_TIMEOUT_MS is
+ * dropped, and when the pool is exhausted the oldest partial message makes
+ * room. Unicast fragments are also tracked on the sending side so delivery
+ * is reported once per message instead of once per fragment.
+ */
+#include "fragmentation.h"
+
+#include <string.h>
+#include "c-logger.h"
+
+static fragmentation_rx_slot_t *_get_rx_slot(fragmentation_handle_t *handle, const packet_t *packet);
+static void _release_rx_slot(fragmentation_rx_slot_t *slot);
+
+/**
+ * @brief Initializes fragmentation and the reassembly pool
+ *
+ * @param handle pointer to fragmentation handle
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int fragmentation_init(fragmentation_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    memset(handle, 0, sizeof(fragmentation_handle_t));
+
+    return 0;
+}
+
+/**
+ * @brief Drops messages that took too long to reassemble
+ *
+ * @param handle pointer to fragmentation handle
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int fragmentation_task(fragmentation_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    for (size_t i = 0; i < pconfigREASSEMBLY_SLOTS; i++)
+    {
+        fragmentation_rx_slot_t *slot = &handle->rx_slots[i];
+        if (slot->in_use && time_utils_done(&slot->timer))
+        {
+            LOG_WARN("Message %d from 0x%02X timed out with %d/%d fragments", slot->message_id, slot->src_addr, slot->received_count, slot->count);
+            _release_rx_slot(slot);
+            handle->stats.timed_out++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Number of packets needed to carry a message
+ *
+ * @param length message length in bytes
+ *
+ * @return fragment count, 1 for messages that fit a single packet
+ */
+uint8_t fragmentation_count(size_t length)
+{
+    if (length <= pconfigMAX_PAYLOAD_SIZE)
+    {
+        return 1;
+    }
+
+    return (uint8_t)((length + pconfigMAX_PAYLOAD_SIZE - 1) / pconfigMAX_PAYLOAD_SIZE);
+}
+
+uint8_t fragmentation_next_message_id(fragmentation_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return 0;
+    }
+
+    return handle->next_message_id++;
+}
+
+/**
+ * @brief Adds a received fragment to its message
+ *
+ * @param handle pointer to fragmentation handle
+ * @param packet received fragment, must have PACKET_FLAG_FRAGMENT set
+ * @param message receives the whole message once complete, pconfigMAX_MESSAGE_SIZE bytes
+ * @param message_length set to the message length once complete, 0 while fragments are missing
+ *
+ * @return error code: 0 = successful, -1 = failed (malformed fragment)
+ */
+int fragmentation_reassemble(fragmentation_handle_t *handle, const packet_t *packet, uint8_t *message, size_t *message_length)
+{
+    if (!handle || !packet || !message || !message_length)
+    {
+        LOG_ERROR("Invalid parameters for reassembly");
+        return -1;
+    }
+
+    *message_length = 0;
+
+    uint8_t index = packet->content.fragment.index;
+    uint8_t count = packet->content.fragment.count;
+    bool last = (index == count - 1);
+
+    if (!(packet->content.flags & PACKET_FLAG_FRAGMENT) || count == 0 || count > FRAGMENTATION_MAX_FRAGMENTS || index >= count)
+    {
+        LOG_WARN("Invalid fragment %d/%d from 0x%02X", index, count, packet->content.src_addr);
+        return -1;
+    }
+    if ((!last && packet->content.payload_length != pconfigMAX_PAYLOAD_SIZE) || packet->content.payload_length == 0)
+    {
+        LOG_WARN("Fragment %d/%d from 0x%02X has invalid length %d", index, count, packet->content.src_addr, packet->content.payload_length);
+        return -1;
+    }
+    if ((size_t)index * pconfigMAX_PAYLOAD_SIZE + packet->content.payload_length > pconfigMAX_MESSAGE_SIZE)
+    {
+        LOG_WARN("Fragment %d/%d from 0x%02X runs past %d bytes", index, count, packet->content.src_addr, pconfigMAX_MESSAGE_SIZE);
+        return -1;
+    }
+
+    fragmentation_rx_slot_t *slot = _get_rx_slot(handle, packet);
+    if (!slot)
+    {
+        LOG_ERROR("Failed to get reassembly slot");
+        return -1;
+    }
+
+    if (slot->count != count)
+    {
+        LOG_WARN("Fragment count changed for message %d from 0x%02X", slot->message_id, slot->src_addr);
+        return -1;
+    }
+
+    uint8_t mask = 1 << (index % 8);
+    if (slot->received[index / 8] & mask)
+    {
+        return 0; // Duplicate, e.g. a broadcast fragment heard twice
+    }
+
+    memcpy(&slot->data[(size_t)index * pconfigMAX_PAYLOAD_SIZE], packet->content.payload, packet->content.payload_length);
+    slot->received[index / 8] |= mask;
+    slot->received_count++;
+
+    if (last)
+    {
+        slot->length = (size_t)index * pconfigMAX_PAYLOAD_SIZE + packet->content.payload_length;
+    }
+
+    if (slot->received_count == slot->count)
+    {
+        memcpy(message, slot->data, slot->length);
+        *message_length = slot->length;
+        _release_rx_slot(slot);
+        handle->stats.reassembled++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Checks if another fragmented unicast message can be tracked for delivery
+ */
+bool fragmentation_tx_available(fragmentation_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    for (size_t i = 0; i < pconfigFRAGMENTED_TX_MESSAGES; i++)
+    {
+        if (!handle->tx_slots[i].in_use)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Starts tracking delivery of a fragmented unicast message
+ *
+ * @param handle pointer to fragmentation handle
+ * @param dest_addr destination of the message
+ * @param first_id packet id of the first fragment, the rest use the following ids
+ * @param count number of fragments
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int fragmentation_track_tx(fragmentation_handle_t *handle, uint8_t dest_addr, uint8_t first_id, uint8_t count)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    for (size_t i = 0; i < pconfigFRAGMENTED_TX_MESSAGES; i++)
+    {
+        fragmentation_tx_slot_t *slot = &handle->tx_slots[i];
+        if (!slot->in_use)
+        {
+            memset(slot, 0, sizeof(fragmentation_tx_slot_t));
+            slot->in_use = true;
+            slot->dest_addr = dest_addr;
+            slot->first_id = first_id;
+            slot->count = count;
+            return 0;
+        }
+    }
+
+    LOG_ERROR("No free slot to track fragmented message");
+    return -1;
+}
+
+/**
+ * @brief Folds the delivery result of one packet into its message
+ *
+ * @param handle pointer to fragmentation handle
+ * @param dest_addr destination the packet was sent to
+ * @param id packet id that was acknowledged or gave up
+ * @param delivered whether the packet was acknowledged
+ * @param status what should be reported for the message, see fragmentation_tx_status_e
+ * @param first_id receives the id of the message's first fragment, which identifies the message to the application
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int fragmentation_tx_result(fragmentation_handle_t *handle, uint8_t dest_addr, uint8_t id, bool delivered, fragmentation_tx_status_e *status, uint8_t *first_id)
+{
+    if (!handle || !status || !first_id)
+    {
+        LOG_ERROR("Invalid parameters for fragmentation TX result");
+        return -1;
+    }
+
+    *status = FRAGMENTATION_TX_NOT_TRACKED;
+
+    for (size_t i = 0; i < pconfigFRAGMENTED_TX_MESSAGES; i++)
+    {
+        fragmentation_tx_slot_t *slot = &handle->tx_slots[i];
+        if (!slot->in_use || slot->dest_addr != dest_addr || (uint8_t)(id - slot->first_id) >= slot->count)
+        {
+            continue;
+        }
+
+        *first_id = slot->first_id;
+        *status = FRAGMENTATION_TX_IN_PROGRESS;
+        slot->reported_count++;
+
+        if (!delivered && !slot->failed)
+        {
+            slot->failed = true;
+            *status = FRAGMENTATION_TX_FAILED;
+        }
+        else if (slot->reported_count == slot->count && !slot->failed)
+        {
+            *status = FRAGMENTATION_TX_DELIVERED;
+        }
+
+        if (slot->reported_count == slot->count)
+        {
+            slot->in_use = false;
+        }
+
+        return 0;
+    }
+
+    return 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+/**
+ * @brief Finds the slot a fragment belongs to, starting a new message (and evicting the oldest one if needed) when there is none
+ */
+static fragmentation_rx_slot_t *_get_rx_slot(fragmentation_handle_t *handle, const packet_t *packet)
+{
+    fragmentation_rx_slot_t *free_slot = NULL;
+    fragmentation_rx_slot_t *oldest = NULL;
+
+    for (size_t i = 0; i < pconfigREASSEMBLY_SLOTS; i++)
+    {
+        fragmentation_rx_slot_t *slot = &handle->rx_slots[i];
+        if (!slot->in_use)
+        {
+            free_slot = free_slot ? free_slot : slot;
+            continue;
+        }
+
+        if (slot->src_addr == packet->content.src_addr && slot->message_id == packet->content.fragment.message_id)
+        {
+            return slot;
+        }
+
+        if (!oldest || slot->timer.finish_time_us < oldest->timer.finish_time_us)
+        {
+            oldest = slot;
+        }
+    }
+
+    if (!free_slot)
+    {
+        LOG_WARN("Reassembly pool full, dropping message %d from 0x%02X", oldest->message_id, oldest->src_addr);
+        handle->stats.evicted++;
+        free_slot = oldest;
+    }
+
+    memset(free_slot, 0, sizeof(fragmentation_rx_slot_t));
+    free_slot->in_use = true;
+    free_slot->src_addr = packet->content.src_addr;
+    free_slot->message_id = packet->content.fragment.message_id;
+    free_slot->count = packet->content.fragment.count;
+    time_utils_start(&free_slot->timer, pconfigREASSEMBLY_TIMEOUT_MS * ONE_MS);
+
+    return free_slot;
+}
+
+static void _release_rx_slot(fragmentation_rx_slot_t *slot)
+{
+    slot->in_use = false;
+    slot->received_count = 0;
+    memset(slot->received, 0, sizeof(slot->received));
+}
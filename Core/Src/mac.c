@@ -0,0 +1,195 @@
+/**
+ * @file mac.c
+ *
+ * @author Diamond42474
+ *
+ * CSMA/CA channel access. Before a frame is keyed up the channel has to be
+ * idle for a full listen window. If it is found busy the node backs off for a
+ * random time drawn from a binary exponential window bounded by
+ * pconfigBACKOFF_BASE_TIME_MS and pconfigBACKOFF_MAX_TIME_MS, so nodes that
+ * all heard the end of the same frame don't key up at the same moment.
+ */
+#include "mac.h"
+
+#include <string.h>
+#include "c-logger.h"
+#include "interface/pconfig.h"
+
+static void _start_listening(mac_handle_t *handle);
+static void _start_backoff(mac_handle_t *handle);
+static uint32_t _random(mac_handle_t *handle);
+
+/**
+ * @brief Initializes the MAC layer
+ *
+ * @param handle pointer to MAC handle
+ * @param seed seed for the backoff random number generator, should differ between nodes
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int mac_init(mac_handle_t *handle, uint32_t seed)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    memset(handle, 0, sizeof(mac_handle_t));
+
+    handle->rng_state = seed ? seed : 1; // xorshift gets stuck on 0
+    handle->state = MAC_STATE_IDLE;
+
+    time_utils_start(&handle->listen_timer, pconfigCSMA_LISTEN_TIME_MS * ONE_MS);
+    time_utils_start(&handle->backoff_timer, 0);
+
+    return 0;
+}
+
+/**
+ * @brief Runs the channel access state machine for a pending frame
+ *
+ * @note Call this periodically while there is something to send. It only returns
+ *       true once the channel has been idle for the whole listen window.
+ *
+ * @param handle pointer to MAC handle
+ * @param channel_busy whether carrier or energy is currently present on the channel
+ *
+ * @return true if the frame may be transmitted now
+ */
+bool mac_clear_to_send(mac_handle_t *handle, bool channel_busy)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    switch (handle->state)
+    {
+    case MAC_STATE_IDLE:
+        STAT_INC(handle->stats.attempts);
+        if (channel_busy)
+        {
+            _start_backoff(handle);
+            break;
+        }
+        _start_listening(handle);
+        break;
+    case MAC_STATE_LISTEN:
+        if (channel_busy)
+        {
+            _start_backoff(handle);
+            break;
+        }
+        if (time_utils_done(&handle->listen_timer))
+        {
+            handle->state = MAC_STATE_CLEAR;
+        }
+        break;
+    case MAC_STATE_BACKOFF:
+        // The timer keeps running while the channel is busy, the listen window that
+        // follows catches anything still on the air
+        if (time_utils_done(&handle->backoff_timer))
+        {
+            STAT_INC(handle->stats.attempts);
+            _start_listening(handle);
+        }
+        break;
+    case MAC_STATE_CLEAR:
+        if (channel_busy)
+        {
+            _start_backoff(handle);
+        }
+        break;
+    default:
+        LOG_ERROR("Unknown MAC state");
+        handle->state = MAC_STATE_IDLE;
+        break;
+    }
+
+    return handle->state == MAC_STATE_CLEAR;
+}
+
+/**
+ * @brief Tells the MAC that a frame has been keyed up, resetting the backoff window
+ *
+ * @param handle pointer to MAC handle
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int mac_transmission_started(mac_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    STAT_INC(handle->stats.transmissions);
+    handle->backoff_exponent = 0;
+    handle->state = MAC_STATE_IDLE;
+
+    return 0;
+}
+
+/**
+ * @brief Drops any channel access in progress without touching the statistics
+ *
+ * @param handle pointer to MAC handle
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int mac_reset(mac_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    handle->backoff_exponent = 0;
+    handle->state = MAC_STATE_IDLE;
+
+    return 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static void _start_listening(mac_handle_t *handle)
+{
+    time_utils_reset(&handle->listen_timer);
+    handle->state = MAC_STATE_LISTEN;
+}
+
+static void _start_backoff(mac_handle_t *handle)
+{
+    uint32_t window_ms = pconfigBACKOFF_BASE_TIME_MS << handle->backoff_exponent;
+    if (window_ms >= pconfigBACKOFF_MAX_TIME_MS)
+    {
+        window_ms = pconfigBACKOFF_MAX_TIME_MS;
+    }
+    else
+    {
+        handle->backoff_exponent++;
+    }
+
+    uint32_t delay_ms = _random(handle) % (window_ms + 1);
+    LOG_DEBUG("Channel busy, backing off %u ms (window %u ms)", delay_ms, window_ms);
+
+    time_utils_start(&handle->backoff_timer, (uint64_t)delay_ms * ONE_MS);
+    STAT_INC(handle->stats.collisions);
+    handle->state = MAC_STATE_BACKOFF;
+}
+
+static uint32_t _random(mac_handle_t *handle)
+{
+    uint32_t x = handle->rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    handle->rng_state = x;
+    return x;
+}
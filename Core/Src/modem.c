@@ -5,36 +5,63 @@
 #include "bsp/adc_bsp.h"
 #include "bsp/ptt_bsp.h"
 #include "bsp/dac_bsp.h"
+#include "bsp/time_bsp.h"
 #include <string.h>
 #include "utils/fsk_utils.h"
 #include "encoding/packet_serializer.h"
 
-static int _init_decoder(modem_handle_t *handle);
+static int _resolve_config(const pc_config_t *config, pc_config_t *resolved);
+static size_t _input_samples(const pc_config_t *config);
+static int _init_decoder(modem_handle_t *handle, arena_t *arena);
 static int _handle_tx(modem_handle_t *handle);
 static int _handle_rx(modem_handle_t *handle);
 
-int modem_init(modem_handle_t *handle, void *orchestrator_ctx)
+/**
+ * @brief Memory modem_init takes from its arena for a config
+ *
+ * @param config The config modem_init will be given
+ *
+ * @return Bytes needed, 0 if the config is invalid
+ */
+size_t modem_required_memory(const pc_config_t *config)
+{
+    pc_config_t resolved;
+    if (!config || _resolve_config(config, &resolved))
+    {
+        return 0;
+    }
+
+    return ARENA_ALIGN(_input_samples(&resolved) * sizeof(uint16_t));
+}
+
+int modem_init(modem_handle_t *handle, const pc_config_t *config, arena_t *arena, void *orchestrator_ctx)
 {
     int ret = 0;
 
-    if (!handle)
+    if (!handle || !config || !arena)
     {
-        LOG_ERROR("Handle is NULL");
+        LOG_ERROR("Handle, config or arena is NULL");
         return -1;
     }
 
     memset(handle, 0, sizeof(modem_handle_t));
 
+    if (_resolve_config(config, &handle->config))
+    {
+        LOG_ERROR("Invalid modem config");
+        return -1;
+    }
+
     handle->orchestrator_ctx = orchestrator_ctx; // Callback for sending packets to orchestrator when decoded
 
-    if (_init_decoder(handle))
+    if (_init_decoder(handle, arena))
     {
         LOG_ERROR("Failed to init decoder");
         return -1;
     }
 
-    time_utils_start(&handle->symbol_timer, (ONE_SECOND / pconfigBAUD_RATE)); // Start symbol timer based on baud rate
-    time_utils_start(&handle->ptt_timer, pconfigPTT_DELAY_MS * ONE_MS);       // Start PTT delay timer
+    time_utils_start(&handle->symbol_timer, (ONE_SECOND / handle->config.baud_rate)); // Start symbol timer based on baud rate
+    time_utils_start(&handle->ptt_timer, handle->config.ptt_delay_ms * ONE_MS);       // Start PTT delay timer
 
     if (circular_buffer_static_init(&handle->tx_buffer, &handle->tx_array, sizeof(uint8_t), pconfigMODEM_TX_BUFFER_SIZE))
     {
@@ -42,6 +69,12 @@ int modem_init(modem_handle_t *handle, void *orchestrator_ctx)
         return -1;
     }
 
+    if (circular_buffer_static_init(&handle->tx_frame_buffer, &handle->tx_frame_array, sizeof(modem_frame_t), pconfigMAX_FRAMES_PER_KEYING))
+    {
+        LOG_ERROR("Failed to init modem TX frame buffer");
+        return -1;
+    }
+
     handle->transmitting = false;
 
     // Setup BSP components
@@ -76,6 +109,13 @@ int modem_send_raw(modem_handle_t *handle, circular_buffer_t *cb)
         return -1;
     }
 
+    // Raw data goes out exactly as given, so none of it is bit stuffed
+    modem_frame_t frame = {
+        .length = circular_buffer_count(cb),
+        .unstuffed_length = circular_buffer_count(cb),
+        .rate = FSK_RATE_BASE,
+    };
+
     while (circular_buffer_count(cb) > 0)
     {
         uint8_t byte;
@@ -92,25 +132,76 @@ int modem_send_raw(modem_handle_t *handle, circular_buffer_t *cb)
         }
     }
 
-    dac_bsp_set_tone(pconfigMODEM_FREQ_0); // Set this so recevers can detect line busy ASAP
-    time_utils_reset(&handle->ptt_timer);  // Reset PTT timer to start delay before transmission
-    ptt_bsp_set_ptt(true);                 // Set PTT high to start transmission
-    handle->transmitting = true;
+    if (circular_buffer_push(&handle->tx_frame_buffer, &frame))
+    {
+        LOG_ERROR("Failed to queue raw frame");
+        return -1;
+    }
 
-    return ret;
+    return modem_start_tx(handle);
 }
 
-int modem_send_packet(modem_handle_t *handle, const packet_t *packet)
+/**
+ * @brief Checks if another full size frame fits in the current transmission
+ *
+ * @param handle Pointer to the modem handle
+ *
+ * @return true if modem_queue_packet() will accept a packet of any size
+ */
+bool modem_can_queue_packet(modem_handle_t *handle)
 {
-    int ret = 0;
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    if (circular_buffer_is_full(&handle->tx_frame_buffer))
+    {
+        return false;
+    }
 
+    size_t free_bytes = circular_buffer_capacity(&handle->tx_buffer) - circular_buffer_count(&handle->tx_buffer);
+    return free_bytes >= MODEM_FRAME_HEADER_SIZE + PACKET_SIZE;
+}
+
+/**
+ * @brief Adds a packet to the next transmission without keying up
+ *
+ * @note Every packet gets its own sync word, so several packets queued before
+ *       modem_start_tx() go out back to back under a single PTT keying.
+ *       The sync word and rate byte always go out at the base rate, only the
+ *       packet itself is sent at the requested rate.
+ *
+ * @param handle Pointer to the modem handle
+ * @param packet Packet to transmit
+ * @param rate Rate to send the packet at, the receiver has to have enough SNR for it
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int modem_queue_packet(modem_handle_t *handle, const packet_t *packet, fsk_rate_e rate)
+{
     if (!handle || !packet)
     {
         LOG_ERROR("Handle or packet is NULL");
         return -1;
     }
 
-    uint8_t sync_word[2] = {pconfigPREAMBLE_BYTE_1, pconfigPREAMBLE_BYTE_2};
+    if (rate >= FSK_RATE_COUNT)
+    {
+        LOG_ERROR("Invalid rate %d", rate);
+        return -1;
+    }
+
+    if (handle->transmitting)
+    {
+        LOG_ERROR("Can't queue packets while transmitting");
+        return -1;
+    }
+
+    size_t start_count = circular_buffer_count(&handle->tx_buffer);
+
+    uint8_t sync_word[MODEM_SYNC_WORD_SIZE] = {pconfigPREAMBLE_BYTE_1, pconfigPREAMBLE_BYTE_2};
     if (circular_buffer_push(&handle->tx_buffer, &sync_word[0]))
     {
         LOG_ERROR("Failed to push preamble byte 1 to tx buffer");
@@ -122,6 +213,13 @@ int modem_send_packet(modem_handle_t *handle, const packet_t *packet)
         return -1;
     }
 
+    uint8_t rate_byte = fsk_rate_encode(rate);
+    if (circular_buffer_push(&handle->tx_buffer, &rate_byte))
+    {
+        LOG_ERROR("Failed to push rate byte to tx buffer");
+        return -1;
+    }
+
     // Serialize packet into modem TX buffer for transmission
     if (packet_serializer_serialize(packet, &handle->tx_buffer))
     {
@@ -129,13 +227,66 @@ int modem_send_packet(modem_handle_t *handle, const packet_t *packet)
         return -1;
     }
 
-    dac_bsp_set_tone(pconfigMODEM_FREQ_0); // Set this so recevers can detect line busy ASAP
-    time_utils_reset(&handle->ptt_timer);  // Reset PTT timer to start delay before transmission
-    ptt_bsp_set_ptt(true);                 // Set PTT high to start transmission
+    modem_frame_t frame = {
+        .length = circular_buffer_count(&handle->tx_buffer) - start_count,
+        .unstuffed_length = MODEM_FRAME_HEADER_SIZE,
+        .rate = rate,
+    };
+    if (circular_buffer_push(&handle->tx_frame_buffer, &frame))
+    {
+        LOG_ERROR("Failed to queue frame");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Keys up and starts sending every queued frame
+ *
+ * @param handle Pointer to the modem handle
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int modem_start_tx(modem_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    if (handle->transmitting)
+    {
+        return 0;
+    }
+
+    if (circular_buffer_is_empty(&handle->tx_frame_buffer))
+    {
+        LOG_WARN("Nothing queued to transmit");
+        return 0;
+    }
+
+    handle->frame_bits_remaining = 0;
+    dac_bsp_set_tone(handle->config.freq_0); // Set this so recevers can detect line busy ASAP
+    time_utils_reset(&handle->ptt_timer);    // Reset PTT timer to start delay before transmission
+    ptt_bsp_set_ptt(true);                   // Set PTT high to start transmission
+    handle->keyed_at_us = time_bsp_get_us();
     handle->transmitting = true;
     handle->state = MODEM_STATE_TX_PREAMBLE;
 
-    return ret;
+    return 0;
+}
+
+int modem_send_packet(modem_handle_t *handle, const packet_t *packet)
+{
+    if (modem_queue_packet(handle, packet, FSK_RATE_BASE))
+    {
+        LOG_ERROR("Failed to queue packet");
+        return -1;
+    }
+
+    return modem_start_tx(handle);
 }
 
 bool modem_rx_busy(modem_handle_t *handle)
@@ -171,6 +322,124 @@ bool modem_busy(modem_handle_t *handle)
     return modem_rx_busy(handle) || modem_tx_busy(handle);
 }
 
+/**
+ * @brief Carrier sense for channel access
+ *
+ * @note Unlike modem_busy(), this also reports energy on either tone before the
+ *       decoder has locked onto a signal, so we don't key up over a frame that just started.
+ *       The energy is measured against the decoder's noise floor rather than a fixed level,
+ *       so carrier sense reaches as far as a frame can be heard over the channel's own noise.
+ *
+ * @param handle Pointer to the modem handle
+ *
+ * @return true if the channel should be considered busy
+ */
+bool modem_channel_busy(modem_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    if (modem_busy(handle))
+    {
+        return true;
+    }
+
+    return decoder_channel_level(&handle->decoder) >= handle->config.csma_energy_threshold;
+}
+
+/**
+ * @brief Changes the tones while running
+ *
+ * @note The decoder redesigns its filters before the next sample. A frame being
+ *       received or sent at the time is lost.
+ *
+ * @param handle Pointer to the modem handle
+ * @param freq_0 Tone for bit 0 in Hz
+ * @param freq_1 Tone for bit 1 in Hz
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int modem_set_frequencies(modem_handle_t *handle, int freq_0, int freq_1)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    pc_config_t config = handle->config;
+    config.freq_0 = freq_0;
+    config.freq_1 = freq_1;
+    if (_resolve_config(&config, &config))
+    {
+        return -1;
+    }
+
+    if (fsk_decoder_set_frequencies(&handle->fsk_decoder, freq_0, freq_1))
+    {
+        LOG_ERROR("Failed to set FSK decoder frequencies");
+        return -1;
+    }
+    handle->config = config;
+
+    return 0;
+}
+
+/**
+ * @brief Changes the tone metric needed to decode a bit while running
+ *
+ * @param handle Pointer to the modem handle
+ * @param threshold The new threshold (must be greater than 0)
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int modem_set_power_threshold(modem_handle_t *handle, float threshold)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    if (fsk_decoder_set_power_threshold(&handle->fsk_decoder, threshold))
+    {
+        LOG_ERROR("Failed to set FSK decoder power threshold");
+        return -1;
+    }
+    handle->config.fsk_power_threshold = threshold;
+
+    return 0;
+}
+
+/**
+ * @brief Changes how far over the noise floor in-band energy counts as a busy channel while running
+ *
+ * @param handle Pointer to the modem handle
+ * @param threshold The new threshold, a ratio over the noise floor (must be greater than 0)
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int modem_set_csma_threshold(modem_handle_t *handle, float threshold)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    if (threshold <= 0.0f)
+    {
+        LOG_ERROR("Invalid CSMA energy threshold: %f", threshold);
+        return -1;
+    }
+    handle->config.csma_energy_threshold = threshold;
+
+    return 0;
+}
+
 int modem_task(modem_handle_t *handle)
 {
     int ret = 0;
@@ -212,13 +481,77 @@ int modem_task(modem_handle_t *handle)
         LOG_ERROR("Failed to handle RX");
         return -1;
     }
+
+    return ret;
 }
 
 // =-=-=-=-=-=-=-=-=-=
 // PRIVATE FUNCTIONS
 // =-=-=-=-=-=-=-=-=-=
 
-static int _init_decoder(modem_handle_t *handle)
+/**
+ * @brief Fills in the sample rate if it's left at 0 and checks the config can be used
+ *
+ * @note config and resolved may point to the same config
+ */
+static int _resolve_config(const pc_config_t *config, pc_config_t *resolved)
+{
+    *resolved = *config;
+    if (resolved->sample_rate == 0)
+    {
+        resolved->sample_rate = calculate_sample_rate(resolved->freq_0, resolved->freq_1, resolved->baud_rate);
+    }
+
+    if (resolved->baud_rate <= 0 || resolved->sample_rate <= 0)
+    {
+        LOG_ERROR("Invalid baud rate %d or sample rate %d", resolved->baud_rate, resolved->sample_rate);
+        return -1;
+    }
+
+    if (resolved->freq_0 <= 0 || resolved->freq_1 <= 0 || resolved->freq_0 == resolved->freq_1 ||
+        resolved->freq_0 * 2 >= resolved->sample_rate || resolved->freq_1 * 2 >= resolved->sample_rate)
+    {
+        LOG_ERROR("Invalid tones %d Hz and %d Hz for %d Hz sampling", resolved->freq_0, resolved->freq_1, resolved->sample_rate);
+        return -1;
+    }
+
+    // The fastest link rate still needs a couple of samples per symbol
+    if (resolved->sample_rate / fsk_rate_baud(resolved->baud_rate, FSK_RATE_COUNT - 1) < 2)
+    {
+        LOG_ERROR("Sample rate %d is too low for %d baud", resolved->sample_rate, resolved->baud_rate);
+        return -1;
+    }
+
+    if (resolved->sample_format < PC_SAMPLE_FORMAT_U12 || resolved->sample_format > PC_SAMPLE_FORMAT_S16)
+    {
+        LOG_ERROR("Invalid sample format %d", (int)resolved->sample_format);
+        return -1;
+    }
+
+    if (resolved->fsk_power_threshold <= 0.0f || resolved->csma_energy_threshold <= 0.0f)
+    {
+        LOG_ERROR("Invalid thresholds: power %f, CSMA %f", resolved->fsk_power_threshold, resolved->csma_energy_threshold);
+        return -1;
+    }
+
+    if (resolved->decoder_buffer_symbol_count == 0)
+    {
+        LOG_ERROR("Decoder buffer symbol count must be greater than 0");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Samples the decoder input buffer holds, a whole number of symbols at the base rate
+ */
+static size_t _input_samples(const pc_config_t *config)
+{
+    return (size_t)(config->sample_rate / config->baud_rate) * config->decoder_buffer_symbol_count;
+}
+
+static int _init_decoder(modem_handle_t *handle, arena_t *arena)
 {
     int ret = 0;
 
@@ -235,22 +568,39 @@ static int _init_decoder(modem_handle_t *handle)
         LOG_ERROR("Failed to init FSK decoder");
         return -1;
     }
-    if (fsk_decoder_set_symbol_sample_size(&handle->fsk_decoder, pconfigSAMPLES_PER_SYMBOL, pconfigDECODER_BUFFER_SYMBOL_COUNT)) // Buffer for 3 symbols to allow for timing recovery
+    int symbol_sample_size = handle->config.sample_rate / handle->config.baud_rate;
+    uint16_t *input_array = arena_alloc(arena, _input_samples(&handle->config) * sizeof(uint16_t));
+    if (!input_array || decoder_set_input_buffer(&handle->decoder, input_array, _input_samples(&handle->config)))
+    {
+        LOG_ERROR("Failed to set decoder input buffer");
+        return -1;
+    }
+    if (fsk_decoder_set_symbol_sample_size(&handle->fsk_decoder, symbol_sample_size, handle->config.decoder_buffer_symbol_count))
     {
         LOG_ERROR("Failed to set FSK decoder symbol sample size");
         return -1;
     }
-    if (fsk_decoder_set_sample_rate(&handle->fsk_decoder, pconfigSAMPLE_RATE_HZ))
+    if (fsk_decoder_set_sample_rate(&handle->fsk_decoder, handle->config.sample_rate))
     {
         LOG_ERROR("Failed to set FSK decoder sample rate");
         return -1;
     }
-    if (fsk_decoder_set_frequencies(&handle->fsk_decoder, pconfigMODEM_FREQ_0, pconfigMODEM_FREQ_1))
+    if (fsk_decoder_set_sample_format(&handle->fsk_decoder, handle->config.sample_format))
+    {
+        LOG_ERROR("Failed to set FSK decoder sample format");
+        return -1;
+    }
+    if (fsk_decoder_set_symbol_rate(&handle->fsk_decoder, handle->config.baud_rate))
+    {
+        LOG_ERROR("Failed to set FSK decoder symbol rate");
+        return -1;
+    }
+    if (fsk_decoder_set_frequencies(&handle->fsk_decoder, handle->config.freq_0, handle->config.freq_1))
     {
         LOG_ERROR("Failed to set FSK decoder frequencies");
         return -1;
     }
-    if (fsk_decoder_set_power_threshold(&handle->fsk_decoder, pconfigFSK_POWER_THRESHOLD))
+    if (fsk_decoder_set_power_threshold(&handle->fsk_decoder, handle->config.fsk_power_threshold))
     {
         LOG_ERROR("Failed to set FSK decoder power threshold");
         return -1;
@@ -278,7 +628,7 @@ static int _init_decoder(modem_handle_t *handle)
         return -1;
     }
 
-    if (adc_bsp_init(pconfigSAMPLE_RATE_HZ))
+    if (adc_bsp_init(handle->config.sample_rate, &handle->decoder.input_ring))
     {
         LOG_ERROR("Failed to init ADC BSP");
         return -1;
@@ -314,26 +664,51 @@ int _handle_tx(modem_handle_t *handle)
     }
     time_utils_reset(&handle->symbol_timer);
 
-    if (bit_unpacker_empty(&handle->bit_unpacker) && !circular_buffer_count(&handle->tx_buffer)) // No more data to send
+    if (handle->frame_bits_remaining == 0)
     {
-        dac_bsp_set_tone(0);    // Stop transmission
-        ptt_bsp_set_ptt(false); // Set PTT low to end transmission
-        handle->transmitting = false;
-        bit_stuffer_reset(&handle->bit_stuffer); // Reset bit stuffer state for next transmission
-        handle->state = MODEM_STATE_IDLE;
-        return 0;
+        // Previous frame is done, start the next one back to back under the same keying
+        bit_stuffer_reset(&handle->bit_stuffer);
+
+        modem_frame_t frame;
+        if (circular_buffer_is_empty(&handle->tx_frame_buffer)) // No more data to send
+        {
+            dac_bsp_set_tone(0);    // Stop transmission
+            ptt_bsp_set_ptt(false); // Set PTT low to end transmission
+            STAT_ADD(handle->stats.airtime_ms, (uint32_t)((time_bsp_get_us() - handle->keyed_at_us) / ONE_MS));
+            handle->transmitting = false;
+            handle->state = MODEM_STATE_IDLE;
+            return 0;
+        }
+
+        if (circular_buffer_pop(&handle->tx_frame_buffer, &frame))
+        {
+            LOG_ERROR("Failed to pop frame from TX frame buffer");
+            return -1;
+        }
+
+        handle->frame_bits_remaining = frame.length * 8;
+        handle->preamble_remaining = frame.unstuffed_length * 8;
+        handle->frame_rate = frame.rate;
+        handle->state = MODEM_STATE_TX_PREAMBLE;
+        STAT_INC(handle->stats.frames_sent);
+
+        // Frame header always goes out at the base rate, even after a faster frame
+        time_utils_start(&handle->symbol_timer, ONE_SECOND / handle->config.baud_rate);
     }
 
     bool bit;
     switch (handle->state)
     {
     case MODEM_STATE_TX_PREAMBLE:
+        // Sync word is sent as-is so the receiver can find it
         bit_unpacker_pop(&handle->bit_unpacker, &handle->tx_buffer, &bit);
-        handle->preamble_sent++;
-        if (handle->preamble_sent >= sizeof(uint16_t) * 8) // 16 bits of preamble (2 bytes)
+        handle->frame_bits_remaining--;
+        handle->preamble_remaining--;
+        if (handle->preamble_remaining == 0)
         {
+            // This bit still lasts a base rate symbol, the rest of the frame uses the frame's rate
+            time_utils_set_duration(&handle->symbol_timer, ONE_SECOND / fsk_rate_baud(handle->config.baud_rate, handle->frame_rate));
             handle->state = MODEM_STATE_TX_PACKET;
-            handle->preamble_sent = 0;
         }
         break;
     case MODEM_STATE_TX_PACKET:
@@ -347,18 +722,25 @@ int _handle_tx(modem_handle_t *handle)
         }
         if (consumed_input)
         {
-            bit_unpacker_pop(&handle->bit_unpacker, &handle->tx_buffer, &bit); // Consume input bit if it was processed (not just a stuffed bit)
+            bool consumed_bit;
+            bit_unpacker_pop(&handle->bit_unpacker, &handle->tx_buffer, &consumed_bit); // Consume input bit if it was processed (not just a stuffed bit)
+            handle->frame_bits_remaining--;
         }
         break;
+    default:
+        LOG_ERROR("Invalid modem TX state");
+        return -1;
     }
     if (bit)
     {
-        dac_bsp_set_tone(pconfigMODEM_FREQ_1);
+        dac_bsp_set_tone(handle->config.freq_1);
     }
     else
     {
-        dac_bsp_set_tone(pconfigMODEM_FREQ_0);
+        dac_bsp_set_tone(handle->config.freq_0);
     }
+
+    return ret;
 }
 
 int _handle_rx(modem_handle_t *handle)
@@ -374,7 +756,7 @@ int _handle_rx(modem_handle_t *handle)
     if (adc_bsp_data_available())
     {
         // Get samples from ADC and push to decoder input buffer
-        if (adc_bsp_get_data(&handle->decoder.input_buffer))
+        if (adc_bsp_get_data(&handle->decoder.input_ring))
         {
             LOG_ERROR("Failed to get ADC data");
             return -1;
@@ -390,6 +772,12 @@ int _handle_rx(modem_handle_t *handle)
             return -1;
         }
 
+        // The decoder counts samples, the newest it has run through its filters is about now
+        uint64_t age_samples = handle->fsk_decoder.sample_index - packet.metadata.sync_sample;
+        uint64_t age_us = age_samples * ONE_SECOND / (uint64_t)handle->config.sample_rate;
+        uint64_t now_us = time_bsp_get_us();
+        packet.metadata.sync_time_us = now_us > age_us ? now_us - age_us : 0;
+
         // Send packet to orchestrator for processing
         if (orchestrator_packet_callback(handle->orchestrator_ctx, &packet))
         {
@@ -1,17 +1,41 @@
 #include "orchestrator.h"
 #include "c-logger.h"
 #include "interface/pconfig.h"
+#include "bsp/time_bsp.h"
+#include "encoding/compression.h"
+#include "utils/trace.h"
 #include <string.h>
 
 static int _add_beacon_to_queue(orchestrator_handle_t *handle);
+static int _add_adverts_to_queue(orchestrator_handle_t *handle);
+static bool _tx_pending(orchestrator_handle_t *handle);
+static int _next_tx_packet(orchestrator_handle_t *handle, packet_t *packet, fsk_rate_e *rate);
+static fsk_rate_e _select_rate(orchestrator_handle_t *handle, const packet_t *packet);
+static int _handle_rx_packet(orchestrator_handle_t *handle, const packet_t *packet);
+static bool _tx_eligible(const packet_t *packet, void *ctx);
+static void _arq_delivery(void *ctx, uint8_t dest_addr, uint8_t id, bool delivered);
+static int _deliver_data(orchestrator_handle_t *handle, const packet_t *packet);
+static void _deliver_message(orchestrator_handle_t *handle, const uint8_t *data, size_t len, uint8_t src_addr, bool compressed);
 
-int orchestrator_init(orchestrator_handle_t *handle, rx_callback_t rx_callback)
+/**
+ * @brief Memory orchestrator_init takes from its arena, on top of the handle itself
+ *
+ * @param config The config orchestrator_init will be given
+ *
+ * @return Bytes needed, 0 if the config is invalid
+ */
+size_t orchestrator_required_memory(const pc_config_t *config)
+{
+    return modem_required_memory(config);
+}
+
+int orchestrator_init(orchestrator_handle_t *handle, const pc_config_t *config, arena_t *arena, rx_callback_t rx_callback)
 {
     int ret = 0;
 
-    if (!handle)
+    if (!handle || !config || !arena)
     {
-        LOG_ERROR("Handle is NULL");
+        LOG_ERROR("Handle, config or arena is NULL");
         return -1;
     }
     if (!rx_callback)
@@ -21,13 +45,41 @@ int orchestrator_init(orchestrator_handle_t *handle, rx_callback_t rx_callback)
     }
 
     memset(handle, 0, sizeof(orchestrator_handle_t));
+    handle->address = config->device_address;
 
-    if (modem_init(&handle->modem, handle))
+    trace_set_clock(time_bsp_get_us);
+
+    if (modem_init(&handle->modem, config, arena, handle))
     {
         LOG_ERROR("Failed to init modem");
         return -1;
     }
 
+    // Seed backoff with our address so nodes that boot together still diverge
+    if (mac_init(&handle->mac, ((uint32_t)handle->address << 24) ^ (uint32_t)time_bsp_get_us()))
+    {
+        LOG_ERROR("Failed to init MAC");
+        return -1;
+    }
+
+    if (arq_init(&handle->arq, handle->address, _arq_delivery, handle))
+    {
+        LOG_ERROR("Failed to init ARQ");
+        return -1;
+    }
+
+    if (fragmentation_init(&handle->fragmentation))
+    {
+        LOG_ERROR("Failed to init fragmentation");
+        return -1;
+    }
+
+    if (routing_init(&handle->routing, handle->address, handle->modem.config.baud_rate))
+    {
+        LOG_ERROR("Failed to init routing");
+        return -1;
+    }
+
     handle->rx_callback = rx_callback;
 
     if (circular_buffer_static_init(&handle->rx_packet_buffer, &handle->rx_packet_array, sizeof(packet_t), pconfigRX_BUFFER_SIZE))
@@ -36,9 +88,9 @@ int orchestrator_init(orchestrator_handle_t *handle, rx_callback_t rx_callback)
         return -1;
     }
 
-    if (circular_buffer_static_init(&handle->tx_packet_buffer, &handle->tx_packet_array, sizeof(packet_t), pconfigTX_BUFFER_SIZE))
+    if (tx_scheduler_init(&handle->tx_scheduler, _tx_eligible, handle))
     {
-        LOG_ERROR("Failed to init TX packet buffer");
+        LOG_ERROR("Failed to init TX scheduler");
         return -1;
     }
 
@@ -47,7 +99,61 @@ int orchestrator_init(orchestrator_handle_t *handle, rx_callback_t rx_callback)
     return 0;
 }
 
-int orchestrator_send(orchestrator_handle_t *handle, const uint8_t *data, size_t len, uint8_t dest_addr)
+/**
+ * @brief Sets the callback used to report whether unicast packets were acknowledged
+ *
+ * @param handle Pointer to the orchestrator handle
+ * @param tx_callback Callback to report delivery status through, NULL to disable
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int orchestrator_set_tx_callback(orchestrator_handle_t *handle, tx_callback_t tx_callback)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    handle->tx_callback = tx_callback;
+
+    return 0;
+}
+
+/**
+ * @brief Checks if the application queue has room for every fragment of a message
+ *
+ * @param handle Pointer to the orchestrator handle
+ * @param len Length of the message
+ * @param dest_addr Destination of the message
+ *
+ * @return true if orchestrator_send won't be refused for lack of queue space (or size)
+ */
+bool orchestrator_can_send(orchestrator_handle_t *handle, size_t len, uint8_t dest_addr)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    if (len > pconfigMAX_MESSAGE_SIZE)
+    {
+        return false;
+    }
+
+    uint8_t count = fragmentation_count(len);
+
+    // Fragmented unicast messages also need a slot to collect the per-fragment delivery results
+    if (count > 1 && dest_addr != pconfigBROADCAST_ADDRESS && !fragmentation_tx_available(&handle->fragmentation))
+    {
+        return false;
+    }
+
+    return tx_scheduler_space(&handle->tx_scheduler, TX_CLASS_APPLICATION) >= count;
+}
+
+int orchestrator_send(orchestrator_handle_t *handle, const uint8_t *data, size_t len, uint8_t dest_addr, uint8_t *id)
 {
     if (!handle)
     {
@@ -59,22 +165,85 @@ int orchestrator_send(orchestrator_handle_t *handle, const uint8_t *data, size_t
         LOG_ERROR("Data is NULL");
         return -1;
     }
-
-    // Create data packet
-    packet_t packet;
-    memset(&packet, 0, sizeof(packet_t));
-    static uint8_t id = 0;
-    if (initialize_packet(&packet, PACKET_TYPE_DATA, pconfigDEVICE_ADDRESS, dest_addr, id++, data, len))
+    if (len > pconfigMAX_MESSAGE_SIZE)
     {
-        LOG_ERROR("Failed to initialize packet");
+        LOG_ERROR("Message of %zu bytes is larger than %d", len, pconfigMAX_MESSAGE_SIZE);
         return -1;
     }
+    if (!orchestrator_can_send(handle, len, dest_addr))
+    {
+        LOG_WARN("Application TX queue is full");
+        return -1; // Checked up front so a refused message doesn't use up sequence ids
+    }
+
+    uint8_t flags = 0;
 
-    // Push packet to TX buffer for transmission by the modem task
-    if (circular_buffer_push(&handle->tx_packet_buffer, &packet))
+#if pconfigCOMPRESSION_ENABLED
+    // Only worth sending compressed if it's actually smaller
+    size_t compressed_len = 0;
+    if (len >= pconfigCOMPRESSION_MIN_SIZE && compression_compress(data, len, handle->tx_compressed, len - 1, &compressed_len) == 0)
     {
-        LOG_ERROR("Failed to push packet to TX buffer");
-        return -1;
+        data = handle->tx_compressed;
+        len = compressed_len;
+        flags |= PACKET_FLAG_COMPRESSED;
+    }
+#endif
+
+    uint8_t count = fragmentation_count(len);
+    uint8_t message_id = (count > 1) ? fragmentation_next_message_id(&handle->fragmentation) : 0;
+    uint8_t first_id = 0;
+
+    for (uint8_t index = 0; index < count; index++)
+    {
+        size_t offset = (size_t)index * pconfigMAX_PAYLOAD_SIZE;
+        size_t fragment_len = (len - offset > pconfigMAX_PAYLOAD_SIZE) ? pconfigMAX_PAYLOAD_SIZE : len - offset;
+
+        // Unicast packets use the per-destination sequence space so the receiver can spot duplicates
+        uint8_t packet_id = (dest_addr == pconfigBROADCAST_ADDRESS) ? handle->broadcast_id++ : arq_next_id(&handle->arq, dest_addr);
+        if (index == 0)
+        {
+            first_id = packet_id;
+        }
+
+        // Create data packet
+        packet_t packet;
+        memset(&packet, 0, sizeof(packet_t));
+        if (initialize_packet(&packet, PACKET_TYPE_DATA, handle->address, dest_addr, packet_id, data + offset, fragment_len))
+        {
+            LOG_ERROR("Failed to initialize packet");
+            return -1;
+        }
+
+        packet.content.flags |= flags;
+        packet.content.crc = calculate_crc(&packet);
+
+        if (count > 1 && packet_set_fragment(&packet, message_id, index, count))
+        {
+            LOG_ERROR("Failed to mark packet as fragment");
+            return -1;
+        }
+
+        // Queue packet for transmission by the modem task
+        if (tx_scheduler_push(&handle->tx_scheduler, TX_CLASS_APPLICATION, &packet))
+        {
+            LOG_ERROR("Failed to push packet to TX queue");
+            return -1;
+        }
+    }
+
+    if (count > 1 && dest_addr != pconfigBROADCAST_ADDRESS)
+    {
+        if (fragmentation_track_tx(&handle->fragmentation, dest_addr, first_id, count))
+        {
+            LOG_ERROR("Failed to track fragmented message");
+            return -1;
+        }
+    }
+
+    // The first packet's id identifies the whole message in delivery reports
+    if (id)
+    {
+        *id = first_id;
     }
 
     return 0;
@@ -107,30 +276,65 @@ int orchestrator_task(orchestrator_handle_t *handle)
         }
     }
 
-    // TODO: Handle timing, retries, and other orchestrator-level tasks
+    if (arq_task(&handle->arq))
+    {
+        LOG_ERROR("ARQ task failed");
+        return -1;
+    }
 
-    // PSUDO Sending
-    if (circular_buffer_count(&handle->tx_packet_buffer) > 0)
+    if (fragmentation_task(&handle->fragmentation))
     {
+        LOG_ERROR("Fragmentation task failed");
+        return -1;
+    }
 
-        if (!modem_busy(&handle->modem)) // Only send if modem is not busy
+    if (routing_task(&handle->routing))
+    {
+        LOG_ERROR("Routing task failed");
+        return -1;
+    }
+
+    if (_add_adverts_to_queue(handle))
+    {
+        LOG_ERROR("Failed to queue route advertisement");
+        return -1;
+    }
+
+    // Sending
+    if (_tx_pending(handle) && !modem_tx_busy(&handle->modem))
+    {
+        // Listen before talk, backs off randomly if someone else is on the air
+        if (mac_clear_to_send(&handle->mac, modem_channel_busy(&handle->modem)))
         {
-            packet_t packet;
-            if (circular_buffer_pop(&handle->tx_packet_buffer, &packet))
+            // Drain as many packets as fit into one keying, the PTT delay is only paid once
+            while (_tx_pending(handle) && modem_can_queue_packet(&handle->modem))
             {
-                LOG_ERROR("Failed to pop packet from TX buffer");
-                return -1;
+                packet_t packet;
+                fsk_rate_e rate;
+                if (_next_tx_packet(handle, &packet, &rate))
+                {
+                    LOG_ERROR("Failed to get next packet to transmit");
+                    return -1;
+                }
+
+                if (modem_queue_packet(&handle->modem, &packet, rate))
+                {
+                    LOG_ERROR("Failed to queue packet in modem");
+                    return -1;
+                }
             }
 
-            if (modem_send_packet(&handle->modem, &packet))
+            if (modem_start_tx(&handle->modem))
             {
-                LOG_ERROR("Failed to send packet through modem");
+                LOG_ERROR("Failed to start transmission");
                 return -1;
             }
+
+            mac_transmission_started(&handle->mac);
         }
     }
 
-    // PSUDO Receiving
+    // Receiving
     if (circular_buffer_count(&handle->rx_packet_buffer) > 0)
     {
         packet_t packet;
@@ -140,11 +344,12 @@ int orchestrator_task(orchestrator_handle_t *handle)
             return -1;
         }
 
-        // Call RX callback with packet payload
-        if (handle->rx_callback)
+        if (_handle_rx_packet(handle, &packet))
         {
-            handle->rx_callback(packet.content.payload, packet.content.payload_length, packet.content.src_addr);
+            LOG_ERROR("Failed to handle received packet");
+            return -1;
         }
+        TRACE_FRAME(TRACE_STAGE_DELIVERED, &packet);
     }
 
     return 0;
@@ -176,6 +381,7 @@ int orchestrator_packet_callback(orchestrator_handle_t *handle, const packet_t *
         LOG_ERROR("Failed to push packet to RX buffer");
         return -1;
     }
+    TRACE_FRAME(TRACE_STAGE_QUEUED, packet);
 
     return 0;
 }
@@ -194,17 +400,310 @@ int _add_beacon_to_queue(orchestrator_handle_t *handle)
         return 0;
     }
 
-    if (initialize_packet(&packet, PACKET_TYPE_BEACON, pconfigDEVICE_ADDRESS, 0, 0, pconfigFCC_CALLSIGN, sizeof(pconfigFCC_CALLSIGN) - 1))
+    if (initialize_packet(&packet, PACKET_TYPE_BEACON, handle->address, pconfigBROADCAST_ADDRESS, 0, pconfigFCC_CALLSIGN, sizeof(pconfigFCC_CALLSIGN) - 1))
     {
         LOG_ERROR("Failed to create packet");
         return -1;
     }
 
-    if (circular_buffer_push(&handle->tx_packet_buffer, &packet))
+    if (tx_scheduler_full(&handle->tx_scheduler, TX_CLASS_BEACON))
+    {
+        LOG_WARN("Beacon still waiting to be sent, skipping this one");
+        return 0;
+    }
+
+    if (tx_scheduler_push(&handle->tx_scheduler, TX_CLASS_BEACON, &packet))
     {
         LOG_ERROR("Failed to add packet to queue");
         return -1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Queues route advertisements as control traffic while the routing table still has entries to send
+ */
+static int _add_adverts_to_queue(orchestrator_handle_t *handle)
+{
+    while (routing_advert_pending(&handle->routing) && !tx_scheduler_full(&handle->tx_scheduler, TX_CLASS_CONTROL))
+    {
+        packet_t packet;
+        if (routing_get_advert(&handle->routing, &packet))
+        {
+            LOG_ERROR("Failed to build route advertisement");
+            return -1;
+        }
+
+        if (tx_scheduler_push(&handle->tx_scheduler, TX_CLASS_CONTROL, &packet))
+        {
+            LOG_ERROR("Failed to add packet to queue");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Checks if there is anything the MAC should contend for
+ */
+static bool _tx_pending(orchestrator_handle_t *handle)
+{
+    return arq_ack_pending(&handle->arq) ||
+           arq_retransmission_pending(&handle->arq) ||
+           tx_scheduler_pending(&handle->tx_scheduler);
+}
+
+/**
+ * @brief Picks the next packet to transmit: ACKs first, then retransmissions, then whatever the TX scheduler picks
+ *
+ * @note ACKs are only built here so every id received until the frame goes out can share it.
+ *       Retransmissions already hold an ARQ window slot, so they go ahead of new traffic.
+ *       They're also sent at the base rate, in case the faster rate is what failed.
+ */
+static int _next_tx_packet(orchestrator_handle_t *handle, packet_t *packet, fsk_rate_e *rate)
+{
+    bool ack = arq_get_ack(&handle->arq, packet) == 0;
+    bool retransmission = !ack && arq_get_retransmission(&handle->arq, packet) == 0;
+
+    if (!ack && !retransmission)
+    {
+        if (tx_scheduler_pop(&handle->tx_scheduler, packet))
+        {
+            LOG_ERROR("Failed to pop packet from TX scheduler");
+            return -1;
+        }
+
+        // Relayed data is acknowledged end to end, only our own is tracked
+        if (packet->content.type == PACKET_TYPE_DATA && packet->content.dest_addr != pconfigBROADCAST_ADDRESS &&
+            packet->content.src_addr == handle->address)
+        {
+            if (arq_track(&handle->arq, packet))
+            {
+                LOG_ERROR("Failed to track packet for acknowledgement");
+                return -1;
+            }
+        }
+    }
+
+    // Our session rides along until the destination has acknowledged it, retransmissions included
+    if (!ack && packet->content.type == PACKET_TYPE_DATA && packet->content.dest_addr != pconfigBROADCAST_ADDRESS &&
+        packet->content.src_addr == handle->address && arq_set_session(&handle->arq, packet))
+    {
+        LOG_ERROR("Failed to set ARQ session");
+        return -1;
+    }
+
+    // Routes are looked up as late as possible, retransmissions take the current best path.
+    // Relays already had their next hop picked when they were queued.
+    if (packet->content.src_addr == handle->address && routing_set_next_hop(&handle->routing, packet))
+    {
+        LOG_ERROR("Failed to set next hop");
+        return -1;
+    }
+
+    *rate = retransmission ? FSK_RATE_BASE : _select_rate(handle, packet);
+
+    return 0;
+}
+
+/**
+ * @brief Picks the fastest rate the next hop should still decode, from the SNR and loss we see on its packets
+ *
+ * @note Assumes the link is about as good in both directions. Anything without a
+ *       single next hop (broadcasts, floods) has to reach every node, so it stays at the base rate.
+ */
+static fsk_rate_e _select_rate(orchestrator_handle_t *handle, const packet_t *packet)
+{
+#if pconfigADAPTIVE_RATE_ENABLED
+    float snr_db;
+    float delivery_ratio;
+
+    if (!(packet->content.flags & PACKET_FLAG_NEXT_HOP) ||
+        routing_link_quality(&handle->routing, packet->content.next_hop, &snr_db, &delivery_ratio) ||
+        delivery_ratio < pconfigRATE_MIN_DELIVERY_RATIO)
+    {
+        return FSK_RATE_BASE;
+    }
+
+    if (snr_db >= pconfigRATE_3X_MIN_SNR_DB)
+    {
+        return FSK_RATE_3X;
+    }
+    if (snr_db >= pconfigRATE_2X_MIN_SNR_DB)
+    {
+        return FSK_RATE_2X;
+    }
+#endif
+
+    return FSK_RATE_BASE;
+}
+
+static int _handle_rx_packet(orchestrator_handle_t *handle, const packet_t *packet)
+{
+    if (packet->content.src_addr == handle->address)
+    {
+        return 0; // Our own packet relayed back to us
+    }
+
+    if (routing_handle_packet(&handle->routing, packet))
+    {
+        LOG_ERROR("Failed to update routes");
+        return -1;
+    }
+
+    // Flooded packets reach us once per relay, routed ones follow a single path
+    bool routed = packet->content.flags & PACKET_FLAG_NEXT_HOP;
+    if (!routed && routing_seen_before(&handle->routing, packet))
+    {
+        return 0;
+    }
+
+    packet_t relay;
+    if (routing_relay(&handle->routing, packet, &relay))
+    {
+        if (tx_scheduler_full(&handle->tx_scheduler, TX_CLASS_RELAY))
+        {
+            LOG_WARN("Relay queue is full, dropping packet from 0x%02X", packet->content.src_addr);
+        }
+        else if (tx_scheduler_push(&handle->tx_scheduler, TX_CLASS_RELAY, &relay))
+        {
+            LOG_ERROR("Failed to queue relay");
+            return -1;
+        }
+    }
+
+    bool for_us = packet->content.dest_addr == handle->address;
+
+    if (!for_us && packet->content.dest_addr != pconfigBROADCAST_ADDRESS)
+    {
+        return 0; // Addressed to someone else
+    }
+
+    switch (packet->content.type)
+    {
+    case PACKET_TYPE_BEACON:
+    case PACKET_TYPE_ROUTE:
+        break; // Already used for routing
+    case PACKET_TYPE_DATA:
+        // Unicast data is acknowledged, and only handed up the first time we see it
+        if (for_us && !arq_handle_data(&handle->arq, packet))
+        {
+            break;
+        }
+
+        if (_deliver_data(handle, packet))
+        {
+            LOG_ERROR("Failed to deliver data");
+            return -1;
+        }
+        break;
+    case PACKET_TYPE_ACK:
+        if (for_us && arq_handle_ack(&handle->arq, packet))
+        {
+            LOG_ERROR("Failed to handle ACK");
+            return -1;
+        }
+        break;
+    default:
+        LOG_WARN("Unknown packet type %d", packet->content.type);
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Our own unicast data has to wait in its queue while the ARQ window is full
+ */
+static bool _tx_eligible(const packet_t *packet, void *ctx)
+{
+    orchestrator_handle_t *handle = (orchestrator_handle_t *)ctx;
+
+    if (packet->content.type == PACKET_TYPE_DATA && packet->content.dest_addr != pconfigBROADCAST_ADDRESS &&
+        packet->content.src_addr == handle->address)
+    {
+        return arq_window_available(&handle->arq);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Reports delivery per message, fragments are folded into the message they belong to
+ */
+static void _arq_delivery(void *ctx, uint8_t dest_addr, uint8_t id, bool delivered)
+{
+    orchestrator_handle_t *handle = (orchestrator_handle_t *)ctx;
+
+    fragmentation_tx_status_e status;
+    uint8_t first_id = id;
+    if (fragmentation_tx_result(&handle->fragmentation, dest_addr, id, delivered, &status, &first_id))
+    {
+        LOG_ERROR("Failed to handle fragment delivery result");
+        return;
+    }
+
+    if (status == FRAGMENTATION_TX_IN_PROGRESS || !handle->tx_callback)
+    {
+        return;
+    }
+
+    handle->tx_callback(dest_addr, first_id, status == FRAGMENTATION_TX_NOT_TRACKED ? delivered : status == FRAGMENTATION_TX_DELIVERED);
+}
+
+/**
+ * @brief Hands data up to the application, once the whole message is there for fragments
+ */
+static int _deliver_data(orchestrator_handle_t *handle, const packet_t *packet)
+{
+    if (!handle->rx_callback)
+    {
+        return 0;
+    }
+
+    bool compressed = packet->content.flags & PACKET_FLAG_COMPRESSED;
+
+    if (!(packet->content.flags & PACKET_FLAG_FRAGMENT))
+    {
+        _deliver_message(handle, packet->content.payload, packet->content.payload_length, packet->content.src_addr, compressed);
+        return 0;
+    }
+
+    size_t message_length = 0;
+    if (fragmentation_reassemble(&handle->fragmentation, packet, handle->rx_message, &message_length))
+    {
+        LOG_WARN("Dropping malformed fragment from 0x%02X", packet->content.src_addr);
+        return 0;
+    }
+
+    if (message_length > 0)
+    {
+        _deliver_message(handle, handle->rx_message, message_length, packet->content.src_addr, compressed);
+    }
+
+    return 0;
+}
+
+static void _deliver_message(orchestrator_handle_t *handle, const uint8_t *data, size_t len, uint8_t src_addr, bool compressed)
+{
+    if (!compressed)
+    {
+        handle->rx_callback(data, len, src_addr);
+        return;
+    }
+
+#if pconfigCOMPRESSION_ENABLED
+    size_t decompressed_len = 0;
+    if (compression_decompress(data, len, handle->rx_decompressed, sizeof(handle->rx_decompressed), &decompressed_len))
+    {
+        LOG_WARN("Dropping message from 0x%02X that failed to decompress", src_addr);
+        return;
+    }
+
+    handle->rx_callback(handle->rx_decompressed, decompressed_len, src_addr);
+#else
+    LOG_WARN("Dropping compressed message from 0x%02X, compression is disabled", src_addr);
+#endif
+}
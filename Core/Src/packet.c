@@ -9,7 +9,22 @@ uint16_t calculate_crc(const packet_t *packet)
     crc += packet->content.dest_addr;
     crc += packet->content.id;
     crc += (packet->content.ttl << 4) | packet->content.type;
+    crc += packet->content.flags;
     crc += packet->content.payload_length;
+    if (packet->content.flags & PACKET_FLAG_FRAGMENT)
+    {
+        crc += packet->content.fragment.message_id;
+        crc += packet->content.fragment.index;
+        crc += packet->content.fragment.count;
+    }
+    if (packet->content.flags & PACKET_FLAG_NEXT_HOP)
+    {
+        crc += packet->content.next_hop;
+    }
+    if (packet->content.flags & PACKET_FLAG_SESSION)
+    {
+        crc += packet->content.session;
+    }
     for (size_t i = 0; i < packet->content.payload_length; i++)
     {
         crc += packet->content.payload[i];
@@ -17,6 +32,57 @@ uint16_t calculate_crc(const packet_t *packet)
     return crc;
 }
 
+/**
+ * @brief Number of header extension bytes that follow the header for the given flags
+ */
+size_t packet_extension_size(uint8_t flags)
+{
+    size_t size = 0;
+
+    if (flags & PACKET_FLAG_FRAGMENT)
+    {
+        size += PACKET_FRAGMENT_EXTENSION_SIZE;
+    }
+    if (flags & PACKET_FLAG_NEXT_HOP)
+    {
+        size += PACKET_NEXT_HOP_EXTENSION_SIZE;
+    }
+    if (flags & PACKET_FLAG_SESSION)
+    {
+        size += PACKET_SESSION_EXTENSION_SIZE;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Marks an initialized packet as one fragment of a larger message
+ *
+ * @param packet Pointer to the packet
+ * @param message_id Id shared by all fragments of the message
+ * @param index Position of this fragment in the message
+ * @param count Number of fragments in the message
+ *
+ * @return error code: 0 = success, -1 = failure
+ */
+int packet_set_fragment(packet_t *packet, uint8_t message_id, uint8_t index, uint8_t count)
+{
+    if (!packet || index >= count)
+    {
+        LOG_ERROR("Invalid fragment parameters");
+        return -1;
+    }
+
+    packet->content.flags |= PACKET_FLAG_FRAGMENT;
+    packet->content.fragment.message_id = message_id;
+    packet->content.fragment.index = index;
+    packet->content.fragment.count = count;
+
+    packet->content.crc = calculate_crc(packet);
+
+    return 0;
+}
+
 int initialize_packet(packet_t *packet, packet_type_e packet_type, uint16_t src_addr, uint16_t dest_addr, uint8_t id, const uint8_t *payload, size_t payload_length)
 {
     // Initialize packet fields
@@ -25,6 +91,7 @@ int initialize_packet(packet_t *packet, packet_type_e packet_type, uint16_t src_
     packet->content.id = id;
     packet->content.ttl = pconfigTTL; // Default TTL value, can be adjusted as
     packet->content.type = packet_type;
+    packet->content.flags = 0;
 
     // Limit payload length if it exceeds maximum size
     if (payload_length > pconfigMAX_PAYLOAD_SIZE)
@@ -52,6 +119,19 @@ void print_packet(const packet_t *packet)
     printf("ID: %d\n", packet->content.id);
     printf("Payload length: %d\n", packet->content.payload_length);
     printf("TTL: %d\n", packet->content.ttl);
+    printf("Flags: 0x%02X\n", packet->content.flags);
+    if (packet->content.flags & PACKET_FLAG_FRAGMENT)
+    {
+        printf("Fragment: %d/%d of message %d\n", packet->content.fragment.index + 1, packet->content.fragment.count, packet->content.fragment.message_id);
+    }
+    if (packet->content.flags & PACKET_FLAG_NEXT_HOP)
+    {
+        printf("Next hop: 0x%02X\n", packet->content.next_hop);
+    }
+    if (packet->content.flags & PACKET_FLAG_SESSION)
+    {
+        printf("Session: 0x%02X\n", packet->content.session);
+    }
     printf("Checksum: 0x%04X\n", packet->content.crc);
     printf("Payload: ");
     for (size_t i = 0; i < packet->content.payload_length; i++)
@@ -5,6 +5,8 @@
 
 #include "interface/peregrine-constellation.h"
 #include "orchestrator.h"
+#include "utils/arena.h"
+#include "utils/trace.h"
 #include "c-logger.h"
 
 // Peregrine Constellation handle
@@ -12,27 +14,99 @@ typedef struct pc_handle
 {
     message_callback_t message_callback;       // Callback for when a message is received and decoded
     orchestrator_handle_t orchestrator_handle; // Handle for the orchestrator which manages the modem and packet buffers
+    void *allocated;                           // Memory pc_init took from the heap, freed by pc_deinit, NULL if the caller's
 } pc_handle_t;
 
-// Initialize the library with the node address
-pc_handle_t *pc_init(message_callback_t callback)
+// Fill in the default profile from pconfig.h
+void pc_default_config(pc_config_t *config)
 {
-    pc_handle_t *handle = malloc(sizeof(pc_handle_t));
-    if (!handle)
+    if (config == NULL)
     {
-        LOG_ERROR("Failed to allocate memory for Peregrine Constellation handle");
-        return NULL;
+        return;
     }
 
-    handle->message_callback = callback;
+    config->device_address = pconfigDEVICE_ADDRESS;
+    config->baud_rate = pconfigBAUD_RATE;
+    config->freq_0 = pconfigMODEM_FREQ_0;
+    config->freq_1 = pconfigMODEM_FREQ_1;
+    config->sample_rate = pconfigSAMPLE_RATE_HZ;
+    config->sample_format = pconfigSAMPLE_FORMAT;
+    config->fsk_power_threshold = pconfigFSK_POWER_THRESHOLD;
+    config->csma_energy_threshold = pconfigCSMA_ENERGY_THRESHOLD;
+    config->decoder_buffer_symbol_count = pconfigDECODER_BUFFER_SYMBOL_COUNT;
+    config->ptt_delay_ms = pconfigPTT_DELAY_MS;
+}
+
+// Bytes pc_init needs for a config (NULL = default profile), 0 if the config is invalid
+size_t pc_required_memory(const pc_config_t *config)
+{
+    pc_config_t default_config;
+    if (config == NULL)
+    {
+        pc_default_config(&default_config);
+        config = &default_config;
+    }
+
+    size_t subsystems = orchestrator_required_memory(config);
+    if (subsystems == 0)
+    {
+        return 0;
+    }
+
+    // Slack for aligning a caller's region that doesn't start on ARENA_ALIGNMENT
+    return (ARENA_ALIGNMENT - 1) + ARENA_ALIGN(sizeof(pc_handle_t)) + subsystems;
+}
 
-    if (!handle->message_callback)
+// Initialize the library, config = NULL uses the default profile. All state is placed in memory,
+// which must hold pc_required_memory(config) bytes and outlive the handle. memory = NULL allocates it once from the heap.
+pc_handle_t *pc_init(const pc_config_t *config, message_callback_t callback, void *memory, size_t memory_size)
+{
+    pc_config_t default_config;
+    if (config == NULL)
+    {
+        pc_default_config(&default_config);
+        config = &default_config;
+    }
+
+    if (!callback)
     {
         LOG_ERROR("Message callback is NULL");
+        return NULL;
+    }
+
+    size_t required = pc_required_memory(config);
+    if (required == 0)
+    {
+        LOG_ERROR("Invalid config");
+        return NULL;
+    }
+
+    void *allocated = NULL;
+    if (memory == NULL)
+    {
+        allocated = malloc(required);
+        memory = allocated;
+        memory_size = required;
+    }
+
+    arena_t arena;
+    if (memory_size < required || arena_init(&arena, memory, memory_size))
+    {
+        LOG_ERROR("Memory for Peregrine Constellation is too small: %zu bytes, %zu required", memory_size, required);
         goto failed;
     }
 
-    if (orchestrator_init(&handle->orchestrator_handle, callback))
+    pc_handle_t *handle = arena_alloc(&arena, sizeof(pc_handle_t));
+    if (!handle)
+    {
+        LOG_ERROR("Failed to allocate memory for Peregrine Constellation handle");
+        goto failed;
+    }
+
+    handle->message_callback = callback;
+    handle->allocated = allocated;
+
+    if (orchestrator_init(&handle->orchestrator_handle, config, &arena, callback))
     {
         LOG_ERROR("Failed to initialize orchestrator");
         goto failed;
@@ -40,12 +114,48 @@ pc_handle_t *pc_init(message_callback_t callback)
 
     return handle;
 failed:
-    free(handle);
+    free(allocated);
     return NULL;
 }
 
+// Shut the library down. Memory pc_init allocated is freed, memory the caller passed in is theirs to reuse.
+// The handle is invalid afterwards
+pc_error_e pc_deinit(pc_handle_t *handle)
+{
+    if (handle == NULL)
+    {
+        LOG_ERROR("Handle is NULL");
+        return PC_ERROR_INVALID_HANDLE;
+    }
+
+    // The handle lives in the memory being freed
+    void *allocated = handle->allocated;
+    handle->message_callback = NULL;
+    free(allocated);
+
+    return PC_SUCCESS;
+}
+
+// Set the callback for delivery status of unicast messages
+pc_error_e pc_set_send_callback(pc_handle_t *handle, send_callback_t callback)
+{
+    if (handle == NULL)
+    {
+        LOG_ERROR("Handle is NULL");
+        return PC_ERROR_INVALID_HANDLE;
+    }
+
+    if (orchestrator_set_tx_callback(&handle->orchestrator_handle, callback))
+    {
+        LOG_ERROR("Failed to set send callback");
+        return PC_ERROR_INVALID_HANDLE;
+    }
+
+    return PC_SUCCESS;
+}
+
 // Send a message
-pc_error_e pc_send_message(pc_handle_t *handle, uint8_t dest_addr, const uint8_t *payload, size_t payload_length)
+pc_error_e pc_send_message(pc_handle_t *handle, uint8_t dest_addr, const uint8_t *payload, size_t payload_length, uint8_t *message_id)
 {
     if (handle == NULL)
     {
@@ -53,7 +163,17 @@ pc_error_e pc_send_message(pc_handle_t *handle, uint8_t dest_addr, const uint8_t
         return PC_ERROR_INVALID_HANDLE;
     }
 
-    if (orchestrator_send(&handle->orchestrator_handle, payload, payload_length, dest_addr))
+    if (payload_length > pconfigMAX_MESSAGE_SIZE)
+    {
+        return PC_ERROR_MESSAGE_TOO_LARGE;
+    }
+
+    if (!orchestrator_can_send(&handle->orchestrator_handle, payload_length, dest_addr))
+    {
+        return PC_ERROR_QUEUE_FULL;
+    }
+
+    if (orchestrator_send(&handle->orchestrator_handle, payload, payload_length, dest_addr, message_id))
     {
         LOG_ERROR("Failed to send message through orchestrator");
         return PC_ERROR_INVALID_HANDLE;
@@ -62,6 +182,92 @@ pc_error_e pc_send_message(pc_handle_t *handle, uint8_t dest_addr, const uint8_t
     return PC_SUCCESS;
 }
 
+// Change the tones at runtime, the decoder filters are redesigned before the next sample
+pc_error_e pc_set_frequencies(pc_handle_t *handle, int freq_0, int freq_1)
+{
+    if (handle == NULL)
+    {
+        LOG_ERROR("Handle is NULL");
+        return PC_ERROR_INVALID_HANDLE;
+    }
+
+    if (modem_set_frequencies(&handle->orchestrator_handle.modem, freq_0, freq_1))
+    {
+        return PC_ERROR_INVALID_CONFIG;
+    }
+
+    return PC_SUCCESS;
+}
+
+// Change the bit decision threshold at runtime
+pc_error_e pc_set_power_threshold(pc_handle_t *handle, float threshold)
+{
+    if (handle == NULL)
+    {
+        LOG_ERROR("Handle is NULL");
+        return PC_ERROR_INVALID_HANDLE;
+    }
+
+    if (modem_set_power_threshold(&handle->orchestrator_handle.modem, threshold))
+    {
+        return PC_ERROR_INVALID_CONFIG;
+    }
+
+    return PC_SUCCESS;
+}
+
+// Change the carrier sense threshold at runtime
+pc_error_e pc_set_csma_threshold(pc_handle_t *handle, float threshold)
+{
+    if (handle == NULL)
+    {
+        LOG_ERROR("Handle is NULL");
+        return PC_ERROR_INVALID_HANDLE;
+    }
+
+    if (modem_set_csma_threshold(&handle->orchestrator_handle.modem, threshold))
+    {
+        return PC_ERROR_INVALID_CONFIG;
+    }
+
+    return PC_SUCCESS;
+}
+
+// Read the counters, safe to call from another thread than pc_task
+pc_error_e pc_get_stats(pc_handle_t *handle, pc_stats_t *stats)
+{
+    if (handle == NULL || stats == NULL)
+    {
+        LOG_ERROR("Handle or stats is NULL");
+        return PC_ERROR_INVALID_HANDLE;
+    }
+
+    orchestrator_handle_t *orchestrator = &handle->orchestrator_handle;
+    modem_handle_t *modem = &orchestrator->modem;
+
+    stats->samples_processed = STAT_GET(modem->fsk_decoder.stats.samples);
+    stats->samples_idle = STAT_GET(modem->fsk_decoder.stats.idle_samples);
+    stats->preambles_detected = STAT_GET(modem->decoder.stats.sync_words);
+    stats->frames_crc_passed = STAT_GET(modem->decoder.packet_decoder.stats.crc_passed);
+    stats->frames_crc_failed = STAT_GET(modem->decoder.packet_decoder.stats.crc_failed);
+    stats->length_rejects = STAT_GET(modem->decoder.packet_decoder.stats.length_rejected);
+    stats->buffer_overflows = STAT_GET(modem->decoder.input_ring.overflows) +
+                              STAT_GET(modem->decoder.output_buffer.overflows) +
+                              STAT_GET(orchestrator->rx_packet_buffer.overflows);
+    stats->frames_sent = STAT_GET(modem->stats.frames_sent);
+    stats->airtime_ms = STAT_GET(modem->stats.airtime_ms);
+    stats->backoffs = STAT_GET(orchestrator->mac.stats.collisions);
+
+    return PC_SUCCESS;
+}
+
+// Write the frame latency trace as Chrome trace JSON, snprintf style: returns the full length even if size was too small.
+// Needs pconfigTRACE_ENABLED, otherwise the trace is empty
+size_t pc_trace_dump(char *buffer, size_t size)
+{
+    return trace_dump_chrome_json(buffer, size);
+}
+
 // Update function to be called periodically to handle retries
 void pc_task(pc_handle_t *handle)
 {
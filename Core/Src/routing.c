@@ -0,0 +1,717 @@
+/**
+ * @file routing.c
+ *
+ * @author Diamond42474
+ *
+ * Distance vector routing over the 8-bit address space. Neighbors are learned
+ * from the beacons and route advertisements they send themselves, and every
+ * link gets a cost from how many of the neighbor's advertisements actually
+ * made it through (lost frames and CRC failures both show up as gaps in the
+ * advertisement ids) and from the tone envelope SNR the decoder measured.
+ * Each node periodically advertises its table, and unicast packets are sent
+ * to the best next hop only. Packets without a known route, and broadcasts,
+ * are flooded with TTL and duplicate suppression as before.
+ *
+ * Advertisements are broadcast, so instead of one poisoned copy per neighbor
+ * every entry names its next hop, and a neighbor treats routes through itself
+ * as unreachable (split horizon with poison reverse). Lost routes go out as
+ * unreachable shortly after, on their own, and again in the next whole table,
+ * instead of just being left out. New and better routes wait for the whole
+ * table, which is repeated less often the more airtime it and the
+ * neighborhood's other tables take.
+ */
+#include "routing.h"
+
+#include <string.h>
+#include "c-logger.h"
+#include "bsp/time_bsp.h"
+
+#define ROUTING_LINK_COST_SCALE (16)    // Cost of a perfect link
+#define ROUTING_MAX_LINK_COST (254)     // Keeps a single link below ROUTING_METRIC_INFINITY
+#define ROUTING_DELIVERY_ALPHA (0.125f) // Smoothing for the delivery ratio
+#define ROUTING_SNR_ALPHA (0.25f)       // Smoothing for the SNR
+#define ROUTING_MAX_COUNTED_LOSSES (8)  // Longer gaps are more likely a reboot than a bad link
+#define ROUTING_ADVERT_HEADER_SIZE (1)  // Whole table interval, in ROUTING_INTERVAL_UNIT_S
+#define ROUTING_ADVERT_ENTRY_SIZE (3)   // Destination, metric and next hop
+#define ROUTING_INTERVAL_UNIT_S (10)    // Resolution of the advertised interval
+#define ROUTING_ADVERT_OVERHEAD (3 + PACKET_HEADER_SIZE) // Sync word, rate byte and header sent with every advertisement
+#define ROUTING_REFRESHES_PER_TIMEOUT (3) // Whole table advertisements a route may miss before it's dropped
+
+static uint32_t _now_ms(void);
+static routing_neighbor_t *_get_neighbor(routing_handle_t *handle, uint8_t addr, bool create);
+static void _update_delivery(routing_neighbor_t *neighbor, uint8_t seq);
+static uint8_t _link_cost(const routing_neighbor_t *neighbor);
+static void _update_route(routing_handle_t *handle, uint8_t dest_addr, const routing_neighbor_t *via, uint8_t advertised_metric, uint8_t advertised_next_hop);
+static void _withdraw_route(routing_handle_t *handle, routing_entry_t *entry, uint32_t now);
+static uint32_t _timeout_ms(const routing_neighbor_t *neighbor);
+static uint16_t _advert_interval_s(const routing_handle_t *handle);
+static uint16_t _identity(const packet_t *packet);
+
+/**
+ * @brief Initializes routing with an empty table
+ *
+ * @param handle pointer to routing handle
+ * @param address our own address
+ * @param baud_rate base rate of the resolved config, adverts are sent at it
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int routing_init(routing_handle_t *handle, uint8_t address, int baud_rate)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    if (baud_rate <= 0)
+    {
+        LOG_ERROR("Invalid baud rate %d", baud_rate);
+        return -1;
+    }
+
+    memset(handle, 0, sizeof(routing_handle_t));
+
+    handle->address = address;
+    handle->baud_rate = baud_rate;
+    for (size_t i = 0; i < ROUTING_TABLE_SIZE; i++)
+    {
+        handle->routes[i].metric = ROUTING_METRIC_INFINITY;
+    }
+
+    // Advertise right away so neighbors learn about us without waiting a full interval
+    handle->advert_pending = true;
+    handle->advert_full = true;
+    handle->advert_interval_s = pconfigROUTE_ADVERT_INTERVAL_S;
+    time_utils_start(&handle->advert_timer, (uint64_t)handle->advert_interval_s * ONE_SECOND);
+
+    return 0;
+}
+
+/**
+ * @brief Ages out neighbors and routes, and schedules advertisements
+ *
+ * @param handle pointer to routing handle
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int routing_task(routing_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    uint32_t now = _now_ms();
+
+    for (size_t i = 0; i < pconfigROUTE_MAX_NEIGHBORS; i++)
+    {
+        routing_neighbor_t *neighbor = &handle->neighbors[i];
+        if (neighbor->in_use && (uint32_t)(now - neighbor->last_heard_ms) >= _timeout_ms(neighbor))
+        {
+            LOG_INFO("Lost neighbor 0x%02X", neighbor->addr);
+            neighbor->in_use = false;
+
+            for (size_t dest = 0; dest < ROUTING_TABLE_SIZE; dest++)
+            {
+                if (handle->routes[dest].metric != ROUTING_METRIC_INFINITY && handle->routes[dest].next_hop == neighbor->addr)
+                {
+                    _withdraw_route(handle, &handle->routes[dest], now);
+                }
+            }
+        }
+    }
+
+    for (size_t dest = 0; dest < ROUTING_TABLE_SIZE; dest++)
+    {
+        routing_entry_t *entry = &handle->routes[dest];
+        if (entry->metric != ROUTING_METRIC_INFINITY &&
+            (uint32_t)(now - entry->updated_ms) >= _timeout_ms(_get_neighbor(handle, entry->next_hop, false)))
+        {
+            _withdraw_route(handle, entry, now);
+        }
+    }
+
+    if (time_utils_done(&handle->advert_timer))
+    {
+        handle->advert_interval_s = _advert_interval_s(handle);
+        time_utils_start(&handle->advert_timer, (uint64_t)handle->advert_interval_s * ONE_SECOND);
+        handle->advert_pending = true;
+        handle->advert_full = true;
+        handle->advert_cursor = 0;
+    }
+    else if (handle->update_scheduled && !handle->advert_pending && time_utils_done(&handle->update_timer))
+    {
+        // A round already going out carries the withdrawals it hasn't passed yet, the rest wait for this one
+        handle->update_scheduled = false;
+        handle->advert_pending = true;
+        handle->advert_full = false;
+        handle->advert_cursor = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Learns neighbors and routes from a received packet
+ *
+ * @note Only beacons and route advertisements are used, they are never relayed so
+ *       their source is the node we actually heard.
+ *
+ * @param handle pointer to routing handle
+ * @param packet received packet
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int routing_handle_packet(routing_handle_t *handle, const packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    if (packet->content.src_addr == handle->address ||
+        (packet->content.type != PACKET_TYPE_BEACON && packet->content.type != PACKET_TYPE_ROUTE))
+    {
+        return 0;
+    }
+
+    bool known = _get_neighbor(handle, packet->content.src_addr, false) != NULL;
+    routing_neighbor_t *neighbor = _get_neighbor(handle, packet->content.src_addr, true);
+
+    neighbor->snr_db = known ? neighbor->snr_db + ROUTING_SNR_ALPHA * (packet->metadata.snr_db - neighbor->snr_db) : packet->metadata.snr_db;
+    neighbor->last_heard_ms = _now_ms();
+
+    if (packet->content.type == PACKET_TYPE_ROUTE && packet->content.payload_length >= ROUTING_ADVERT_HEADER_SIZE)
+    {
+        handle->stats.adverts_received++;
+        _update_delivery(neighbor, packet->content.id);
+        neighbor->advert_interval_s = (uint16_t)(packet->content.payload[0] * ROUTING_INTERVAL_UNIT_S);
+    }
+
+    // The neighbor itself is one link away
+    _update_route(handle, neighbor->addr, neighbor, 0, neighbor->addr);
+
+    if (packet->content.type == PACKET_TYPE_ROUTE)
+    {
+        for (size_t i = ROUTING_ADVERT_HEADER_SIZE; i + ROUTING_ADVERT_ENTRY_SIZE <= packet->content.payload_length; i += ROUTING_ADVERT_ENTRY_SIZE)
+        {
+            uint8_t dest_addr = packet->content.payload[i];
+            if (dest_addr == handle->address || dest_addr == pconfigBROADCAST_ADDRESS)
+            {
+                continue;
+            }
+
+            _update_route(handle, dest_addr, neighbor, packet->content.payload[i + 1], packet->content.payload[i + 2]);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Checks if a packet was already seen recently, remembering it if not
+ *
+ * @note Relays change the TTL and next hop, so packets are compared on everything else.
+ *
+ * @param handle pointer to routing handle
+ * @param packet received packet
+ *
+ * @return true if the same packet was seen within pconfigRELAY_CACHE_TIME_MS
+ */
+bool routing_seen_before(routing_handle_t *handle, const packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return false;
+    }
+
+    uint32_t now = _now_ms();
+    uint16_t identity = _identity(packet);
+
+    for (size_t i = 0; i < pconfigRELAY_CACHE_SIZE; i++)
+    {
+        routing_seen_t *seen = &handle->seen[i];
+        if (seen->in_use && (uint32_t)(now - seen->seen_ms) < pconfigRELAY_CACHE_TIME_MS &&
+            seen->src_addr == packet->content.src_addr && seen->id == packet->content.id && seen->identity == identity)
+        {
+            handle->stats.duplicates++;
+            return true;
+        }
+    }
+
+    // Oldest entry makes room
+    routing_seen_t *seen = &handle->seen[handle->seen_next];
+    handle->seen_next = (handle->seen_next + 1) % pconfigRELAY_CACHE_SIZE;
+
+    seen->in_use = true;
+    seen->src_addr = packet->content.src_addr;
+    seen->id = packet->content.id;
+    seen->identity = identity;
+    seen->seen_ms = now;
+
+    return false;
+}
+
+/**
+ * @brief Decides if we should relay a received packet and builds the copy to send
+ *
+ * @note Duplicate suppression for flooded packets is left to routing_seen_before.
+ *
+ * @param handle pointer to routing handle
+ * @param packet received packet
+ * @param relay receives the packet to transmit, with TTL and next hop updated
+ *
+ * @return true if relay should be transmitted
+ */
+bool routing_relay(routing_handle_t *handle, const packet_t *packet, packet_t *relay)
+{
+    if (!handle || !packet || !relay)
+    {
+        LOG_ERROR("Invalid parameters for relay");
+        return false;
+    }
+
+    if (packet->content.src_addr == handle->address || packet->content.dest_addr == handle->address)
+    {
+        return false;
+    }
+    if (packet->content.type == PACKET_TYPE_BEACON || packet->content.type == PACKET_TYPE_ROUTE)
+    {
+        return false; // Link local
+    }
+    if ((packet->content.flags & PACKET_FLAG_NEXT_HOP) && packet->content.next_hop != handle->address)
+    {
+        return false; // Another node was picked to carry it
+    }
+    if (packet->content.ttl <= 1)
+    {
+        handle->stats.ttl_expired++;
+        return false;
+    }
+
+    *relay = *packet;
+    relay->content.ttl--;
+
+    // Sent on from here, what was measured receiving it doesn't describe the new transmission
+    relay->metadata.snr_db = 0.0f;
+    relay->metadata.sync_sample = 0;
+    relay->metadata.sync_time_us = 0;
+    relay->metadata.tone_0_level = 0.0f;
+    relay->metadata.tone_1_level = 0.0f;
+    relay->metadata.metric_margin = 0.0f;
+    relay->metadata.stuffed_bits = 0;
+
+    if (routing_set_next_hop(handle, relay))
+    {
+        LOG_ERROR("Failed to set next hop");
+        return false;
+    }
+
+    if (relay->content.flags & PACKET_FLAG_NEXT_HOP)
+    {
+        handle->stats.relayed++;
+    }
+    else
+    {
+        handle->stats.flooded++;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Looks up the best next hop towards a destination
+ *
+ * @param handle pointer to routing handle
+ * @param dest_addr destination address
+ * @param next_hop receives the neighbor to send through
+ *
+ * @return error code: 0 = successful, -1 = failed (no route)
+ */
+int routing_next_hop(routing_handle_t *handle, uint8_t dest_addr, uint8_t *next_hop)
+{
+    if (!handle || !next_hop)
+    {
+        LOG_ERROR("Handle or next hop is NULL");
+        return -1;
+    }
+
+    if (handle->routes[dest_addr].metric == ROUTING_METRIC_INFINITY)
+    {
+        return -1;
+    }
+
+    *next_hop = handle->routes[dest_addr].next_hop;
+
+    return 0;
+}
+
+/**
+ * @brief Addresses a unicast packet to the best next hop, or marks it for flooding when there's no route
+ *
+ * @param handle pointer to routing handle
+ * @param packet packet about to be transmitted, its CRC is updated
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int routing_set_next_hop(routing_handle_t *handle, packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    uint8_t next_hop;
+    if (packet->content.dest_addr != pconfigBROADCAST_ADDRESS && routing_next_hop(handle, packet->content.dest_addr, &next_hop) == 0)
+    {
+        packet->content.flags |= PACKET_FLAG_NEXT_HOP;
+        packet->content.next_hop = next_hop;
+    }
+    else
+    {
+        packet->content.flags &= ~PACKET_FLAG_NEXT_HOP;
+        packet->content.next_hop = 0;
+    }
+
+    packet->content.crc = calculate_crc(packet);
+
+    return 0;
+}
+
+/**
+ * @brief Gets the measured quality of the link to a neighbor
+ *
+ * @param handle pointer to routing handle
+ * @param neighbor_addr neighbor address
+ * @param snr_db receives the smoothed SNR of packets heard from the neighbor
+ * @param delivery_ratio receives the fraction of the neighbor's advertisements we received
+ *
+ * @return error code: 0 = successful, -1 = failed (not a neighbor)
+ */
+int routing_link_quality(routing_handle_t *handle, uint8_t neighbor_addr, float *snr_db, float *delivery_ratio)
+{
+    if (!handle || !snr_db || !delivery_ratio)
+    {
+        LOG_ERROR("Invalid parameters for link quality");
+        return -1;
+    }
+
+    routing_neighbor_t *neighbor = _get_neighbor(handle, neighbor_addr, false);
+    if (!neighbor)
+    {
+        return -1;
+    }
+
+    *snr_db = neighbor->snr_db;
+    *delivery_ratio = neighbor->delivery_ratio;
+
+    return 0;
+}
+
+bool routing_advert_pending(routing_handle_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    return handle->advert_pending;
+}
+
+/**
+ * @brief Builds the next route advertisement
+ *
+ * @note A round too large for one packet is spread over several advertisements,
+ *       routing_advert_pending stays set until all of it has been sent. Whole table
+ *       rounds also carry the routes withdrawn since the last one, update rounds only those.
+ *
+ * @param handle pointer to routing handle
+ * @param packet receives the advertisement
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int routing_get_advert(routing_handle_t *handle, packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    uint8_t payload[pconfigMAX_PAYLOAD_SIZE];
+    size_t len = 0;
+
+    payload[len++] = (uint8_t)(handle->advert_interval_s / ROUTING_INTERVAL_UNIT_S);
+
+    while (handle->advert_cursor < ROUTING_TABLE_SIZE && len + ROUTING_ADVERT_ENTRY_SIZE <= sizeof(payload))
+    {
+        uint8_t dest_addr = (uint8_t)handle->advert_cursor++;
+        routing_entry_t *entry = &handle->routes[dest_addr];
+
+        bool known = entry->metric != ROUTING_METRIC_INFINITY || entry->withdrawn;
+        if (dest_addr == handle->address || !(handle->advert_full ? known : entry->changed))
+        {
+            continue;
+        }
+
+        payload[len++] = dest_addr;
+        payload[len++] = entry->metric;
+        payload[len++] = entry->next_hop;
+        entry->changed = false;
+        entry->withdrawn = entry->withdrawn && !handle->advert_full;
+    }
+
+    if (handle->advert_cursor >= ROUTING_TABLE_SIZE)
+    {
+        handle->advert_pending = false;
+    }
+
+    if (initialize_packet(packet, PACKET_TYPE_ROUTE, handle->address, pconfigBROADCAST_ADDRESS, handle->advert_seq++, payload, len))
+    {
+        LOG_ERROR("Failed to initialize route advertisement");
+        return -1;
+    }
+
+    handle->stats.adverts_sent++;
+
+    return 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static uint32_t _now_ms(void)
+{
+    return (uint32_t)time_bsp_get_ms();
+}
+
+static routing_neighbor_t *_get_neighbor(routing_handle_t *handle, uint8_t addr, bool create)
+{
+    routing_neighbor_t *free_slot = NULL;
+    routing_neighbor_t *oldest = NULL;
+
+    for (size_t i = 0; i < pconfigROUTE_MAX_NEIGHBORS; i++)
+    {
+        routing_neighbor_t *neighbor = &handle->neighbors[i];
+        if (!neighbor->in_use)
+        {
+            free_slot = free_slot ? free_slot : neighbor;
+            continue;
+        }
+
+        if (neighbor->addr == addr)
+        {
+            return neighbor;
+        }
+
+        if (!oldest || (int32_t)(neighbor->last_heard_ms - oldest->last_heard_ms) < 0)
+        {
+            oldest = neighbor;
+        }
+    }
+
+    if (!create)
+    {
+        return NULL;
+    }
+
+    if (!free_slot)
+    {
+        LOG_WARN("Neighbor table full, forgetting 0x%02X", oldest->addr);
+        for (size_t dest = 0; dest < ROUTING_TABLE_SIZE; dest++)
+        {
+            if (handle->routes[dest].metric != ROUTING_METRIC_INFINITY && handle->routes[dest].next_hop == oldest->addr)
+            {
+                _withdraw_route(handle, &handle->routes[dest], _now_ms());
+            }
+        }
+        free_slot = oldest;
+    }
+
+    LOG_INFO("New neighbor 0x%02X", addr);
+    memset(free_slot, 0, sizeof(routing_neighbor_t));
+    free_slot->in_use = true;
+    free_slot->addr = addr;
+    free_slot->delivery_ratio = 1.0f; // Optimistic until advertisements say otherwise
+
+    return free_slot;
+}
+
+/**
+ * @brief Counts every advertisement id skipped since the last one as a lost frame
+ */
+static void _update_delivery(routing_neighbor_t *neighbor, uint8_t seq)
+{
+    if (neighbor->seq_valid)
+    {
+        uint8_t gap = (uint8_t)(seq - neighbor->last_seq);
+        if (gap == 0)
+        {
+            return;
+        }
+
+        uint8_t missed = gap - 1;
+        if (missed > ROUTING_MAX_COUNTED_LOSSES)
+        {
+            missed = ROUTING_MAX_COUNTED_LOSSES;
+        }
+
+        for (uint8_t i = 0; i < missed; i++)
+        {
+            neighbor->delivery_ratio -= ROUTING_DELIVERY_ALPHA * neighbor->delivery_ratio;
+        }
+    }
+
+    neighbor->delivery_ratio += ROUTING_DELIVERY_ALPHA * (1.0f - neighbor->delivery_ratio);
+    neighbor->seq_valid = true;
+    neighbor->last_seq = seq;
+}
+
+/**
+ * @brief Expected transmissions scaled by ROUTING_LINK_COST_SCALE, with a penalty for weak signals
+ */
+static uint8_t _link_cost(const routing_neighbor_t *neighbor)
+{
+    float cost = (float)ROUTING_LINK_COST_SCALE / neighbor->delivery_ratio;
+
+    if (neighbor->snr_db < pconfigROUTE_MIN_SNR_DB)
+    {
+        cost += ROUTING_LINK_COST_SCALE;
+    }
+
+    if (cost > ROUTING_MAX_LINK_COST || neighbor->delivery_ratio <= 0.0f)
+    {
+        return ROUTING_MAX_LINK_COST;
+    }
+
+    return (uint8_t)cost;
+}
+
+/**
+ * @brief Takes a route through a neighbor if it's better, or if it comes from the next hop we already use
+ *
+ * @note A route the neighbor reaches through us is no route at all, taking it would make a loop.
+ */
+static void _update_route(routing_handle_t *handle, uint8_t dest_addr, const routing_neighbor_t *via, uint8_t advertised_metric, uint8_t advertised_next_hop)
+{
+    routing_entry_t *entry = &handle->routes[dest_addr];
+    uint32_t now = _now_ms();
+
+    uint32_t metric = ROUTING_METRIC_INFINITY;
+    if (advertised_metric != ROUTING_METRIC_INFINITY && advertised_next_hop != handle->address)
+    {
+        metric = advertised_metric + _link_cost(via);
+        metric = (metric > ROUTING_METRIC_INFINITY) ? ROUTING_METRIC_INFINITY : metric;
+    }
+
+    bool current_hop = entry->metric != ROUTING_METRIC_INFINITY && entry->next_hop == via->addr;
+    if (current_hop && metric == ROUTING_METRIC_INFINITY)
+    {
+        _withdraw_route(handle, entry, now); // Our next hop lost it
+        return;
+    }
+
+    if (metric < entry->metric || current_hop)
+    {
+        entry->next_hop = via->addr;
+        entry->metric = (uint8_t)metric;
+        entry->withdrawn = false;
+        entry->changed = false;
+        entry->updated_ms = now;
+    }
+}
+
+/**
+ * @brief Marks a route unreachable and queues it for the next update, which goes out pconfigROUTE_UPDATE_DELAY_S after the first
+ */
+static void _withdraw_route(routing_handle_t *handle, routing_entry_t *entry, uint32_t now)
+{
+    entry->metric = ROUTING_METRIC_INFINITY;
+    entry->withdrawn = true;
+    entry->changed = true;
+    entry->updated_ms = now;
+
+    if (!handle->update_scheduled)
+    {
+        handle->update_scheduled = true;
+        time_utils_start(&handle->update_timer, pconfigROUTE_UPDATE_DELAY_S * ONE_SECOND);
+    }
+}
+
+/**
+ * @brief How long a neighbor, and the routes through it, last without being heard
+ */
+static uint32_t _timeout_ms(const routing_neighbor_t *neighbor)
+{
+    uint32_t timeout_s = pconfigROUTE_TIMEOUT_S;
+
+    if (neighbor && (uint32_t)neighbor->advert_interval_s * ROUTING_REFRESHES_PER_TIMEOUT > timeout_s)
+    {
+        timeout_s = (uint32_t)neighbor->advert_interval_s * ROUTING_REFRESHES_PER_TIMEOUT;
+    }
+
+    return timeout_s * 1000UL;
+}
+
+/**
+ * @brief Interval between whole table advertisements that keeps the neighborhood's share of the channel
+ *
+ * @note Every neighbor is assumed to advertise a table about the size of ours. Rounded up to
+ *       ROUTING_INTERVAL_UNIT_S so neighbors are told exactly.
+ */
+static uint16_t _advert_interval_s(const routing_handle_t *handle)
+{
+    uint32_t entries = 0;
+    for (size_t dest = 0; dest < ROUTING_TABLE_SIZE; dest++)
+    {
+        const routing_entry_t *entry = &handle->routes[dest];
+        if (dest != handle->address && (entry->metric != ROUTING_METRIC_INFINITY || entry->withdrawn))
+        {
+            entries++;
+        }
+    }
+
+    uint32_t nodes = 1; // Us
+    for (size_t i = 0; i < pconfigROUTE_MAX_NEIGHBORS; i++)
+    {
+        nodes += handle->neighbors[i].in_use ? 1 : 0;
+    }
+
+    const uint32_t per_advert = (pconfigMAX_PAYLOAD_SIZE - ROUTING_ADVERT_HEADER_SIZE) / ROUTING_ADVERT_ENTRY_SIZE;
+    uint32_t adverts = entries ? (entries + per_advert - 1) / per_advert : 1;
+    uint32_t bytes = entries * ROUTING_ADVERT_ENTRY_SIZE + adverts * (ROUTING_ADVERT_HEADER_SIZE + ROUTING_ADVERT_OVERHEAD);
+    uint32_t airtime_ms = bytes * 8 * 1000 / (uint32_t)handle->baud_rate;
+
+    uint32_t interval_s = nodes * airtime_ms / (10 * pconfigROUTE_ADVERT_SHARE_PERCENT); // airtime * 100% / share, in seconds
+    if (interval_s < pconfigROUTE_ADVERT_INTERVAL_S)
+    {
+        interval_s = pconfigROUTE_ADVERT_INTERVAL_S;
+    }
+    if (interval_s > pconfigROUTE_ADVERT_MAX_INTERVAL_S)
+    {
+        interval_s = pconfigROUTE_ADVERT_MAX_INTERVAL_S;
+    }
+
+    return (uint16_t)((interval_s + ROUTING_INTERVAL_UNIT_S - 1) / ROUTING_INTERVAL_UNIT_S * ROUTING_INTERVAL_UNIT_S);
+}
+
+/**
+ * @brief CRC over everything but the fields relays rewrite, so relayed copies of a packet match
+ */
+static uint16_t _identity(const packet_t *packet)
+{
+    packet_t copy = *packet;
+
+    copy.content.ttl = 0;
+    copy.content.flags &= ~PACKET_FLAG_NEXT_HOP;
+    copy.content.next_hop = 0;
+
+    return calculate_crc(&copy);
+}
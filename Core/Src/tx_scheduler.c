@@ -0,0 +1,244 @@
+/**
+ * @file tx_scheduler.c
+ *
+ * @author Diamond42474
+ *
+ * Outbound packet scheduling. Every traffic class gets its own bounded queue
+ * so bulk data can't sit in front of link control. Control and beacon queues
+ * are served with strict priority, relay and application traffic share what's
+ * left through deficit round robin so neither can starve the other.
+ */
+#include "tx_scheduler.h"
+
+#include <string.h>
+#include "c-logger.h"
+
+static bool _head_eligible(tx_scheduler_t *handle, tx_class_e tx_class, packet_t *head);
+static tx_class_e _drr_next(tx_class_e tx_class);
+static uint32_t _packet_cost(const packet_t *packet);
+
+/**
+ * @brief Initializes the TX scheduler
+ *
+ * @param handle pointer to TX scheduler handle
+ * @param eligible_callback checked against the head of the relay/application queues before sending, may be NULL
+ * @param eligible_ctx passed through to eligible_callback
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int tx_scheduler_init(tx_scheduler_t *handle, tx_eligible_callback_t eligible_callback, void *eligible_ctx)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return -1;
+    }
+
+    memset(handle, 0, sizeof(tx_scheduler_t));
+
+    handle->eligible_callback = eligible_callback;
+    handle->eligible_ctx = eligible_ctx;
+
+    if (circular_buffer_static_init(&handle->queues[TX_CLASS_CONTROL].buffer, handle->control_array, sizeof(packet_t), pconfigTX_CONTROL_QUEUE_SIZE) ||
+        circular_buffer_static_init(&handle->queues[TX_CLASS_BEACON].buffer, handle->beacon_array, sizeof(packet_t), pconfigTX_BEACON_QUEUE_SIZE) ||
+        circular_buffer_static_init(&handle->queues[TX_CLASS_RELAY].buffer, handle->relay_array, sizeof(packet_t), pconfigTX_RELAY_QUEUE_SIZE) ||
+        circular_buffer_static_init(&handle->queues[TX_CLASS_APPLICATION].buffer, handle->application_array, sizeof(packet_t), pconfigTX_APPLICATION_QUEUE_SIZE))
+    {
+        LOG_ERROR("Failed to init TX queues");
+        return -1;
+    }
+
+    handle->queues[TX_CLASS_RELAY].quantum = pconfigTX_RELAY_QUANTUM;
+    handle->queues[TX_CLASS_APPLICATION].quantum = pconfigTX_APPLICATION_QUANTUM;
+
+    handle->drr_current = TX_CLASS_RELAY;
+    handle->queues[TX_CLASS_RELAY].deficit = pconfigTX_RELAY_QUANTUM;
+
+    return 0;
+}
+
+/**
+ * @brief Queues a packet for transmission
+ *
+ * @param handle pointer to TX scheduler handle
+ * @param tx_class traffic class deciding which queue the packet goes into
+ * @param packet packet to queue
+ *
+ * @return error code: 0 = successful, -1 = failed (including the queue being full)
+ */
+int tx_scheduler_push(tx_scheduler_t *handle, tx_class_e tx_class, const packet_t *packet)
+{
+    if (!handle || !packet || tx_class >= TX_CLASS_COUNT)
+    {
+        LOG_ERROR("Invalid parameters for TX scheduler push");
+        return -1;
+    }
+
+    if (circular_buffer_is_full(&handle->queues[tx_class].buffer))
+    {
+        LOG_WARN("TX queue %d is full", tx_class);
+        handle->stats.rejected[tx_class]++;
+        return -1;
+    }
+
+    if (circular_buffer_push(&handle->queues[tx_class].buffer, packet))
+    {
+        LOG_ERROR("Failed to push packet to TX queue %d", tx_class);
+        return -1;
+    }
+
+    return 0;
+}
+
+bool tx_scheduler_full(tx_scheduler_t *handle, tx_class_e tx_class)
+{
+    if (!handle || tx_class >= TX_CLASS_COUNT)
+    {
+        LOG_ERROR("Invalid parameters for TX scheduler full");
+        return true;
+    }
+
+    return circular_buffer_is_full(&handle->queues[tx_class].buffer);
+}
+
+/**
+ * @brief Number of packets that can still be pushed to a queue
+ */
+size_t tx_scheduler_space(tx_scheduler_t *handle, tx_class_e tx_class)
+{
+    if (!handle || tx_class >= TX_CLASS_COUNT)
+    {
+        LOG_ERROR("Invalid parameters for TX scheduler space");
+        return 0;
+    }
+
+    circular_buffer_t *buffer = &handle->queues[tx_class].buffer;
+    return circular_buffer_capacity(buffer) - circular_buffer_count(buffer);
+}
+
+/**
+ * @brief Checks if any queue has a packet that could be sent right now
+ *
+ * @param handle pointer to TX scheduler handle
+ *
+ * @return true if tx_scheduler_pop would return a packet
+ */
+bool tx_scheduler_pending(tx_scheduler_t *handle)
+{
+    if (!handle)
+    {
+        LOG_ERROR("Handle is NULL");
+        return false;
+    }
+
+    packet_t head;
+    return !circular_buffer_is_empty(&handle->queues[TX_CLASS_CONTROL].buffer) ||
+           !circular_buffer_is_empty(&handle->queues[TX_CLASS_BEACON].buffer) ||
+           _head_eligible(handle, TX_CLASS_RELAY, &head) ||
+           _head_eligible(handle, TX_CLASS_APPLICATION, &head);
+}
+
+/**
+ * @brief Takes the next packet to transmit
+ *
+ * @note Control and beacon queues always go first. Relay and application queues
+ *       then take turns, each turn allowing up to the queue's quantum in bytes.
+ *       A queue whose head isn't eligible gives up its turn and its credit.
+ *
+ * @param handle pointer to TX scheduler handle
+ * @param packet receives the packet to transmit
+ *
+ * @return error code: 0 = successful, -1 = failed (nothing to send)
+ */
+int tx_scheduler_pop(tx_scheduler_t *handle, packet_t *packet)
+{
+    if (!handle || !packet)
+    {
+        LOG_ERROR("Handle or packet is NULL");
+        return -1;
+    }
+
+    for (tx_class_e tx_class = TX_CLASS_CONTROL; tx_class <= TX_CLASS_BEACON; tx_class++)
+    {
+        if (!circular_buffer_is_empty(&handle->queues[tx_class].buffer))
+        {
+            handle->stats.sent[tx_class]++;
+            return circular_buffer_pop(&handle->queues[tx_class].buffer, packet);
+        }
+    }
+
+    packet_t head;
+    if (!_head_eligible(handle, TX_CLASS_RELAY, &head) && !_head_eligible(handle, TX_CLASS_APPLICATION, &head))
+    {
+        return -1;
+    }
+
+    // Terminates since at least one eligible queue gains credit every turn
+    while (true)
+    {
+        tx_queue_t *queue = &handle->queues[handle->drr_current];
+
+        if (_head_eligible(handle, handle->drr_current, &head))
+        {
+            uint32_t cost = _packet_cost(&head);
+            if (cost <= (uint32_t)queue->deficit)
+            {
+                if (circular_buffer_pop(&queue->buffer, packet))
+                {
+                    LOG_ERROR("Failed to pop packet from TX queue %d", handle->drr_current);
+                    return -1;
+                }
+
+                queue->deficit -= cost;
+                if (circular_buffer_is_empty(&queue->buffer))
+                {
+                    queue->deficit = 0;
+                }
+
+                handle->stats.sent[handle->drr_current]++;
+                return 0;
+            }
+        }
+        else
+        {
+            queue->deficit = 0; // Idle queues don't bank credit
+        }
+
+        handle->drr_current = _drr_next(handle->drr_current);
+        handle->queues[handle->drr_current].deficit += handle->queues[handle->drr_current].quantum;
+    }
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static bool _head_eligible(tx_scheduler_t *handle, tx_class_e tx_class, packet_t *head)
+{
+    if (circular_buffer_is_empty(&handle->queues[tx_class].buffer))
+    {
+        return false;
+    }
+
+    circular_buffer_peek(&handle->queues[tx_class].buffer, head);
+
+    if (handle->eligible_callback)
+    {
+        return handle->eligible_callback(head, handle->eligible_ctx);
+    }
+
+    return true;
+}
+
+static tx_class_e _drr_next(tx_class_e tx_class)
+{
+    return (tx_class == TX_CLASS_RELAY) ? TX_CLASS_APPLICATION : TX_CLASS_RELAY;
+}
+
+/**
+ * @brief Airtime cost of a packet in bytes, so round robin is fair in airtime rather than packet count
+ */
+static uint32_t _packet_cost(const packet_t *packet)
+{
+    return PACKET_HEADER_SIZE + packet->content.payload_length;
+}
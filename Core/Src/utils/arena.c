@@ -0,0 +1,90 @@
+/**
+ * @file arena.c
+ *
+ * @author Diamond42474
+ *
+ * Hands out aligned blocks from one region the caller owns, so the
+ * library never touches the heap after initialization.
+ */
+#include "utils/arena.h"
+
+#include <string.h>
+#include "c-logger.h"
+
+/**
+ * @brief Initializes an arena over the given memory
+ *
+ * @note The start is rounded up to ARENA_ALIGNMENT, so up to ARENA_ALIGNMENT - 1
+ *       bytes of the region may go unused.
+ *
+ * @param arena Pointer to the arena
+ * @param memory Region to allocate from, owned by the caller for the arena's lifetime
+ * @param size Size of the region in bytes
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int arena_init(arena_t *arena, void *memory, size_t size)
+{
+    if (!arena || !memory)
+    {
+        LOG_ERROR("Arena or memory is NULL");
+        return -1;
+    }
+
+    uintptr_t start = (uintptr_t)memory;
+    size_t padding = ARENA_ALIGN(start) - start;
+    if (padding > size)
+    {
+        LOG_ERROR("Arena memory is too small to align");
+        return -1;
+    }
+
+    arena->base = (uint8_t *)memory + padding;
+    arena->size = size - padding;
+    arena->used = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Takes a zeroed block from the arena
+ *
+ * @param arena Pointer to the arena
+ * @param size Bytes needed
+ *
+ * @return Pointer to the block, aligned to ARENA_ALIGNMENT, or NULL if the arena is exhausted
+ */
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    if (!arena || !arena->base)
+    {
+        LOG_ERROR("Arena is not initialized");
+        return NULL;
+    }
+
+    size_t aligned = ARENA_ALIGN(size);
+    if (aligned < size || aligned > arena->size - arena->used)
+    {
+        LOG_ERROR("Arena exhausted: %zu bytes requested, %zu left", size, arena->size - arena->used);
+        return NULL;
+    }
+
+    void *block = arena->base + arena->used;
+    arena->used += aligned;
+    memset(block, 0, aligned);
+
+    return block;
+}
+
+/**
+ * @brief Bytes still available in the arena
+ */
+size_t arena_remaining(const arena_t *arena)
+{
+    if (!arena)
+    {
+        return 0;
+    }
+
+    return arena->size - arena->used;
+}
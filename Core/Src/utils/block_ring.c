@@ -0,0 +1,202 @@
+/**
+ * @file block_ring.c
+ *
+ * @author Diamond42474
+ *
+ * Hands blocks of samples from the ADC to the decoder without copying them.
+ * The producer and consumer each own an index, and a block belongs to the
+ * consumer from the moment its length is stored until it is released, so
+ * the two sides can run in different threads or an interrupt without a
+ * lock. The producer side doesn't log, it may be running in an ISR.
+ */
+#include "utils/block_ring.h"
+
+#include "c-logger.h"
+
+/**
+ * @brief Initializes a ring over caller memory, all blocks start free
+ *
+ * @param ring Pointer to the ring
+ * @param buffer Memory for block_count * block_size elements, owned by the caller for the ring's lifetime
+ * @param element_size Size of each element
+ * @param block_size Elements per block, what a single commit can hand over
+ * @param block_count Blocks in the ring, 2 for ping-pong, at most BLOCK_RING_MAX_BLOCKS
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int block_ring_init(block_ring_t *ring, void *buffer, size_t element_size, size_t block_size, size_t block_count)
+{
+    if (!ring || !buffer || element_size == 0 || block_size == 0)
+    {
+        LOG_ERROR("Invalid parameters for block ring init");
+        return -1;
+    }
+
+    if (block_count < 2 || block_count > BLOCK_RING_MAX_BLOCKS)
+    {
+        LOG_ERROR("Block ring needs 2 to %d blocks, got %zu", BLOCK_RING_MAX_BLOCKS, block_count);
+        return -1;
+    }
+
+    ring->buffer = buffer;
+    ring->element_size = element_size;
+    ring->block_size = block_size;
+    ring->block_count = block_count;
+    ring->write_block = 0;
+    ring->read_block = 0;
+    for (size_t i = 0; i < BLOCK_RING_MAX_BLOCKS; i++)
+    {
+        atomic_init(&ring->lengths[i], 0);
+    }
+    atomic_init(&ring->overflows, 0);
+
+    return 0;
+}
+
+/**
+ * @brief Gets the block to fill next, the same one until it is committed
+ *
+ * @param ring Pointer to the ring
+ * @param capacity Set to the elements the block holds
+ *
+ * @return the block, NULL if the consumer hasn't released it yet
+ */
+void *block_ring_acquire(block_ring_t *ring, size_t *capacity)
+{
+    if (!ring || !capacity)
+    {
+        return NULL;
+    }
+
+    size_t block = ring->write_block;
+    if (atomic_load_explicit(&ring->lengths[block], memory_order_acquire) != 0)
+    {
+        return NULL; // Consumer is a whole ring behind, polled producers just try again later
+    }
+
+    *capacity = ring->block_size;
+
+    return (char *)ring->buffer + block * ring->block_size * ring->element_size;
+}
+
+/**
+ * @brief Counts elements the producer had to discard because the ring was full
+ *
+ * @note Only for producers that can't wait, like a capture callback. A failed acquire on its own
+ *       isn't an overflow, a polled producer keeps its samples and tries again.
+ *
+ * @param ring Pointer to the ring
+ * @param count Elements discarded
+ */
+void block_ring_drop(block_ring_t *ring, size_t count)
+{
+    if (!ring)
+    {
+        return;
+    }
+
+    STAT_ADD(ring->overflows, count);
+}
+
+/**
+ * @brief Hands the acquired block to the consumer
+ *
+ * @note Committing 0 elements leaves the block with the producer.
+ *
+ * @param ring Pointer to the ring
+ * @param count Elements written to the block, at most its capacity
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int block_ring_commit(block_ring_t *ring, size_t count)
+{
+    if (!ring || count > ring->block_size)
+    {
+        return -1;
+    }
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    size_t block = ring->write_block;
+    if (atomic_load_explicit(&ring->lengths[block], memory_order_relaxed) != 0)
+    {
+        return -1; // Never acquired
+    }
+
+    // Release so the samples are visible before the consumer sees the length
+    atomic_store_explicit(&ring->lengths[block], count, memory_order_release);
+    ring->write_block = (block + 1) % ring->block_count;
+
+    return 0;
+}
+
+/**
+ * @brief Gets the oldest committed block without taking it off the ring
+ *
+ * @param ring Pointer to the ring
+ * @param count Set to the elements in the block
+ *
+ * @return the block, NULL if nothing has been committed
+ */
+const void *block_ring_peek(block_ring_t *ring, size_t *count)
+{
+    if (!ring || !count)
+    {
+        LOG_ERROR("Ring or count is NULL");
+        return NULL;
+    }
+
+    size_t block = ring->read_block;
+    size_t length = atomic_load_explicit(&ring->lengths[block], memory_order_acquire);
+    if (length == 0)
+    {
+        return NULL;
+    }
+
+    *count = length;
+
+    return (const char *)ring->buffer + block * ring->block_size * ring->element_size;
+}
+
+/**
+ * @brief Gives the oldest committed block back to the producer
+ *
+ * @param ring Pointer to the ring
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int block_ring_release(block_ring_t *ring)
+{
+    if (!ring)
+    {
+        LOG_ERROR("Ring is NULL");
+        return -1;
+    }
+
+    size_t block = ring->read_block;
+    if (atomic_load_explicit(&ring->lengths[block], memory_order_relaxed) == 0)
+    {
+        LOG_ERROR("No block to release");
+        return -1;
+    }
+
+    // Release so we're done reading before the producer can refill it
+    atomic_store_explicit(&ring->lengths[block], 0, memory_order_release);
+    ring->read_block = (block + 1) % ring->block_count;
+
+    return 0;
+}
+
+bool block_ring_is_empty(block_ring_t *ring)
+{
+    if (!ring)
+    {
+        LOG_ERROR("Ring is NULL");
+        return true;
+    }
+
+    return atomic_load_explicit(&ring->lengths[ring->read_block], memory_order_acquire) == 0;
+}
@@ -28,6 +28,7 @@ int circular_buffer_static_init(circular_buffer_t *cb, void *buffer, size_t elem
     cb->head = 0;
     cb->tail = 0;
     cb->full = false;
+    cb->overflows = 0;
     cb->dynamic = false;
     cb->count = 0;
 
@@ -64,6 +65,7 @@ int circular_buffer_dynamic_init(circular_buffer_t *cb, size_t element_size, siz
     cb->head = 0;
     cb->tail = 0;
     cb->full = false;
+    cb->overflows = 0;
     cb->dynamic = true;
     cb->count = 0;
 
@@ -107,6 +109,7 @@ int circular_buffer_push(circular_buffer_t *cb, const void *item)
 
     if (cb->full)
     {
+        STAT_INC(cb->overflows);
         LOG_WARN("Circular buffer is full");
         // TODO: Add an option to prevent overwriting old data and instead return an error code
         return -1;                           // Buffer is full, cannot push new item
@@ -117,10 +120,7 @@ int circular_buffer_push(circular_buffer_t *cb, const void *item)
 
     cb->head = (cb->head + 1) % cb->max;
     cb->full = (cb->head == cb->tail);
-    if (!cb->full)
-    {
-        cb->count++;
-    }
+    cb->count++;
 
     return 0; // Success
 }
@@ -2,6 +2,9 @@
 #include <math.h>
 #include "interface/pconfig.h"
 
+// Faster than 3x the 1200 Hz tone has barely more than a cycle per symbol, too little for the tone filters to tell apart
+static const int rate_multipliers[FSK_RATE_COUNT] = {1, 2, 3};
+
 /**
  * @brief Calculate the recommended sample rate for FSK modulation based on the given frequencies and baud rate.
  *
@@ -22,3 +25,53 @@ int calculate_sample_rate(double f1, double f2, double baud)
 
     return (int)(baud * N * OVERSAMPLING_FACTOR);
 }
+
+/**
+ * @brief Symbol rate of a frame sent at the given rate
+ *
+ * @param base_baud_rate The configured base rate the sync word is sent at
+ * @param rate The rate
+ *
+ * @return The baud rate (symbols per second)
+ */
+int fsk_rate_baud(int base_baud_rate, fsk_rate_e rate)
+{
+    return base_baud_rate * rate_multipliers[rate];
+}
+
+/**
+ * @brief Builds the rate byte sent after the sync word
+ *
+ * @note The rate goes in the low nibble and its complement in the high nibble,
+ *       so a corrupted rate byte is rejected instead of switching to the wrong rate.
+ *
+ * @param rate The rate the rest of the frame is sent at
+ *
+ * @return The rate byte
+ */
+uint8_t fsk_rate_encode(fsk_rate_e rate)
+{
+    return (uint8_t)((~rate & 0x0F) << 4 | (rate & 0x0F));
+}
+
+/**
+ * @brief Parses a rate byte
+ *
+ * @param byte The received rate byte
+ * @param rate Receives the rate
+ *
+ * @return error code: 0 = success, -1 = failure (corrupted or unknown rate)
+ */
+int fsk_rate_decode(uint8_t byte, fsk_rate_e *rate)
+{
+    uint8_t value = byte & 0x0F;
+
+    if ((byte >> 4) != (~value & 0x0F) || value >= FSK_RATE_COUNT)
+    {
+        return -1;
+    }
+
+    *rate = (fsk_rate_e)value;
+
+    return 0;
+}
@@ -76,4 +76,11 @@ int goertzel_compute_power_circular_buff(const circular_buffer_t *cb, int num_sa
     *power = s_prev2 * s_prev2 + s_prev * s_prev - coeff * s_prev * s_prev2;
 
     return 0;
-}
\ No newline at end of file
+}
+
+void goertzel_init(goertzel_t *g, float target_freq, float sample_rate)
+{
+    g->coeff = 2.0f * cosf(2.0f * (float)M_PI * target_freq / sample_rate);
+    g->s1 = 0.0f;
+    g->s2 = 0.0f;
+}
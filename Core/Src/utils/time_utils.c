@@ -33,4 +33,15 @@ bool time_utils_done(HAL_timer_t *timer)
 void time_utils_reset(HAL_timer_t *timer)
 {
     timer->finish_time_us = time_bsp_get_us() + timer->duration_us;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Changes the duration used from the next reset on, the running period is left as is.
+ *
+ * @param timer Pointer to the timer to change.
+ * @param duration_us New duration of the timer in microseconds.
+ */
+void time_utils_set_duration(HAL_timer_t *timer, uint64_t duration_us)
+{
+    timer->duration_us = duration_us;
+}
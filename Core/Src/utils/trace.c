@@ -0,0 +1,167 @@
+/**
+ * @file trace.c
+ *
+ * @author Diamond42474
+ *
+ * Timestamps received frames at each pipeline boundary into a fixed-size
+ * ring, and dumps the ring as Chrome trace JSON (chrome://tracing, Perfetto).
+ * Each frame shows up as an async slice from its sync word to its delivery,
+ * with the stages in between as instant marks.
+ */
+#include "utils/trace.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#if pconfigTRACE_ENABLED
+
+static trace_event_t trace_ring[pconfigTRACE_BUFFER_SIZE];
+static size_t trace_head;  // Next slot to write
+static size_t trace_count; // Valid events, oldest ones are overwritten once full
+static uint32_t trace_next_frame = 1;
+static trace_clock_t trace_clock; // NULL until trace_set_clock, events are stamped 0
+
+static const char *const stage_names[TRACE_STAGE_COUNT] = {
+    "sync detected",
+    "header parsed",
+    "crc validated",
+    "queued",
+    "delivered",
+};
+
+/**
+ * @brief Gives a frame its trace id and stamps its sync word
+ *
+ * @param frame Where the frame carries its id, normally the packet's metadata
+ */
+void trace_frame_start(uint32_t *frame)
+{
+    *frame = trace_next_frame++;
+    if (trace_next_frame == 0)
+    {
+        trace_next_frame = 1;
+    }
+
+    trace_record(TRACE_STAGE_SYNC_DETECTED, *frame);
+}
+
+/**
+ * @brief Stamps a frame at a pipeline stage
+ *
+ * @note Not safe against concurrent writers, every stage runs from pc_task.
+ *
+ * @param stage The stage the frame just passed
+ * @param frame The frame's trace id, 0 (locally built packets) is ignored
+ */
+void trace_record(trace_stage_e stage, uint32_t frame)
+{
+    if (frame == 0)
+    {
+        return;
+    }
+
+    trace_ring[trace_head] = (trace_event_t){
+        .timestamp_us = trace_clock ? trace_clock() : 0,
+        .frame = frame,
+        .stage = (uint8_t)stage,
+    };
+    trace_head = (trace_head + 1) % pconfigTRACE_BUFFER_SIZE;
+    if (trace_count < pconfigTRACE_BUFFER_SIZE)
+    {
+        trace_count++;
+    }
+}
+
+#endif // pconfigTRACE_ENABLED
+
+/**
+ * @brief Sets where event timestamps come from
+ *
+ * @note Kept out of trace_record so the traced decoder sources link without a time BSP,
+ *       tools driving the decoder directly can leave it unset or pass their own clock.
+ *
+ * @param clock Returns microseconds, NULL stamps every event 0
+ */
+void trace_set_clock(trace_clock_t clock)
+{
+#if pconfigTRACE_ENABLED
+    trace_clock = clock;
+#else
+    (void)clock;
+#endif
+}
+
+// snprintf into what's left of the buffer, tracking the full length like snprintf does
+static void _append(char *buffer, size_t size, size_t *length, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    size_t offset = *length < size ? *length : size;
+    int written = vsnprintf(buffer ? buffer + offset : NULL, buffer ? size - offset : 0, format, args);
+    va_end(args);
+
+    if (written > 0)
+    {
+        *length += (size_t)written;
+    }
+}
+
+/**
+ * @brief Writes the trace ring, oldest event first, as Chrome trace JSON
+ *
+ * @note Like snprintf, the return value is the full length even if the buffer was too small,
+ *       so trace_dump_chrome_json(NULL, 0) + 1 is the size to allocate.
+ *
+ * @param buffer Where to write the JSON, NUL terminated if size > 0. May be NULL when size is 0
+ * @param size Size of buffer in bytes
+ *
+ * @return Length of the JSON, not counting the terminator
+ */
+size_t trace_dump_chrome_json(char *buffer, size_t size)
+{
+    size_t length = 0;
+
+    _append(buffer, size, &length, "{\"traceEvents\":[");
+
+#if pconfigTRACE_ENABLED
+    size_t oldest = (trace_head + pconfigTRACE_BUFFER_SIZE - trace_count) % pconfigTRACE_BUFFER_SIZE;
+    for (size_t i = 0; i < trace_count; i++)
+    {
+        const trace_event_t *event = &trace_ring[(oldest + i) % pconfigTRACE_BUFFER_SIZE];
+
+        // Async begin/end around the frame, instant marks for the stages in between
+        char phase = 'n';
+        if (event->stage == TRACE_STAGE_SYNC_DETECTED)
+        {
+            phase = 'b';
+        }
+        else if (event->stage == TRACE_STAGE_DELIVERED)
+        {
+            phase = 'e';
+        }
+
+        _append(buffer, size, &length,
+                "%s{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"%c\",\"id\":%lu,\"ts\":%llu,\"pid\":0,\"tid\":0}",
+                i ? "," : "",
+                phase == 'n' ? stage_names[event->stage] : "frame",
+                phase,
+                (unsigned long)event->frame,
+                (unsigned long long)event->timestamp_us);
+    }
+#endif
+
+    _append(buffer, size, &length, "],\"displayTimeUnit\":\"ms\"}");
+
+    return length;
+}
+
+/**
+ * @brief Drops every recorded event
+ */
+void trace_clear(void)
+{
+#if pconfigTRACE_ENABLED
+    trace_head = 0;
+    trace_count = 0;
+#endif
+}
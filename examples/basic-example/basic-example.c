@@ -13,7 +13,7 @@ void message_callback(const uint8_t *data, size_t len, uint8_t src_addr)
 
 int main()
 {
-    pc_handle_t *handle = pc_init(message_callback);
+    pc_handle_t *handle = pc_init(NULL, message_callback, NULL, 0); // Default profile from pconfig.h, state allocated once from the heap
     if (!handle)
     {
         return -1;
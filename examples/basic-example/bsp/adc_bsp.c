@@ -1,6 +1,6 @@
 #include "adc_bsp.h"
 
-int adc_bsp_init(int sample_rate)
+int adc_bsp_init(int sample_rate, block_ring_t *ring)
 {
     return 0;
 }
@@ -15,7 +15,7 @@ bool adc_bsp_data_available()
     return false;
 }
 
-int adc_bsp_get_data(circular_buffer_t *buffer)
+int adc_bsp_get_data(block_ring_t *ring)
 {
     return 0;
 }
\ No newline at end of file
@@ -76,8 +76,9 @@ int main(void)
     fsk_decoder_init(&fsk_decoder);
     fsk_decoder_set_symbol_sample_size(&fsk_decoder, samples_per_bit, 3); // Buffer for 3 symbols to allow for timing recovery
     fsk_decoder_set_sample_rate(&fsk_decoder, sample_rate);
+    fsk_decoder_set_sample_format(&fsk_decoder, PC_SAMPLE_FORMAT_U16);
     fsk_decoder_set_frequencies(&fsk_decoder, FQ0, FQ1);
-    fsk_decoder_set_power_threshold(&fsk_decoder, 1E13f);
+    fsk_decoder_set_power_threshold(&fsk_decoder, pconfigFSK_POWER_THRESHOLD); // Noise is kept out by the squelch, this only has to tell the tones apart
     // Initialize Byte Assembler
     byte_assembler_init(&byte_assembler);
     if (byte_assembler_set_preamble(&byte_assembler, 0xABBA))
@@ -87,8 +88,15 @@ int main(void)
         return ret;
     } // Buffer for 256 bytes
 
-    // Initialize Decoder
+    // Initialize Decoder, its input holds 3 symbols per block like the FSK decoder's window
+    uint16_t input_samples[samples_per_bit * 3 * pconfigDECODER_INPUT_BLOCKS];
     decoder_init(&decoder);
+    if (decoder_set_input_buffer(&decoder, input_samples, sizeof(input_samples) / sizeof(input_samples[0])))
+    {
+        LOG_ERROR("Failed to set decoder input buffer");
+        ret = -1;
+        return ret;
+    }
     decoder_set_bit_decoder(&decoder, BIT_DECODER_FSK, &fsk_decoder);
     decoder_set_byte_decoder(&decoder, BYTE_DECODER_BIT_STUFFING, &byte_assembler);
 
@@ -135,7 +143,7 @@ int main(void)
     }
 
     LOG_INFO("===== Sending test signal (0xABBA) using FSK modulation =====");
-    LOG_INFO("Current samples in buffer: %d", circular_buffer_count(&decoder.input_buffer));
+    LOG_INFO("Samples left in input: %s", block_ring_is_empty(&decoder.input_ring) ? "no" : "yes");
     send_byte(&decoder, 0xAB, samples_per_bit, sample_rate);
     send_byte(&decoder, 0xBA, samples_per_bit, sample_rate);
     // send_byte(&decoder, 0x03, samples_per_bit, sample_rate);
@@ -0,0 +1,593 @@
+/**
+ * @file audio.c
+ *
+ * @author Diamond42474
+ *
+ * Sound card engine for the Linux gateway. Tone and PTT changes from the
+ * modem are queued with the sample they happen at and rendered from that
+ * queue, in real time a period behind the clock so a late thread can't
+ * shorten or stretch a symbol, offline in step with the samples read. The
+ * serial PTT line drops only once the last rendered symbol has played out.
+ */
+#include "audio.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+
+#include "c-logger.h"
+#include "pcm.h"
+
+#define AUDIO_TX_AMPLITUDE (0.5f * 32767.0f) // Half scale, leaves the radio's mic input headroom
+#define AUDIO_EVENT_COUNT (256)              // Tone and PTT changes waiting to be rendered
+#define AUDIO_PREFILL_PERIODS (2)            // Silence queued on the playback device before the first period
+
+typedef struct
+{
+    uint64_t sample; // Sample the change takes effect at
+    float tone;      // Tone from here on, 0 = silent
+    int ptt;         // 1 = key, 0 = unkey, -1 = unchanged
+} audio_event_t;
+
+typedef struct
+{
+    audio_config_t config;
+    bool realtime;
+    bool started;
+    int sample_rate;
+    block_ring_t *ring;
+
+    pcm_t capture;
+    pcm_t playback;
+    bool has_capture;
+    bool has_playback;
+    int ptt_fd;
+
+    // Single producer (the modem's thread), single consumer (the renderer)
+    audio_event_t events[AUDIO_EVENT_COUNT];
+    atomic_size_t event_head;
+    atomic_size_t event_tail;
+    float tone; // Last tone the modem set, for PTT-only events
+
+    // Renderer state, owned by the playback thread in real time and the modem's thread offline
+    float phase;
+    float rendered_tone;
+    bool rendered_keyed;
+    uint64_t rendered;      // Samples rendered so far
+    uint64_t unkey_at;      // Sample the PTT line drops at, once the audio before it has played
+    bool unkey_pending;
+    uint64_t output_delay;  // Samples between rendering and the radio hearing them
+
+    atomic_bool keyed;
+    atomic_bool running;
+    atomic_bool capture_done;
+    uint64_t samples;  // Offline clock, samples read
+    uint64_t start_us; // Real time clock at audio_start
+
+    int16_t *capture_frames;
+    int16_t *playback_frames;
+    pthread_t capture_thread;
+    pthread_t playback_thread;
+    bool capture_thread_running;
+    bool playback_thread_running;
+} audio_t;
+
+static audio_t audio = {.ptt_fd = -1};
+
+static uint64_t _monotonic_us(void);
+static uint64_t _now_sample(void);
+static bool _renders(void);
+static int _queue_event(float tone, int ptt);
+static void _render(int16_t *frames, size_t count);
+static int _commit(block_ring_t *ring, const int16_t *frames, size_t count);
+static int _set_rts(bool active);
+static void *_capture_task(void *arg);
+static void *_playback_task(void *arg);
+
+/**
+ * @brief Picks real time or offline from the devices and opens the PTT port
+ *
+ * @param config Devices to use, the strings must outlive the gateway
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int audio_configure(const audio_config_t *config)
+{
+    if (!config || config->period_frames == 0)
+    {
+        LOG_ERROR("Invalid audio config");
+        return -1;
+    }
+
+    audio.config = *config;
+
+    bool capture_alsa = config->capture && pcm_backend_for(config->capture) == PCM_BACKEND_ALSA;
+    bool playback_alsa = config->playback && pcm_backend_for(config->playback) == PCM_BACKEND_ALSA;
+    if (playback_alsa && config->capture && !capture_alsa)
+    {
+        LOG_ERROR("Playing to a sound card while capturing from a file mixes two clocks");
+        return -1;
+    }
+    audio.realtime = capture_alsa || playback_alsa;
+
+    if (config->ptt)
+    {
+        audio.ptt_fd = open(config->ptt, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (audio.ptt_fd < 0)
+        {
+            LOG_ERROR("Failed to open PTT port %s", config->ptt);
+            return -1;
+        }
+        if (_set_rts(false))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Opens the devices and, in real time, starts the capture and playback threads
+ *
+ * @param sample_rate Modem sample rate in Hz
+ * @param ring Decoder input the capture side fills
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int audio_start(int sample_rate, block_ring_t *ring)
+{
+    if (sample_rate <= 0 || !ring)
+    {
+        LOG_ERROR("Invalid parameters for audio start");
+        return -1;
+    }
+
+    if (audio.started)
+    {
+        LOG_ERROR("Audio is already running");
+        return -1;
+    }
+
+    audio.sample_rate = sample_rate;
+    audio.ring = ring;
+    audio.samples = 0;
+    audio.rendered = 0;
+    audio.output_delay = 0;
+    atomic_store(&audio.event_head, 0);
+    atomic_store(&audio.event_tail, 0);
+    atomic_store(&audio.capture_done, audio.config.capture == NULL);
+
+    size_t period = audio.config.period_frames;
+    audio.capture_frames = calloc(period, sizeof(int16_t));
+    audio.playback_frames = calloc(period, sizeof(int16_t));
+    if (!audio.capture_frames || !audio.playback_frames)
+    {
+        LOG_ERROR("Failed to allocate audio buffers");
+        return -1;
+    }
+
+    if (audio.config.capture)
+    {
+        if (pcm_open(&audio.capture, audio.config.capture, true, sample_rate, period))
+        {
+            return -1;
+        }
+        audio.has_capture = true;
+    }
+    if (audio.config.playback)
+    {
+        if (pcm_open(&audio.playback, audio.config.playback, false, sample_rate, period))
+        {
+            return -1;
+        }
+        audio.has_playback = true;
+        if (audio.playback.backend == PCM_BACKEND_ALSA)
+        {
+            audio.output_delay = (AUDIO_PREFILL_PERIODS + 1) * period;
+        }
+    }
+
+    audio.start_us = _monotonic_us();
+    atomic_store(&audio.running, true);
+    audio.started = true;
+
+    if (!audio.realtime)
+    {
+        return 0;
+    }
+
+    if (audio.has_capture)
+    {
+        if (pthread_create(&audio.capture_thread, NULL, _capture_task, NULL))
+        {
+            LOG_ERROR("Failed to start capture thread");
+            return -1;
+        }
+        audio.capture_thread_running = true;
+    }
+    if (audio.has_playback)
+    {
+        if (pthread_create(&audio.playback_thread, NULL, _playback_task, NULL))
+        {
+            LOG_ERROR("Failed to start playback thread");
+            return -1;
+        }
+        audio.playback_thread_running = true;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stops the threads, unkeys the radio and closes the devices
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int audio_stop(void)
+{
+    int ret = 0;
+
+    atomic_store(&audio.running, false);
+    if (audio.capture_thread_running)
+    {
+        pthread_join(audio.capture_thread, NULL);
+        audio.capture_thread_running = false;
+    }
+    if (audio.playback_thread_running)
+    {
+        pthread_join(audio.playback_thread, NULL);
+        audio.playback_thread_running = false;
+    }
+
+    if (audio.ptt_fd >= 0)
+    {
+        _set_rts(false);
+        close(audio.ptt_fd);
+        audio.ptt_fd = -1;
+    }
+
+    if (audio.has_capture && pcm_close(&audio.capture))
+    {
+        ret = -1;
+    }
+    if (audio.has_playback && pcm_close(&audio.playback))
+    {
+        ret = -1;
+    }
+    audio.has_capture = false;
+    audio.has_playback = false;
+
+    free(audio.capture_frames);
+    free(audio.playback_frames);
+    audio.capture_frames = NULL;
+    audio.playback_frames = NULL;
+    audio.started = false;
+
+    return ret;
+}
+
+bool audio_realtime(void)
+{
+    return audio.realtime;
+}
+
+bool audio_capture_done(void)
+{
+    return atomic_load(&audio.capture_done);
+}
+
+bool audio_keyed(void)
+{
+    return atomic_load(&audio.keyed);
+}
+
+uint64_t audio_now_us(void)
+{
+    if (audio.realtime)
+    {
+        return _monotonic_us();
+    }
+
+    return audio.sample_rate ? audio.samples * 1000000ULL / (uint64_t)audio.sample_rate : 0;
+}
+
+/**
+ * @brief Reads the next samples offline and renders the output that goes with them
+ *
+ * @note While keyed a single sample is read per call, so each symbol starts on the sample the
+ * modem asked for. Otherwise a whole period is read at once.
+ *
+ * @param ring Decoder input ring
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int audio_poll(block_ring_t *ring)
+{
+    if (!audio.started || audio.realtime)
+    {
+        return 0;
+    }
+
+    size_t capacity;
+    uint16_t *block = block_ring_acquire(ring, &capacity);
+    if (!block)
+    {
+        return 0; // Decoder hasn't caught up, the clock waits for it
+    }
+
+    size_t count = audio_keyed() ? 1 : audio.config.period_frames;
+    if (count > capacity)
+    {
+        count = capacity;
+    }
+
+    // Once the file runs out the decoder gets silence, so the last frame still makes it through
+    size_t read = 0;
+    if (!audio_capture_done())
+    {
+        int result = pcm_read(&audio.capture, audio.capture_frames, count);
+        if (result < 0)
+        {
+            return -1;
+        }
+        read = (size_t)result;
+        if (read < count)
+        {
+            atomic_store(&audio.capture_done, true);
+        }
+    }
+    memset(&audio.capture_frames[read], 0, (count - read) * sizeof(int16_t));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        block[i] = (uint16_t)audio.capture_frames[i]; // The decoder takes S16 as is, see linux-gateway.c
+    }
+    if (block_ring_commit(ring, count))
+    {
+        LOG_ERROR("Failed to commit samples");
+        return -1;
+    }
+
+    _render(audio.playback_frames, count);
+    if (audio.has_playback && pcm_write(&audio.playback, audio.playback_frames, count))
+    {
+        return -1;
+    }
+    audio.samples += count;
+
+    return 0;
+}
+
+int audio_set_tone(float frequency)
+{
+    audio.tone = frequency;
+
+    return _queue_event(frequency, -1);
+}
+
+int audio_set_ptt(bool active)
+{
+    atomic_store(&audio.keyed, active);
+
+    if (!_renders())
+    {
+        return _set_rts(active); // Nothing is being played, so there is nothing to wait for
+    }
+
+    return _queue_event(audio.tone, active ? 1 : 0);
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static uint64_t _monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static uint64_t _now_sample(void)
+{
+    if (!audio.realtime)
+    {
+        return audio.samples;
+    }
+
+    return (_monotonic_us() - audio.start_us) * (uint64_t)audio.sample_rate / 1000000ULL;
+}
+
+// Offline always renders, even without an output, so PTT events are still played out
+static bool _renders(void)
+{
+    return audio.started && (!audio.realtime || audio.has_playback);
+}
+
+static int _queue_event(float tone, int ptt)
+{
+    if (!_renders())
+    {
+        return 0;
+    }
+
+    size_t head = atomic_load_explicit(&audio.event_head, memory_order_relaxed);
+    size_t next = (head + 1) % AUDIO_EVENT_COUNT;
+    if (next == atomic_load_explicit(&audio.event_tail, memory_order_acquire))
+    {
+        LOG_WARN("Tone queue full, playback has stalled");
+        return -1;
+    }
+
+    audio.events[head] = (audio_event_t){
+        .sample = _now_sample(),
+        .tone = tone,
+        .ptt = ptt,
+    };
+    atomic_store_explicit(&audio.event_head, next, memory_order_release);
+
+    return 0;
+}
+
+static void _render(int16_t *frames, size_t count)
+{
+    float step = 2.0f * (float)M_PI / (float)audio.sample_rate;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t sample = audio.rendered + i;
+
+        size_t tail = atomic_load_explicit(&audio.event_tail, memory_order_relaxed);
+        while (tail != atomic_load_explicit(&audio.event_head, memory_order_acquire) && audio.events[tail].sample <= sample)
+        {
+            const audio_event_t *event = &audio.events[tail];
+            audio.rendered_tone = event->tone;
+            if (event->ptt == 1)
+            {
+                audio.rendered_keyed = true;
+                audio.unkey_pending = false;
+                _set_rts(true);
+            }
+            else if (event->ptt == 0)
+            {
+                audio.rendered_keyed = false;
+                audio.unkey_pending = true;
+                audio.unkey_at = sample + audio.output_delay;
+            }
+
+            tail = (tail + 1) % AUDIO_EVENT_COUNT;
+            atomic_store_explicit(&audio.event_tail, tail, memory_order_release);
+        }
+
+        if (audio.rendered_keyed && audio.rendered_tone > 0.0f)
+        {
+            frames[i] = (int16_t)lrintf(AUDIO_TX_AMPLITUDE * sinf(audio.phase));
+            audio.phase += step * audio.rendered_tone;
+            if (audio.phase >= 2.0f * (float)M_PI)
+            {
+                audio.phase -= 2.0f * (float)M_PI;
+            }
+        }
+        else
+        {
+            frames[i] = 0;
+        }
+    }
+
+    audio.rendered += count;
+    if (audio.unkey_pending && audio.rendered >= audio.unkey_at)
+    {
+        audio.unkey_pending = false;
+        _set_rts(false);
+    }
+}
+
+// Hands samples to the decoder, whatever doesn't fit is dropped and counted as an overflow
+static int _commit(block_ring_t *ring, const int16_t *frames, size_t count)
+{
+    size_t done = 0;
+    while (done < count)
+    {
+        size_t capacity;
+        uint16_t *block = block_ring_acquire(ring, &capacity);
+        if (!block)
+        {
+            block_ring_drop(ring, count - done); // The capture device won't wait for the decoder
+            return -1;
+        }
+
+        size_t length = count - done < capacity ? count - done : capacity;
+        for (size_t i = 0; i < length; i++)
+        {
+            block[i] = (uint16_t)frames[done + i];
+        }
+        block_ring_commit(ring, length);
+        done += length;
+    }
+
+    return 0;
+}
+
+static int _set_rts(bool active)
+{
+    if (audio.ptt_fd < 0)
+    {
+        return 0;
+    }
+
+    int bits = TIOCM_RTS;
+    if (ioctl(audio.ptt_fd, active ? TIOCMBIS : TIOCMBIC, &bits))
+    {
+        LOG_ERROR("Failed to %s PTT", active ? "key" : "unkey");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void *_capture_task(void *arg)
+{
+    (void)arg;
+
+    while (atomic_load(&audio.running))
+    {
+        int read = pcm_read(&audio.capture, audio.capture_frames, audio.config.period_frames);
+        if (read <= 0)
+        {
+            atomic_store(&audio.capture_done, true);
+            break;
+        }
+
+        _commit(audio.ring, audio.capture_frames, (size_t)read);
+    }
+
+    return NULL;
+}
+
+static void *_playback_task(void *arg)
+{
+    (void)arg;
+
+    size_t period = audio.config.period_frames;
+    if (audio.playback.backend == PCM_BACKEND_ALSA)
+    {
+        memset(audio.playback_frames, 0, period * sizeof(int16_t));
+        for (int i = 0; i < AUDIO_PREFILL_PERIODS; i++)
+        {
+            pcm_write(&audio.playback, audio.playback_frames, period);
+        }
+    }
+
+    while (atomic_load(&audio.running))
+    {
+        // Render a period only once the clock has passed it, every change in it is queued by then
+        uint64_t end = audio.rendered + period;
+        uint64_t now = _now_sample();
+        if (now < end)
+        {
+            uint64_t wait_us = (end - now) * 1000000ULL / (uint64_t)audio.sample_rate;
+            struct timespec ts = {
+                .tv_sec = (time_t)(wait_us / 1000000ULL),
+                .tv_nsec = (long)(wait_us % 1000000ULL) * 1000L,
+            };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        _render(audio.playback_frames, period);
+        if (pcm_write(&audio.playback, audio.playback_frames, period))
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
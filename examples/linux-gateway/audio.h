@@ -0,0 +1,42 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utils/block_ring.h"
+
+// The gateway's sound card, behind the library's ADC, DAC, PTT and time BSPs.
+//
+// With an ALSA device the gateway runs in real time: a capture thread reads periods from the
+// card into the decoder's input ring, a playback thread renders the TX tones a period behind
+// the clock and writes them out, and time is CLOCK_MONOTONIC. Without one it runs offline:
+// samples are pulled from the file in adc_bsp_get_data, the output is rendered in step with
+// them and time is the number of samples read, so a recording decodes as fast as the CPU
+// allows and a transmission renders with exact symbol timing.
+
+typedef struct
+{
+    const char *capture;  // ALSA device or file to receive from, NULL = silence
+    const char *playback; // ALSA device or file to transmit to, NULL = discard
+    const char *ptt;      // Serial port keyed through RTS, NULL = VOX
+    size_t period_frames; // Frames per sound card transfer
+} audio_config_t;
+
+int audio_configure(const audio_config_t *config); // Before pc_init
+int audio_start(int sample_rate, block_ring_t *ring);
+int audio_stop(void);
+
+bool audio_realtime(void);
+bool audio_capture_done(void); // The capture file has run out, silence follows
+bool audio_keyed(void);
+uint64_t audio_now_us(void);
+
+// Offline only, pulls the next samples into the ring
+int audio_poll(block_ring_t *ring);
+
+// From the DAC and PTT BSPs, take effect at the current sample
+int audio_set_tone(float frequency);
+int audio_set_ptt(bool active);
+
+#endif // AUDIO_H
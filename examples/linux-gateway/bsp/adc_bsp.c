@@ -0,0 +1,25 @@
+#include "adc_bsp.h"
+
+#include "../audio.h"
+
+// In real time the capture thread fills the ring on its own, offline it's pulled a period at a time
+
+int adc_bsp_init(int sample_rate, block_ring_t *ring)
+{
+    return audio_start(sample_rate, ring);
+}
+
+int adc_bsp_task()
+{
+    return 0;
+}
+
+bool adc_bsp_data_available()
+{
+    return !audio_realtime();
+}
+
+int adc_bsp_get_data(block_ring_t *ring)
+{
+    return audio_poll(ring);
+}
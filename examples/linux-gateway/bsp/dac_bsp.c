@@ -0,0 +1,20 @@
+#include "dac_bsp.h"
+
+#include "../audio.h"
+
+// Tones are rendered by the audio engine, which opens the output with the capture in adc_bsp_init
+
+int dac_bsp_init()
+{
+    return 0;
+}
+
+int dac_bsp_task()
+{
+    return 0;
+}
+
+int dac_bsp_set_tone(float frequency)
+{
+    return audio_set_tone(frequency);
+}
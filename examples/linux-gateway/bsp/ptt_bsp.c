@@ -0,0 +1,20 @@
+#include "ptt_bsp.h"
+
+#include "../audio.h"
+
+// The serial port is opened by audio_configure, the line follows the rendered audio
+
+int ptt_bsp_init()
+{
+    return 0;
+}
+
+int ptt_bsp_task()
+{
+    return 0;
+}
+
+int ptt_bsp_set_ptt(bool active)
+{
+    return audio_set_ptt(active);
+}
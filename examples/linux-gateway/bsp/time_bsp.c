@@ -0,0 +1,20 @@
+#include "time_bsp.h"
+
+#include "../audio.h"
+
+// CLOCK_MONOTONIC in real time, the count of samples read offline
+
+int time_bsp_init()
+{
+    return 0;
+}
+
+uint64_t time_bsp_get_ms()
+{
+    return audio_now_us() / 1000ULL;
+}
+
+uint64_t time_bsp_get_us()
+{
+    return audio_now_us();
+}
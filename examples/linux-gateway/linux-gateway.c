@@ -0,0 +1,308 @@
+/**
+ * @file linux-gateway.c
+ *
+ * @author Diamond42474
+ *
+ * Runs a node on a Linux host through a USB sound card, or offline through
+ * WAV files. Received messages are printed to stdout, lines typed on stdin
+ * are sent. Offline, a transmission can be rendered to a WAV with --send
+ * and decoded again by pointing --capture at it.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <getopt.h>
+
+#include "peregrine-constellation.h"
+#include "pconfig.h"
+#include "c-logger.h"
+#include "audio.h"
+#include "pcm.h"
+
+#define GATEWAY_LINE_SIZE (pconfigMAX_MESSAGE_SIZE + 2) // Message plus the newline and terminator
+#define GATEWAY_TAIL_US (1000000ULL)                     // Offline, silence decoded after the capture ends
+#define GATEWAY_OFFLINE_DURATION_S (10)                  // Offline without a capture, how long to render
+#define GATEWAY_IDLE_SLEEP_US (1000)                     // Real time, pause between pc_task calls while unkeyed
+
+typedef struct
+{
+    audio_config_t audio;
+    uint8_t address;
+    uint8_t destination;
+    const char *send;
+    float send_at_s;
+    int duration_s;
+    log_level_e log_level;
+} gateway_options_t;
+
+static volatile sig_atomic_t stopping;
+
+static void _usage(const char *name);
+static int _parse_options(int argc, char **argv, gateway_options_t *options);
+static void _message_callback(const uint8_t *data, size_t len, uint8_t src_addr);
+static void _stop(int signal);
+static int _send(pc_handle_t *handle, const gateway_options_t *options, const char *text);
+static int _read_stdin(pc_handle_t *handle, const gateway_options_t *options);
+
+int main(int argc, char **argv)
+{
+    gateway_options_t options = {
+        .audio = {
+            .capture = pcm_alsa_available() ? "default" : NULL,
+            .playback = pcm_alsa_available() ? "default" : NULL,
+            .period_frames = 256,
+        },
+        .address = pconfigDEVICE_ADDRESS,
+        .destination = pconfigBROADCAST_ADDRESS,
+        .log_level = LOG_LEVEL_WARN,
+    };
+
+    if (_parse_options(argc, argv, &options))
+    {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    log_init(options.log_level);
+
+    if (audio_configure(&options.audio))
+    {
+        return 1;
+    }
+
+    pc_config_t config;
+    pc_default_config(&config);
+    config.device_address = options.address;
+    config.sample_format = PC_SAMPLE_FORMAT_S16; // Sound card samples keep their full 16 bits
+
+    pc_handle_t *handle = pc_init(&config, _message_callback, NULL, 0);
+    if (!handle)
+    {
+        audio_stop();
+        return 1;
+    }
+
+    signal(SIGINT, _stop);
+    signal(SIGTERM, _stop);
+
+    bool realtime = audio_realtime();
+    bool read_stdin = realtime && !(options.audio.capture && strcmp(options.audio.capture, "-") == 0);
+    if (!realtime && !options.audio.capture && options.duration_s == 0)
+    {
+        options.duration_s = GATEWAY_OFFLINE_DURATION_S;
+    }
+
+    uint64_t end_us = (uint64_t)options.duration_s * 1000000ULL;
+    uint64_t send_at_us = audio_now_us() + (uint64_t)(options.send_at_s * 1000000.0f);
+    uint64_t tail_end_us = 0;
+    while (!stopping)
+    {
+        pc_task(handle);
+
+        uint64_t now_us = audio_now_us();
+        if (options.send && now_us >= send_at_us)
+        {
+            _send(handle, &options, options.send);
+            options.send = NULL;
+        }
+        if (end_us && now_us >= end_us && !audio_keyed())
+        {
+            break;
+        }
+
+        if (!realtime)
+        {
+            // A file capture ends a little after the file does, once the last frame has decoded
+            if (options.audio.capture && options.duration_s == 0 && audio_capture_done())
+            {
+                if (tail_end_us == 0)
+                {
+                    tail_end_us = now_us + GATEWAY_TAIL_US;
+                }
+                else if (now_us >= tail_end_us && !audio_keyed())
+                {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        if (read_stdin && _read_stdin(handle, &options))
+        {
+            read_stdin = false; // Closed, keep receiving
+        }
+
+        // Keyed, every call may start the next symbol, so keep up with the clock
+        if (!audio_keyed())
+        {
+            usleep(GATEWAY_IDLE_SLEEP_US);
+        }
+    }
+
+    pc_stats_t stats;
+    if (pc_get_stats(handle, &stats) == PC_SUCCESS)
+    {
+        fprintf(stderr, "%u samples (%u idle), %u frames received, %u CRC failures, %u frames sent, %u overflows\n",
+                stats.samples_processed, stats.samples_idle, stats.frames_crc_passed, stats.frames_crc_failed,
+                stats.frames_sent, stats.buffer_overflows);
+    }
+    pc_deinit(handle);
+
+    return audio_stop() ? 1 : 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --capture DEV     ALSA device, .wav, raw S16_LE file, - for stdin or none (default: %s)\n"
+            "  --playback DEV    ALSA device, .wav, raw S16_LE file, - for stdout or none (default: %s)\n"
+            "  --ptt TTY         serial port keyed through RTS (default: none, VOX)\n"
+            "  --period N        frames per sound card transfer (default 256)\n"
+            "  --address N       this node's address (default %d)\n"
+            "  --dest N          address messages are sent to (default %d, broadcast)\n"
+            "  --send TEXT       send a message at startup\n"
+            "  --at S            send it S seconds after startup instead, clear of the first route advert\n"
+            "  --duration S      stop after S seconds, offline these are seconds of audio\n"
+            "  --verbose         library info messages, twice for debug\n"
+            "Without an ALSA device the gateway runs offline, as fast as it can, on the samples' clock.\n",
+            name, pcm_alsa_available() ? "default" : "none", pcm_alsa_available() ? "default" : "none",
+            pconfigDEVICE_ADDRESS, pconfigBROADCAST_ADDRESS);
+}
+
+static int _parse_options(int argc, char **argv, gateway_options_t *options)
+{
+    static const struct option long_options[] = {
+        {"capture", required_argument, NULL, 'c'},
+        {"playback", required_argument, NULL, 'p'},
+        {"ptt", required_argument, NULL, 't'},
+        {"period", required_argument, NULL, 'P'},
+        {"address", required_argument, NULL, 'a'},
+        {"dest", required_argument, NULL, 'd'},
+        {"send", required_argument, NULL, 's'},
+        {"at", required_argument, NULL, 'A'},
+        {"duration", required_argument, NULL, 'D'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "c:p:t:P:a:d:s:A:D:vh", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'c':
+            options->audio.capture = strcmp(optarg, "none") == 0 ? NULL : optarg;
+            break;
+        case 'p':
+            options->audio.playback = strcmp(optarg, "none") == 0 ? NULL : optarg;
+            break;
+        case 't':
+            options->audio.ptt = optarg;
+            break;
+        case 'P':
+            options->audio.period_frames = (size_t)atoi(optarg);
+            break;
+        case 'a':
+            options->address = (uint8_t)strtol(optarg, NULL, 0);
+            break;
+        case 'd':
+            options->destination = (uint8_t)strtol(optarg, NULL, 0);
+            break;
+        case 's':
+            options->send = optarg;
+            break;
+        case 'A':
+            options->send_at_s = strtof(optarg, NULL);
+            break;
+        case 'D':
+            options->duration_s = atoi(optarg);
+            break;
+        case 'v':
+            if (options->log_level > LOG_LEVEL_DEBUG)
+            {
+                options->log_level = (log_level_e)(options->log_level - 1);
+            }
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if (options->audio.period_frames == 0 || options->duration_s < 0 || options->send_at_s < 0.0f)
+    {
+        fprintf(stderr, "Period must be positive, duration and send time not negative\n");
+        return -1;
+    }
+
+    if (options->audio.capture && options->audio.playback &&
+        strcmp(options->audio.capture, "-") == 0 && strcmp(options->audio.playback, "-") == 0)
+    {
+        fprintf(stderr, "Only one of capture and playback can use the standard streams\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void _message_callback(const uint8_t *data, size_t len, uint8_t src_addr)
+{
+    printf("0x%02X: ", src_addr);
+    for (size_t i = 0; i < len; i++)
+    {
+        putchar(data[i] >= 0x20 && data[i] < 0x7F ? data[i] : '.');
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+static void _stop(int signal)
+{
+    (void)signal;
+    stopping = 1;
+}
+
+static int _send(pc_handle_t *handle, const gateway_options_t *options, const char *text)
+{
+    pc_error_e error = pc_send_message(handle, options->destination, (const uint8_t *)text, strlen(text), NULL);
+    if (error != PC_SUCCESS)
+    {
+        LOG_ERROR("Failed to send message: %d", error);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Sends each line typed without blocking the loop while there is none, -1 once stdin is closed
+static int _read_stdin(pc_handle_t *handle, const gateway_options_t *options)
+{
+    struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+    if (poll(&input, 1, 0) <= 0 || !(input.revents & (POLLIN | POLLHUP)))
+    {
+        return 0;
+    }
+
+    char line[GATEWAY_LINE_SIZE];
+    if (!fgets(line, sizeof(line), stdin))
+    {
+        return -1;
+    }
+
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] != '\0')
+    {
+        _send(handle, options, line);
+    }
+
+    return 0;
+}
@@ -0,0 +1,486 @@
+/**
+ * @file pcm.c
+ *
+ * @author Diamond42474
+ *
+ * Mono 16-bit PCM streams for the Linux gateway. ALSA is only compiled in
+ * when the development headers were found (GATEWAY_ALSA), WAV and raw
+ * files always work so the gateway can be run offline against recordings.
+ */
+#include "pcm.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include "c-logger.h"
+
+#ifdef GATEWAY_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#define PCM_ALSA_PERIODS (4)     // ALSA buffer size in periods, headroom for a late capture thread
+#define PCM_WAV_HEADER_SIZE (44) // RIFF, fmt and data headers of a plain PCM WAV
+#define PCM_WAV_FORMAT_PCM (1)
+#define PCM_WAV_FORMAT_EXTENSIBLE (0xFFFE)
+
+static int _alsa_open(pcm_t *pcm, const char *name);
+static int _wav_open_read(pcm_t *pcm, const char *name);
+static int _wav_open_write(pcm_t *pcm, const char *name);
+static int _wav_finish(pcm_t *pcm);
+static int _file_read(pcm_t *pcm, int16_t *frames, size_t count);
+static uint32_t _le32(const uint8_t *bytes);
+static uint16_t _le16(const uint8_t *bytes);
+static void _put_le32(uint8_t *bytes, uint32_t value);
+static void _put_le16(uint8_t *bytes, uint16_t value);
+
+pcm_backend_e pcm_backend_for(const char *name)
+{
+    size_t length = strlen(name);
+    if (length > 4 && strcasecmp(&name[length - 4], ".wav") == 0)
+    {
+        return PCM_BACKEND_WAV;
+    }
+    if (strcmp(name, "default") == 0 || strchr(name, ':'))
+    {
+        return PCM_BACKEND_ALSA;
+    }
+
+    return PCM_BACKEND_RAW;
+}
+
+bool pcm_alsa_available(void)
+{
+#ifdef GATEWAY_ALSA
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Opens a stream, the backend is chosen from the name
+ *
+ * @param pcm Pointer to the stream
+ * @param name ALSA device, WAV path, raw path or "-" for stdin/stdout
+ * @param capture true to read samples, false to write them
+ * @param sample_rate Sample rate in Hz, a WAV being read must already be at this rate
+ * @param period_frames Frames per ALSA transfer, sets the latency
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int pcm_open(pcm_t *pcm, const char *name, bool capture, int sample_rate, size_t period_frames)
+{
+    if (!pcm || !name || sample_rate <= 0 || period_frames == 0)
+    {
+        LOG_ERROR("Invalid parameters for PCM open");
+        return -1;
+    }
+
+    memset(pcm, 0, sizeof(*pcm));
+    pcm->backend = pcm_backend_for(name);
+    pcm->capture = capture;
+    pcm->sample_rate = sample_rate;
+    pcm->period_frames = period_frames;
+    pcm->channels = 1;
+
+    switch (pcm->backend)
+    {
+    case PCM_BACKEND_ALSA:
+        return _alsa_open(pcm, name);
+    case PCM_BACKEND_WAV:
+        return capture ? _wav_open_read(pcm, name) : _wav_open_write(pcm, name);
+    case PCM_BACKEND_RAW:
+        if (strcmp(name, "-") == 0)
+        {
+            pcm->file = capture ? stdin : stdout;
+            return 0;
+        }
+        pcm->file = fopen(name, capture ? "rb" : "wb");
+        if (!pcm->file)
+        {
+            LOG_ERROR("Failed to open %s", name);
+            return -1;
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Closes a stream, playback is drained and a WAV header gets its final sizes
+ *
+ * @param pcm Pointer to the stream
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int pcm_close(pcm_t *pcm)
+{
+    int ret = 0;
+
+    if (!pcm)
+    {
+        return -1;
+    }
+
+#ifdef GATEWAY_ALSA
+    if (pcm->alsa)
+    {
+        if (!pcm->capture)
+        {
+            snd_pcm_drain(pcm->alsa);
+        }
+        snd_pcm_close(pcm->alsa);
+        pcm->alsa = NULL;
+    }
+#endif
+
+    if (pcm->file)
+    {
+        if (pcm->backend == PCM_BACKEND_WAV && !pcm->capture && _wav_finish(pcm))
+        {
+            ret = -1;
+        }
+        if (pcm->file != stdin && pcm->file != stdout)
+        {
+            fclose(pcm->file);
+        }
+        else
+        {
+            fflush(pcm->file);
+        }
+        pcm->file = NULL;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Reads samples, an ALSA overrun is recovered from and reading carries on
+ *
+ * @param pcm Pointer to the stream
+ * @param frames Receives the samples
+ * @param count Samples wanted
+ *
+ * @return the samples read, 0 at the end of a file, -1 on error
+ */
+int pcm_read(pcm_t *pcm, int16_t *frames, size_t count)
+{
+    if (!pcm || !frames || !pcm->capture)
+    {
+        LOG_ERROR("Invalid parameters for PCM read");
+        return -1;
+    }
+
+#ifdef GATEWAY_ALSA
+    if (pcm->alsa)
+    {
+        size_t done = 0;
+        while (done < count)
+        {
+            snd_pcm_sframes_t read = snd_pcm_readi(pcm->alsa, &frames[done], count - done);
+            if (read < 0)
+            {
+                LOG_WARN("Capture overrun, %s", snd_strerror((int)read));
+                read = snd_pcm_recover(pcm->alsa, (int)read, 1);
+                if (read < 0)
+                {
+                    LOG_ERROR("Capture failed: %s", snd_strerror((int)read));
+                    return -1;
+                }
+                continue;
+            }
+            done += (size_t)read;
+        }
+        return (int)done;
+    }
+#endif
+
+    return _file_read(pcm, frames, count);
+}
+
+/**
+ * @brief Writes samples, blocking on ALSA until there is room for them
+ *
+ * @param pcm Pointer to the stream
+ * @param frames Samples to write
+ * @param count Number of samples
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int pcm_write(pcm_t *pcm, const int16_t *frames, size_t count)
+{
+    if (!pcm || !frames || pcm->capture)
+    {
+        LOG_ERROR("Invalid parameters for PCM write");
+        return -1;
+    }
+
+#ifdef GATEWAY_ALSA
+    if (pcm->alsa)
+    {
+        size_t done = 0;
+        while (done < count)
+        {
+            snd_pcm_sframes_t written = snd_pcm_writei(pcm->alsa, &frames[done], count - done);
+            if (written < 0)
+            {
+                LOG_WARN("Playback underrun, %s", snd_strerror((int)written));
+                written = snd_pcm_recover(pcm->alsa, (int)written, 1);
+                if (written < 0)
+                {
+                    LOG_ERROR("Playback failed: %s", snd_strerror((int)written));
+                    return -1;
+                }
+                continue;
+            }
+            done += (size_t)written;
+        }
+        return 0;
+    }
+#endif
+
+    if (fwrite(frames, sizeof(int16_t), count, pcm->file) != count)
+    {
+        LOG_ERROR("Failed to write samples");
+        return -1;
+    }
+    pcm->data_bytes += (uint32_t)(count * sizeof(int16_t));
+
+    return 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static int _alsa_open(pcm_t *pcm, const char *name)
+{
+#ifdef GATEWAY_ALSA
+    snd_pcm_t *handle;
+    int err = snd_pcm_open(&handle, name, pcm->capture ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0)
+    {
+        LOG_ERROR("Failed to open %s: %s", name, snd_strerror(err));
+        return -1;
+    }
+
+    // Let plug devices resample, USB sound cards rarely run at the modem's rate natively
+    unsigned int latency_us = (unsigned int)(PCM_ALSA_PERIODS * pcm->period_frames * 1000000ULL / (uint64_t)pcm->sample_rate);
+    err = snd_pcm_set_params(handle, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, 1,
+                             (unsigned int)pcm->sample_rate, 1, latency_us);
+    if (err < 0)
+    {
+        LOG_ERROR("Failed to set %s to %d Hz mono: %s", name, pcm->sample_rate, snd_strerror(err));
+        snd_pcm_close(handle);
+        return -1;
+    }
+
+    pcm->alsa = handle;
+
+    return 0;
+#else
+    (void)pcm;
+    LOG_ERROR("%s looks like an ALSA device, but the gateway was built without ALSA", name);
+    return -1;
+#endif
+}
+
+static int _wav_open_read(pcm_t *pcm, const char *name)
+{
+    pcm->file = fopen(name, "rb");
+    if (!pcm->file)
+    {
+        LOG_ERROR("Failed to open %s", name);
+        return -1;
+    }
+
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), pcm->file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(&header[8], "WAVE", 4) != 0)
+    {
+        LOG_ERROR("%s is not a WAV file", name);
+        goto failed;
+    }
+
+    // Chunks can come in any order and there may be others (LIST, fact), stop at the data
+    bool have_format = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), pcm->file) == sizeof(chunk))
+    {
+        uint32_t size = _le32(&chunk[4]);
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            uint8_t format[16];
+            if (size < sizeof(format) || fread(format, 1, sizeof(format), pcm->file) != sizeof(format))
+            {
+                LOG_ERROR("%s has a truncated format chunk", name);
+                goto failed;
+            }
+
+            uint16_t type = _le16(&format[0]);
+            pcm->channels = _le16(&format[2]);
+            uint32_t rate = _le32(&format[4]);
+            uint16_t bits = _le16(&format[14]);
+            if ((type != PCM_WAV_FORMAT_PCM && type != PCM_WAV_FORMAT_EXTENSIBLE) || bits != 16 || pcm->channels == 0)
+            {
+                LOG_ERROR("%s must be 16-bit PCM", name);
+                goto failed;
+            }
+            if (rate != (uint32_t)pcm->sample_rate)
+            {
+                LOG_ERROR("%s is %u Hz, the modem runs at %d Hz", name, rate, pcm->sample_rate);
+                goto failed;
+            }
+
+            have_format = true;
+            size -= sizeof(format);
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!have_format)
+            {
+                LOG_ERROR("%s has no format before its data", name);
+                goto failed;
+            }
+            return 0;
+        }
+
+        // Chunks are padded to an even size
+        if (fseek(pcm->file, (long)(size + (size & 1)), SEEK_CUR))
+        {
+            break;
+        }
+    }
+
+    LOG_ERROR("%s has no data chunk", name);
+
+failed:
+    fclose(pcm->file);
+    pcm->file = NULL;
+    return -1;
+}
+
+static int _wav_open_write(pcm_t *pcm, const char *name)
+{
+    pcm->file = fopen(name, "wb");
+    if (!pcm->file)
+    {
+        LOG_ERROR("Failed to open %s", name);
+        return -1;
+    }
+
+    // Sizes are left at 0 until close, when the length is known
+    uint8_t header[PCM_WAV_HEADER_SIZE] = {0};
+    memcpy(&header[0], "RIFF", 4);
+    memcpy(&header[8], "WAVE", 4);
+    memcpy(&header[12], "fmt ", 4);
+    _put_le32(&header[16], 16);
+    _put_le16(&header[20], PCM_WAV_FORMAT_PCM);
+    _put_le16(&header[22], 1);
+    _put_le32(&header[24], (uint32_t)pcm->sample_rate);
+    _put_le32(&header[28], (uint32_t)pcm->sample_rate * sizeof(int16_t));
+    _put_le16(&header[32], sizeof(int16_t));
+    _put_le16(&header[34], 16);
+    memcpy(&header[36], "data", 4);
+
+    if (fwrite(header, 1, sizeof(header), pcm->file) != sizeof(header))
+    {
+        LOG_ERROR("Failed to write WAV header to %s", name);
+        fclose(pcm->file);
+        pcm->file = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int _wav_finish(pcm_t *pcm)
+{
+    uint8_t size[4];
+
+    _put_le32(size, PCM_WAV_HEADER_SIZE - 8 + pcm->data_bytes);
+    if (fseek(pcm->file, 4, SEEK_SET) || fwrite(size, 1, sizeof(size), pcm->file) != sizeof(size))
+    {
+        LOG_ERROR("Failed to update WAV header");
+        return -1;
+    }
+
+    _put_le32(size, pcm->data_bytes);
+    if (fseek(pcm->file, PCM_WAV_HEADER_SIZE - 4, SEEK_SET) || fwrite(size, 1, sizeof(size), pcm->file) != sizeof(size))
+    {
+        LOG_ERROR("Failed to update WAV header");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int _file_read(pcm_t *pcm, int16_t *frames, size_t count)
+{
+    if (pcm->eof)
+    {
+        return 0;
+    }
+
+    size_t done = 0;
+    while (done < count)
+    {
+        // Interleaved WAVs are read a frame at a time and only the first channel kept
+        int16_t frame[8];
+        size_t channels = (size_t)pcm->channels;
+        if (channels > sizeof(frame) / sizeof(frame[0]))
+        {
+            LOG_ERROR("Too many channels: %zu", channels);
+            return -1;
+        }
+
+        if (channels == 1)
+        {
+            size_t read = fread(&frames[done], sizeof(int16_t), count - done, pcm->file);
+            done += read;
+            if (read == 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (fread(frame, sizeof(int16_t), channels, pcm->file) != channels)
+        {
+            break;
+        }
+        frames[done++] = frame[0];
+    }
+
+    if (done < count)
+    {
+        pcm->eof = true;
+    }
+
+    return (int)done;
+}
+
+static uint32_t _le32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static uint16_t _le16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static void _put_le32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static void _put_le16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+}
@@ -0,0 +1,45 @@
+#ifndef PCM_H
+#define PCM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Mono signed 16-bit audio in or out of a sound card, a WAV file or a raw file/pipe. The backend
+// is picked from the name: "*.wav" is a WAV file, "-" is stdin/stdout raw, "default" or anything
+// with a ':' (hw:1,0, plughw:CARD=Device) is an ALSA PCM, any other path is a raw S16_LE file.
+
+typedef enum
+{
+    PCM_BACKEND_ALSA,
+    PCM_BACKEND_WAV,
+    PCM_BACKEND_RAW,
+} pcm_backend_e;
+
+typedef struct
+{
+    pcm_backend_e backend;
+    bool capture;
+    int sample_rate;
+    size_t period_frames; // Frames an ALSA read or write moves at once
+
+    void *alsa; // snd_pcm_t, NULL unless built with ALSA
+
+    FILE *file;
+    int channels;          // Channels in a WAV being read, only the first is used
+    uint32_t data_bytes;   // WAV data written so far, patched into the header on close
+    bool eof;
+} pcm_t;
+
+pcm_backend_e pcm_backend_for(const char *name);
+bool pcm_alsa_available(void);
+
+int pcm_open(pcm_t *pcm, const char *name, bool capture, int sample_rate, size_t period_frames);
+int pcm_close(pcm_t *pcm);
+
+// Blocks on ALSA, returns the frames read, 0 at the end of a file, -1 on error
+int pcm_read(pcm_t *pcm, int16_t *frames, size_t count);
+int pcm_write(pcm_t *pcm, const int16_t *frames, size_t count);
+
+#endif // PCM_H
@@ -0,0 +1,295 @@
+#include "unity.h"
+
+#include "arq.h"
+#include "packet.h"
+#include "c-logger.h"
+#include "interface/pconfig.h"
+#include "utils/time_utils.h"
+#include <string.h>
+
+#define LOCAL_ADDR (0x01)
+#define PEER_ADDR (0x02)
+
+extern void mock_time_set_us(uint64_t us);
+extern void mock_time_advance_us(uint64_t us);
+
+static arq_handle_t arq;
+
+static int delivered_count;
+static int failed_count;
+static uint8_t last_reported_id;
+
+static void _delivery_cb(void *ctx, uint8_t dest_addr, uint8_t id, bool delivered)
+{
+    (void)ctx;
+    (void)dest_addr;
+
+    last_reported_id = id;
+    if (delivered)
+    {
+        delivered_count++;
+    }
+    else
+    {
+        failed_count++;
+    }
+}
+
+static packet_t _data_packet(uint8_t src, uint8_t dest, uint8_t id)
+{
+    packet_t packet;
+    uint8_t payload[] = {0xDE, 0xAD};
+    memset(&packet, 0, sizeof(packet));
+    initialize_packet(&packet, PACKET_TYPE_DATA, src, dest, id, payload, sizeof(payload));
+    return packet;
+}
+
+static packet_t _ack_packet(uint8_t src, uint8_t dest, const uint8_t *ids, size_t count)
+{
+    packet_t packet;
+    memset(&packet, 0, sizeof(packet));
+    initialize_packet(&packet, PACKET_TYPE_ACK, src, dest, 0, ids, count);
+    return packet;
+}
+
+void setUp(void)
+{
+    mock_time_set_us(0);
+    arq_init(&arq, LOCAL_ADDR, _delivery_cb, NULL);
+    delivered_count = 0;
+    failed_count = 0;
+    last_reported_id = 0xFF;
+}
+
+void tearDown(void)
+{
+}
+
+void test_sequence_per_destination(void)
+{
+    TEST_ASSERT_EQUAL(0, arq_next_id(&arq, 0x02));
+    TEST_ASSERT_EQUAL(1, arq_next_id(&arq, 0x02));
+    TEST_ASSERT_EQUAL(0, arq_next_id(&arq, 0x03));
+    TEST_ASSERT_EQUAL(2, arq_next_id(&arq, 0x02));
+}
+
+void test_window_limits_in_flight(void)
+{
+    for (int i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        TEST_ASSERT_TRUE(arq_window_available(&arq));
+        packet_t packet = _data_packet(LOCAL_ADDR, PEER_ADDR, arq_next_id(&arq, PEER_ADDR));
+        TEST_ASSERT_EQUAL(0, arq_track(&arq, &packet));
+    }
+
+    TEST_ASSERT_FALSE(arq_window_available(&arq));
+}
+
+void test_selective_ack_releases_window(void)
+{
+    for (int i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        packet_t packet = _data_packet(LOCAL_ADDR, PEER_ADDR, arq_next_id(&arq, PEER_ADDR));
+        arq_track(&arq, &packet);
+    }
+
+    // Acknowledge ids 0 and 2 in one frame, 1 and 3 are still outstanding
+    uint8_t ids[] = {0, 2};
+    packet_t ack = _ack_packet(PEER_ADDR, LOCAL_ADDR, ids, sizeof(ids));
+    TEST_ASSERT_EQUAL(0, arq_handle_ack(&arq, &ack));
+
+    TEST_ASSERT_EQUAL(2, delivered_count);
+    TEST_ASSERT_TRUE(arq_window_available(&arq));
+
+    // An ACK from a different peer must not release our packets to PEER_ADDR
+    uint8_t other_ids[] = {1, 3};
+    ack = _ack_packet(0x07, LOCAL_ADDR, other_ids, sizeof(other_ids));
+    arq_handle_ack(&arq, &ack);
+    TEST_ASSERT_EQUAL(2, delivered_count);
+}
+
+void test_retransmit_with_backoff_then_fail(void)
+{
+    packet_t packet = _data_packet(LOCAL_ADDR, PEER_ADDR, arq_next_id(&arq, PEER_ADDR));
+    arq_track(&arq, &packet);
+
+    uint64_t last_timeout_us = 0;
+    for (int retry = 0; retry < pconfigMAX_RETRIES; retry++)
+    {
+        arq_task(&arq);
+        TEST_ASSERT_FALSE(arq_retransmission_pending(&arq));
+
+        uint64_t timeout_us = arq.window[0].timer.duration_us;
+        TEST_ASSERT_TRUE(timeout_us >= last_timeout_us);
+        last_timeout_us = timeout_us;
+
+        mock_time_advance_us(timeout_us);
+        arq_task(&arq);
+        TEST_ASSERT_TRUE(arq_retransmission_pending(&arq));
+
+        packet_t resend;
+        TEST_ASSERT_EQUAL(0, arq_get_retransmission(&arq, &resend));
+        TEST_ASSERT_EQUAL(packet.content.id, resend.content.id);
+    }
+
+    mock_time_advance_us(arq.window[0].timer.duration_us);
+    arq_task(&arq);
+
+    TEST_ASSERT_EQUAL(1, failed_count);
+    TEST_ASSERT_EQUAL(packet.content.id, last_reported_id);
+    TEST_ASSERT_EQUAL(pconfigMAX_RETRIES, arq.stats.retransmissions);
+    TEST_ASSERT_FALSE(arq_retransmission_pending(&arq));
+}
+
+void test_acks_are_batched(void)
+{
+    for (uint8_t id = 0; id < 3; id++)
+    {
+        packet_t packet = _data_packet(PEER_ADDR, LOCAL_ADDR, id);
+        TEST_ASSERT_TRUE(arq_handle_data(&arq, &packet));
+    }
+
+    // Held back for the ACK delay so the ids can share one frame
+    TEST_ASSERT_FALSE(arq_ack_pending(&arq));
+    mock_time_advance_us(pconfigARQ_ACK_DELAY_MS * ONE_MS);
+    TEST_ASSERT_TRUE(arq_ack_pending(&arq));
+
+    packet_t ack;
+    TEST_ASSERT_EQUAL(0, arq_get_ack(&arq, &ack));
+    TEST_ASSERT_EQUAL(PACKET_TYPE_ACK, ack.content.type);
+    TEST_ASSERT_EQUAL(LOCAL_ADDR, ack.content.src_addr);
+    TEST_ASSERT_EQUAL(PEER_ADDR, ack.content.dest_addr);
+    TEST_ASSERT_EQUAL(3, ack.content.payload_length);
+    TEST_ASSERT_EQUAL(ack.content.crc, calculate_crc(&ack));
+
+    TEST_ASSERT_FALSE(arq_ack_pending(&arq));
+}
+
+void test_duplicates_are_acked_not_delivered(void)
+{
+    packet_t packet = _data_packet(PEER_ADDR, LOCAL_ADDR, 5);
+    TEST_ASSERT_TRUE(arq_handle_data(&arq, &packet));
+    TEST_ASSERT_FALSE(arq_handle_data(&arq, &packet));
+    TEST_ASSERT_EQUAL(1, arq.stats.duplicates);
+
+    // Out of order but new
+    packet = _data_packet(PEER_ADDR, LOCAL_ADDR, 3);
+    TEST_ASSERT_TRUE(arq_handle_data(&arq, &packet));
+
+    // Older than the highest id seen, but never received
+    packet = _data_packet(PEER_ADDR, LOCAL_ADDR, 250);
+    TEST_ASSERT_TRUE(arq_handle_data(&arq, &packet));
+
+    mock_time_advance_us(pconfigARQ_ACK_DELAY_MS * ONE_MS);
+    packet_t ack;
+    TEST_ASSERT_EQUAL(0, arq_get_ack(&arq, &ack));
+    TEST_ASSERT_EQUAL(3, ack.content.payload_length);
+}
+
+// Sends the sender's next packet to LOCAL_ADDR the way the orchestrator does, returns whether arq delivered it
+static bool _send_from(arq_handle_t *sender, bool resend_last, packet_t *last)
+{
+    if (!resend_last)
+    {
+        *last = _data_packet(PEER_ADDR, LOCAL_ADDR, arq_next_id(sender, LOCAL_ADDR));
+        TEST_ASSERT_EQUAL(0, arq_track(sender, last));
+    }
+    TEST_ASSERT_EQUAL(0, arq_set_session(sender, last));
+    TEST_ASSERT_EQUAL(last->content.crc, calculate_crc(last));
+    return arq_handle_data(&arq, last);
+}
+
+// ACKs everything arq owes the sender
+static void _ack_to(arq_handle_t *sender)
+{
+    mock_time_advance_us(pconfigARQ_ACK_DELAY_MS * ONE_MS);
+    packet_t ack;
+    TEST_ASSERT_EQUAL(0, arq_get_ack(&arq, &ack));
+    TEST_ASSERT_EQUAL(0, arq_handle_ack(sender, &ack));
+}
+
+void test_session_sent_until_acked(void)
+{
+    packet_t first = _data_packet(LOCAL_ADDR, PEER_ADDR, arq_next_id(&arq, PEER_ADDR));
+    TEST_ASSERT_EQUAL(0, arq_track(&arq, &first));
+    TEST_ASSERT_EQUAL(0, arq_set_session(&arq, &first));
+    TEST_ASSERT_TRUE(first.content.flags & PACKET_FLAG_SESSION);
+    TEST_ASSERT_TRUE(first.content.session != 0);
+
+    uint8_t ids[] = {first.content.id};
+    packet_t ack = _ack_packet(PEER_ADDR, LOCAL_ADDR, ids, sizeof(ids));
+    TEST_ASSERT_EQUAL(0, arq_handle_ack(&arq, &ack));
+
+    // Retransmissions of packets from before the ACK drop it too
+    packet_t next = first;
+    TEST_ASSERT_EQUAL(0, arq_set_session(&arq, &next));
+    TEST_ASSERT_FALSE(next.content.flags & PACKET_FLAG_SESSION);
+    TEST_ASSERT_EQUAL(next.content.crc, calculate_crc(&next));
+}
+
+void test_restarted_sender_is_delivered(void)
+{
+    arq_handle_t sender;
+    TEST_ASSERT_EQUAL(0, arq_init(&sender, PEER_ADDR, NULL, NULL));
+
+    packet_t packet;
+    for (int i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        TEST_ASSERT_TRUE(_send_from(&sender, false, &packet));
+    }
+    _ack_to(&sender);
+    TEST_ASSERT_TRUE(_send_from(&sender, false, &packet));
+    TEST_ASSERT_FALSE(packet.content.flags & PACKET_FLAG_SESSION);
+    TEST_ASSERT_FALSE(_send_from(&sender, true, &packet));
+
+    // The sender reboots a while later and starts over at id 0, which we still hold as received
+    mock_time_advance_us(1234567);
+    TEST_ASSERT_EQUAL(0, arq_init(&sender, PEER_ADDR, NULL, NULL));
+    for (int i = 0; i < pconfigARQ_WINDOW_SIZE; i++)
+    {
+        TEST_ASSERT_TRUE(_send_from(&sender, false, &packet));
+        TEST_ASSERT_EQUAL(i, packet.content.id);
+        TEST_ASSERT_TRUE(packet.content.flags & PACKET_FLAG_SESSION);
+    }
+
+    // Retransmissions in the new session are still caught
+    TEST_ASSERT_FALSE(_send_from(&sender, true, &packet));
+}
+
+void test_evicted_peer_starts_new_session(void)
+{
+    packet_t packet = _data_packet(LOCAL_ADDR, PEER_ADDR, arq_next_id(&arq, PEER_ADDR));
+    TEST_ASSERT_EQUAL(0, arq_set_session(&arq, &packet));
+    uint8_t session = packet.content.session;
+
+    // Enough other destinations to push PEER_ADDR out of the peer table
+    for (uint8_t addr = 0x10; addr < 0x10 + pconfigARQ_MAX_PEERS; addr++)
+    {
+        arq_next_id(&arq, addr);
+    }
+
+    packet = _data_packet(LOCAL_ADDR, PEER_ADDR, arq_next_id(&arq, PEER_ADDR));
+    TEST_ASSERT_EQUAL(0, packet.content.id);
+    TEST_ASSERT_EQUAL(0, arq_set_session(&arq, &packet));
+    TEST_ASSERT_TRUE(packet.content.flags & PACKET_FLAG_SESSION);
+    TEST_ASSERT_TRUE(packet.content.session != session);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    log_init(LOG_LEVEL_INFO);
+
+    RUN_TEST(test_sequence_per_destination);
+    RUN_TEST(test_window_limits_in_flight);
+    RUN_TEST(test_selective_ack_releases_window);
+    RUN_TEST(test_retransmit_with_backoff_then_fail);
+    RUN_TEST(test_acks_are_batched);
+    RUN_TEST(test_duplicates_are_acked_not_delivered);
+    RUN_TEST(test_session_sent_until_acked);
+    RUN_TEST(test_restarted_sender_is_delivered);
+    RUN_TEST(test_evicted_peer_starts_new_session);
+
+    return UNITY_END();
+}
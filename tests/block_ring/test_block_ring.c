@@ -0,0 +1,176 @@
+#include "unity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "utils/block_ring.h"
+#include "c-logger.h"
+
+#define BLOCK_SIZE (16)
+#define BLOCK_COUNT (2)
+#define THREAD_SAMPLES (200000) // Enough hand-offs for a race to show up
+
+static block_ring_t ring;
+static uint16_t memory[BLOCK_SIZE * BLOCK_COUNT];
+
+void setUp(void)
+{
+    log_init(LOG_LEVEL_ERROR);
+    memset(memory, 0, sizeof(memory));
+    TEST_ASSERT_EQUAL(0, block_ring_init(&ring, memory, sizeof(uint16_t), BLOCK_SIZE, BLOCK_COUNT));
+}
+
+void tearDown(void)
+{
+}
+
+static void _fill(uint16_t first, size_t count)
+{
+    size_t capacity;
+    uint16_t *block = block_ring_acquire(&ring, &capacity);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, capacity);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        block[i] = (uint16_t)(first + i);
+    }
+    TEST_ASSERT_EQUAL(0, block_ring_commit(&ring, count));
+}
+
+void test_rejects_bad_block_counts(void)
+{
+    block_ring_t bad;
+    TEST_ASSERT_EQUAL(-1, block_ring_init(&bad, memory, sizeof(uint16_t), BLOCK_SIZE, 1));
+    TEST_ASSERT_EQUAL(-1, block_ring_init(&bad, memory, sizeof(uint16_t), BLOCK_SIZE, BLOCK_RING_MAX_BLOCKS + 1));
+    TEST_ASSERT_EQUAL(-1, block_ring_init(&bad, memory, sizeof(uint16_t), 0, BLOCK_COUNT));
+}
+
+void test_blocks_come_out_in_order(void)
+{
+    TEST_ASSERT_TRUE(block_ring_is_empty(&ring));
+
+    _fill(100, BLOCK_SIZE);
+    _fill(200, 5); // Partial block
+
+    size_t count;
+    const uint16_t *block = block_ring_peek(&ring, &count);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, count);
+    TEST_ASSERT_EQUAL_UINT16(100, block[0]);
+    TEST_ASSERT_EQUAL_UINT16(100 + BLOCK_SIZE - 1, block[BLOCK_SIZE - 1]);
+    TEST_ASSERT_EQUAL(0, block_ring_release(&ring));
+
+    block = block_ring_peek(&ring, &count);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_EQUAL(5, count);
+    TEST_ASSERT_EQUAL_UINT16(204, block[4]);
+    TEST_ASSERT_EQUAL(0, block_ring_release(&ring));
+
+    TEST_ASSERT_TRUE(block_ring_is_empty(&ring));
+    TEST_ASSERT_NULL(block_ring_peek(&ring, &count));
+    TEST_ASSERT_EQUAL(-1, block_ring_release(&ring));
+}
+
+void test_full_ring_counts_only_dropped_samples(void)
+{
+    _fill(0, BLOCK_SIZE);
+    _fill(0, BLOCK_SIZE);
+
+    // A producer that waits and tries again loses nothing
+    size_t capacity;
+    TEST_ASSERT_NULL(block_ring_acquire(&ring, &capacity));
+    TEST_ASSERT_NULL(block_ring_acquire(&ring, &capacity));
+    TEST_ASSERT_EQUAL_UINT32(0, STAT_GET(ring.overflows));
+
+    block_ring_drop(&ring, 5);
+    TEST_ASSERT_EQUAL_UINT32(5, STAT_GET(ring.overflows));
+
+    // Freeing the oldest block gives it straight back to the producer
+    TEST_ASSERT_EQUAL(0, block_ring_release(&ring));
+    TEST_ASSERT_EQUAL_PTR(memory, block_ring_acquire(&ring, &capacity));
+}
+
+void test_empty_commit_keeps_block(void)
+{
+    size_t capacity;
+    void *block = block_ring_acquire(&ring, &capacity);
+    TEST_ASSERT_EQUAL(0, block_ring_commit(&ring, 0));
+    TEST_ASSERT_TRUE(block_ring_is_empty(&ring));
+    TEST_ASSERT_EQUAL_PTR(block, block_ring_acquire(&ring, &capacity));
+    TEST_ASSERT_EQUAL(-1, block_ring_commit(&ring, BLOCK_SIZE + 1));
+}
+
+static void *_producer(void *arg)
+{
+    (void)arg;
+
+    uint32_t next = 0;
+    while (next < THREAD_SAMPLES)
+    {
+        size_t capacity;
+        uint16_t *block = block_ring_acquire(&ring, &capacity);
+        if (!block)
+        {
+            sched_yield(); // Don't starve the consumer on a single core
+            continue;
+        }
+
+        size_t count = 1 + next % capacity; // Vary the fill so partial blocks cross over too
+        if (count > THREAD_SAMPLES - next)
+        {
+            count = THREAD_SAMPLES - next;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            block[i] = (uint16_t)(next++);
+        }
+        block_ring_commit(&ring, count);
+    }
+
+    return NULL;
+}
+
+void test_threads_hand_off_every_sample(void)
+{
+    pthread_t producer;
+    TEST_ASSERT_EQUAL(0, pthread_create(&producer, NULL, _producer, NULL));
+
+    uint32_t expected = 0;
+    uint32_t mismatches = 0;
+    while (expected < THREAD_SAMPLES)
+    {
+        size_t count;
+        const uint16_t *block = block_ring_peek(&ring, &count);
+        if (!block)
+        {
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (block[i] != (uint16_t)expected)
+            {
+                mismatches++;
+            }
+            expected++;
+        }
+        block_ring_release(&ring);
+    }
+
+    pthread_join(producer, NULL);
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+    TEST_ASSERT_TRUE(block_ring_is_empty(&ring));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_bad_block_counts);
+    RUN_TEST(test_blocks_come_out_in_order);
+    RUN_TEST(test_full_ring_counts_only_dropped_samples);
+    RUN_TEST(test_empty_commit_keeps_block);
+    RUN_TEST(test_threads_hand_off_every_sample);
+    return UNITY_END();
+}
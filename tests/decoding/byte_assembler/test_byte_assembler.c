@@ -70,6 +70,7 @@ void test_preamble_correction(void)
 
     TEST_ASSERT_TRUE(byte_assembler_handle.preamble_found);
 
+    _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, fsk_rate_encode(FSK_RATE_BASE));
     _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, 0xCD);
 
     // Check for bit alignment
@@ -110,6 +111,35 @@ void test_msb_first_preamble_detection(void)
     TEST_ASSERT_EQUAL_HEX16(0xABBA, byte_assembler_handle.preamble_buffer);
 }
 
+void test_rate_byte(void)
+{
+    TEST_ASSERT_TRUE(byte_assembler_init(&byte_assembler_handle) == 0);
+
+    byte_assembler_set_preamble(&byte_assembler_handle, 0xABBA);
+
+    _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, 0xAB);
+    _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, 0xBA);
+    TEST_ASSERT_EQUAL(BYTE_ASSEMBLER_READING_RATE, byte_assembler_handle.state);
+
+    _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, fsk_rate_encode(FSK_RATE_3X));
+    TEST_ASSERT_EQUAL(BYTE_ASSEMBLER_ASSEMBLING, byte_assembler_handle.state);
+
+    // A corrupted rate byte drops the frame instead of switching to a wrong rate
+    _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, 0xAB);
+    _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, 0xBA);
+    _send_byte_as_bits(&byte_assembler_handle, &decoder_handle, fsk_rate_encode(FSK_RATE_2X) ^ 0x10);
+    TEST_ASSERT_FALSE(byte_assembler_handle.preamble_found);
+    TEST_ASSERT_EQUAL(BYTE_ASSEMBLER_WAITING_FOR_PREAMBLE, byte_assembler_handle.state);
+
+    fsk_rate_e rate;
+    for (int i = 0; i < FSK_RATE_COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL(0, fsk_rate_decode(fsk_rate_encode((fsk_rate_e)i), &rate));
+        TEST_ASSERT_EQUAL(i, rate);
+    }
+    TEST_ASSERT_EQUAL(-1, fsk_rate_decode(fsk_rate_encode(FSK_RATE_COUNT), &rate));
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -120,6 +150,7 @@ int main(void)
     RUN_TEST(test_preamble_correction);
     RUN_TEST(test_byte_assembler_reset);
     RUN_TEST(test_msb_first_preamble_detection);
+    RUN_TEST(test_rate_byte);
 
     return UNITY_END();
 }
\ No newline at end of file
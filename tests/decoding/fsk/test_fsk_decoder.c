@@ -17,6 +17,16 @@
 #define SAMPLE_RATE (79200)       // Based off decoder_example.c calculated for 32 baud
 #define SYMBOL_SAMPLE_SIZE (2475) // Based off decoder_example.c calculated for 32 baud
 #define BUFFER_SYMBOL_COUNT (3)   // Minimum of 3 is good for timing recovery
+#define DRIFT_SAMPLE_RATE (9600)   // Not a whole multiple of DRIFT_BAUD_RATE, 38.4 samples per symbol
+#define DRIFT_BAUD_RATE (250)
+#define DRIFT_CLOCK_OFFSET (0.008f) // Sender's clock runs this much fast
+#define SQUELCH_LEARN_SYMBOLS (1500) // Six seconds of noise at DRIFT_BAUD_RATE, the floor climbs 20 dB a second
+#define QUIET_AMPLITUDE (300.0f)    // S16 tone about 40 dB below full scale
+#define QUIET_DC_OFFSET (4000.0f)   // Sound card DC offset, far larger than the tone
+#define LEVEL_NOISE (600)           // Noise under the carrier sense tones, leaves room for them in 12 bits
+#define LEVEL_TONE (700.0f)         // Both tones at once, about 14 dB over that noise in band and never a bit
+#define LEVEL_TONE_SYMBOLS (750)    // Three seconds of them at DRIFT_BAUD_RATE
+#define LEVEL_BUSY (4.0f)           // Channel level that counts as busy, where the squelch opens
 
 extern void mock_decoder_reset(void);
 extern void mock_decoder_set_bit_processor(void (*processor)(bool));
@@ -33,6 +43,16 @@ void bit_cb(bool bit)
     circular_buffer_push(&bit_circular_buffer, &bit);
 }
 
+// Switches to 3x the configured rate after the second bit, the way a rate byte would
+void rate_switch_cb(bool bit)
+{
+    circular_buffer_push(&bit_circular_buffer, &bit);
+    if (circular_buffer_count(&bit_circular_buffer) == 2)
+    {
+        TEST_ASSERT_EQUAL(0, fsk_decoder_set_baud_rate(&handle, 3 * SAMPLE_RATE / SYMBOL_SAMPLE_SIZE));
+    }
+}
+
 void generate_sine_wave(uint16_t *buffer, float frequency, float sample_rate, uint32_t sample_count)
 {
     const float amplitude = 2047.0f; // Half of 12-bit range
@@ -73,6 +93,23 @@ void generate_noise(uint16_t *buffer, float sample_rate, uint32_t sample_count)
     }
 }
 
+// Commits samples to the decoder's input ring, a block at a time the way the ADC BSP would
+static void push_samples(const uint16_t *samples, size_t sample_count)
+{
+    size_t pushed = 0;
+    while (pushed < sample_count)
+    {
+        size_t capacity;
+        uint16_t *block = block_ring_acquire(&decoder_handle.input_ring, &capacity);
+        TEST_ASSERT_NOT_NULL(block); // Input ring is full
+
+        size_t count = sample_count - pushed < capacity ? sample_count - pushed : capacity;
+        memcpy(block, &samples[pushed], count * sizeof(uint16_t));
+        TEST_ASSERT_EQUAL(0, block_ring_commit(&decoder_handle.input_ring, count));
+        pushed += count;
+    }
+}
+
 void send_bit(bool bit)
 {
     uint16_t buffer[SYMBOL_SAMPLE_SIZE];
@@ -84,10 +121,7 @@ void send_bit(bool bit)
     {
         generate_sine_wave(buffer, F0, SAMPLE_RATE, SYMBOL_SAMPLE_SIZE);
     }
-    for (int i = 0; i < SYMBOL_SAMPLE_SIZE; i++)
-    {
-        circular_buffer_push(&decoder_handle.input_buffer, &buffer[i]);
-    }
+    push_samples(buffer, SYMBOL_SAMPLE_SIZE);
 }
 
 void send_partial_bit(bool bit, size_t sample_count)
@@ -101,38 +135,41 @@ void send_partial_bit(bool bit, size_t sample_count)
     {
         generate_sine_wave(buffer, F0, SAMPLE_RATE, sample_count);
     }
-    for (size_t i = 0; i < sample_count; i++)
-    {
-        circular_buffer_push(&decoder_handle.input_buffer, &buffer[i]);
-    }
+    push_samples(buffer, sample_count);
 }
 
 void send_noise(int sample_count)
 {
     uint16_t buffer[sample_count];
     generate_noise(buffer, SAMPLE_RATE, sample_count);
-    for (int i = 0; i < sample_count; i++)
-    {
-        circular_buffer_push(&decoder_handle.input_buffer, &buffer[i]);
-    }
+    push_samples(buffer, sample_count);
 }
 
 void send_silence(int sample_count)
 {
     uint16_t buffer[sample_count];
     memset(buffer, 4096 / 2, sizeof(buffer)); // Center value for unsigned 12-bit (silence)
+    push_samples(buffer, sample_count);
+}
+
+// Both tones at once, or nothing with amplitude 0, in uniform noise at the drift test rate
+void send_tones_in_noise(float amplitude, int sample_count)
+{
+    static uint32_t sent = 0; // Keeps the tones' phase running across calls
+    uint16_t buffer[sample_count];
     for (int i = 0; i < sample_count; i++)
     {
-        circular_buffer_push(&decoder_handle.input_buffer, &buffer[i]);
+        float t = (float)(sent++ % DRIFT_SAMPLE_RATE) / DRIFT_SAMPLE_RATE;
+        float tone = amplitude * (sinf(2.0f * (float)M_PI * F0 * t) + sinf(2.0f * (float)M_PI * F1 * t));
+        int noise = (rand() % (2 * LEVEL_NOISE + 1)) - LEVEL_NOISE;
+        buffer[i] = (uint16_t)(2048 + noise + (int)tone);
     }
+    push_samples(buffer, sample_count);
 }
 
 void send_samples(uint16_t *samples, size_t sample_count)
 {
-    for (size_t i = 0; i < sample_count; i++)
-    {
-        circular_buffer_push(&decoder_handle.input_buffer, &samples[i]);
-    }
+    push_samples(samples, sample_count);
 }
 
 typedef struct
@@ -190,12 +227,35 @@ void process(void)
     }
 }
 
+// Continuous phase FSK the way the modulator sends it, at any rate and however long a symbol is.
+// Samples are center + amplitude * tone, cast through int16_t so signed formats come out as the BSP hands them over
+void send_fsk(const bool *bits, size_t bit_count, float sample_rate, float samples_per_symbol, float center, float amplitude)
+{
+    uint16_t buffer[SYMBOL_SAMPLE_SIZE];
+    size_t total = (size_t)(bit_count * samples_per_symbol);
+    size_t count = 0;
+    float phase = 0.0f;
+
+    for (size_t i = 0; i < total; i++)
+    {
+        float frequency = bits[(size_t)(i / samples_per_symbol)] ? F1 : F0;
+        phase = fmodf(phase + 2.0f * (float)M_PI * frequency / sample_rate, 2.0f * (float)M_PI);
+        buffer[count++] = (uint16_t)(int16_t)(center + amplitude * sinf(phase));
+        if (count == SYMBOL_SAMPLE_SIZE || i == total - 1)
+        {
+            push_samples(buffer, count);
+            process();
+            count = 0;
+        }
+    }
+}
+
 void setUp(void)
 {
     memset(&decoder_handle, 0, sizeof(decoder_handle));
     memset(&handle, 0, sizeof(handle));
     memset(sample_buffer, 0, sizeof(sample_buffer));
-    circular_buffer_static_init(&decoder_handle.input_buffer, sample_buffer, sizeof(uint16_t), BUFFER_SYMBOL_COUNT * SYMBOL_SAMPLE_SIZE * 2);
+    block_ring_init(&decoder_handle.input_ring, sample_buffer, sizeof(uint16_t), SYMBOL_SAMPLE_SIZE, BUFFER_SYMBOL_COUNT * 2); // A block per symbol, tests queue a few sends before processing
     circular_buffer_static_init(&bit_circular_buffer, bit_buffer, sizeof(bool), sizeof(bit_buffer) / sizeof(bool));
     mock_decoder_set_bit_processor(bit_cb);
 }
@@ -203,7 +263,6 @@ void setUp(void)
 void tearDown(void)
 {
     mock_decoder_reset();
-    circular_buffer_reset(&decoder_handle.input_buffer);
     circular_buffer_reset(&bit_circular_buffer);
 }
 
@@ -376,6 +435,292 @@ void test_baud32(void)
     }
 }
 
+void runtime_reconfiguration(void)
+{
+    init();
+    LOG_INFO("===== RUNTIME RECONFIGURATION =====");
+
+    // Swapped tones, the filters have to be redesigned for the new mapping to decode
+    TEST_ASSERT_TRUE(fsk_decoder_set_frequencies(&handle, F1, F0) == 0);
+    process();
+
+    send_bit(0); // F0, which is now bit 1
+    send_silence(SYMBOL_SAMPLE_SIZE);
+    send_silence(SYMBOL_SAMPLE_SIZE);
+    process();
+
+    bool bit = 0;
+    TEST_ASSERT_EQUAL_MESSAGE(1, circular_buffer_count(&bit_circular_buffer), "We should have 1 bit ready to process");
+    circular_buffer_pop(&bit_circular_buffer, &bit);
+    TEST_ASSERT_EQUAL(1, bit);
+}
+
+void fast_rate_decoding(void)
+{
+    init();
+    LOG_INFO("===== FAST RATE DECODING =====");
+    mock_decoder_set_bit_processor(rate_switch_cb);
+
+    const bool fast_bits[] = {1, 0, 1, 1, 0, 0, 1, 0};
+
+    send_bit(1);
+    process();
+    send_bit(0);
+    process();
+    for (size_t i = 0; i < sizeof(fast_bits); i++)
+    {
+        send_partial_bit(fast_bits[i], SYMBOL_SAMPLE_SIZE / 3);
+        process();
+    }
+
+    // Falls back to the configured rate after a run of weak bits once the signal is gone
+    for (int i = 0; i < 6; i++)
+    {
+        send_silence(SYMBOL_SAMPLE_SIZE);
+        process();
+    }
+    TEST_ASSERT_EQUAL(SYMBOL_SAMPLE_SIZE, handle.symbol_sample_size);
+
+    TEST_ASSERT_TRUE(circular_buffer_count(&bit_circular_buffer) >= 2 + sizeof(fast_bits));
+    bool bit;
+    circular_buffer_pop(&bit_circular_buffer, &bit);
+    TEST_ASSERT_EQUAL(1, bit);
+    circular_buffer_pop(&bit_circular_buffer, &bit);
+    TEST_ASSERT_EQUAL(0, bit);
+    for (size_t i = 0; i < sizeof(fast_bits); i++)
+    {
+        circular_buffer_pop(&bit_circular_buffer, &bit);
+        TEST_ASSERT_EQUAL_MESSAGE(fast_bits[i], bit, "Decoded fast bit does not match what was sent");
+    }
+}
+
+void clock_drift(void)
+{
+    LOG_INFO("===== CLOCK DRIFT =====");
+    TEST_ASSERT_EQUAL(0, fsk_decoder_init(&handle));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_frequencies(&handle, F0, F1));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_power_threshold(&handle, POWER_THRESHOLD));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_sample_rate(&handle, DRIFT_SAMPLE_RATE));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_sample_size(&handle, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, BUFFER_SYMBOL_COUNT));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_rate(&handle, DRIFT_BAUD_RATE));
+    process();
+
+    // Alternating bits to lock onto, then runs of equal bits long enough that a clock following
+    // neither the fraction of a sample per symbol nor the drift would slip a bit somewhere
+    bool bits[160];
+    size_t bit_count = 0;
+    for (int i = 0; i < 32; i++)
+    {
+        bits[bit_count++] = i & 1;
+    }
+    const int runs[] = {20, 3, 24, 1, 30, 2, 25};
+    for (size_t run = 0; run < sizeof(runs) / sizeof(runs[0]); run++)
+    {
+        for (int i = 0; i < runs[run]; i++)
+        {
+            bits[bit_count++] = run & 1;
+        }
+    }
+
+    send_silence(DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+    send_fsk(bits, bit_count, DRIFT_SAMPLE_RATE, DRIFT_SAMPLE_RATE / (DRIFT_BAUD_RATE * (1.0f + DRIFT_CLOCK_OFFSET)), 2048.0f, 2047.0f);
+    TEST_ASSERT_FLOAT_WITHIN(0.004f, DRIFT_CLOCK_OFFSET, handle.clock_offset);
+    send_noise(4 * DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE); // Flushes out the last bit
+    process();
+
+    // The edge out of silence doesn't lag by the filter delay like the ones after it, which
+    // can cost a bit ahead of the first, before the clock has been set to a tone change
+    size_t extra = circular_buffer_count(&bit_circular_buffer) - bit_count;
+    TEST_ASSERT_TRUE(circular_buffer_count(&bit_circular_buffer) >= bit_count && extra <= 1);
+    bool bit;
+    while (extra--)
+    {
+        circular_buffer_pop(&bit_circular_buffer, &bit);
+    }
+    for (size_t i = 0; i < bit_count; i++)
+    {
+        circular_buffer_pop(&bit_circular_buffer, &bit);
+        TEST_ASSERT_EQUAL_MESSAGE(bits[i], bit, "Decoded bit does not match what was sent");
+    }
+}
+
+void quiet_s16_samples(void)
+{
+    LOG_INFO("===== QUIET S16 SAMPLES =====");
+    TEST_ASSERT_EQUAL(0, fsk_decoder_init(&handle));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_frequencies(&handle, F0, F1));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_power_threshold(&handle, POWER_THRESHOLD));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_sample_rate(&handle, DRIFT_SAMPLE_RATE));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_sample_size(&handle, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, BUFFER_SYMBOL_COUNT));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_rate(&handle, DRIFT_BAUD_RATE));
+    TEST_ASSERT_EQUAL(-1, fsk_decoder_set_sample_format(&handle, (pc_sample_format_e)42));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_sample_format(&handle, PC_SAMPLE_FORMAT_S16));
+    process();
+
+    bool bits[64];
+    size_t bit_count = 0;
+    for (int i = 0; i < 32; i++)
+    {
+        bits[bit_count++] = i & 1;
+    }
+    for (int i = 0; i < 32; i++)
+    {
+        bits[bit_count++] = (i / 3) & 1;
+    }
+
+    send_fsk(bits, bit_count, DRIFT_SAMPLE_RATE, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, QUIET_DC_OFFSET, QUIET_AMPLITUDE);
+
+    // Reported against input full scale whatever gain the AGC settled on, so CSMA thresholds still hold
+    float expected_energy = 0.5f * (QUIET_AMPLITUDE / 32768.0f) * (QUIET_AMPLITUDE / 32768.0f);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f * expected_energy, expected_energy, fsk_decoder_channel_energy(&handle));
+
+    send_noise(4 * DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE); // Flushes out the last bit, the noise may be decided on too
+    process();
+
+    TEST_ASSERT_TRUE(circular_buffer_count(&bit_circular_buffer) >= bit_count);
+    bool bit;
+    for (size_t i = 0; i < bit_count; i++)
+    {
+        circular_buffer_pop(&bit_circular_buffer, &bit);
+        TEST_ASSERT_EQUAL_MESSAGE(bits[i], bit, "Decoded bit does not match what was sent");
+    }
+}
+
+void squelch(void)
+{
+    LOG_INFO("===== SQUELCH =====");
+    TEST_ASSERT_EQUAL(0, fsk_decoder_init(&handle));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_frequencies(&handle, F0, F1));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_power_threshold(&handle, POWER_THRESHOLD));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_sample_rate(&handle, DRIFT_SAMPLE_RATE));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_sample_size(&handle, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, BUFFER_SYMBOL_COUNT));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_rate(&handle, DRIFT_BAUD_RATE));
+    process();
+
+    // The floor starts low with the squelch open, then learns the noise
+    for (int i = 0; i < SQUELCH_LEARN_SYMBOLS; i++)
+    {
+        send_noise(DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+        process();
+    }
+    TEST_ASSERT_TRUE(fsk_decoder_noise_floor(&handle) > 1e-3f);
+
+    // Once it has, noise doesn't make it to the bit path at all
+    circular_buffer_reset(&bit_circular_buffer);
+    for (int i = 0; i < DRIFT_BAUD_RATE; i++)
+    {
+        send_noise(DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+        process();
+        TEST_ASSERT_FALSE(fsk_decoder_signal_detected(&handle));
+    }
+    TEST_ASSERT_EQUAL(0, circular_buffer_count(&bit_circular_buffer));
+
+    // A signal clear of the floor opens it in time for its first bit
+    bool bits[32];
+    for (size_t i = 0; i < 32; i++)
+    {
+        bits[i] = i & 1;
+    }
+    send_fsk(bits, 32, DRIFT_SAMPLE_RATE, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, 2048.0f, 2047.0f);
+    send_noise(4 * DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE); // Flushes out the last bit, the noise may be decided on too
+    process();
+
+    TEST_ASSERT_TRUE(circular_buffer_count(&bit_circular_buffer) >= 32);
+    bool bit;
+    for (size_t i = 0; i < 32; i++)
+    {
+        circular_buffer_pop(&bit_circular_buffer, &bit);
+        TEST_ASSERT_EQUAL_MESSAGE(bits[i], bit, "Decoded bit does not match what was sent");
+    }
+}
+
+void channel_level(void)
+{
+    LOG_INFO("===== CHANNEL LEVEL =====");
+    TEST_ASSERT_EQUAL(0, fsk_decoder_init(&handle));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_frequencies(&handle, F0, F1));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_power_threshold(&handle, POWER_THRESHOLD));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_sample_rate(&handle, DRIFT_SAMPLE_RATE));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_sample_size(&handle, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, BUFFER_SYMBOL_COUNT));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_rate(&handle, DRIFT_BAUD_RATE));
+    process();
+
+    for (int i = 0; i < SQUELCH_LEARN_SYMBOLS; i++)
+    {
+        send_tones_in_noise(0.0f, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+        process();
+    }
+    TEST_ASSERT_TRUE(fsk_decoder_channel_level(&handle) < LEVEL_BUSY);
+
+    // A carrier that's never decoded stays busy, the floor doesn't learn it as noise
+    for (int i = 0; i < LEVEL_TONE_SYMBOLS; i++)
+    {
+        send_tones_in_noise(LEVEL_TONE, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+        process();
+        if (i >= 4)
+        {
+            TEST_ASSERT_TRUE(fsk_decoder_channel_level(&handle) >= LEVEL_BUSY);
+        }
+    }
+
+    // and the channel is quiet again as soon as it's gone
+    for (int i = 0; i < 4; i++)
+    {
+        send_tones_in_noise(0.0f, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+        process();
+    }
+    TEST_ASSERT_TRUE(fsk_decoder_channel_level(&handle) < LEVEL_BUSY);
+}
+
+void idle_channel(void)
+{
+    LOG_INFO("===== IDLE CHANNEL =====");
+    TEST_ASSERT_EQUAL(0, fsk_decoder_init(&handle));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_frequencies(&handle, F0, F1));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_power_threshold(&handle, POWER_THRESHOLD));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_sample_rate(&handle, DRIFT_SAMPLE_RATE));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_sample_size(&handle, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, BUFFER_SYMBOL_COUNT));
+    TEST_ASSERT_EQUAL(0, fsk_decoder_set_symbol_rate(&handle, DRIFT_BAUD_RATE));
+    process();
+
+    for (int i = 0; i < SQUELCH_LEARN_SYMBOLS; i++)
+    {
+        send_noise(DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+        process();
+    }
+
+    // Once the channel is known to be quiet the tone filters sleep through nearly all of it
+    uint32_t samples = STAT_GET(handle.stats.samples);
+    uint32_t idle = STAT_GET(handle.stats.idle_samples);
+    for (int i = 0; i < DRIFT_BAUD_RATE; i++)
+    {
+        send_noise(DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+        process();
+    }
+    samples = STAT_GET(handle.stats.samples) - samples;
+    idle = STAT_GET(handle.stats.idle_samples) - idle;
+    TEST_ASSERT_TRUE(idle > samples * 9 / 10);
+
+    // and a frame wakes them in time for its first bit
+    circular_buffer_reset(&bit_circular_buffer);
+    bool bits[32];
+    for (size_t i = 0; i < 32; i++)
+    {
+        bits[i] = (i / 3) & 1;
+    }
+    send_fsk(bits, 32, DRIFT_SAMPLE_RATE, DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE, 2048.0f, 2047.0f);
+    send_noise(4 * DRIFT_SAMPLE_RATE / DRIFT_BAUD_RATE);
+    process();
+
+    TEST_ASSERT_TRUE(circular_buffer_count(&bit_circular_buffer) >= 32);
+    bool bit;
+    for (size_t i = 0; i < 32; i++)
+    {
+        circular_buffer_pop(&bit_circular_buffer, &bit);
+        TEST_ASSERT_EQUAL_MESSAGE(bits[i], bit, "Decoded bit does not match what was sent");
+    }
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -388,6 +733,13 @@ int main(void)
     RUN_TEST(timing_recovery);
     RUN_TEST(auto_timing_recovery);
     RUN_TEST(test_baud32);
+    RUN_TEST(fast_rate_decoding);
+    RUN_TEST(runtime_reconfiguration);
+    RUN_TEST(clock_drift);
+    RUN_TEST(quiet_s16_samples);
+    RUN_TEST(squelch);
+    RUN_TEST(idle_channel);
+    RUN_TEST(channel_level);
 
     return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "unity.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "decoding/fsk_bank.h"
+#include "encoding/packet_serializer.h"
+#include "encoding/bit_stuffer.h"
+#include "utils/bit_unpacker.h"
+#include "utils/fsk_utils.h"
+#include "interface/pconfig.h"
+#include "c-logger.h"
+#include "packet.h"
+
+// Frames on two tone pairs sharing one ADC, overlapping in time. Each pair's channel should
+// decode its own frame and nothing of the other's.
+
+#define SAMPLE_RATE (26250)
+#define BAUD_RATE (250)
+#define SAMPLES_PER_SYMBOL (SAMPLE_RATE / BAUD_RATE)
+#define PAIR_A_F0 (1200)
+#define PAIR_A_F1 (2200)
+#define PAIR_B_F0 (4000)
+#define PAIR_B_F1 (5000)
+#define TONE_AMPLITUDE (800.0f)        // ADC counts per pair, both together stay inside the 12-bit range
+#define NOISE_AMPLITUDE (40)           // ADC counts of noise under the tones
+#define LEAD_IN (SAMPLE_RATE)          // Noise before the first frame
+#define PAIR_B_OFFSET (37 * SAMPLES_PER_SYMBOL / 10) // Pair B starts 3.7 symbols after pair A
+#define TAIL (8 * SAMPLES_PER_SYMBOL)  // Noise after the last frame, flushes out its last bits
+#define FRAME_HEADER_BYTES (3)        // Sync word and rate byte, sent unstuffed
+#define MAX_FRAME_BITS (8 * (FRAME_HEADER_BYTES + PACKET_SIZE) * 6 / 5 + 8) // A stuffed bit after every five at most
+#define INPUT_SAMPLES (2 * 1024)
+#define CHUNK (1024)
+
+typedef struct
+{
+    bool bits[MAX_FRAME_BITS];
+    size_t bit_count;
+    int start;   // Sample the frame starts on
+    float f0, f1;
+    float phase;
+} tone_pair_t;
+
+static fsk_bank_t bank;
+static uint16_t input[INPUT_SAMPLES];
+static tone_pair_t pairs[2];
+
+void setUp(void)
+{
+    log_init(LOG_LEVEL_ERROR);
+    srand(1);
+
+    pc_config_t config = {
+        .baud_rate = BAUD_RATE,
+        .sample_rate = SAMPLE_RATE,
+        .sample_format = PC_SAMPLE_FORMAT_U12,
+        .fsk_power_threshold = pconfigFSK_POWER_THRESHOLD,
+        .decoder_buffer_symbol_count = pconfigDECODER_BUFFER_SYMBOL_COUNT,
+    };
+    TEST_ASSERT_EQUAL(0, fsk_bank_init(&bank, &config));
+    TEST_ASSERT_EQUAL(0, fsk_bank_set_input_buffer(&bank, input, INPUT_SAMPLES));
+}
+
+void tearDown(void)
+{
+}
+
+static void build_packet(packet_t *packet, uint8_t id)
+{
+    uint8_t payload[16];
+    for (size_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (uint8_t)(i * 53 + id);
+    }
+
+    TEST_ASSERT_EQUAL(0, initialize_packet(packet, PACKET_TYPE_DATA, 0x01, 0x02, id, payload, sizeof(payload)));
+}
+
+// Frame bits the way the modem sends them, the header as is and the packet bit stuffed
+static void build_frame(tone_pair_t *pair, const packet_t *packet)
+{
+    uint8_t bytes[FRAME_HEADER_BYTES + PACKET_SIZE];
+    circular_buffer_t buffer;
+    TEST_ASSERT_EQUAL(0, circular_buffer_static_init(&buffer, bytes, sizeof(uint8_t), sizeof(bytes)));
+
+    uint8_t header[FRAME_HEADER_BYTES] = {pconfigPREAMBLE_BYTE_1, pconfigPREAMBLE_BYTE_2, fsk_rate_encode(FSK_RATE_BASE)};
+    for (size_t i = 0; i < sizeof(header); i++)
+    {
+        TEST_ASSERT_EQUAL(0, circular_buffer_push(&buffer, &header[i]));
+    }
+    TEST_ASSERT_EQUAL(0, packet_serializer_serialize(packet, &buffer));
+
+    bit_unpacker_t unpacker;
+    bit_stuffer_t stuffer;
+    bit_unpacker_init(&unpacker);
+    bit_stuffer_init(&stuffer);
+
+    size_t header_bits = 8 * FRAME_HEADER_BYTES;
+    size_t data_bits = 8 * circular_buffer_count(&buffer);
+    pair->bit_count = 0;
+    while (data_bits > 0)
+    {
+        bool bit;
+        if (pair->bit_count < header_bits)
+        {
+            TEST_ASSERT_EQUAL(0, bit_unpacker_pop(&unpacker, &buffer, &bit));
+            data_bits--;
+        }
+        else
+        {
+            bool consumed;
+            TEST_ASSERT_EQUAL(0, bit_unpacker_peek(&unpacker, &buffer, &bit));
+            TEST_ASSERT_EQUAL(0, bit_stuffer_process(&stuffer, bit, &bit, &consumed));
+            if (consumed)
+            {
+                bool dropped;
+                bit_unpacker_pop(&unpacker, &buffer, &dropped);
+                data_bits--;
+            }
+        }
+        TEST_ASSERT_LESS_THAN(MAX_FRAME_BITS, pair->bit_count);
+        pair->bits[pair->bit_count++] = bit;
+    }
+}
+
+// Both pairs' tones with continuous phase, over a little noise
+static uint16_t next_sample(int n)
+{
+    float x = (float)((rand() % (2 * NOISE_AMPLITUDE + 1)) - NOISE_AMPLITUDE);
+    for (size_t p = 0; p < 2; p++)
+    {
+        tone_pair_t *pair = &pairs[p];
+        int symbol = (n - pair->start) / SAMPLES_PER_SYMBOL;
+        if (n < pair->start || (size_t)symbol >= pair->bit_count)
+        {
+            continue;
+        }
+
+        float frequency = pair->bits[symbol] ? pair->f1 : pair->f0;
+        pair->phase = fmodf(pair->phase + 2.0f * (float)M_PI * frequency / SAMPLE_RATE, 2.0f * (float)M_PI);
+        x += TONE_AMPLITUDE * sinf(pair->phase);
+    }
+
+    return (uint16_t)(2048.0f + x);
+}
+
+static void run(int sample_count)
+{
+    uint16_t chunk[CHUNK];
+    for (int n = 0; n < sample_count;)
+    {
+        int count = sample_count - n < CHUNK ? sample_count - n : CHUNK;
+        for (int i = 0; i < count; i++)
+        {
+            chunk[i] = next_sample(n + i);
+        }
+        TEST_ASSERT_EQUAL(0, fsk_bank_process_samples(&bank, chunk, (size_t)count));
+        TEST_ASSERT_EQUAL(0, fsk_bank_task(&bank));
+        n += count;
+    }
+}
+
+static void assert_received(decoder_handle_t *decoder, const packet_t *expected)
+{
+    TEST_ASSERT_TRUE(decoder_has_packet(decoder));
+
+    packet_t packet;
+    TEST_ASSERT_EQUAL(0, decoder_get_packet(decoder, &packet));
+    TEST_ASSERT_EQUAL_UINT8(expected->content.id, packet.content.id);
+    TEST_ASSERT_EQUAL_UINT8(expected->content.payload_length, packet.content.payload_length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->content.payload, packet.content.payload, expected->content.payload_length);
+
+    TEST_ASSERT_FALSE(decoder_has_packet(decoder));
+}
+
+void test_overlapping_frames_decode_on_their_own_channels(void)
+{
+    TEST_ASSERT_EQUAL(0, fsk_bank_add_channel(&bank, PAIR_A_F0, PAIR_A_F1));
+    TEST_ASSERT_EQUAL(1, fsk_bank_add_channel(&bank, PAIR_B_F0, PAIR_B_F1));
+
+    // Channels come up over the first few tasks
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(0, fsk_bank_task(&bank));
+    }
+    TEST_ASSERT_EQUAL(FSK_BANK_STATE_RUNNING, bank.state);
+
+    packet_t packet_a, packet_b;
+    build_packet(&packet_a, 11);
+    build_packet(&packet_b, 22);
+
+    memset(pairs, 0, sizeof(pairs));
+    pairs[0].start = LEAD_IN;
+    pairs[0].f0 = PAIR_A_F0;
+    pairs[0].f1 = PAIR_A_F1;
+    build_frame(&pairs[0], &packet_a);
+    pairs[1].start = LEAD_IN + PAIR_B_OFFSET;
+    pairs[1].f0 = PAIR_B_F0;
+    pairs[1].f1 = PAIR_B_F1;
+    build_frame(&pairs[1], &packet_b);
+
+    size_t longest = pairs[0].bit_count > pairs[1].bit_count ? pairs[0].bit_count : pairs[1].bit_count;
+    run(LEAD_IN + PAIR_B_OFFSET + (int)longest * SAMPLES_PER_SYMBOL + TAIL);
+
+    assert_received(fsk_bank_channel(&bank, 0), &packet_a);
+    assert_received(fsk_bank_channel(&bank, 1), &packet_b);
+}
+
+void test_channels_only_added_before_running(void)
+{
+    for (int i = 0; i < pconfigFSK_BANK_MAX_CHANNELS; i++)
+    {
+        TEST_ASSERT_EQUAL(i, fsk_bank_add_channel(&bank, 1200 + 1500 * i, 1700 + 1500 * i));
+    }
+    TEST_ASSERT_EQUAL(-1, fsk_bank_add_channel(&bank, 9000, 9500));
+    TEST_ASSERT_NULL(fsk_bank_channel(&bank, pconfigFSK_BANK_MAX_CHANNELS));
+
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(0, fsk_bank_task(&bank));
+    }
+    TEST_ASSERT_EQUAL(FSK_BANK_STATE_RUNNING, bank.state);
+    TEST_ASSERT_EQUAL(-1, fsk_bank_add_channel(&bank, 9000, 9500));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_overlapping_frames_decode_on_their_own_channels);
+    RUN_TEST(test_channels_only_added_before_running);
+
+    return UNITY_END();
+}
@@ -73,6 +73,128 @@ void test_packet_decoding(void)
     TEST_ASSERT_EQUAL_INT_MESSAGE(1, packets_received, "We should have decoded 1 packet");
 }
 
+void test_back_to_back_frames(void)
+{
+    uint8_t serialized_packet[256];
+    circular_buffer_t serialized_buffer;
+    circular_buffer_static_init(&serialized_buffer, serialized_packet, sizeof(uint8_t), sizeof(serialized_packet));
+
+    uint8_t payload[] = {0xCA, 0xFE};
+    packet_t test_packet;
+    initialize_packet(&test_packet, PACKET_TYPE_DATA, 0x01, 0x02, 0x10, payload, sizeof(payload));
+
+    // A frame cut off mid payload, followed by two complete frames under the same keying.
+    // Every frame starts with a sync word, which resets the packet decoder.
+    packet_serializer_serialize(&test_packet, &serialized_buffer);
+    size_t truncated = circular_buffer_count(&serialized_buffer) - 3;
+    for (size_t i = 0; i < truncated; i++)
+    {
+        uint8_t byte;
+        circular_buffer_pop(&serialized_buffer, &byte);
+        packet_decoder_process_byte(&packet_decoder_handle, byte);
+    }
+
+    for (int frame = 0; frame < 2; frame++)
+    {
+        packet_decoder_reset(&packet_decoder_handle);
+
+        circular_buffer_static_init(&serialized_buffer, serialized_packet, sizeof(uint8_t), sizeof(serialized_packet));
+        packet_serializer_serialize(&test_packet, &serialized_buffer);
+        while (circular_buffer_count(&serialized_buffer))
+        {
+            uint8_t byte;
+            circular_buffer_pop(&serialized_buffer, &byte);
+            packet_decoder_process_byte(&packet_decoder_handle, byte);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(2, packets_received, "Both complete frames should decode");
+    TEST_ASSERT_EQUAL_HEX8(0xCA, last_processed_packet.content.payload[0]);
+}
+
+void test_empty_payload_frame(void)
+{
+    uint8_t serialized_packet[256];
+    circular_buffer_t serialized_buffer;
+    circular_buffer_static_init(&serialized_buffer, serialized_packet, sizeof(uint8_t), sizeof(serialized_packet));
+
+    packet_t test_packet;
+    initialize_packet(&test_packet, PACKET_TYPE_ACK, 0x01, 0x02, 0x10, NULL, 0);
+    packet_serializer_serialize(&test_packet, &serialized_buffer);
+
+    // The header is the whole frame, it has to decode without waiting for a byte after it
+    while (circular_buffer_count(&serialized_buffer))
+    {
+        uint8_t byte;
+        circular_buffer_pop(&serialized_buffer, &byte);
+        packet_decoder_process_byte(&packet_decoder_handle, byte);
+    }
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, packets_received, "A frame without payload should decode on its last header byte");
+    TEST_ASSERT_EQUAL(PACKET_TYPE_ACK, last_processed_packet.content.type);
+}
+
+void test_fragment_extension_round_trip(void)
+{
+    uint8_t serialized_packet[256];
+    circular_buffer_t serialized_buffer;
+    circular_buffer_static_init(&serialized_buffer, serialized_packet, sizeof(uint8_t), sizeof(serialized_packet));
+
+    uint8_t payload[] = {0x01, 0x02, 0x03};
+    packet_t test_packet;
+    initialize_packet(&test_packet, PACKET_TYPE_DATA, 0x01, 0x02, 0x10, payload, sizeof(payload));
+    packet_set_fragment(&test_packet, 7, 2, 3);
+
+    packet_serializer_serialize(&test_packet, &serialized_buffer);
+    TEST_ASSERT_EQUAL(PACKET_HEADER_SIZE + PACKET_FRAGMENT_EXTENSION_SIZE + sizeof(payload), circular_buffer_count(&serialized_buffer));
+
+    while (circular_buffer_count(&serialized_buffer))
+    {
+        uint8_t byte;
+        circular_buffer_pop(&serialized_buffer, &byte);
+        packet_decoder_process_byte(&packet_decoder_handle, byte);
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, packets_received);
+    TEST_ASSERT_EQUAL_HEX8(PACKET_FLAG_FRAGMENT, last_processed_packet.content.flags);
+    TEST_ASSERT_EQUAL(7, last_processed_packet.content.fragment.message_id);
+    TEST_ASSERT_EQUAL(2, last_processed_packet.content.fragment.index);
+    TEST_ASSERT_EQUAL(3, last_processed_packet.content.fragment.count);
+    TEST_ASSERT_EQUAL_MEMORY(payload, last_processed_packet.content.payload, sizeof(payload));
+}
+
+void test_rejection_counters(void)
+{
+    uint8_t serialized_packet[256];
+    circular_buffer_t serialized_buffer;
+    circular_buffer_static_init(&serialized_buffer, serialized_packet, sizeof(uint8_t), sizeof(serialized_packet));
+
+    uint8_t payload[] = {0xCA, 0xFE};
+    packet_t test_packet;
+    initialize_packet(&test_packet, PACKET_TYPE_DATA, 0x01, 0x02, 0x10, payload, sizeof(payload));
+    packet_serializer_serialize(&test_packet, &serialized_buffer);
+
+    // Last payload byte flipped
+    size_t length = circular_buffer_count(&serialized_buffer);
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t byte;
+        circular_buffer_pop(&serialized_buffer, &byte);
+        packet_decoder_process_byte(&packet_decoder_handle, i == length - 1 ? byte ^ 0xFF : byte);
+    }
+    TEST_ASSERT_EQUAL(0, packets_received);
+    TEST_ASSERT_EQUAL(1, STAT_GET(packet_decoder_handle.stats.crc_failed));
+    TEST_ASSERT_EQUAL(0, STAT_GET(packet_decoder_handle.stats.crc_passed));
+
+    // Header announcing a payload that can't fit
+    const uint8_t header[] = {0x01, 0x02, 0x11, 0x51, 0x00, 0xFF, 0x00, 0x00};
+    for (size_t i = 0; i < sizeof(header); i++)
+    {
+        packet_decoder_process_byte(&packet_decoder_handle, header[i]);
+    }
+    TEST_ASSERT_EQUAL(1, STAT_GET(packet_decoder_handle.stats.length_rejected));
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -80,6 +202,10 @@ int main(void)
     log_init(LOG_LEVEL_INFO);
 
     RUN_TEST(test_packet_decoding);
+    RUN_TEST(test_back_to_back_frames);
+    RUN_TEST(test_empty_payload_frame);
+    RUN_TEST(test_fragment_extension_round_trip);
+    RUN_TEST(test_rejection_counters);
 
     return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "unity.h"
+
+#include "encoding/compression.h"
+#include "c-logger.h"
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BUFFER_SIZE (512)
+#define TIMING_RUNS (200)
+
+static const char *messages[] = {
+    "OK",
+    "status: online, battery 3.92V, temp 21.4C, rssi -87",
+    "{\"id\":12,\"temp\":21.5,\"batt\":3.91,\"status\":\"ok\"}",
+    "lat 47.6205 lon -122.3493 alt 56 sats 9 speed 0.0 heading 270",
+    "seq 1042 temp 21.4 humidity 48% pressure 1013.2hPa; seq 1043 temp 21.4 humidity 48% pressure 1013.1hPa; "
+    "seq 1044 temp 21.5 humidity 47% pressure 1013.1hPa; seq 1045 temp 21.5 humidity 47% pressure 1013.0hPa",
+};
+
+static uint8_t compressed[BUFFER_SIZE];
+static uint8_t decompressed[BUFFER_SIZE];
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_round_trip_and_report(void)
+{
+    size_t total_in = 0;
+    size_t total_out = 0;
+
+    printf("%-8s %-8s %-8s %-12s\n", "bytes", "packed", "ratio", "us/message");
+    for (size_t i = 0; i < sizeof(messages) / sizeof(messages[0]); i++)
+    {
+        const uint8_t *input = (const uint8_t *)messages[i];
+        size_t input_len = strlen(messages[i]);
+        size_t compressed_len = 0;
+        size_t decompressed_len = 0;
+
+        TEST_ASSERT_EQUAL(0, compression_compress(input, input_len, compressed, sizeof(compressed), &compressed_len));
+        TEST_ASSERT_EQUAL(0, compression_decompress(compressed, compressed_len, decompressed, sizeof(decompressed), &decompressed_len));
+        TEST_ASSERT_EQUAL(input_len, decompressed_len);
+        TEST_ASSERT_EQUAL_MEMORY(input, decompressed, input_len);
+
+        clock_t start = clock();
+        for (int run = 0; run < TIMING_RUNS; run++)
+        {
+            compression_compress(input, input_len, compressed, sizeof(compressed), &compressed_len);
+        }
+        double us = 1e6 * (double)(clock() - start) / CLOCKS_PER_SEC / TIMING_RUNS;
+
+        printf("%-8zu %-8zu %-8.2f %-12.1f\n", input_len, compressed_len, (double)input_len / compressed_len, us);
+        total_in += input_len;
+        total_out += compressed_len;
+    }
+    printf("Overall ratio %.2f\n", (double)total_in / total_out);
+
+    // Telemetry-like text should shrink noticeably
+    TEST_ASSERT_TRUE(total_out * 10 < total_in * 8);
+}
+
+void test_incompressible_data_gives_up(void)
+{
+    uint8_t input[64];
+    uint32_t state = 0x12345678;
+    for (size_t i = 0; i < sizeof(input); i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        input[i] = (uint8_t)state;
+    }
+
+    // The caller only asks for output smaller than the input
+    size_t compressed_len = 0;
+    TEST_ASSERT_EQUAL(-1, compression_compress(input, sizeof(input), compressed, sizeof(input) - 1, &compressed_len));
+}
+
+void test_rejects_corrupt_input(void)
+{
+    // A match pointing further back than the dictionary reaches
+    const uint8_t corrupt[] = {0x00, 0xFF, 0xF0};
+    size_t decompressed_len = 0;
+    TEST_ASSERT_EQUAL(-1, compression_decompress(corrupt, sizeof(corrupt), decompressed, sizeof(decompressed), &decompressed_len));
+
+    // Output that doesn't fit
+    const char *text = "temperature temperature temperature";
+    size_t compressed_len = 0;
+    compression_compress((const uint8_t *)text, strlen(text), compressed, sizeof(compressed), &compressed_len);
+    TEST_ASSERT_EQUAL(-1, compression_decompress(compressed, compressed_len, decompressed, 10, &decompressed_len));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    log_init(LOG_LEVEL_INFO);
+
+    RUN_TEST(test_round_trip_and_report);
+    RUN_TEST(test_incompressible_data_gives_up);
+    RUN_TEST(test_rejects_corrupt_input);
+
+    return UNITY_END();
+}
@@ -0,0 +1,186 @@
+#include "unity.h"
+
+#include "fragmentation.h"
+#include "packet.h"
+#include "c-logger.h"
+#include "interface/pconfig.h"
+#include "utils/time_utils.h"
+#include <string.h>
+
+#define SRC_ADDR (0x02)
+#define DEST_ADDR (0x01)
+
+extern void mock_time_set_us(uint64_t us);
+extern void mock_time_advance_us(uint64_t us);
+
+static fragmentation_handle_t fragmentation;
+static uint8_t message[pconfigMAX_MESSAGE_SIZE];
+static uint8_t reassembled[pconfigMAX_MESSAGE_SIZE];
+
+static packet_t _fragment(uint8_t src, uint8_t message_id, uint8_t index, size_t length)
+{
+    uint8_t count = fragmentation_count(length);
+    size_t offset = (size_t)index * pconfigMAX_PAYLOAD_SIZE;
+    size_t fragment_length = (length - offset > pconfigMAX_PAYLOAD_SIZE) ? pconfigMAX_PAYLOAD_SIZE : length - offset;
+
+    packet_t packet;
+    memset(&packet, 0, sizeof(packet));
+    initialize_packet(&packet, PACKET_TYPE_DATA, src, DEST_ADDR, index, message + offset, fragment_length);
+    packet_set_fragment(&packet, message_id, index, count);
+    return packet;
+}
+
+void setUp(void)
+{
+    mock_time_set_us(0);
+    fragmentation_init(&fragmentation);
+    for (size_t i = 0; i < sizeof(message); i++)
+    {
+        message[i] = (uint8_t)(i * 31 + 7);
+    }
+}
+
+void tearDown(void)
+{
+}
+
+void test_fragment_count(void)
+{
+    TEST_ASSERT_EQUAL(1, fragmentation_count(0));
+    TEST_ASSERT_EQUAL(1, fragmentation_count(pconfigMAX_PAYLOAD_SIZE));
+    TEST_ASSERT_EQUAL(2, fragmentation_count(pconfigMAX_PAYLOAD_SIZE + 1));
+    TEST_ASSERT_EQUAL(FRAGMENTATION_MAX_FRAGMENTS, fragmentation_count(pconfigMAX_MESSAGE_SIZE));
+}
+
+void test_reassembles_out_of_order_with_duplicates(void)
+{
+    const size_t length = 3 * pconfigMAX_PAYLOAD_SIZE + 5;
+    const uint8_t order[] = {3, 1, 1, 0, 2};
+    size_t reassembled_length = 0;
+
+    for (size_t i = 0; i < sizeof(order); i++)
+    {
+        TEST_ASSERT_EQUAL(0, reassembled_length);
+        packet_t packet = _fragment(SRC_ADDR, 9, order[i], length);
+        TEST_ASSERT_EQUAL(0, fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length));
+    }
+
+    TEST_ASSERT_EQUAL(length, reassembled_length);
+    TEST_ASSERT_EQUAL_MEMORY(message, reassembled, length);
+    TEST_ASSERT_EQUAL(1, fragmentation.stats.reassembled);
+}
+
+void test_incomplete_message_times_out(void)
+{
+    size_t reassembled_length = 0;
+    packet_t packet = _fragment(SRC_ADDR, 1, 0, 2 * pconfigMAX_PAYLOAD_SIZE);
+    fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length);
+
+    mock_time_advance_us(pconfigREASSEMBLY_TIMEOUT_MS * ONE_MS);
+    fragmentation_task(&fragmentation);
+    TEST_ASSERT_EQUAL(1, fragmentation.stats.timed_out);
+
+    // The late second half alone isn't enough anymore
+    packet = _fragment(SRC_ADDR, 1, 1, 2 * pconfigMAX_PAYLOAD_SIZE);
+    fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length);
+    TEST_ASSERT_EQUAL(0, reassembled_length);
+}
+
+void test_pool_evicts_oldest_message(void)
+{
+    size_t reassembled_length = 0;
+    const size_t length = 2 * pconfigMAX_PAYLOAD_SIZE;
+
+    // Fill every slot with a half finished message, the first one is the oldest
+    for (uint8_t message_id = 0; message_id <= pconfigREASSEMBLY_SLOTS; message_id++)
+    {
+        packet_t packet = _fragment(SRC_ADDR, message_id, 0, length);
+        fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length);
+        mock_time_advance_us(ONE_MS);
+    }
+    TEST_ASSERT_EQUAL(1, fragmentation.stats.evicted);
+
+    packet_t packet = _fragment(SRC_ADDR, 0, 1, length);
+    fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length);
+    TEST_ASSERT_EQUAL(0, reassembled_length);
+
+    packet = _fragment(SRC_ADDR, pconfigREASSEMBLY_SLOTS, 1, length);
+    fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length);
+    TEST_ASSERT_EQUAL(length, reassembled_length);
+}
+
+void test_rejects_malformed_fragments(void)
+{
+    size_t reassembled_length = 0;
+    packet_t packet = _fragment(SRC_ADDR, 0, 0, 2 * pconfigMAX_PAYLOAD_SIZE);
+
+    // Only the last fragment may be short
+    packet.content.payload_length = pconfigMAX_PAYLOAD_SIZE - 1;
+    TEST_ASSERT_EQUAL(-1, fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length));
+
+    packet = _fragment(SRC_ADDR, 0, 0, 2 * pconfigMAX_PAYLOAD_SIZE);
+    packet.content.fragment.index = 2;
+    TEST_ASSERT_EQUAL(-1, fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length));
+}
+
+void test_largest_message_fills_slot_exactly(void)
+{
+    size_t reassembled_length = 0;
+    uint8_t count = fragmentation_count(pconfigMAX_MESSAGE_SIZE);
+    TEST_ASSERT_EQUAL(FRAGMENTATION_MAX_FRAGMENTS, count);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        packet_t packet = _fragment(SRC_ADDR, 0, i, pconfigMAX_MESSAGE_SIZE);
+        TEST_ASSERT_EQUAL(0, fragmentation_reassemble(&fragmentation, &packet, reassembled, &reassembled_length));
+    }
+
+    TEST_ASSERT_EQUAL(pconfigMAX_MESSAGE_SIZE, reassembled_length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(message, reassembled, pconfigMAX_MESSAGE_SIZE);
+}
+
+void test_delivery_reported_once_per_message(void)
+{
+    fragmentation_tx_status_e status;
+    uint8_t first_id;
+
+    // Ids wrap around the 8-bit sequence space
+    TEST_ASSERT_EQUAL(0, fragmentation_track_tx(&fragmentation, SRC_ADDR, 254, 3));
+
+    fragmentation_tx_result(&fragmentation, SRC_ADDR, 255, true, &status, &first_id);
+    TEST_ASSERT_EQUAL(FRAGMENTATION_TX_IN_PROGRESS, status);
+    fragmentation_tx_result(&fragmentation, SRC_ADDR, 254, true, &status, &first_id);
+    TEST_ASSERT_EQUAL(FRAGMENTATION_TX_IN_PROGRESS, status);
+    fragmentation_tx_result(&fragmentation, SRC_ADDR, 0, true, &status, &first_id);
+    TEST_ASSERT_EQUAL(FRAGMENTATION_TX_DELIVERED, status);
+    TEST_ASSERT_EQUAL(254, first_id);
+
+    // Plain packets aren't tracked
+    fragmentation_tx_result(&fragmentation, SRC_ADDR, 1, true, &status, &first_id);
+    TEST_ASSERT_EQUAL(FRAGMENTATION_TX_NOT_TRACKED, status);
+
+    // One lost fragment fails the message, exactly once
+    fragmentation_track_tx(&fragmentation, SRC_ADDR, 10, 2);
+    fragmentation_tx_result(&fragmentation, SRC_ADDR, 10, false, &status, &first_id);
+    TEST_ASSERT_EQUAL(FRAGMENTATION_TX_FAILED, status);
+    fragmentation_tx_result(&fragmentation, SRC_ADDR, 11, true, &status, &first_id);
+    TEST_ASSERT_EQUAL(FRAGMENTATION_TX_IN_PROGRESS, status);
+    TEST_ASSERT_TRUE(fragmentation_tx_available(&fragmentation));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    log_init(LOG_LEVEL_INFO);
+
+    RUN_TEST(test_fragment_count);
+    RUN_TEST(test_reassembles_out_of_order_with_duplicates);
+    RUN_TEST(test_incomplete_message_times_out);
+    RUN_TEST(test_pool_evicts_oldest_message);
+    RUN_TEST(test_rejects_malformed_fragments);
+    RUN_TEST(test_largest_message_fills_slot_exactly);
+    RUN_TEST(test_delivery_reported_once_per_message);
+
+    return UNITY_END();
+}
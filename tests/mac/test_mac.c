@@ -0,0 +1,119 @@
+#include "unity.h"
+
+#include "mac.h"
+#include "c-logger.h"
+#include "interface/pconfig.h"
+#include "utils/time_utils.h"
+#include <stdbool.h>
+
+extern void mock_time_set_us(uint64_t us);
+extern void mock_time_advance_us(uint64_t us);
+
+static mac_handle_t mac;
+
+void setUp(void)
+{
+    mock_time_set_us(0);
+    mac_init(&mac, 0x1234);
+}
+
+void tearDown(void)
+{
+}
+
+// Steps time forward 1 ms at a time until the MAC grants the channel
+static uint64_t _time_until_clear(mac_handle_t *handle, bool channel_busy)
+{
+    uint64_t waited_ms = 0;
+    while (!mac_clear_to_send(handle, channel_busy))
+    {
+        mock_time_advance_us(ONE_MS);
+        waited_ms++;
+        if (waited_ms > 10 * pconfigBACKOFF_MAX_TIME_MS)
+        {
+            TEST_FAIL_MESSAGE("MAC never granted the channel");
+        }
+    }
+    return waited_ms;
+}
+
+void test_idle_channel_waits_listen_window(void)
+{
+    TEST_ASSERT_FALSE(mac_clear_to_send(&mac, false));
+    TEST_ASSERT_EQUAL(MAC_STATE_LISTEN, mac.state);
+
+    uint64_t waited_ms = _time_until_clear(&mac, false);
+
+    TEST_ASSERT_EQUAL(pconfigCSMA_LISTEN_TIME_MS, waited_ms);
+    TEST_ASSERT_EQUAL(1, mac.stats.attempts);
+    TEST_ASSERT_EQUAL(0, mac.stats.collisions);
+}
+
+void test_busy_channel_backs_off(void)
+{
+    TEST_ASSERT_FALSE(mac_clear_to_send(&mac, true));
+    TEST_ASSERT_EQUAL(MAC_STATE_BACKOFF, mac.state);
+    TEST_ASSERT_EQUAL(1, mac.stats.collisions);
+
+    // Channel stays busy for a while, every re-sense should back off again
+    for (int i = 0; i < 2000; i++)
+    {
+        TEST_ASSERT_FALSE(mac_clear_to_send(&mac, true));
+        mock_time_advance_us(ONE_MS);
+    }
+    TEST_ASSERT_TRUE(mac.stats.collisions > 1);
+    TEST_ASSERT_TRUE((pconfigBACKOFF_BASE_TIME_MS << mac.backoff_exponent) <= 2 * pconfigBACKOFF_MAX_TIME_MS);
+
+    // Once it goes quiet we should get through within one max backoff plus a listen window
+    uint64_t waited_ms = _time_until_clear(&mac, false);
+    TEST_ASSERT_TRUE(waited_ms <= pconfigBACKOFF_MAX_TIME_MS + pconfigCSMA_LISTEN_TIME_MS + 1);
+}
+
+void test_busy_during_listen_restarts(void)
+{
+    mac_clear_to_send(&mac, false);
+    mock_time_advance_us((pconfigCSMA_LISTEN_TIME_MS - 1) * ONE_MS);
+
+    TEST_ASSERT_FALSE(mac_clear_to_send(&mac, true));
+    TEST_ASSERT_EQUAL(MAC_STATE_BACKOFF, mac.state);
+}
+
+void test_transmission_resets_backoff(void)
+{
+    mac_clear_to_send(&mac, true);
+    TEST_ASSERT_TRUE(mac.backoff_exponent > 0);
+
+    _time_until_clear(&mac, false);
+    mac_transmission_started(&mac);
+
+    TEST_ASSERT_EQUAL(0, mac.backoff_exponent);
+    TEST_ASSERT_EQUAL(MAC_STATE_IDLE, mac.state);
+    TEST_ASSERT_EQUAL(1, mac.stats.transmissions);
+}
+
+void test_nodes_desynchronize(void)
+{
+    // Two nodes that heard the same frame end must not key up at the same time
+    mac_handle_t other;
+    mac_init(&other, 0xBEEF);
+
+    mac_clear_to_send(&mac, true);
+    mac_clear_to_send(&other, true);
+
+    TEST_ASSERT_TRUE(mac.backoff_timer.finish_time_us != other.backoff_timer.finish_time_us);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    log_init(LOG_LEVEL_INFO);
+
+    RUN_TEST(test_idle_channel_waits_listen_window);
+    RUN_TEST(test_busy_channel_backs_off);
+    RUN_TEST(test_busy_during_listen_restarts);
+    RUN_TEST(test_transmission_resets_backoff);
+    RUN_TEST(test_nodes_desynchronize);
+
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include "bsp/adc_bsp.h"
+#include "bsp/dac_bsp.h"
+#include "bsp/ptt_bsp.h"
+#include "bsp/time_bsp.h"
+
+#include <math.h>
+
+// Loopback audio: whatever tone the DAC sends while PTT is keyed comes back on the ADC.
+// Each sample handed to the ADC moves the mock clock one sample period forward, so code
+// under test runs on sample time and a whole transmission takes as long as it takes to
+// decode, not as long as it takes on air. Link together with mock_time_bsp.c.
+
+#define MOCK_AUDIO_AMPLITUDE (0.5f * 2047.0f) // Tone level in ADC counts, same as a real radio's line out at half scale
+#define MOCK_AUDIO_MIDSCALE (2048)
+
+extern void mock_time_set_us(uint64_t us);
+
+static int sample_rate;
+static size_t chunk = 1;    // Samples per adc_bsp_get_data call
+static uint64_t samples;    // Samples produced since the last reset
+static uint64_t start_us;   // Clock at the last reset
+static float tone;
+static float phase;
+static bool keyed;
+static uint64_t keyed_at_us;
+static uint64_t unkeyed_at_us;
+static uint32_t symbols;    // Tones set while keyed, one per symbol sent
+
+void mock_audio_reset(void)
+{
+    chunk = 1;
+    samples = 0;
+    start_us = time_bsp_get_us();
+    tone = 0.0f;
+    phase = 0.0f;
+    keyed = false;
+    keyed_at_us = 0;
+    unkeyed_at_us = 0;
+    symbols = 0;
+}
+
+// Larger chunks run faster but make the TX symbol timing coarser
+void mock_audio_set_chunk(size_t samples_per_call)
+{
+    chunk = samples_per_call ? samples_per_call : 1;
+}
+
+bool mock_audio_keyed(void)
+{
+    return keyed;
+}
+
+uint64_t mock_audio_keyed_at_us(void)
+{
+    return keyed_at_us;
+}
+
+uint64_t mock_audio_unkeyed_at_us(void)
+{
+    return unkeyed_at_us;
+}
+
+uint32_t mock_audio_symbols(void)
+{
+    return symbols;
+}
+
+int adc_bsp_init(int rate, block_ring_t *ring)
+{
+    (void)ring; // Polled, filled from adc_bsp_get_data
+
+    if (rate <= 0)
+    {
+        return -1;
+    }
+
+    sample_rate = rate;
+
+    return 0;
+}
+
+int adc_bsp_task()
+{
+    return 0;
+}
+
+bool adc_bsp_data_available()
+{
+    return sample_rate > 0;
+}
+
+int adc_bsp_get_data(block_ring_t *ring)
+{
+    size_t capacity;
+    uint16_t *block = block_ring_acquire(ring, &capacity);
+    if (!block)
+    {
+        return 0; // Decoder still holds every block, nothing is lost while the clock waits
+    }
+
+    size_t count = chunk < capacity ? chunk : capacity;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint16_t sample = MOCK_AUDIO_MIDSCALE;
+        if (keyed && tone > 0.0f)
+        {
+            sample = (uint16_t)lrintf((float)MOCK_AUDIO_MIDSCALE + MOCK_AUDIO_AMPLITUDE * sinf(phase));
+            phase += 2.0f * (float)M_PI * tone / (float)sample_rate;
+            if (phase >= 2.0f * (float)M_PI)
+            {
+                phase -= 2.0f * (float)M_PI;
+            }
+        }
+        block[i] = sample;
+
+        // Recomputed from the sample count so the clock doesn't drift from rounding
+        samples++;
+        mock_time_set_us(start_us + samples * 1000000ULL / (uint64_t)sample_rate);
+    }
+
+    return block_ring_commit(ring, count);
+}
+
+int dac_bsp_init()
+{
+    return 0;
+}
+
+int dac_bsp_task()
+{
+    return 0;
+}
+
+int dac_bsp_set_tone(float frequency)
+{
+    tone = frequency;
+    if (keyed && frequency > 0.0f)
+    {
+        symbols++;
+    }
+
+    return 0;
+}
+
+int ptt_bsp_init()
+{
+    return 0;
+}
+
+int ptt_bsp_task()
+{
+    return 0;
+}
+
+int ptt_bsp_set_ptt(bool active)
+{
+    if (active && !keyed)
+    {
+        keyed_at_us = time_bsp_get_us();
+    }
+    else if (!active && keyed)
+    {
+        unkeyed_at_us = time_bsp_get_us();
+    }
+    keyed = active;
+
+    return 0;
+}
@@ -44,73 +44,104 @@ void mock_decoder_set_packet_processor(void (*processor)(packet_t *))
 
 int decoder_init(decoder_handle_t *handle)
 {
+    (void)handle;
     return 0;
 }
 
 int decoder_deinit(decoder_handle_t *handle)
 {
+    (void)handle;
     return 0;
 }
 
 int decoder_set_byte_decoder(decoder_handle_t *handle, byte_decoder_e type, void *byte_decoder_handle)
 {
+    (void)handle;
+    (void)type;
+    (void)byte_decoder_handle;
     return 0;
 }
 
 int decoder_set_bit_decoder(decoder_handle_t *handle, bit_decoder_e type, void *bit_decoder_handle)
 {
+    (void)handle;
+    (void)type;
+    (void)bit_decoder_handle;
     return 0;
 }
 
 int decoder_task(decoder_handle_t *handle)
 {
+    (void)handle;
     return 0;
 }
 
 int decoder_process_samples(decoder_handle_t *handle, const uint16_t *samples, size_t num_samples)
 {
+    (void)handle;
+    (void)samples;
+    (void)num_samples;
     return 0;
 }
 
 int decoder_process_bit(decoder_handle_t *handle, bool bit)
 {
+    (void)handle;
+
     bit_processor(bit);
     return 0;
 }
 
 int decoder_process_byte(decoder_handle_t *handle, unsigned char byte)
 {
+    (void)handle;
+
     byte_processor(byte);
     return 0;
 }
 
 int decoder_process_packet(decoder_handle_t *handle, packet_t *packet)
 {
+    (void)handle;
+
     packet_processor(packet);
     return 0;
 }
 
 int decoder_sync_word_detected(decoder_handle_t *handle)
 {
+    (void)handle;
+    return 0;
+}
+
+int decoder_rate_detected(decoder_handle_t *handle, fsk_rate_e rate)
+{
+    (void)handle;
+    (void)rate;
     return 0;
 }
 
 bool decoder_has_packet(decoder_handle_t *handle)
 {
+    (void)handle;
     return false;
 }
 
 int decoder_get_packet(decoder_handle_t *handle, packet_t *packet)
 {
+    (void)handle;
+    (void)packet;
     return 0;
 }
 
 bool decoder_busy(decoder_handle_t *handle)
 {
+    (void)handle;
     return false;
 }
 
 int decoder_reset(decoder_handle_t *handle)
 {
+    (void)handle;
     return 0;
 }
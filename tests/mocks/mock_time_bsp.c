@@ -0,0 +1,28 @@
+#include "bsp/time_bsp.h"
+
+static uint64_t now_us = 0;
+
+void mock_time_set_us(uint64_t us)
+{
+    now_us = us;
+}
+
+void mock_time_advance_us(uint64_t us)
+{
+    now_us += us;
+}
+
+int time_bsp_init(void)
+{
+    return 0;
+}
+
+uint64_t time_bsp_get_ms(void)
+{
+    return now_us / 1000ULL;
+}
+
+uint64_t time_bsp_get_us(void)
+{
+    return now_us;
+}
@@ -0,0 +1,245 @@
+#include "unity.h"
+
+#include <string.h>
+#include "modem.h"
+#include "orchestrator.h"
+#include "utils/time_utils.h"
+#include "bsp/time_bsp.h"
+#include "interface/pconfig.h"
+#include "c-logger.h"
+
+// Full TX to RX exchanges through one modem over the loopback audio mock. Time only moves as
+// samples are decoded, so the PTT delay and every symbol are honoured at full length without
+// the test waiting for them.
+
+#define MAX_LOOPS (5000000)        // Safety to prevent infinite loops in tests, about 190 s of samples
+#define MODEM_MEMORY_SIZE (16384)  // Arena for the decoder input buffer
+
+extern void mock_time_set_us(uint64_t us);
+extern void mock_audio_reset(void);
+extern bool mock_audio_keyed(void);
+extern uint64_t mock_audio_keyed_at_us(void);
+extern uint64_t mock_audio_unkeyed_at_us(void);
+extern uint32_t mock_audio_symbols(void);
+
+static modem_handle_t modem;
+static pc_config_t config;
+static uint8_t memory[MODEM_MEMORY_SIZE];
+static packet_t received[pconfigMAX_FRAMES_PER_KEYING];
+static size_t received_count;
+
+// Stands in for the orchestrator, the modem hands it every decoded packet
+int orchestrator_packet_callback(orchestrator_handle_t *handle, const packet_t *packet)
+{
+    (void)handle;
+
+    if (received_count < pconfigMAX_FRAMES_PER_KEYING)
+    {
+        received[received_count] = *packet;
+    }
+    received_count++;
+
+    return 0;
+}
+
+void setUp(void)
+{
+    log_init(LOG_LEVEL_ERROR);
+
+    mock_time_set_us(0);
+    mock_audio_reset();
+    received_count = 0;
+
+    config = (pc_config_t){
+        .device_address = pconfigDEVICE_ADDRESS,
+        .baud_rate = pconfigBAUD_RATE,
+        .freq_0 = pconfigMODEM_FREQ_0,
+        .freq_1 = pconfigMODEM_FREQ_1,
+        .sample_rate = pconfigSAMPLE_RATE_HZ,
+        .fsk_power_threshold = pconfigFSK_POWER_THRESHOLD,
+        .csma_energy_threshold = pconfigCSMA_ENERGY_THRESHOLD,
+        .decoder_buffer_symbol_count = pconfigDECODER_BUFFER_SYMBOL_COUNT,
+        .ptt_delay_ms = pconfigPTT_DELAY_MS,
+    };
+
+    TEST_ASSERT_LESS_OR_EQUAL(MODEM_MEMORY_SIZE, modem_required_memory(&config));
+
+    arena_t arena;
+    TEST_ASSERT_EQUAL(0, arena_init(&arena, memory, sizeof(memory)));
+    TEST_ASSERT_EQUAL(0, modem_init(&modem, &config, &arena, NULL));
+}
+
+void tearDown(void)
+{
+}
+
+static void build_packet(packet_t *packet, uint8_t id)
+{
+    uint8_t payload[pconfigMAX_PAYLOAD_SIZE];
+    for (size_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (uint8_t)(i * 37 + id);
+    }
+
+    TEST_ASSERT_EQUAL(0, initialize_packet(packet, PACKET_TYPE_DATA, 0x01, 0x02, id, payload, sizeof(payload)));
+}
+
+// Runs the modem until it has gone quiet and every expected packet is in
+static void run_until_received(size_t expected)
+{
+    int loops = 0;
+    while ((modem_tx_busy(&modem) || received_count < expected) && loops < MAX_LOOPS)
+    {
+        TEST_ASSERT_EQUAL(0, modem_task(&modem));
+        loops++;
+    }
+
+    // Let the tail of the last frame drain out of the decoder
+    for (int i = 0; i < 2 * pconfigSAMPLES_PER_SYMBOL; i++)
+    {
+        TEST_ASSERT_EQUAL(0, modem_task(&modem));
+    }
+}
+
+static void assert_same_packet(const packet_t *expected, const packet_t *actual)
+{
+    TEST_ASSERT_EQUAL_UINT8(expected->content.src_addr, actual->content.src_addr);
+    TEST_ASSERT_EQUAL_UINT8(expected->content.dest_addr, actual->content.dest_addr);
+    TEST_ASSERT_EQUAL_UINT8(expected->content.id, actual->content.id);
+    TEST_ASSERT_EQUAL_UINT8(expected->content.payload_length, actual->content.payload_length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->content.payload, actual->content.payload, expected->content.payload_length);
+}
+
+void test_loopback_packet(void)
+{
+    packet_t packet;
+    build_packet(&packet, 7);
+
+    TEST_ASSERT_EQUAL(0, modem_send_packet(&modem, &packet));
+    run_until_received(1);
+
+    TEST_ASSERT_EQUAL(1, received_count);
+    assert_same_packet(&packet, &received[0]);
+    TEST_ASSERT_FALSE(mock_audio_keyed());
+}
+
+void test_received_packet_metadata(void)
+{
+    packet_t packet;
+    build_packet(&packet, 3);
+
+    TEST_ASSERT_EQUAL(0, modem_send_packet(&modem, &packet));
+    run_until_received(1);
+    TEST_ASSERT_EQUAL(1, received_count);
+
+    // The sync word is the first thing sent once the PTT delay is over, both stamps should land
+    // on its end to within a symbol
+    const int symbol_us = ONE_SECOND / pconfigBAUD_RATE;
+    uint64_t sync_end_us = mock_audio_keyed_at_us() + (uint64_t)pconfigPTT_DELAY_MS * ONE_MS +
+                           (uint64_t)MODEM_SYNC_WORD_SIZE * 8 * symbol_us;
+    uint64_t sync_sample_us = received[0].metadata.sync_sample * ONE_SECOND / pconfigSAMPLE_RATE_HZ;
+
+    TEST_ASSERT_UINT32_WITHIN(symbol_us, (uint32_t)sync_end_us, (uint32_t)received[0].metadata.sync_time_us);
+    TEST_ASSERT_UINT32_WITHIN(symbol_us, (uint32_t)sync_end_us, (uint32_t)sync_sample_us);
+
+    // Clean loopback, both tones were heard and every decision was well clear of the threshold
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.0f, received[0].metadata.tone_0_level);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.0f, received[0].metadata.tone_1_level);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.0f, received[0].metadata.metric_margin);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.0f, received[0].metadata.snr_db);
+}
+
+void test_stuffed_bits_counted(void)
+{
+    uint8_t ones[pconfigMAX_PAYLOAD_SIZE];
+    memset(ones, 0xFF, sizeof(ones));
+
+    packet_t packet;
+    TEST_ASSERT_EQUAL(0, initialize_packet(&packet, PACKET_TYPE_DATA, 0x01, 0x02, 4, ones, sizeof(ones)));
+    TEST_ASSERT_EQUAL(0, modem_send_packet(&modem, &packet));
+    run_until_received(1);
+    TEST_ASSERT_EQUAL(1, received_count);
+
+    // A bit is stuffed after every run of five, so the payload alone needs one per five bits
+    TEST_ASSERT_GREATER_OR_EQUAL(sizeof(ones) * 8 / 5, received[0].metadata.stuffed_bits);
+    assert_same_packet(&packet, &received[0]);
+}
+
+void test_airtime_follows_virtual_clock(void)
+{
+    packet_t packet;
+    build_packet(&packet, 1);
+
+    TEST_ASSERT_EQUAL(0, modem_send_packet(&modem, &packet));
+    run_until_received(1);
+    TEST_ASSERT_EQUAL(1, received_count);
+
+    // Keyed for the PTT delay plus one symbol period per tone sent. Timers are only checked once
+    // per sample, so each symbol may run up to a sample long, but never short.
+    int symbols = (int)mock_audio_symbols();
+    int sample_us = ONE_SECOND / pconfigSAMPLE_RATE_HZ + 1;
+    int expected_us = pconfigPTT_DELAY_MS * ONE_MS + symbols * (ONE_SECOND / pconfigBAUD_RATE);
+    int airtime_us = (int)(mock_audio_unkeyed_at_us() - mock_audio_keyed_at_us());
+
+    TEST_ASSERT_GREATER_THAN(0, symbols);
+    TEST_ASSERT_GREATER_OR_EQUAL(expected_us, airtime_us);
+    TEST_ASSERT_LESS_OR_EQUAL(expected_us + (symbols + 2) * sample_us, airtime_us);
+    TEST_ASSERT_EQUAL_UINT32(1, STAT_GET(modem.stats.frames_sent));
+    TEST_ASSERT_EQUAL_UINT32(airtime_us / ONE_MS, STAT_GET(modem.stats.airtime_ms));
+}
+
+void test_nothing_sent_during_ptt_delay(void)
+{
+    packet_t packet;
+    build_packet(&packet, 2);
+
+    TEST_ASSERT_EQUAL(0, modem_send_packet(&modem, &packet));
+    while (!mock_audio_keyed())
+    {
+        TEST_ASSERT_EQUAL(0, modem_task(&modem));
+    }
+
+    // Only the carrier goes out until the radio has had time to settle
+    uint64_t settle_us = mock_audio_keyed_at_us() + (uint64_t)pconfigPTT_DELAY_MS * ONE_MS;
+    while (time_bsp_get_us() < settle_us)
+    {
+        TEST_ASSERT_EQUAL(0, modem_task(&modem));
+        TEST_ASSERT_EQUAL_UINT32(0, mock_audio_symbols());
+    }
+
+    run_until_received(1);
+    TEST_ASSERT_EQUAL(1, received_count);
+}
+
+void test_frames_share_keying_at_fast_rates(void)
+{
+    packet_t packets[3];
+    fsk_rate_e rates[3] = {FSK_RATE_BASE, FSK_RATE_2X, FSK_RATE_3X};
+    for (int i = 0; i < 3; i++)
+    {
+        build_packet(&packets[i], (uint8_t)(10 + i));
+        TEST_ASSERT_EQUAL(0, modem_queue_packet(&modem, &packets[i], rates[i]));
+    }
+
+    TEST_ASSERT_EQUAL(0, modem_start_tx(&modem));
+    run_until_received(3);
+
+    TEST_ASSERT_EQUAL(3, received_count);
+    for (int i = 0; i < 3; i++)
+    {
+        assert_same_packet(&packets[i], &received[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, STAT_GET(modem.stats.frames_sent));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_loopback_packet);
+    RUN_TEST(test_received_packet_metadata);
+    RUN_TEST(test_stuffed_bits_counted);
+    RUN_TEST(test_airtime_follows_virtual_clock);
+    RUN_TEST(test_nothing_sent_during_ptt_delay);
+    RUN_TEST(test_frames_share_keying_at_fast_rates);
+    return UNITY_END();
+}
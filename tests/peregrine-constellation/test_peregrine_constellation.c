@@ -0,0 +1,103 @@
+#include "unity.h"
+
+#include <string.h>
+#include "interface/peregrine-constellation.h"
+#include "interface/pconfig.h"
+#include "c-logger.h"
+
+// Bringing whole instances up and down through the public API, with memory from the heap and
+// from the caller, several at once the way the mesh simulator runs them.
+
+#define INSTANCES (3)
+#define INSTANCE_MEMORY_SIZE (65536) // Caller-provided memory per instance, the handle and its compile-time buffers included
+
+extern void mock_time_set_us(uint64_t us);
+extern void mock_audio_reset(void);
+
+static uint8_t memory[INSTANCES][INSTANCE_MEMORY_SIZE];
+
+static void _message_callback(const uint8_t *data, size_t len, uint8_t src_addr)
+{
+    (void)data;
+    (void)len;
+    (void)src_addr;
+}
+
+void setUp(void)
+{
+    log_init(LOG_LEVEL_ERROR);
+
+    mock_time_set_us(0);
+    mock_audio_reset();
+}
+
+void tearDown(void)
+{
+}
+
+void test_heap_instances_come_up_and_down_repeatedly(void)
+{
+    for (int round = 0; round < 4; round++)
+    {
+        pc_handle_t *handles[INSTANCES];
+        for (int i = 0; i < INSTANCES; i++)
+        {
+            pc_config_t config;
+            pc_default_config(&config);
+            config.device_address = (uint8_t)(i + 1);
+
+            handles[i] = pc_init(&config, _message_callback, NULL, 0);
+            TEST_ASSERT_NOT_NULL(handles[i]);
+        }
+
+        const uint8_t text[] = "hello";
+        TEST_ASSERT_EQUAL(PC_SUCCESS, pc_send_message(handles[0], 2, text, sizeof(text), NULL));
+        pc_task(handles[0]);
+
+        for (int i = 0; i < INSTANCES; i++)
+        {
+            TEST_ASSERT_EQUAL(PC_SUCCESS, pc_deinit(handles[i]));
+        }
+    }
+}
+
+void test_caller_memory_is_left_to_the_caller(void)
+{
+    TEST_ASSERT_LESS_OR_EQUAL(INSTANCE_MEMORY_SIZE, pc_required_memory(NULL));
+
+    pc_handle_t *handles[INSTANCES];
+    for (int i = 0; i < INSTANCES; i++)
+    {
+        handles[i] = pc_init(NULL, _message_callback, memory[i], sizeof(memory[i]));
+        TEST_ASSERT_NOT_NULL(handles[i]);
+        TEST_ASSERT_TRUE((uint8_t *)handles[i] >= memory[i] && (uint8_t *)handles[i] < memory[i] + sizeof(memory[i]));
+    }
+
+    // The same memory takes a fresh instance once the old one is shut down
+    TEST_ASSERT_EQUAL(PC_SUCCESS, pc_deinit(handles[0]));
+    handles[0] = pc_init(NULL, _message_callback, memory[0], sizeof(memory[0]));
+    TEST_ASSERT_NOT_NULL(handles[0]);
+
+    for (int i = 0; i < INSTANCES; i++)
+    {
+        TEST_ASSERT_EQUAL(PC_SUCCESS, pc_deinit(handles[i]));
+    }
+}
+
+void test_init_and_deinit_reject_bad_arguments(void)
+{
+    TEST_ASSERT_NULL(pc_init(NULL, _message_callback, memory[0], pc_required_memory(NULL) - 1));
+    TEST_ASSERT_NULL(pc_init(NULL, NULL, NULL, 0));
+    TEST_ASSERT_EQUAL(PC_ERROR_INVALID_HANDLE, pc_deinit(NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_heap_instances_come_up_and_down_repeatedly);
+    RUN_TEST(test_caller_memory_is_left_to_the_caller);
+    RUN_TEST(test_init_and_deinit_reject_bad_arguments);
+
+    return UNITY_END();
+}
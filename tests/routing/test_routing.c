@@ -0,0 +1,430 @@
+#include "unity.h"
+
+#include "routing.h"
+#include "packet.h"
+#include "c-logger.h"
+#include "interface/pconfig.h"
+#include "utils/time_utils.h"
+#include <string.h>
+
+#define OUR_ADDR (0x01)
+#define NEIGHBOR_A (0x02)
+#define NEIGHBOR_B (0x03)
+#define FAR_ADDR (0x09)
+#define GOOD_SNR_DB (30.0f)
+#define ADVERT_INTERVAL (pconfigROUTE_ADVERT_INTERVAL_S / 10) // Advertised interval byte, in 10 s units
+#define LINE_NODES (4)
+
+extern void mock_time_set_us(uint64_t us);
+extern void mock_time_advance_us(uint64_t us);
+
+static routing_handle_t routing;
+
+// Advertisement of destination, metric, next hop entries
+static packet_t _advert(uint8_t src, uint8_t seq, const uint8_t *entries, size_t len)
+{
+    uint8_t payload[pconfigMAX_PAYLOAD_SIZE] = {ADVERT_INTERVAL};
+    memcpy(&payload[1], entries, len);
+
+    packet_t packet;
+    memset(&packet, 0, sizeof(packet));
+    initialize_packet(&packet, PACKET_TYPE_ROUTE, src, pconfigBROADCAST_ADDRESS, seq, payload, len + 1);
+    packet.metadata.snr_db = GOOD_SNR_DB;
+    return packet;
+}
+
+static packet_t _data(uint8_t src, uint8_t dest, uint8_t id)
+{
+    const uint8_t payload[] = "hello";
+    packet_t packet;
+    memset(&packet, 0, sizeof(packet));
+    initialize_packet(&packet, PACKET_TYPE_DATA, src, dest, id, payload, sizeof(payload));
+    return packet;
+}
+
+void setUp(void)
+{
+    mock_time_set_us(0);
+    routing_init(&routing, OUR_ADDR, pconfigBAUD_RATE);
+}
+
+void tearDown(void)
+{
+}
+
+void test_neighbor_learned_from_beacon(void)
+{
+    packet_t beacon;
+    memset(&beacon, 0, sizeof(beacon));
+    initialize_packet(&beacon, PACKET_TYPE_BEACON, NEIGHBOR_A, pconfigBROADCAST_ADDRESS, 0, (const uint8_t *)"KM7DEJ", 6);
+    beacon.metadata.snr_db = GOOD_SNR_DB;
+
+    uint8_t next_hop = 0;
+    TEST_ASSERT_EQUAL(-1, routing_next_hop(&routing, NEIGHBOR_A, &next_hop));
+
+    TEST_ASSERT_EQUAL(0, routing_handle_packet(&routing, &beacon));
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&routing, NEIGHBOR_A, &next_hop));
+    TEST_ASSERT_EQUAL(NEIGHBOR_A, next_hop);
+}
+
+void test_prefers_lower_cost_path(void)
+{
+    // A reaches the far node in 3 link costs, B in 1
+    const uint8_t via_a[] = {FAR_ADDR, 48, 0x20};
+    const uint8_t via_b[] = {FAR_ADDR, 16, FAR_ADDR};
+
+    packet_t advert = _advert(NEIGHBOR_A, 0, via_a, sizeof(via_a));
+    routing_handle_packet(&routing, &advert);
+
+    uint8_t next_hop = 0;
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+    TEST_ASSERT_EQUAL(NEIGHBOR_A, next_hop);
+
+    advert = _advert(NEIGHBOR_B, 0, via_b, sizeof(via_b));
+    routing_handle_packet(&routing, &advert);
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+    TEST_ASSERT_EQUAL(NEIGHBOR_B, next_hop);
+
+    // Lossy link to B, most of its advertisements never arrive
+    for (uint8_t seq = 8; seq <= 64; seq += 8)
+    {
+        advert = _advert(NEIGHBOR_B, seq, via_b, sizeof(via_b));
+        routing_handle_packet(&routing, &advert);
+    }
+    advert = _advert(NEIGHBOR_A, 1, via_a, sizeof(via_a));
+    routing_handle_packet(&routing, &advert);
+
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+    TEST_ASSERT_EQUAL(NEIGHBOR_A, next_hop);
+}
+
+void test_relay_picks_next_hop_and_decrements_ttl(void)
+{
+    const uint8_t via_a[] = {FAR_ADDR, 16, FAR_ADDR};
+    packet_t advert = _advert(NEIGHBOR_A, 0, via_a, sizeof(via_a));
+    routing_handle_packet(&routing, &advert);
+
+    // Routed through us by B
+    packet_t packet = _data(NEIGHBOR_B, FAR_ADDR, 7);
+    packet.content.flags |= PACKET_FLAG_NEXT_HOP;
+    packet.content.next_hop = OUR_ADDR;
+    packet.content.crc = calculate_crc(&packet);
+
+    packet_t relay;
+    TEST_ASSERT_TRUE(routing_relay(&routing, &packet, &relay));
+    TEST_ASSERT_EQUAL(pconfigTTL - 1, relay.content.ttl);
+    TEST_ASSERT_TRUE(relay.content.flags & PACKET_FLAG_NEXT_HOP);
+    TEST_ASSERT_EQUAL(NEIGHBOR_A, relay.content.next_hop);
+    TEST_ASSERT_EQUAL(calculate_crc(&relay), relay.content.crc);
+    TEST_ASSERT_EQUAL(1, routing.stats.relayed);
+
+    // Another node was picked to carry this one
+    packet.content.next_hop = NEIGHBOR_B;
+    TEST_ASSERT_FALSE(routing_relay(&routing, &packet, &relay));
+
+    // Out of hops
+    packet.content.next_hop = OUR_ADDR;
+    packet.content.ttl = 1;
+    TEST_ASSERT_FALSE(routing_relay(&routing, &packet, &relay));
+
+    // Addressed to us
+    packet = _data(NEIGHBOR_B, OUR_ADDR, 8);
+    TEST_ASSERT_FALSE(routing_relay(&routing, &packet, &relay));
+}
+
+void test_flooded_duplicates_suppressed(void)
+{
+    packet_t packet = _data(NEIGHBOR_B, FAR_ADDR, 3);
+
+    TEST_ASSERT_FALSE(routing_seen_before(&routing, &packet));
+
+    packet_t relay;
+    TEST_ASSERT_TRUE(routing_relay(&routing, &packet, &relay));
+    TEST_ASSERT_FALSE(relay.content.flags & PACKET_FLAG_NEXT_HOP);
+    TEST_ASSERT_EQUAL(1, routing.stats.flooded);
+
+    // The same packet coming back through another relay, with a lower TTL
+    TEST_ASSERT_TRUE(routing_seen_before(&routing, &relay));
+
+    // Remembered only for a while, a retransmission later on is new again
+    mock_time_advance_us((uint64_t)pconfigRELAY_CACHE_TIME_MS * ONE_MS);
+    TEST_ASSERT_FALSE(routing_seen_before(&routing, &packet));
+}
+
+void test_routes_expire_with_neighbor(void)
+{
+    const uint8_t via_a[] = {FAR_ADDR, 16, FAR_ADDR};
+    packet_t advert = _advert(NEIGHBOR_A, 0, via_a, sizeof(via_a));
+    routing_handle_packet(&routing, &advert);
+
+    uint8_t next_hop = 0;
+    mock_time_advance_us((uint64_t)(pconfigROUTE_TIMEOUT_S - 1) * ONE_SECOND);
+    routing_task(&routing);
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+
+    mock_time_advance_us(ONE_SECOND);
+    routing_task(&routing);
+    TEST_ASSERT_EQUAL(-1, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+    TEST_ASSERT_EQUAL(-1, routing_next_hop(&routing, NEIGHBOR_A, &next_hop));
+
+    // Our own table is advertised with both routes unreachable, so nobody keeps using us for them
+    packet_t packet;
+    TEST_ASSERT_TRUE(routing_advert_pending(&routing));
+    TEST_ASSERT_EQUAL(0, routing_get_advert(&routing, &packet));
+    TEST_ASSERT_EQUAL(PACKET_TYPE_ROUTE, packet.content.type);
+    const uint8_t withdrawn[] = {ADVERT_INTERVAL, NEIGHBOR_A, ROUTING_METRIC_INFINITY, NEIGHBOR_A, FAR_ADDR, ROUTING_METRIC_INFINITY, NEIGHBOR_A};
+    TEST_ASSERT_EQUAL(sizeof(withdrawn), packet.content.payload_length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(withdrawn, packet.content.payload, sizeof(withdrawn));
+    TEST_ASSERT_FALSE(routing_advert_pending(&routing));
+
+    // Until the neighbors have surely heard
+    mock_time_advance_us((uint64_t)pconfigROUTE_TIMEOUT_S * ONE_SECOND);
+    routing_task(&routing);
+    TEST_ASSERT_TRUE(routing_advert_pending(&routing));
+    TEST_ASSERT_EQUAL(0, routing_get_advert(&routing, &packet));
+    TEST_ASSERT_EQUAL(1, packet.content.payload_length);
+}
+
+void test_route_through_us_is_poisoned(void)
+{
+    const uint8_t via_a[] = {FAR_ADDR, 16, FAR_ADDR};
+    packet_t advert = _advert(NEIGHBOR_A, 0, via_a, sizeof(via_a));
+    routing_handle_packet(&routing, &advert);
+
+    // B only reaches the far node through us, however cheap it says it is
+    const uint8_t via_us[] = {FAR_ADDR, 0, OUR_ADDR};
+    advert = _advert(NEIGHBOR_B, 0, via_us, sizeof(via_us));
+    routing_handle_packet(&routing, &advert);
+
+    uint8_t next_hop = 0;
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+    TEST_ASSERT_EQUAL(NEIGHBOR_A, next_hop);
+
+    // A loses it and B still names us, so nothing is left
+    const uint8_t lost[] = {FAR_ADDR, ROUTING_METRIC_INFINITY, FAR_ADDR};
+    advert = _advert(NEIGHBOR_A, 1, lost, sizeof(lost));
+    routing_handle_packet(&routing, &advert);
+    advert = _advert(NEIGHBOR_B, 1, via_us, sizeof(via_us));
+    routing_handle_packet(&routing, &advert);
+    TEST_ASSERT_EQUAL(-1, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+}
+
+void test_only_withdrawals_go_out_between_whole_tables(void)
+{
+    packet_t packet;
+    while (routing_advert_pending(&routing))
+    {
+        TEST_ASSERT_EQUAL(0, routing_get_advert(&routing, &packet));
+    }
+
+    // New routes wait for the next whole table
+    const uint8_t via_a[] = {FAR_ADDR, 16, FAR_ADDR, 0x20, 32, 0x21};
+    packet_t advert = _advert(NEIGHBOR_A, 0, via_a, sizeof(via_a));
+    routing_handle_packet(&routing, &advert);
+    mock_time_advance_us((uint64_t)pconfigROUTE_UPDATE_DELAY_S * ONE_SECOND);
+    routing_task(&routing);
+    TEST_ASSERT_FALSE(routing_advert_pending(&routing));
+
+    // Lost ones go out on their own, held back a little so others lost meanwhile can share the advertisement
+    const uint8_t lost[] = {FAR_ADDR, ROUTING_METRIC_INFINITY, FAR_ADDR, 0x20, 32, 0x21};
+    advert = _advert(NEIGHBOR_A, 1, lost, sizeof(lost));
+    routing_handle_packet(&routing, &advert);
+    routing_task(&routing);
+    TEST_ASSERT_FALSE(routing_advert_pending(&routing));
+    mock_time_advance_us((uint64_t)pconfigROUTE_UPDATE_DELAY_S * ONE_SECOND);
+    routing_task(&routing);
+    TEST_ASSERT_TRUE(routing_advert_pending(&routing));
+    TEST_ASSERT_EQUAL(0, routing_get_advert(&routing, &packet));
+    const uint8_t withdrawal[] = {ADVERT_INTERVAL, FAR_ADDR, ROUTING_METRIC_INFINITY, NEIGHBOR_A};
+    TEST_ASSERT_EQUAL(sizeof(withdrawal), packet.content.payload_length);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(withdrawal, packet.content.payload, sizeof(withdrawal));
+    TEST_ASSERT_FALSE(routing_advert_pending(&routing));
+
+    // Once more in the next whole table, then it's left out
+    for (int round = 0; round < 2; round++)
+    {
+        mock_time_advance_us((uint64_t)pconfigROUTE_ADVERT_INTERVAL_S * ONE_SECOND);
+        routing_handle_packet(&routing, &advert);
+        routing_task(&routing);
+        TEST_ASSERT_EQUAL(0, routing_get_advert(&routing, &packet));
+        TEST_ASSERT_EQUAL(round == 0 ? 1 + 3 * 3 : 1 + 2 * 3, packet.content.payload_length);
+    }
+}
+
+// A dozen neighbors each with a couple of destinations, a full table takes several advertisements
+static void _crowd_neighborhood(routing_handle_t *handle)
+{
+    for (uint8_t n = 0; n < 12; n++)
+    {
+        uint8_t entries[2 * 3];
+        for (uint8_t d = 0; d < 2; d++)
+        {
+            entries[3 * d] = (uint8_t)(0x40 + 2 * n + d);
+            entries[3 * d + 1] = 16;
+            entries[3 * d + 2] = (uint8_t)(0x40 + 2 * n + d);
+        }
+        packet_t advert = _advert((uint8_t)(0x10 + n), 0, entries, sizeof(entries));
+        routing_handle_packet(handle, &advert);
+    }
+}
+
+void test_advert_interval_stretches_with_neighborhood(void)
+{
+    _crowd_neighborhood(&routing);
+
+    mock_time_advance_us((uint64_t)pconfigROUTE_ADVERT_INTERVAL_S * ONE_SECOND);
+    routing_task(&routing);
+    TEST_ASSERT_TRUE(routing.advert_interval_s > pconfigROUTE_ADVERT_INTERVAL_S);
+    TEST_ASSERT_TRUE(routing.advert_interval_s <= pconfigROUTE_ADVERT_MAX_INTERVAL_S);
+
+    packet_t packet;
+    TEST_ASSERT_EQUAL(0, routing_get_advert(&routing, &packet));
+    TEST_ASSERT_EQUAL(routing.advert_interval_s / 10, packet.content.payload[0]);
+
+    // Neighbors advertising that rarely keep their routes for 3 of their intervals
+    const uint8_t slow[] = {FAR_ADDR, 16, FAR_ADDR};
+    packet_t advert = _advert(NEIGHBOR_A, 0, slow, sizeof(slow));
+    advert.content.payload[0] = pconfigROUTE_ADVERT_MAX_INTERVAL_S / 10;
+    routing_handle_packet(&routing, &advert);
+    for (int i = 0; i < 3 * pconfigROUTE_ADVERT_MAX_INTERVAL_S / 10 - 1; i++)
+    {
+        mock_time_advance_us(10 * ONE_SECOND);
+        routing_task(&routing);
+    }
+    uint8_t next_hop;
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+    mock_time_advance_us(10 * ONE_SECOND);
+    routing_task(&routing);
+    TEST_ASSERT_EQUAL(-1, routing_next_hop(&routing, FAR_ADDR, &next_hop));
+}
+
+void test_advert_interval_follows_configured_baud_rate(void)
+{
+    // The same neighborhood at twice the rate takes half the airtime to advertise
+    static routing_handle_t fast;
+    TEST_ASSERT_EQUAL(-1, routing_init(&fast, OUR_ADDR, 0));
+    TEST_ASSERT_EQUAL(0, routing_init(&fast, OUR_ADDR, 2 * pconfigBAUD_RATE));
+    _crowd_neighborhood(&routing);
+    _crowd_neighborhood(&fast);
+
+    mock_time_advance_us((uint64_t)pconfigROUTE_ADVERT_INTERVAL_S * ONE_SECOND);
+    routing_task(&routing);
+    routing_task(&fast);
+
+    TEST_ASSERT_TRUE(routing.advert_interval_s < pconfigROUTE_ADVERT_MAX_INTERVAL_S);
+    TEST_ASSERT_TRUE(fast.advert_interval_s > pconfigROUTE_ADVERT_INTERVAL_S);
+    TEST_ASSERT_UINT32_WITHIN(2 * 10, routing.advert_interval_s, 2 * fast.advert_interval_s); // Both rounded up to 10 s
+}
+
+// Nodes 0x11 - 0x12 - 0x13 - 0x14 in a line, each only hearing the next one along
+static routing_handle_t line[LINE_NODES];
+static bool line_cut[LINE_NODES - 1]; // Link between node i and i + 1 is down
+static bool line_lose_withdrawal;     // The next advertisement withdrawing the far end never reaches 0x12
+
+static bool _withdraws(const packet_t *advert, uint8_t dest_addr)
+{
+    for (size_t i = 1; i + 3 <= advert->content.payload_length; i += 3)
+    {
+        if (advert->content.payload[i] == dest_addr && advert->content.payload[i + 1] == ROUTING_METRIC_INFINITY)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _exchange_line(void)
+{
+    for (int i = 0; i < LINE_NODES; i++)
+    {
+        routing_task(&line[i]);
+        while (routing_advert_pending(&line[i]))
+        {
+            packet_t advert;
+            TEST_ASSERT_EQUAL(0, routing_get_advert(&line[i], &advert));
+            advert.metadata.snr_db = GOOD_SNR_DB;
+            if (i == 2 && line_lose_withdrawal && _withdraws(&advert, 0x14))
+            {
+                line_lose_withdrawal = false;
+            }
+            else if (i > 0 && !line_cut[i - 1])
+            {
+                routing_handle_packet(&line[i - 1], &advert);
+            }
+            if (i < LINE_NODES - 1 && !line_cut[i])
+            {
+                routing_handle_packet(&line[i + 1], &advert);
+            }
+        }
+    }
+}
+
+void test_cut_line_withdraws_without_looping(void)
+{
+    memset(line_cut, 0, sizeof(line_cut));
+    line_lose_withdrawal = false;
+    for (int i = 0; i < LINE_NODES; i++)
+    {
+        routing_init(&line[i], (uint8_t)(0x11 + i), pconfigBAUD_RATE);
+    }
+
+    for (int step = 0; step < 60; step++)
+    {
+        _exchange_line();
+        mock_time_advance_us(5 * ONE_SECOND);
+    }
+
+    uint8_t next_hop;
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&line[0], 0x14, &next_hop));
+    TEST_ASSERT_EQUAL(0x12, next_hop);
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&line[2], 0x14, &next_hop));
+    TEST_ASSERT_EQUAL(0x14, next_hop);
+
+    // The last link goes down. Until 0x13 notices, the others keep their routes, after that nobody
+    // may pick the far end up again from a neighbor that only had it through them. 0x12 misses the
+    // first withdrawal and advertises its stale route back to 0x13 before hearing the next.
+    line_cut[LINE_NODES - 2] = true;
+    line_lose_withdrawal = true;
+    for (int step = 0; step < 2 * pconfigROUTE_TIMEOUT_S / 5; step++)
+    {
+        _exchange_line();
+        mock_time_advance_us(5 * ONE_SECOND);
+
+        for (int i = 0; i < LINE_NODES - 1; i++)
+        {
+            // Routes only ever point away from the far end's side into a node that points further along
+            if (routing_next_hop(&line[i], 0x14, &next_hop) == 0)
+            {
+                TEST_ASSERT_EQUAL(0x11 + i + 1, next_hop);
+            }
+        }
+    }
+
+    TEST_ASSERT_FALSE(line_lose_withdrawal);
+    for (int i = 0; i < LINE_NODES - 1; i++)
+    {
+        TEST_ASSERT_EQUAL(-1, routing_next_hop(&line[i], 0x14, &next_hop));
+    }
+    TEST_ASSERT_EQUAL(0, routing_next_hop(&line[0], 0x13, &next_hop));
+    TEST_ASSERT_EQUAL(0x12, next_hop);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    log_init(LOG_LEVEL_INFO);
+
+    RUN_TEST(test_neighbor_learned_from_beacon);
+    RUN_TEST(test_prefers_lower_cost_path);
+    RUN_TEST(test_relay_picks_next_hop_and_decrements_ttl);
+    RUN_TEST(test_flooded_duplicates_suppressed);
+    RUN_TEST(test_routes_expire_with_neighbor);
+    RUN_TEST(test_route_through_us_is_poisoned);
+    RUN_TEST(test_only_withdrawals_go_out_between_whole_tables);
+    RUN_TEST(test_advert_interval_stretches_with_neighborhood);
+    RUN_TEST(test_advert_interval_follows_configured_baud_rate);
+    RUN_TEST(test_cut_line_withdraws_without_looping);
+
+    return UNITY_END();
+}
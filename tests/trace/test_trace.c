@@ -0,0 +1,190 @@
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "modem.h"
+#include "orchestrator.h"
+#include "utils/trace.h"
+#include "utils/time_utils.h"
+#include "bsp/time_bsp.h"
+#include "interface/pconfig.h"
+#include "c-logger.h"
+
+// Built with pconfigTRACE_ENABLED, frames looped back through one modem should leave their
+// decode stages in the trace, stamped off the mock clock that the loopback advances.
+
+#define MAX_LOOPS (5000000)        // Safety to prevent infinite loops in tests, about 190 s of samples
+#define MODEM_MEMORY_SIZE (16384)  // Arena for the decoder input buffer
+#define TRACE_JSON_SIZE (32768)    // Room for a full trace ring
+
+extern void mock_time_set_us(uint64_t us);
+extern void mock_audio_reset(void);
+
+static modem_handle_t modem;
+static pc_config_t config;
+static uint8_t memory[MODEM_MEMORY_SIZE];
+static packet_t received[pconfigMAX_FRAMES_PER_KEYING];
+static size_t received_count;
+static char json[TRACE_JSON_SIZE];
+
+// Stands in for the orchestrator, the modem hands it every decoded packet
+int orchestrator_packet_callback(orchestrator_handle_t *handle, const packet_t *packet)
+{
+    (void)handle;
+
+    if (received_count < pconfigMAX_FRAMES_PER_KEYING)
+    {
+        received[received_count] = *packet;
+    }
+    received_count++;
+
+    return 0;
+}
+
+void setUp(void)
+{
+    log_init(LOG_LEVEL_ERROR);
+
+    mock_time_set_us(0);
+    mock_audio_reset();
+    received_count = 0;
+
+    trace_clear();
+    trace_set_clock(time_bsp_get_us);
+
+    config = (pc_config_t){
+        .device_address = pconfigDEVICE_ADDRESS,
+        .baud_rate = pconfigBAUD_RATE,
+        .freq_0 = pconfigMODEM_FREQ_0,
+        .freq_1 = pconfigMODEM_FREQ_1,
+        .sample_rate = pconfigSAMPLE_RATE_HZ,
+        .fsk_power_threshold = pconfigFSK_POWER_THRESHOLD,
+        .csma_energy_threshold = pconfigCSMA_ENERGY_THRESHOLD,
+        .decoder_buffer_symbol_count = pconfigDECODER_BUFFER_SYMBOL_COUNT,
+        .ptt_delay_ms = pconfigPTT_DELAY_MS,
+    };
+
+    TEST_ASSERT_LESS_OR_EQUAL(MODEM_MEMORY_SIZE, modem_required_memory(&config));
+
+    arena_t arena;
+    TEST_ASSERT_EQUAL(0, arena_init(&arena, memory, sizeof(memory)));
+    TEST_ASSERT_EQUAL(0, modem_init(&modem, &config, &arena, NULL));
+}
+
+void tearDown(void)
+{
+    trace_set_clock(NULL);
+}
+
+static void send_packet(uint8_t id)
+{
+    uint8_t payload[pconfigMAX_PAYLOAD_SIZE];
+    for (size_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (uint8_t)(i * 37 + id);
+    }
+
+    packet_t packet;
+    TEST_ASSERT_EQUAL(0, initialize_packet(&packet, PACKET_TYPE_DATA, 0x01, 0x02, id, payload, sizeof(payload)));
+    TEST_ASSERT_EQUAL(0, modem_send_packet(&modem, &packet));
+}
+
+// Runs the modem until it has gone quiet and every expected packet is in
+static void run_until_received(size_t expected)
+{
+    int loops = 0;
+    while ((modem_tx_busy(&modem) || received_count < expected) && loops < MAX_LOOPS)
+    {
+        TEST_ASSERT_EQUAL(0, modem_task(&modem));
+        loops++;
+    }
+
+    // Let the tail of the last frame drain out of the decoder
+    for (int i = 0; i < 2 * pconfigSAMPLES_PER_SYMBOL; i++)
+    {
+        TEST_ASSERT_EQUAL(0, modem_task(&modem));
+    }
+}
+
+// Timestamp of a frame's event in the dumped JSON, -1 if it isn't there
+static long long event_ts(const char *name, char phase, uint32_t frame)
+{
+    char event[96];
+    snprintf(event, sizeof(event), "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"%c\",\"id\":%lu,\"ts\":",
+             name, phase, (unsigned long)frame);
+
+    const char *found = strstr(json, event);
+    long long ts;
+    if (!found || sscanf(found + strlen(event), "%lld", &ts) != 1)
+    {
+        return -1;
+    }
+
+    return ts;
+}
+
+void test_decoded_frame_is_traced(void)
+{
+    send_packet(7);
+    run_until_received(1);
+    TEST_ASSERT_EQUAL(1, received_count);
+
+    uint32_t frame = received[0].metadata.trace_id;
+    TEST_ASSERT_TRUE(frame != 0);
+
+    size_t length = trace_dump_chrome_json(json, sizeof(json));
+    TEST_ASSERT_LESS_THAN(sizeof(json), length);
+
+    // The sync word opens the frame's slice, the later stages are instant marks on it
+    long long sync_ts = event_ts("frame", 'b', frame);
+    long long header_ts = event_ts("header parsed", 'n', frame);
+    long long crc_ts = event_ts("crc validated", 'n', frame);
+
+    TEST_ASSERT_GREATER_THAN(0, sync_ts);
+    TEST_ASSERT_GREATER_THAN(sync_ts, header_ts);
+    TEST_ASSERT_GREATER_THAN(header_ts, crc_ts);
+    TEST_ASSERT_UINT32_WITHIN(ONE_SECOND / pconfigBAUD_RATE, (uint32_t)received[0].metadata.sync_time_us, (uint32_t)sync_ts);
+
+    // Queued and delivered are the orchestrator's, there's none here
+    TEST_ASSERT_EQUAL(-1, event_ts("queued", 'n', frame));
+}
+
+void test_frames_get_their_own_trace_ids(void)
+{
+    send_packet(1);
+    run_until_received(1);
+    send_packet(2);
+    run_until_received(2);
+    TEST_ASSERT_EQUAL(2, received_count);
+
+    uint32_t first = received[0].metadata.trace_id;
+    uint32_t second = received[1].metadata.trace_id;
+    TEST_ASSERT_TRUE(first != second);
+
+    trace_dump_chrome_json(json, sizeof(json));
+    TEST_ASSERT_GREATER_THAN(event_ts("crc validated", 'n', first), event_ts("frame", 'b', second));
+}
+
+void test_clear_empties_trace(void)
+{
+    send_packet(3);
+    run_until_received(1);
+    TEST_ASSERT_EQUAL(1, received_count);
+
+    trace_clear();
+
+    size_t length = trace_dump_chrome_json(json, sizeof(json));
+    TEST_ASSERT_EQUAL_STRING("{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}", json);
+    TEST_ASSERT_EQUAL(strlen(json), length);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_decoded_frame_is_traced);
+    RUN_TEST(test_frames_get_their_own_trace_ids);
+    RUN_TEST(test_clear_empties_trace);
+
+    return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include "unity.h"
+
+#include "tx_scheduler.h"
+#include "packet.h"
+#include "c-logger.h"
+#include "interface/pconfig.h"
+#include <string.h>
+
+static tx_scheduler_t scheduler;
+static bool unicast_blocked;
+
+static bool _eligible(const packet_t *packet, void *ctx)
+{
+    (void)ctx;
+
+    return !(unicast_blocked && packet->content.dest_addr != pconfigBROADCAST_ADDRESS);
+}
+
+static packet_t _packet(packet_type_e type, uint8_t dest, uint8_t id, size_t payload_length)
+{
+    packet_t packet;
+    uint8_t payload[pconfigMAX_PAYLOAD_SIZE] = {0};
+    memset(&packet, 0, sizeof(packet));
+    initialize_packet(&packet, type, 0x01, dest, id, payload, payload_length);
+    return packet;
+}
+
+void setUp(void)
+{
+    unicast_blocked = false;
+    tx_scheduler_init(&scheduler, _eligible, NULL);
+}
+
+void tearDown(void)
+{
+}
+
+void test_control_has_strict_priority(void)
+{
+    packet_t packet = _packet(PACKET_TYPE_DATA, 0x02, 1, 8);
+    tx_scheduler_push(&scheduler, TX_CLASS_APPLICATION, &packet);
+    packet = _packet(PACKET_TYPE_DATA, 0x03, 2, 8);
+    tx_scheduler_push(&scheduler, TX_CLASS_RELAY, &packet);
+    packet = _packet(PACKET_TYPE_BEACON, pconfigBROADCAST_ADDRESS, 3, 6);
+    tx_scheduler_push(&scheduler, TX_CLASS_BEACON, &packet);
+    packet = _packet(PACKET_TYPE_ACK, 0x02, 4, 1);
+    tx_scheduler_push(&scheduler, TX_CLASS_CONTROL, &packet);
+
+    TEST_ASSERT_EQUAL(0, tx_scheduler_pop(&scheduler, &packet));
+    TEST_ASSERT_EQUAL(4, packet.content.id);
+    TEST_ASSERT_EQUAL(0, tx_scheduler_pop(&scheduler, &packet));
+    TEST_ASSERT_EQUAL(3, packet.content.id);
+}
+
+void test_round_robin_shares_airtime(void)
+{
+    // Relay sends small packets, application sends full ones; each should get about half the bytes
+    for (uint8_t i = 0; i < pconfigTX_RELAY_QUEUE_SIZE; i++)
+    {
+        packet_t packet = _packet(PACKET_TYPE_DATA, 0x05, i, 4);
+        TEST_ASSERT_EQUAL(0, tx_scheduler_push(&scheduler, TX_CLASS_RELAY, &packet));
+    }
+    for (uint8_t i = 0; i < pconfigTX_APPLICATION_QUEUE_SIZE; i++)
+    {
+        packet_t packet = _packet(PACKET_TYPE_DATA, 0x06, i, pconfigMAX_PAYLOAD_SIZE);
+        TEST_ASSERT_EQUAL(0, tx_scheduler_push(&scheduler, TX_CLASS_APPLICATION, &packet));
+    }
+
+    uint32_t relay_bytes = 0;
+    uint32_t application_bytes = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        packet_t packet;
+        TEST_ASSERT_EQUAL(0, tx_scheduler_pop(&scheduler, &packet));
+        uint32_t bytes = PACKET_HEADER_SIZE + packet.content.payload_length;
+        if (packet.content.dest_addr == 0x05)
+        {
+            relay_bytes += bytes;
+        }
+        else
+        {
+            application_bytes += bytes;
+        }
+    }
+
+    TEST_ASSERT_TRUE(relay_bytes > 0);
+    TEST_ASSERT_TRUE(application_bytes > 0);
+    // Sampling can stop part way through a turn, so allow one quantum plus a packet of slack
+    TEST_ASSERT_TRUE(relay_bytes <= application_bytes + pconfigTX_RELAY_QUANTUM + PACKET_SIZE);
+    TEST_ASSERT_TRUE(application_bytes <= relay_bytes + pconfigTX_APPLICATION_QUANTUM + PACKET_SIZE);
+}
+
+void test_ineligible_head_yields_turn(void)
+{
+    packet_t packet = _packet(PACKET_TYPE_DATA, 0x02, 1, 8);
+    tx_scheduler_push(&scheduler, TX_CLASS_APPLICATION, &packet);
+    packet = _packet(PACKET_TYPE_DATA, pconfigBROADCAST_ADDRESS, 2, 8);
+    tx_scheduler_push(&scheduler, TX_CLASS_RELAY, &packet);
+
+    unicast_blocked = true;
+
+    TEST_ASSERT_TRUE(tx_scheduler_pending(&scheduler));
+    TEST_ASSERT_EQUAL(0, tx_scheduler_pop(&scheduler, &packet));
+    TEST_ASSERT_EQUAL(2, packet.content.id);
+
+    // Only the blocked unicast packet is left
+    TEST_ASSERT_FALSE(tx_scheduler_pending(&scheduler));
+    TEST_ASSERT_EQUAL(-1, tx_scheduler_pop(&scheduler, &packet));
+
+    unicast_blocked = false;
+    TEST_ASSERT_EQUAL(0, tx_scheduler_pop(&scheduler, &packet));
+    TEST_ASSERT_EQUAL(1, packet.content.id);
+}
+
+void test_queue_limit_applies_backpressure(void)
+{
+    packet_t packet = _packet(PACKET_TYPE_DATA, 0x02, 0, 8);
+    for (int i = 0; i < pconfigTX_APPLICATION_QUEUE_SIZE; i++)
+    {
+        TEST_ASSERT_FALSE(tx_scheduler_full(&scheduler, TX_CLASS_APPLICATION));
+        TEST_ASSERT_EQUAL(0, tx_scheduler_push(&scheduler, TX_CLASS_APPLICATION, &packet));
+    }
+
+    TEST_ASSERT_TRUE(tx_scheduler_full(&scheduler, TX_CLASS_APPLICATION));
+    TEST_ASSERT_EQUAL(-1, tx_scheduler_push(&scheduler, TX_CLASS_APPLICATION, &packet));
+    TEST_ASSERT_EQUAL(1, scheduler.stats.rejected[TX_CLASS_APPLICATION]);
+
+    // Other classes have their own room
+    TEST_ASSERT_EQUAL(0, tx_scheduler_push(&scheduler, TX_CLASS_CONTROL, &packet));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    log_init(LOG_LEVEL_INFO);
+
+    RUN_TEST(test_control_has_strict_priority);
+    RUN_TEST(test_round_robin_shares_airtime);
+    RUN_TEST(test_ineligible_head_yields_turn);
+    RUN_TEST(test_queue_limit_applies_backpressure);
+
+    return UNITY_END();
+}
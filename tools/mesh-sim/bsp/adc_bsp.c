@@ -0,0 +1,29 @@
+#include "adc_bsp.h"
+
+#include "../channel.h"
+
+// Samples come from the simulated channel, rendered for whichever node pc_task is running for
+
+int adc_bsp_init(int sample_rate, block_ring_t *ring)
+{
+    (void)ring; // Polled, filled from adc_bsp_get_data
+
+    return channel_set_sample_rate(channel_active(), sample_rate);
+}
+
+int adc_bsp_task()
+{
+    return 0;
+}
+
+bool adc_bsp_data_available()
+{
+    channel_node_t *node = channel_current_node(channel_active());
+
+    return node && node->pending_count > 0;
+}
+
+int adc_bsp_get_data(block_ring_t *ring)
+{
+    return channel_collect(channel_active(), ring);
+}
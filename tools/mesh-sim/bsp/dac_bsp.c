@@ -0,0 +1,18 @@
+#include "dac_bsp.h"
+
+#include "../channel.h"
+
+int dac_bsp_init()
+{
+    return 0;
+}
+
+int dac_bsp_task()
+{
+    return 0;
+}
+
+int dac_bsp_set_tone(float frequency)
+{
+    return channel_set_tone(channel_active(), frequency);
+}
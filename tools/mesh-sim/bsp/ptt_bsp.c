@@ -0,0 +1,18 @@
+#include "ptt_bsp.h"
+
+#include "../channel.h"
+
+int ptt_bsp_init()
+{
+    return 0;
+}
+
+int ptt_bsp_task()
+{
+    return 0;
+}
+
+int ptt_bsp_set_ptt(bool active)
+{
+    return channel_set_ptt(channel_active(), active);
+}
@@ -0,0 +1,24 @@
+#include "time_bsp.h"
+
+#include "../channel.h"
+
+// Every node shares the channel's virtual clock, it only moves when the simulator renders samples
+
+int time_bsp_init()
+{
+    return 0;
+}
+
+uint64_t time_bsp_get_ms()
+{
+    channel_t *channel = channel_active();
+
+    return channel ? channel->now_us / 1000ULL : 0;
+}
+
+uint64_t time_bsp_get_us()
+{
+    channel_t *channel = channel_active();
+
+    return channel ? channel->now_us : 0;
+}
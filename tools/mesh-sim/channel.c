@@ -0,0 +1,470 @@
+/**
+ * @file channel.c
+ *
+ * @author Diamond42474
+ *
+ * Shared audio channel for the mesh simulator. Every keyed node puts its
+ * AFSK tone on air, and every receiver hears the sum of them scaled by the
+ * path loss between the two nodes, plus white Gaussian noise, quantized
+ * like the 12-bit ADC the decoder expects. The channel also owns the
+ * virtual clock: time moves one sample period per channel_step, however
+ * long that takes in real time.
+ */
+#include "channel.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-logger.h"
+
+#define CHANNEL_ADC_MIDSCALE (2048)
+#define CHANNEL_ADC_MAX (4095)
+
+static channel_t *active_channel;
+
+static bool _reaches(channel_t *channel, int from, int to);
+static void _check_collisions(channel_t *channel, int node);
+static uint16_t _quantize(float level);
+
+/**
+ * @brief Places the nodes and works out the path loss between every pair
+ *
+ * @note The channel becomes the one the BSP functions talk to.
+ *
+ * @param channel Pointer to the channel
+ * @param config Node count, geometry, noise and seed
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int channel_init(channel_t *channel, const channel_config_t *config)
+{
+    if (!channel || !config)
+    {
+        LOG_ERROR("Channel or config is NULL");
+        return -1;
+    }
+
+    if (config->node_count <= 0 || config->area_m <= 0.0f || config->reference_range_m <= 0.0f ||
+        config->path_loss_exponent <= 0.0f || config->noise_amplitude < 0.0f)
+    {
+        LOG_ERROR("Invalid channel config");
+        return -1;
+    }
+
+    memset(channel, 0, sizeof(*channel));
+    channel->config = *config;
+    channel->current = -1;
+    channel->rng_state = config->seed ? config->seed : 0x9E3779B97F4A7C15ULL;
+
+    int count = config->node_count;
+    channel->nodes = calloc((size_t)count, sizeof(channel_node_t));
+    channel->gain = calloc((size_t)count * (size_t)count, sizeof(float));
+    channel->active = calloc((size_t)count, sizeof(int));
+    channel->tx_level = calloc((size_t)count, sizeof(float));
+    if (!channel->nodes || !channel->gain || !channel->active || !channel->tx_level)
+    {
+        LOG_ERROR("Failed to allocate %d channel nodes", count);
+        channel_deinit(channel);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        channel->nodes[i].x = channel_uniform(channel) * config->area_m;
+        channel->nodes[i].y = channel_uniform(channel) * config->area_m;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j < count; j++)
+        {
+            if (i == j)
+            {
+                continue;
+            }
+
+            float distance = hypotf(channel->nodes[i].x - channel->nodes[j].x, channel->nodes[i].y - channel->nodes[j].y);
+            float gain = CHANNEL_TX_AMPLITUDE;
+            if (distance > config->reference_range_m)
+            {
+                // Amplitude goes with the square root of power
+                gain *= powf(config->reference_range_m / distance, config->path_loss_exponent / 2.0f);
+            }
+            channel->gain[i * count + j] = gain;
+        }
+    }
+
+    active_channel = channel;
+
+    return 0;
+}
+
+int channel_deinit(channel_t *channel)
+{
+    if (!channel)
+    {
+        LOG_ERROR("Channel is NULL");
+        return -1;
+    }
+
+    free(channel->nodes);
+    free(channel->gain);
+    free(channel->active);
+    free(channel->tx_level);
+    channel->nodes = NULL;
+    channel->gain = NULL;
+    channel->active = NULL;
+    channel->tx_level = NULL;
+
+    if (active_channel == channel)
+    {
+        active_channel = NULL;
+    }
+
+    return 0;
+}
+
+channel_t *channel_active(void)
+{
+    return active_channel;
+}
+
+/**
+ * @brief Routes the BSP calls that follow to a node, set before each of its pc_init and pc_task calls
+ *
+ * @param channel Pointer to the channel
+ * @param node Index of the node
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int channel_select_node(channel_t *channel, int node)
+{
+    if (!channel)
+    {
+        LOG_ERROR("Channel is NULL");
+        return -1;
+    }
+
+    if (node < 0 || node >= channel->config.node_count)
+    {
+        LOG_ERROR("Invalid node %d", node);
+        return -1;
+    }
+
+    channel->current = node;
+
+    return 0;
+}
+
+channel_node_t *channel_current_node(channel_t *channel)
+{
+    if (!channel || channel->current < 0)
+    {
+        return NULL;
+    }
+
+    return &channel->nodes[channel->current];
+}
+
+/**
+ * @brief Renders one sample period at every receiver and advances the virtual clock
+ *
+ * @param channel Pointer to the channel
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int channel_step(channel_t *channel)
+{
+    if (!channel)
+    {
+        LOG_ERROR("Channel is NULL");
+        return -1;
+    }
+
+    if (channel->sample_rate <= 0)
+    {
+        LOG_ERROR("Sample rate isn't set, no node has been initialized");
+        return -1;
+    }
+
+    int count = channel->config.node_count;
+    float phase_step = 2.0f * (float)M_PI / (float)channel->sample_rate;
+
+    // Transmitters first, their oscillators advance once per sample whoever is listening
+    int active_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        channel_node_t *node = &channel->nodes[i];
+        if (!node->keyed || node->tone <= 0.0f)
+        {
+            continue;
+        }
+
+        channel->active[active_count] = i;
+        channel->tx_level[active_count] = sinf(node->phase);
+        active_count++;
+
+        node->phase += phase_step * node->tone;
+        if (node->phase >= 2.0f * (float)M_PI)
+        {
+            node->phase -= 2.0f * (float)M_PI;
+        }
+    }
+
+    for (int j = 0; j < count; j++)
+    {
+        channel_node_t *node = &channel->nodes[j];
+
+        uint16_t sample = CHANNEL_ADC_MIDSCALE; // Receiver is muted while keyed
+        if (!node->keyed)
+        {
+            float level = channel->config.noise_amplitude * channel_gauss(channel);
+            for (int k = 0; k < active_count; k++)
+            {
+                level += channel->gain[channel->active[k] * count + j] * channel->tx_level[k];
+            }
+            sample = _quantize(level);
+        }
+
+        if (node->pending_count >= CHANNEL_PENDING_SAMPLES)
+        {
+            channel->stats.dropped_samples++;
+            continue;
+        }
+        node->pending[node->pending_count++] = sample;
+    }
+
+    channel->sample_index++;
+    channel->now_us = channel->sample_index * 1000000ULL / (uint64_t)channel->sample_rate;
+
+    return 0;
+}
+
+/**
+ * @brief Sets the sample rate the channel renders at, called from adc_bsp_init
+ *
+ * @param channel Pointer to the channel
+ * @param sample_rate Sample rate in Hz, has to match the one the other nodes use
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int channel_set_sample_rate(channel_t *channel, int sample_rate)
+{
+    if (!channel)
+    {
+        LOG_ERROR("Channel is NULL");
+        return -1;
+    }
+
+    if (sample_rate <= 0)
+    {
+        LOG_ERROR("Invalid sample rate %d", sample_rate);
+        return -1;
+    }
+
+    if (channel->sample_rate && channel->sample_rate != sample_rate)
+    {
+        LOG_ERROR("Node %d samples at %d Hz, the channel runs at %d Hz", channel->current, sample_rate, channel->sample_rate);
+        return -1;
+    }
+
+    channel->sample_rate = sample_rate;
+
+    return 0;
+}
+
+int channel_set_tone(channel_t *channel, float tone)
+{
+    channel_node_t *node = channel_current_node(channel);
+    if (!node)
+    {
+        LOG_ERROR("No node selected");
+        return -1;
+    }
+
+    node->tone = tone;
+
+    return 0;
+}
+
+/**
+ * @brief Keys or unkeys the current node, keeping the airtime and collision counts
+ *
+ * @param channel Pointer to the channel
+ * @param active true to start transmitting
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int channel_set_ptt(channel_t *channel, bool active)
+{
+    channel_node_t *node = channel_current_node(channel);
+    if (!node)
+    {
+        LOG_ERROR("No node selected");
+        return -1;
+    }
+
+    if (node->keyed == active)
+    {
+        return 0;
+    }
+
+    node->keyed = active;
+    if (active)
+    {
+        node->keyed_at_us = channel->now_us;
+        node->collided = false;
+        channel->stats.transmissions++;
+        _check_collisions(channel, channel->current);
+    }
+    else
+    {
+        channel->stats.airtime_us += channel->now_us - node->keyed_at_us;
+        if (node->collided)
+        {
+            channel->stats.collided_transmissions++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Hands the current node's pending samples to its decoder
+ *
+ * @note Samples that don't fit stay pending for the next call.
+ *
+ * @param channel Pointer to the channel
+ * @param ring The decoder's input ring
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int channel_collect(channel_t *channel, block_ring_t *ring)
+{
+    channel_node_t *node = channel_current_node(channel);
+    if (!node || !ring)
+    {
+        LOG_ERROR("No node selected or ring is NULL");
+        return -1;
+    }
+
+    // Whatever doesn't fit while the decoder still holds every block waits for the next poll
+    size_t taken = 0;
+    while (taken < node->pending_count)
+    {
+        size_t capacity;
+        uint16_t *block = block_ring_acquire(ring, &capacity);
+        if (!block)
+        {
+            break;
+        }
+
+        size_t count = node->pending_count - taken;
+        if (count > capacity)
+        {
+            count = capacity;
+        }
+        memcpy(block, &node->pending[taken], count * sizeof(uint16_t));
+        if (block_ring_commit(ring, count))
+        {
+            LOG_ERROR("Failed to commit samples");
+            return -1;
+        }
+        taken += count;
+    }
+
+    node->pending_count -= taken;
+    memmove(node->pending, &node->pending[taken], node->pending_count * sizeof(uint16_t));
+
+    return 0;
+}
+
+// xorshift64*, plenty for noise and traffic and the same on every platform
+uint32_t channel_rand(channel_t *channel)
+{
+    channel->rng_state ^= channel->rng_state >> 12;
+    channel->rng_state ^= channel->rng_state << 25;
+    channel->rng_state ^= channel->rng_state >> 27;
+
+    return (uint32_t)((channel->rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+float channel_uniform(channel_t *channel)
+{
+    return (float)(channel_rand(channel) >> 8) / (float)(1u << 24);
+}
+
+// Box-Muller, the second value of each pair is kept for the next call
+float channel_gauss(channel_t *channel)
+{
+    if (channel->gauss_cached)
+    {
+        channel->gauss_cached = false;
+        return channel->gauss_spare;
+    }
+
+    float u = channel_uniform(channel) + 1.0f / (float)(1u << 25); // Keep log() away from 0
+    float v = channel_uniform(channel);
+    float radius = sqrtf(-2.0f * logf(u));
+
+    channel->gauss_spare = radius * sinf(2.0f * (float)M_PI * v);
+    channel->gauss_cached = true;
+
+    return radius * cosf(2.0f * (float)M_PI * v);
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+// A signal counts as heard when it stands above the noise
+static bool _reaches(channel_t *channel, int from, int to)
+{
+    float floor = fmaxf(channel->config.noise_amplitude, 0.01f * CHANNEL_TX_AMPLITUDE);
+
+    return channel->gain[from * channel->config.node_count + to] >= floor;
+}
+
+// Overlapping keyings collide when some third node hears both of them
+static void _check_collisions(channel_t *channel, int node)
+{
+    int count = channel->config.node_count;
+
+    for (int other = 0; other < count; other++)
+    {
+        if (other == node || !channel->nodes[other].keyed)
+        {
+            continue;
+        }
+
+        for (int receiver = 0; receiver < count; receiver++)
+        {
+            if (receiver == node || receiver == other)
+            {
+                continue;
+            }
+
+            if (_reaches(channel, node, receiver) && _reaches(channel, other, receiver))
+            {
+                channel->nodes[node].collided = true;
+                channel->nodes[other].collided = true;
+                break;
+            }
+        }
+    }
+}
+
+static uint16_t _quantize(float level)
+{
+    long sample = CHANNEL_ADC_MIDSCALE + lrintf(level * (float)(CHANNEL_ADC_MIDSCALE - 1));
+    if (sample < 0)
+    {
+        sample = 0;
+    }
+    else if (sample > CHANNEL_ADC_MAX)
+    {
+        sample = CHANNEL_ADC_MAX;
+    }
+
+    return (uint16_t)sample;
+}
@@ -0,0 +1,78 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utils/block_ring.h"
+
+#define CHANNEL_PENDING_SAMPLES (512) // ADC samples a node can have waiting before pc_task picks them up
+#define CHANNEL_TX_AMPLITUDE (0.5f)   // Received tone amplitude within the reference range, full scale = 1
+
+typedef struct channel_config
+{
+    int node_count;           // Virtual nodes sharing the channel
+    float area_m;             // Nodes are placed at random within a square this wide
+    float reference_range_m;  // Receivers closer than this hear a transmitter at CHANNEL_TX_AMPLITUDE
+    float path_loss_exponent; // Received power falls off as distance^-exponent beyond the reference range
+    float noise_amplitude;    // Standard deviation of the AWGN added at every receiver, full scale = 1
+    uint64_t seed;            // Placement, noise and traffic all come from this, same seed = same run
+} channel_config_t;
+
+typedef struct channel_node
+{
+    float x, y;          // Position in metres
+    float tone;          // Tone the DAC is set to, 0 = silent
+    float phase;         // Oscillator phase, continuous across tone changes like a real AFSK modulator
+    bool keyed;          // PTT is active, the receiver is muted while transmitting
+    bool collided;       // Another transmission reaching a common receiver overlapped this one
+    uint64_t keyed_at_us;
+
+    uint16_t pending[CHANNEL_PENDING_SAMPLES]; // ADC samples produced since the node's last pc_task
+    size_t pending_count;
+} channel_node_t;
+
+typedef struct channel
+{
+    channel_config_t config;
+    channel_node_t *nodes;
+    float *gain;     // Amplitude gain from node i to node j at gain[i * node_count + j]
+    int *active;     // Indices of the nodes on air during the current sample
+    float *tx_level; // Sample each active node puts on air
+    int sample_rate; // Set by the first adc_bsp_init, every node must use the same one
+
+    uint64_t sample_index; // Samples rendered since the start, the virtual clock
+    uint64_t now_us;
+    int current;           // Node whose BSP calls are being served
+
+    uint64_t rng_state;
+    bool gauss_cached;
+    float gauss_spare;
+
+    struct
+    {
+        uint64_t transmissions;         // Keyings, each carries one or more frames
+        uint64_t collided_transmissions; // Keyings that overlapped another one at some receiver
+        uint64_t airtime_us;            // Time any node was keyed, summed over nodes
+        uint64_t dropped_samples;       // Samples a node didn't collect in time
+    } stats;
+} channel_t;
+
+int channel_init(channel_t *channel, const channel_config_t *config);
+int channel_deinit(channel_t *channel);
+channel_t *channel_active(void); // The channel the BSP functions talk to, the last one initialized
+
+int channel_select_node(channel_t *channel, int node); // Route BSP calls to this node
+channel_node_t *channel_current_node(channel_t *channel);
+int channel_step(channel_t *channel);                  // Render one sample at every receiver and advance the clock
+
+int channel_set_sample_rate(channel_t *channel, int sample_rate);
+int channel_set_tone(channel_t *channel, float tone);
+int channel_set_ptt(channel_t *channel, bool active);
+int channel_collect(channel_t *channel, block_ring_t *ring); // Move the current node's pending samples into the decoder
+
+uint32_t channel_rand(channel_t *channel);
+float channel_uniform(channel_t *channel); // In [0, 1)
+float channel_gauss(channel_t *channel);   // Standard normal
+
+#endif // CHANNEL_H
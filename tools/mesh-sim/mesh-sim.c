@@ -0,0 +1,568 @@
+/**
+ * @file mesh-sim.c
+ *
+ * @author Diamond42474
+ *
+ * Runs a whole mesh of library instances against the simulated channel on
+ * a virtual clock and reports how the network did: goodput, delivery ratio,
+ * collisions and end-to-end latency. Every node sends messages to random
+ * other nodes at a Poisson rate once the routes have had a warmup period
+ * to form. A run is fully determined by its options and seed, so MAC and
+ * routing changes can be compared on identical traffic.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "peregrine-constellation.h"
+#include "pconfig.h"
+#include "c-logger.h"
+#include "channel.h"
+
+#define MESH_SIM_MAX_NODES (254)     // One address each, 0 is broadcast
+#define MESH_SIM_ID_SIZE (4)         // Every payload starts with the message's index in the message log
+#define MESH_SIM_PROGRESS_STEPS (10) // Progress lines printed over a run
+#define MESH_SIM_LATENCY_BUCKETS (9)
+
+typedef struct
+{
+    int duration_s;       // Traffic is generated for this long after the warmup
+    int warmup_s;         // Routes form before the first message is sent
+    int drain_s;          // Time left for the last messages to arrive
+    float message_rate;   // Messages per node per minute
+    int payload_size;     // Bytes per message, MESH_SIM_ID_SIZE included
+    int poll_samples;     // Idle nodes run pc_task every this many samples, keyed nodes every sample
+    log_level_e log_level;
+    channel_config_t channel;
+} sim_options_t;
+
+typedef struct
+{
+    uint64_t sent_us;
+    uint8_t destination;
+    bool delivered;
+} sim_message_t;
+
+typedef struct
+{
+    sim_message_t *messages; // Every message sent, indexed by the id in its payload
+    size_t message_count;
+    size_t message_capacity;
+
+    uint64_t *latencies_us; // One per delivered message
+    size_t latency_count;
+
+    uint64_t delivered_bytes;
+    uint32_t duplicates;  // Messages delivered more than once
+    uint32_t misrouted;   // Messages delivered to a node they weren't sent to
+    uint32_t queue_full;  // Messages pc_send_message turned away
+    uint32_t acknowledged;
+    uint32_t given_up;
+} sim_results_t;
+
+static channel_t channel;
+static pc_handle_t **nodes;
+static uint64_t *next_send_us;
+static sim_results_t results;
+
+static void _usage(const char *name);
+static int _parse_options(int argc, char **argv, sim_options_t *options);
+static void _message_callback(const uint8_t *data, size_t len, uint8_t src_addr);
+static void _send_callback(uint8_t dest_addr, uint8_t message_id, bool delivered);
+static uint64_t _next_interval_us(const sim_options_t *options);
+static int _send_message(const sim_options_t *options, int node);
+static void _sum_stats(int node_count, pc_stats_t *total);
+static void _report(const sim_options_t *options, const channel_t *start, const pc_stats_t *start_stats, double wall_s);
+static int _compare_u64(const void *a, const void *b);
+static double _wall_clock_s(void);
+
+int main(int argc, char **argv)
+{
+    // Ten nodes a few hops across, enough to exercise relaying and carrier sense while the channel
+    // still carries the traffic, and quick enough to run after every change. Scale up with the options.
+    sim_options_t options = {
+        .duration_s = 600,
+        .warmup_s = 120,
+        .drain_s = 60,
+        .message_rate = 0.5f,
+        .payload_size = 16,
+        .poll_samples = 32,
+        .log_level = LOG_LEVEL_ERROR,
+        .channel = {
+            .node_count = 10,
+            .area_m = 4000.0f,
+            .reference_range_m = 1500.0f,
+            .path_loss_exponent = 3.5f,
+            .noise_amplitude = 0.05f,
+            .seed = 1,
+        },
+    };
+
+    if (_parse_options(argc, argv, &options))
+    {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    log_init(options.log_level);
+
+    if (channel_init(&channel, &options.channel))
+    {
+        return 1;
+    }
+
+    int count = options.channel.node_count;
+    nodes = calloc((size_t)count, sizeof(pc_handle_t *));
+    next_send_us = calloc((size_t)count, sizeof(uint64_t));
+    if (!nodes || !next_send_us)
+    {
+        LOG_ERROR("Failed to allocate %d nodes", count);
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        pc_config_t config;
+        pc_default_config(&config);
+        config.device_address = (uint8_t)(i + 1);
+
+        channel_select_node(&channel, i);
+        nodes[i] = pc_init(&config, _message_callback, NULL, 0);
+        if (!nodes[i])
+        {
+            LOG_ERROR("Failed to init node %d", i + 1);
+            return 1;
+        }
+        pc_set_send_callback(nodes[i], _send_callback);
+
+        next_send_us[i] = (uint64_t)options.warmup_s * 1000000ULL + _next_interval_us(&options);
+    }
+
+    uint64_t traffic_start_us = (uint64_t)options.warmup_s * 1000000ULL;
+    uint64_t traffic_end_us = traffic_start_us + (uint64_t)options.duration_s * 1000000ULL;
+    uint64_t end_us = traffic_end_us + (uint64_t)options.drain_s * 1000000ULL;
+    uint64_t progress_step_us = end_us / MESH_SIM_PROGRESS_STEPS;
+    uint64_t next_progress_us = progress_step_us;
+
+    channel_t start = channel;
+    pc_stats_t start_stats = {0};
+    bool measuring = false;
+
+    double wall_start = _wall_clock_s();
+    while (channel.now_us < end_us)
+    {
+        if (channel_step(&channel))
+        {
+            return 1;
+        }
+
+        if (!measuring && channel.now_us >= traffic_start_us)
+        {
+            // Routing adverts and beacons during the warmup don't count against the results
+            start = channel;
+            _sum_stats(count, &start_stats);
+            measuring = true;
+        }
+
+        bool poll_all = channel.sample_index % (uint64_t)options.poll_samples == 0;
+        for (int i = 0; i < count; i++)
+        {
+            // Keyed nodes need every sample to hold their symbol timing, receivers decode in batches anyway
+            if (!poll_all && !channel.nodes[i].keyed)
+            {
+                continue;
+            }
+
+            channel_select_node(&channel, i);
+            if (poll_all && channel.now_us >= next_send_us[i] && channel.now_us < traffic_end_us)
+            {
+                _send_message(&options, i);
+                next_send_us[i] += _next_interval_us(&options);
+            }
+            pc_task(nodes[i]);
+        }
+
+        if (channel.now_us >= next_progress_us)
+        {
+            // stdout like the report, stderr is left to the library's logging
+            printf("%3d%%  %llu s simulated, %zu sent, %zu delivered\n",
+                   (int)(100 * channel.now_us / end_us), (unsigned long long)(channel.now_us / 1000000ULL),
+                   results.message_count, results.latency_count);
+            fflush(stdout);
+            next_progress_us += progress_step_us;
+        }
+    }
+
+    _report(&options, &start, &start_stats, _wall_clock_s() - wall_start);
+
+    for (int i = 0; i < count; i++)
+    {
+        pc_deinit(nodes[i]);
+    }
+    free(nodes);
+
+    return 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --nodes N         virtual nodes (default 10)\n"
+            "  --duration S      simulated seconds of traffic (default 600)\n"
+            "  --warmup S        seconds for routes to form before traffic starts (default 120)\n"
+            "  --drain S         seconds after the traffic for the last messages to arrive (default 60)\n"
+            "  --rate R          messages per node per minute (default 0.5)\n"
+            "  --size B          payload bytes per message, at least %d (default 16)\n"
+            "  --area M          side of the square the nodes are placed in, metres (default 4000)\n"
+            "  --range M         distance heard at full level, metres (default 1500)\n"
+            "  --exponent E      path loss exponent beyond the range (default 3.5)\n"
+            "  --noise A         AWGN standard deviation, full scale = 1 (default 0.05)\n"
+            "  --seed N          placement, noise and traffic seed (default 1)\n"
+            "  --poll N          samples between pc_task calls on idle nodes (default 32)\n"
+            "  --verbose         library warnings, twice for info\n",
+            name, MESH_SIM_ID_SIZE);
+}
+
+static int _parse_options(int argc, char **argv, sim_options_t *options)
+{
+    static const struct option long_options[] = {
+        {"nodes", required_argument, NULL, 'n'},
+        {"duration", required_argument, NULL, 'd'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"drain", required_argument, NULL, 'D'},
+        {"rate", required_argument, NULL, 'r'},
+        {"size", required_argument, NULL, 's'},
+        {"area", required_argument, NULL, 'a'},
+        {"range", required_argument, NULL, 'R'},
+        {"exponent", required_argument, NULL, 'e'},
+        {"noise", required_argument, NULL, 'N'},
+        {"seed", required_argument, NULL, 'S'},
+        {"poll", required_argument, NULL, 'p'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "n:d:w:D:r:s:a:R:e:N:S:p:vh", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'n':
+            options->channel.node_count = atoi(optarg);
+            break;
+        case 'd':
+            options->duration_s = atoi(optarg);
+            break;
+        case 'w':
+            options->warmup_s = atoi(optarg);
+            break;
+        case 'D':
+            options->drain_s = atoi(optarg);
+            break;
+        case 'r':
+            options->message_rate = strtof(optarg, NULL);
+            break;
+        case 's':
+            options->payload_size = atoi(optarg);
+            break;
+        case 'a':
+            options->channel.area_m = strtof(optarg, NULL);
+            break;
+        case 'R':
+            options->channel.reference_range_m = strtof(optarg, NULL);
+            break;
+        case 'e':
+            options->channel.path_loss_exponent = strtof(optarg, NULL);
+            break;
+        case 'N':
+            options->channel.noise_amplitude = strtof(optarg, NULL);
+            break;
+        case 'S':
+            options->channel.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'p':
+            options->poll_samples = atoi(optarg);
+            break;
+        case 'v':
+            if (options->log_level > LOG_LEVEL_INFO)
+            {
+                options->log_level = (log_level_e)(options->log_level - 1);
+            }
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if (options->channel.node_count < 2 || options->channel.node_count > MESH_SIM_MAX_NODES)
+    {
+        fprintf(stderr, "Node count must be between 2 and %d\n", MESH_SIM_MAX_NODES);
+        return -1;
+    }
+
+    if (options->duration_s <= 0 || options->warmup_s < 0 || options->drain_s < 0 || options->message_rate <= 0.0f ||
+        options->payload_size < MESH_SIM_ID_SIZE || options->payload_size > pconfigMAX_MESSAGE_SIZE || options->poll_samples <= 0)
+    {
+        fprintf(stderr, "Invalid traffic options\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Deliveries arrive from inside pc_task, the selected node is the receiver
+static void _message_callback(const uint8_t *data, size_t len, uint8_t src_addr)
+{
+    (void)src_addr;
+
+    if (len < MESH_SIM_ID_SIZE)
+    {
+        return; // Not ours
+    }
+
+    uint32_t id = (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+    if (id >= results.message_count)
+    {
+        return;
+    }
+
+    sim_message_t *message = &results.messages[id];
+    if (message->destination != channel.current + 1)
+    {
+        results.misrouted++;
+        return;
+    }
+
+    if (message->delivered)
+    {
+        results.duplicates++;
+        return;
+    }
+
+    message->delivered = true;
+    results.latencies_us[results.latency_count++] = channel.now_us - message->sent_us;
+    results.delivered_bytes += len;
+}
+
+static void _send_callback(uint8_t dest_addr, uint8_t message_id, bool delivered)
+{
+    (void)dest_addr;
+    (void)message_id;
+
+    if (delivered)
+    {
+        results.acknowledged++;
+    }
+    else
+    {
+        results.given_up++;
+    }
+}
+
+// Exponential gaps make each node a Poisson source
+static uint64_t _next_interval_us(const sim_options_t *options)
+{
+    float mean_us = 60.0e6f / options->message_rate;
+    float u = channel_uniform(&channel);
+
+    return (uint64_t)(-logf(1.0f - u) * mean_us) + 1;
+}
+
+static int _send_message(const sim_options_t *options, int node)
+{
+    if (results.message_count == results.message_capacity)
+    {
+        size_t capacity = results.message_capacity ? results.message_capacity * 2 : 1024;
+        sim_message_t *messages = realloc(results.messages, capacity * sizeof(sim_message_t));
+        uint64_t *latencies = realloc(results.latencies_us, capacity * sizeof(uint64_t));
+        if (!messages || !latencies)
+        {
+            LOG_ERROR("Failed to grow the message log");
+            free(messages ? messages : results.messages);
+            free(latencies ? latencies : results.latencies_us);
+            exit(1);
+        }
+        results.messages = messages;
+        results.latencies_us = latencies;
+        results.message_capacity = capacity;
+    }
+
+    int count = options->channel.node_count;
+    int destination = (node + 1 + (int)(channel_rand(&channel) % (uint32_t)(count - 1))) % count;
+
+    uint8_t payload[pconfigMAX_MESSAGE_SIZE];
+    uint32_t id = (uint32_t)results.message_count;
+    payload[0] = (uint8_t)id;
+    payload[1] = (uint8_t)(id >> 8);
+    payload[2] = (uint8_t)(id >> 16);
+    payload[3] = (uint8_t)(id >> 24);
+    for (int i = MESH_SIM_ID_SIZE; i < options->payload_size; i++)
+    {
+        payload[i] = (uint8_t)channel_rand(&channel);
+    }
+
+    pc_error_e err = pc_send_message(nodes[node], (uint8_t)(destination + 1), payload, (size_t)options->payload_size, NULL);
+    if (err == PC_ERROR_QUEUE_FULL)
+    {
+        results.queue_full++;
+        return 0;
+    }
+    if (err != PC_SUCCESS)
+    {
+        LOG_ERROR("Node %d failed to send: %d", node + 1, err);
+        return -1;
+    }
+
+    results.messages[results.message_count++] = (sim_message_t){
+        .sent_us = channel.now_us,
+        .destination = (uint8_t)(destination + 1),
+        .delivered = false,
+    };
+
+    return 0;
+}
+
+static void _sum_stats(int node_count, pc_stats_t *total)
+{
+    memset(total, 0, sizeof(*total));
+
+    for (int i = 0; i < node_count; i++)
+    {
+        pc_stats_t stats;
+        if (pc_get_stats(nodes[i], &stats) != PC_SUCCESS)
+        {
+            continue;
+        }
+
+        total->samples_processed += stats.samples_processed;
+        total->samples_idle += stats.samples_idle;
+        total->preambles_detected += stats.preambles_detected;
+        total->frames_crc_passed += stats.frames_crc_passed;
+        total->frames_crc_failed += stats.frames_crc_failed;
+        total->length_rejects += stats.length_rejects;
+        total->buffer_overflows += stats.buffer_overflows;
+        total->frames_sent += stats.frames_sent;
+        total->airtime_ms += stats.airtime_ms;
+        total->backoffs += stats.backoffs;
+    }
+}
+
+static void _report(const sim_options_t *options, const channel_t *start, const pc_stats_t *start_stats, double wall_s)
+{
+    int count = options->channel.node_count;
+    double simulated_s = (double)channel.now_us / 1e6;
+    double window_s = (double)options->duration_s;
+
+    pc_stats_t stats;
+    _sum_stats(count, &stats);
+
+    uint64_t transmissions = channel.stats.transmissions - start->stats.transmissions;
+    uint64_t collided = channel.stats.collided_transmissions - start->stats.collided_transmissions;
+    uint64_t airtime_us = channel.stats.airtime_us - start->stats.airtime_us;
+
+    printf("mesh-sim: %d nodes, %.0f s simulated in %.1f s (%.1fx real time), seed %llu\n",
+           count, simulated_s, wall_s, wall_s > 0.0 ? simulated_s / wall_s : 0.0, (unsigned long long)options->channel.seed);
+
+    printf("\nMessages (%d s of traffic, %.2f per node per minute, %d bytes)\n", options->duration_s, options->message_rate, options->payload_size);
+    printf("  sent           %zu\n", results.message_count);
+    printf("  delivered      %zu (%.1f%%)\n", results.latency_count,
+           results.message_count ? 100.0 * (double)results.latency_count / (double)results.message_count : 0.0);
+    printf("  duplicates     %u\n", results.duplicates);
+    printf("  misrouted      %u\n", results.misrouted);
+    printf("  queue full     %u\n", results.queue_full);
+    printf("  acknowledged   %u, given up %u\n", results.acknowledged, results.given_up);
+    printf("  goodput        %.2f B/s network, %.3f B/s per node\n",
+           (double)results.delivered_bytes / window_s, (double)results.delivered_bytes / window_s / count);
+
+    printf("\nChannel (from the end of the warmup)\n");
+    printf("  transmissions  %llu\n", (unsigned long long)transmissions);
+    printf("  collided       %llu (%.1f%%)\n", (unsigned long long)collided,
+           transmissions ? 100.0 * (double)collided / (double)transmissions : 0.0);
+    printf("  airtime        %.1f s, %.1f%% of the time per node\n", (double)airtime_us / 1e6,
+           100.0 * (double)airtime_us / 1e6 / (simulated_s - (double)start->now_us / 1e6) / count);
+    printf("  frames sent    %u\n", stats.frames_sent - start_stats->frames_sent);
+    printf("  preambles      %u\n", stats.preambles_detected - start_stats->preambles_detected);
+    printf("  crc passed     %u, failed %u, bad length %u\n", stats.frames_crc_passed - start_stats->frames_crc_passed,
+           stats.frames_crc_failed - start_stats->frames_crc_failed, stats.length_rejects - start_stats->length_rejects);
+    printf("  backoffs       %u\n", stats.backoffs - start_stats->backoffs);
+    uint32_t samples = stats.samples_processed - start_stats->samples_processed;
+    printf("  filters idle   %.1f%% of the samples\n",
+           samples ? 100.0 * (double)(stats.samples_idle - start_stats->samples_idle) / (double)samples : 0.0);
+    printf("  overflows      %u, %llu samples dropped by the channel\n", stats.buffer_overflows - start_stats->buffer_overflows,
+           (unsigned long long)channel.stats.dropped_samples);
+
+    if (results.latency_count == 0)
+    {
+        printf("\nLatency: nothing delivered\n");
+        return;
+    }
+
+    qsort(results.latencies_us, results.latency_count, sizeof(uint64_t), _compare_u64);
+
+    double sum_s = 0.0;
+    for (size_t i = 0; i < results.latency_count; i++)
+    {
+        sum_s += (double)results.latencies_us[i] / 1e6;
+    }
+
+#define PERCENTILE(p) ((double)results.latencies_us[(results.latency_count - 1) * (p) / 100] / 1e6)
+    printf("\nLatency (s)\n");
+    printf("  mean %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n", sum_s / (double)results.latency_count,
+           PERCENTILE(50), PERCENTILE(90), PERCENTILE(99), PERCENTILE(100));
+#undef PERCENTILE
+
+    // Doubling buckets from half a second, the last one is open ended
+    size_t buckets[MESH_SIM_LATENCY_BUCKETS] = {0};
+    for (size_t i = 0; i < results.latency_count; i++)
+    {
+        int bucket = 0;
+        uint64_t limit_us = 500000ULL;
+        while (bucket < MESH_SIM_LATENCY_BUCKETS - 1 && results.latencies_us[i] >= limit_us)
+        {
+            bucket++;
+            limit_us *= 2;
+        }
+        buckets[bucket]++;
+    }
+
+    double limit_s = 0.5;
+    for (int bucket = 0; bucket < MESH_SIM_LATENCY_BUCKETS; bucket++)
+    {
+        int width = (int)(50 * buckets[bucket] / results.latency_count);
+        if (bucket < MESH_SIM_LATENCY_BUCKETS - 1)
+        {
+            printf("  < %5.1f %7zu  %.*s\n", limit_s, buckets[bucket], width, "##################################################");
+        }
+        else
+        {
+            printf("  >=%5.1f %7zu  %.*s\n", limit_s / 2, buckets[bucket], width, "##################################################");
+        }
+        limit_s *= 2;
+    }
+}
+
+static int _compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double _wall_clock_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,809 @@
+/**
+ * @file recording.c
+ *
+ * @author Diamond42474
+ *
+ * Reads and writes compressed capture recordings. Each block of samples is
+ * run through whichever fixed polynomial predictor (order 0, 1 or 2) leaves
+ * the smallest residuals, the same trick Shorten and FLAC use, and the
+ * residuals are Rice coded with a parameter picked per block. Band-limited
+ * AFSK and quiet channel noise both predict well, so recordings come out
+ * much smaller than the 16-bit WAVs they'd otherwise be kept as. Signed
+ * samples are stored offset binary, so both widths predict from mid-scale.
+ */
+#include "recording.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-logger.h"
+
+#define RECORDING_MAGIC "PCRC"
+#define RECORDING_VERSION (3)
+#define RECORDING_U12_BITS (12)
+#define RECORDING_S16_BITS (16)
+#define RECORDING_HEADER_SIZE (12)
+#define RECORDING_CHUNK_HEADER_SIZE (5)
+#define RECORDING_CHUNK_AUDIO ('A')
+#define RECORDING_CHUNK_FRAME ('F')
+#define RECORDING_MAX_ORDER (2)
+#define RECORDING_MAX_RICE (15)
+#define RECORDING_ESCAPE (24)       // Quotients this long are replaced by the raw residual
+#define RECORDING_ESCAPE_EXTRA_BITS (4) // Zigzagged residuals are at most 3 bits wider than the samples
+#define RECORDING_FRAME_HEADER_SIZE (25)
+#define RECORDING_AUDIO_HEADER_SIZE (4)
+#define RECORDING_AUDIO_CAPACITY (RECORDING_AUDIO_HEADER_SIZE + RECORDING_MAX_ORDER * 2 + \
+                                  (RECORDING_BLOCK_SAMPLES * (RECORDING_ESCAPE + RECORDING_S16_BITS + RECORDING_ESCAPE_EXTRA_BITS) + 7) / 8)
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    uint64_t bits;
+    int count;
+} bit_writer_t;
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    uint64_t bits;
+    int count;
+} bit_reader_t;
+
+static int _sample_bits(pc_sample_format_e format);
+static int32_t _residual(const uint16_t *samples, size_t index, int order, int bits);
+static uint32_t _zigzag(int32_t value);
+static int32_t _unzigzag(uint32_t value);
+static int _choose_order(const uint16_t *samples, size_t count, int bits);
+static int _choose_rice(const uint16_t *samples, size_t count, int order, int bits);
+static void _put_bits(bit_writer_t *writer, uint32_t value, int count);
+static int _get_bits(bit_reader_t *reader, int count, uint32_t *value);
+static int _write_chunk(recording_writer_t *writer, uint8_t type, const uint8_t *payload, size_t length);
+static int _flush_block(recording_writer_t *writer);
+static int _decode_audio(recording_reader_t *reader, const uint8_t *payload, size_t length);
+static int _decode_frame(recording_reader_t *reader, const uint8_t *payload, size_t length);
+static uint32_t _le32(const uint8_t *bytes);
+static uint16_t _le16(const uint8_t *bytes);
+static void _put_le32(uint8_t *bytes, uint32_t value);
+static void _put_le16(uint8_t *bytes, uint16_t value);
+
+bool recording_is_recording(const uint8_t *data, size_t size)
+{
+    return data && size >= RECORDING_HEADER_SIZE && memcmp(data, RECORDING_MAGIC, 4) == 0;
+}
+
+/**
+ * @brief Creates a recording and writes its header
+ *
+ * @param writer Pointer to the writer
+ * @param path File to create, replaced if it exists
+ * @param sample_rate Sample rate of the samples that will be written
+ * @param format Format of the samples that will be written, PC_SAMPLE_FORMAT_U12 or PC_SAMPLE_FORMAT_S16
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int recording_create(recording_writer_t *writer, const char *path, int sample_rate, pc_sample_format_e format)
+{
+    if (!writer || !path || sample_rate <= 0)
+    {
+        LOG_ERROR("Invalid parameters for recording create");
+        return -1;
+    }
+
+    if (!_sample_bits(format))
+    {
+        LOG_ERROR("Recordings hold 12-bit ADC or signed 16-bit samples, not format %d", (int)format);
+        return -1;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->sample_rate = sample_rate;
+    writer->format = format;
+    writer->file = fopen(path, "wb");
+    if (!writer->file)
+    {
+        LOG_ERROR("Failed to create %s", path);
+        return -1;
+    }
+
+    uint8_t header[RECORDING_HEADER_SIZE] = {0};
+    memcpy(header, RECORDING_MAGIC, 4);
+    header[4] = RECORDING_VERSION;
+    header[5] = (uint8_t)_sample_bits(format);
+    _put_le32(&header[8], (uint32_t)sample_rate);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header))
+    {
+        LOG_ERROR("Failed to write recording header");
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+    writer->bytes = sizeof(header);
+
+    return 0;
+}
+
+/**
+ * @brief Appends samples, a chunk is written out for every full block
+ *
+ * @param writer Pointer to the writer
+ * @param samples Samples in the format the recording was created with
+ * @param count Number of samples
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int recording_write_samples(recording_writer_t *writer, const uint16_t *samples, size_t count)
+{
+    if (!writer || !writer->file || (!samples && count))
+    {
+        LOG_ERROR("Invalid parameters for recording write");
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (writer->format == PC_SAMPLE_FORMAT_U12 && samples[i] > RECORDING_SAMPLE_MAX)
+        {
+            LOG_ERROR("Sample %u is wider than %d bits", samples[i], RECORDING_U12_BITS);
+            return -1;
+        }
+
+        // Signed samples are kept offset binary, like the 12-bit ones
+        writer->block[writer->block_count++] = writer->format == PC_SAMPLE_FORMAT_S16 ? samples[i] ^ 0x8000 : samples[i];
+        if (writer->block_count == RECORDING_BLOCK_SAMPLES && _flush_block(writer))
+        {
+            return -1;
+        }
+    }
+    writer->samples += count;
+
+    return 0;
+}
+
+/**
+ * @brief Writes a frame annotation
+ *
+ * @param writer Pointer to the writer
+ * @param frame Frame and the sample it was decoded by
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int recording_write_frame(recording_writer_t *writer, const recording_frame_t *frame)
+{
+    if (!writer || !writer->file || !frame)
+    {
+        LOG_ERROR("Invalid parameters for recording frame");
+        return -1;
+    }
+
+    const packet_t *packet = &frame->packet;
+    uint8_t payload[RECORDING_FRAME_HEADER_SIZE + pconfigMAX_PAYLOAD_SIZE];
+    uint32_t snr;
+    memcpy(&snr, &packet->metadata.snr_db, sizeof(snr));
+
+    _put_le32(&payload[0], (uint32_t)frame->sample);
+    _put_le32(&payload[4], (uint32_t)(frame->sample >> 32));
+    _put_le32(&payload[8], snr);
+    payload[12] = packet->content.src_addr;
+    payload[13] = packet->content.dest_addr;
+    payload[14] = packet->content.id;
+    payload[15] = (uint8_t)(packet->content.ttl << 4 | packet->content.type);
+    payload[16] = packet->content.flags;
+    payload[17] = packet->content.payload_length;
+    _put_le16(&payload[18], packet->content.crc);
+    payload[20] = packet->content.fragment.message_id;
+    payload[21] = packet->content.fragment.index;
+    payload[22] = packet->content.fragment.count;
+    payload[23] = packet->content.next_hop;
+    payload[24] = packet->content.session;
+    memcpy(&payload[RECORDING_FRAME_HEADER_SIZE], packet->content.payload, packet->content.payload_length);
+
+    return _write_chunk(writer, RECORDING_CHUNK_FRAME, payload, RECORDING_FRAME_HEADER_SIZE + packet->content.payload_length);
+}
+
+/**
+ * @brief Writes out the partial block and closes the file
+ *
+ * @param writer Pointer to the writer
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int recording_close(recording_writer_t *writer)
+{
+    int ret = 0;
+
+    if (!writer || !writer->file)
+    {
+        return -1;
+    }
+
+    if (writer->block_count && _flush_block(writer))
+    {
+        ret = -1;
+    }
+    if (fclose(writer->file))
+    {
+        LOG_ERROR("Failed to close recording");
+        ret = -1;
+    }
+    writer->file = NULL;
+
+    return ret;
+}
+
+/**
+ * @brief Starts reading a recording held in memory
+ *
+ * @param reader Pointer to the reader
+ * @param data The whole file, must outlive the reader
+ * @param size Size of the file
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int recording_open(recording_reader_t *reader, const uint8_t *data, size_t size)
+{
+    if (!reader || !recording_is_recording(data, size))
+    {
+        LOG_ERROR("Not a recording");
+        return -1;
+    }
+
+    if (data[4] != RECORDING_VERSION || (data[5] != RECORDING_U12_BITS && data[5] != RECORDING_S16_BITS))
+    {
+        LOG_ERROR("Unsupported recording version %u with %u bit samples", data[4], data[5]);
+        return -1;
+    }
+
+    memset(reader, 0, sizeof(*reader));
+    reader->data = data;
+    reader->size = size;
+    reader->offset = RECORDING_HEADER_SIZE;
+    reader->sample_rate = (int)_le32(&data[8]);
+    reader->format = data[5] == RECORDING_S16_BITS ? PC_SAMPLE_FORMAT_S16 : PC_SAMPLE_FORMAT_U12;
+
+    return 0;
+}
+
+/**
+ * @brief Reads the next samples, collecting the frame annotations passed on the way
+ *
+ * @param reader Pointer to the reader
+ * @param samples Receives the samples, in the recording's format
+ * @param count Samples wanted
+ *
+ * @return the samples read, 0 at the end of the recording
+ */
+size_t recording_read(recording_reader_t *reader, uint16_t *samples, size_t count)
+{
+    size_t done = 0;
+
+    while (done < count)
+    {
+        if (reader->block_position < reader->block_count)
+        {
+            size_t length = reader->block_count - reader->block_position;
+            if (length > count - done)
+            {
+                length = count - done;
+            }
+            memcpy(&samples[done], &reader->block[reader->block_position], length * sizeof(uint16_t));
+            reader->block_position += length;
+            done += length;
+            continue;
+        }
+
+        if (reader->size - reader->offset < RECORDING_CHUNK_HEADER_SIZE)
+        {
+            break;
+        }
+
+        const uint8_t *chunk = &reader->data[reader->offset];
+        uint32_t length = _le32(&chunk[1]);
+        if (reader->size - reader->offset - RECORDING_CHUNK_HEADER_SIZE < length)
+        {
+            LOG_WARN("Recording is cut short %zu bytes in", reader->offset);
+            reader->offset = reader->size;
+            break;
+        }
+        reader->offset += RECORDING_CHUNK_HEADER_SIZE + length;
+
+        const uint8_t *payload = &chunk[RECORDING_CHUNK_HEADER_SIZE];
+        int result = 0;
+        switch (chunk[0])
+        {
+        case RECORDING_CHUNK_AUDIO:
+            result = _decode_audio(reader, payload, length);
+            break;
+        case RECORDING_CHUNK_FRAME:
+            result = _decode_frame(reader, payload, length);
+            break;
+        default:
+            break; // Newer chunk types are skipped
+        }
+
+        if (result)
+        {
+            LOG_ERROR("Corrupt chunk %zu bytes in", (size_t)(chunk - reader->data));
+            reader->offset = reader->size;
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * @brief Moves the read position to a sample without decoding the audio in between
+ *
+ * Annotations are collected from the start of the recording up to the new position, so
+ * seeking past the end gathers all of them.
+ *
+ * @param reader Pointer to the reader
+ * @param sample Sample the next read starts at
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int recording_seek(recording_reader_t *reader, uint64_t sample)
+{
+    if (!reader || !reader->data)
+    {
+        LOG_ERROR("Invalid parameters for recording seek");
+        return -1;
+    }
+
+    reader->offset = RECORDING_HEADER_SIZE;
+    reader->block_count = 0;
+    reader->block_position = 0;
+    reader->frame_count = 0;
+
+    uint64_t position = 0;
+    while (reader->size - reader->offset >= RECORDING_CHUNK_HEADER_SIZE)
+    {
+        const uint8_t *chunk = &reader->data[reader->offset];
+        uint32_t length = _le32(&chunk[1]);
+        if (reader->size - reader->offset - RECORDING_CHUNK_HEADER_SIZE < length)
+        {
+            break; // Cut short, recording_read reports it
+        }
+
+        const uint8_t *payload = &chunk[RECORDING_CHUNK_HEADER_SIZE];
+        if (chunk[0] == RECORDING_CHUNK_AUDIO && length >= RECORDING_AUDIO_HEADER_SIZE)
+        {
+            uint64_t count = _le16(payload);
+            if (position + count > sample)
+            {
+                reader->offset += RECORDING_CHUNK_HEADER_SIZE + length;
+                if (_decode_audio(reader, payload, length))
+                {
+                    LOG_ERROR("Corrupt chunk %zu bytes in", (size_t)(chunk - reader->data));
+                    return -1;
+                }
+                reader->block_position = (size_t)(sample - position);
+                return 0;
+            }
+            position += count;
+        }
+        else if (chunk[0] == RECORDING_CHUNK_FRAME && _decode_frame(reader, payload, length))
+        {
+            LOG_ERROR("Corrupt chunk %zu bytes in", (size_t)(chunk - reader->data));
+            return -1;
+        }
+
+        reader->offset += RECORDING_CHUNK_HEADER_SIZE + length;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Counts the samples in a recording from its chunk headers
+ *
+ * @param reader Pointer to the reader
+ *
+ * @return the samples in the recording, up to its last whole chunk
+ */
+uint64_t recording_length(const recording_reader_t *reader)
+{
+    uint64_t samples = 0;
+    size_t offset = RECORDING_HEADER_SIZE;
+
+    while (reader->size - offset >= RECORDING_CHUNK_HEADER_SIZE)
+    {
+        const uint8_t *chunk = &reader->data[offset];
+        uint32_t length = _le32(&chunk[1]);
+        if (reader->size - offset - RECORDING_CHUNK_HEADER_SIZE < length)
+        {
+            break;
+        }
+
+        if (chunk[0] == RECORDING_CHUNK_AUDIO && length >= RECORDING_AUDIO_HEADER_SIZE)
+        {
+            samples += _le16(&chunk[RECORDING_CHUNK_HEADER_SIZE]);
+        }
+        offset += RECORDING_CHUNK_HEADER_SIZE + length;
+    }
+
+    return samples;
+}
+
+void recording_release(recording_reader_t *reader)
+{
+    if (!reader)
+    {
+        return;
+    }
+
+    free(reader->frames);
+    reader->frames = NULL;
+    reader->frame_count = 0;
+    reader->frame_capacity = 0;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+// Width of the samples a format is stored with, 0 if recordings can't hold it
+static int _sample_bits(pc_sample_format_e format)
+{
+    switch (format)
+    {
+    case PC_SAMPLE_FORMAT_U12:
+        return RECORDING_U12_BITS;
+    case PC_SAMPLE_FORMAT_S16:
+        return RECORDING_S16_BITS;
+    default:
+        return 0;
+    }
+}
+
+// What the predictor of the given order misses, index must be at least the order
+static int32_t _residual(const uint16_t *samples, size_t index, int order, int bits)
+{
+    int32_t x = samples[index];
+
+    switch (order)
+    {
+    case 0:
+        return x - (1 << (bits - 1));
+    case 1:
+        return x - samples[index - 1];
+    default:
+        return x - (2 * (int32_t)samples[index - 1] - (int32_t)samples[index - 2]);
+    }
+}
+
+static uint32_t _zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t _unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// The order leaving the least residual energy, residuals from RECORDING_MAX_ORDER on are compared
+static int _choose_order(const uint16_t *samples, size_t count, int bits)
+{
+    int best = 0;
+    uint64_t best_sum = UINT64_MAX;
+
+    for (int order = 0; order <= RECORDING_MAX_ORDER; order++)
+    {
+        uint64_t sum = 0;
+        for (size_t i = RECORDING_MAX_ORDER; i < count; i++)
+        {
+            sum += _zigzag(_residual(samples, i, order, bits));
+        }
+        if (sum < best_sum)
+        {
+            best_sum = sum;
+            best = order;
+        }
+    }
+
+    return count > RECORDING_MAX_ORDER ? best : 0;
+}
+
+// Starts from the mean residual and checks its neighbours for the exact cheapest parameter
+static int _choose_rice(const uint16_t *samples, size_t count, int order, int bits)
+{
+    if (count <= (size_t)order)
+    {
+        return 0;
+    }
+
+    uint64_t sum = 0;
+    for (size_t i = (size_t)order; i < count; i++)
+    {
+        sum += _zigzag(_residual(samples, i, order, bits));
+    }
+
+    uint64_t mean = sum / (count - (size_t)order);
+    int estimate = 0;
+    while (estimate < RECORDING_MAX_RICE && (mean >> (estimate + 1)) > 0)
+    {
+        estimate++;
+    }
+
+    int escape_bits = bits + RECORDING_ESCAPE_EXTRA_BITS;
+    int best = estimate;
+    uint64_t best_bits = UINT64_MAX;
+    for (int k = estimate - 1; k <= estimate + 1; k++)
+    {
+        if (k < 0 || k > RECORDING_MAX_RICE)
+        {
+            continue;
+        }
+
+        uint64_t total = 0;
+        for (size_t i = (size_t)order; i < count; i++)
+        {
+            uint32_t quotient = _zigzag(_residual(samples, i, order, bits)) >> k;
+            total += quotient < RECORDING_ESCAPE ? quotient + 1 + (uint64_t)k : (uint64_t)(RECORDING_ESCAPE + escape_bits);
+        }
+        if (total < best_bits)
+        {
+            best_bits = total;
+            best = k;
+        }
+    }
+
+    return best;
+}
+
+static void _put_bits(bit_writer_t *writer, uint32_t value, int count)
+{
+    writer->bits |= (uint64_t)value << writer->count;
+    writer->count += count;
+    while (writer->count >= 8)
+    {
+        writer->data[writer->size++] = (uint8_t)writer->bits;
+        writer->bits >>= 8;
+        writer->count -= 8;
+    }
+}
+
+static int _get_bits(bit_reader_t *reader, int count, uint32_t *value)
+{
+    while (reader->count < count)
+    {
+        if (reader->position >= reader->size)
+        {
+            return -1;
+        }
+        reader->bits |= (uint64_t)reader->data[reader->position++] << reader->count;
+        reader->count += 8;
+    }
+
+    *value = (uint32_t)(reader->bits & ((1ULL << count) - 1));
+    reader->bits >>= count;
+    reader->count -= count;
+
+    return 0;
+}
+
+static int _write_chunk(recording_writer_t *writer, uint8_t type, const uint8_t *payload, size_t length)
+{
+    uint8_t header[RECORDING_CHUNK_HEADER_SIZE];
+    header[0] = type;
+    _put_le32(&header[1], (uint32_t)length);
+
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header) ||
+        fwrite(payload, 1, length, writer->file) != length)
+    {
+        LOG_ERROR("Failed to write recording chunk");
+        return -1;
+    }
+    writer->bytes += sizeof(header) + length;
+
+    // A live recording stays readable up to here if the process is killed
+    fflush(writer->file);
+
+    return 0;
+}
+
+static int _flush_block(recording_writer_t *writer)
+{
+    static uint8_t payload[RECORDING_AUDIO_CAPACITY];
+
+    const uint16_t *samples = writer->block;
+    size_t count = writer->block_count;
+    int sample_bits = _sample_bits(writer->format);
+    int order = _choose_order(samples, count, sample_bits);
+    int rice = _choose_rice(samples, count, order, sample_bits);
+
+    _put_le16(&payload[0], (uint16_t)count);
+    payload[2] = (uint8_t)order;
+    payload[3] = (uint8_t)rice;
+    size_t length = RECORDING_AUDIO_HEADER_SIZE;
+    for (int i = 0; i < order && (size_t)i < count; i++)
+    {
+        _put_le16(&payload[length], samples[i]);
+        length += 2;
+    }
+
+    bit_writer_t bits = {.data = &payload[length]};
+    for (size_t i = (size_t)order; i < count; i++)
+    {
+        uint32_t value = _zigzag(_residual(samples, i, order, sample_bits));
+        uint32_t quotient = value >> rice;
+        if (quotient >= RECORDING_ESCAPE)
+        {
+            _put_bits(&bits, (1u << RECORDING_ESCAPE) - 1, RECORDING_ESCAPE);
+            _put_bits(&bits, value, sample_bits + RECORDING_ESCAPE_EXTRA_BITS);
+            continue;
+        }
+
+        _put_bits(&bits, (1u << quotient) - 1, (int)quotient + 1); // Unary, the top bit is the 0 that ends it
+        _put_bits(&bits, value & ((1u << rice) - 1), rice);
+    }
+    if (bits.count)
+    {
+        _put_bits(&bits, 0, 8 - bits.count);
+    }
+    length += bits.size;
+
+    writer->block_count = 0;
+
+    return _write_chunk(writer, RECORDING_CHUNK_AUDIO, payload, length);
+}
+
+static int _decode_audio(recording_reader_t *reader, const uint8_t *payload, size_t length)
+{
+    if (length < RECORDING_AUDIO_HEADER_SIZE)
+    {
+        return -1;
+    }
+
+    int sample_bits = _sample_bits(reader->format);
+    int32_t sample_max = (1 << sample_bits) - 1;
+    size_t count = _le16(&payload[0]);
+    int order = payload[2];
+    int rice = payload[3];
+    if (count > RECORDING_BLOCK_SAMPLES || order > RECORDING_MAX_ORDER || rice > RECORDING_MAX_RICE ||
+        length < RECORDING_AUDIO_HEADER_SIZE + 2 * (size_t)order)
+    {
+        return -1;
+    }
+
+    size_t offset = RECORDING_AUDIO_HEADER_SIZE;
+    for (int i = 0; i < order && (size_t)i < count; i++)
+    {
+        reader->block[i] = _le16(&payload[offset]);
+        offset += 2;
+    }
+
+    bit_reader_t bits = {.data = &payload[offset], .size = length - offset};
+    for (size_t i = (size_t)order; i < count; i++)
+    {
+        uint32_t quotient = 0;
+        uint32_t bit = 1;
+        while (quotient < RECORDING_ESCAPE)
+        {
+            if (_get_bits(&bits, 1, &bit))
+            {
+                return -1;
+            }
+            if (!bit)
+            {
+                break;
+            }
+            quotient++;
+        }
+
+        uint32_t value;
+        if (quotient == RECORDING_ESCAPE)
+        {
+            if (_get_bits(&bits, sample_bits + RECORDING_ESCAPE_EXTRA_BITS, &value))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            uint32_t remainder = 0;
+            if (rice && _get_bits(&bits, rice, &remainder))
+            {
+                return -1;
+            }
+            value = quotient << rice | remainder;
+        }
+
+        // The residual is relative to the prediction from the samples already decoded
+        reader->block[i] = 0;
+        int32_t prediction = -_residual(reader->block, i, order, sample_bits);
+        int32_t sample = prediction + _unzigzag(value);
+        if (sample < 0 || sample > sample_max)
+        {
+            return -1;
+        }
+        reader->block[i] = (uint16_t)sample;
+    }
+
+    // Handed back in the format they were written in, the residuals were all of offset binary
+    if (reader->format == PC_SAMPLE_FORMAT_S16)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            reader->block[i] ^= 0x8000;
+        }
+    }
+
+    reader->block_count = count;
+    reader->block_position = 0;
+
+    return 0;
+}
+
+static int _decode_frame(recording_reader_t *reader, const uint8_t *payload, size_t length)
+{
+    if (length < RECORDING_FRAME_HEADER_SIZE || length - RECORDING_FRAME_HEADER_SIZE != payload[17] ||
+        payload[17] > pconfigMAX_PAYLOAD_SIZE)
+    {
+        return -1;
+    }
+
+    if (reader->frame_count == reader->frame_capacity)
+    {
+        size_t capacity = reader->frame_capacity ? reader->frame_capacity * 2 : 64;
+        recording_frame_t *frames = realloc(reader->frames, capacity * sizeof(recording_frame_t));
+        if (!frames)
+        {
+            LOG_ERROR("Failed to allocate frame annotations");
+            return -1;
+        }
+        reader->frames = frames;
+        reader->frame_capacity = capacity;
+    }
+
+    recording_frame_t *frame = &reader->frames[reader->frame_count++];
+    memset(frame, 0, sizeof(*frame));
+
+    uint32_t snr = _le32(&payload[8]);
+    frame->sample = (uint64_t)_le32(&payload[0]) | (uint64_t)_le32(&payload[4]) << 32;
+    memcpy(&frame->packet.metadata.snr_db, &snr, sizeof(snr));
+    frame->packet.content.src_addr = payload[12];
+    frame->packet.content.dest_addr = payload[13];
+    frame->packet.content.id = payload[14];
+    frame->packet.content.ttl = payload[15] >> 4;
+    frame->packet.content.type = payload[15] & 0x0F;
+    frame->packet.content.flags = payload[16];
+    frame->packet.content.payload_length = payload[17];
+    frame->packet.content.crc = _le16(&payload[18]);
+    frame->packet.content.fragment.message_id = payload[20];
+    frame->packet.content.fragment.index = payload[21];
+    frame->packet.content.fragment.count = payload[22];
+    frame->packet.content.next_hop = payload[23];
+    frame->packet.content.session = payload[24];
+    memcpy(frame->packet.content.payload, &payload[RECORDING_FRAME_HEADER_SIZE], payload[17]);
+
+    return 0;
+}
+
+static uint32_t _le32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static uint16_t _le16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+static void _put_le32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static void _put_le16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+}
@@ -0,0 +1,74 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "packet.h"
+#include "peregrine-constellation.h"
+
+// Lossless recordings of captures, either 12-bit ADC samples or signed 16-bit sound card samples
+// kept at their full width, with the frames decoded while recording stored alongside. Smaller
+// than a 16-bit WAV by whatever the predictor removes, and by the 4 unused bits of 12-bit ones.
+//
+// Format, little endian: "PCRC", u8 version, u8 bits per sample (12 unsigned, 16 signed),
+// u16 reserved, u32 sample rate, then chunks of u8 type, u32 length and the payload until the
+// end of the file. A recording cut short by a crash is still readable up to its last whole chunk.
+//
+// Audio chunk: u16 samples, u8 predictor order (0-2), u8 Rice parameter, the first order
+// samples as u16 offset binary, then a Rice coded, zigzagged residual per remaining sample.
+// Frame chunk: u64 sample the frame had decoded by, f32 SNR, then the packet header fields
+// and payload.
+
+#define RECORDING_BLOCK_SAMPLES (4096)
+#define RECORDING_SAMPLE_MAX (4095)
+
+typedef struct
+{
+    uint64_t sample; // Samples into the recording when the decoder produced it
+    packet_t packet;
+} recording_frame_t;
+
+typedef struct
+{
+    FILE *file;
+    int sample_rate;
+    pc_sample_format_e format; // PC_SAMPLE_FORMAT_U12 or PC_SAMPLE_FORMAT_S16
+    uint16_t block[RECORDING_BLOCK_SAMPLES]; // Samples waiting for a full chunk, offset binary
+    size_t block_count;
+    uint64_t samples; // Samples written, the partial block included
+    uint64_t bytes;   // File size so far
+} recording_writer_t;
+
+typedef struct
+{
+    const uint8_t *data; // The whole file, usually mmap'd
+    size_t size;
+    size_t offset; // Next chunk
+    int sample_rate;
+    pc_sample_format_e format; // Samples are read back in the format they were written in
+
+    uint16_t block[RECORDING_BLOCK_SAMPLES]; // Decoded audio chunk being read out
+    size_t block_count;
+    size_t block_position;
+
+    recording_frame_t *frames; // Annotations met so far, in file order
+    size_t frame_count;
+    size_t frame_capacity;
+} recording_reader_t;
+
+bool recording_is_recording(const uint8_t *data, size_t size);
+
+int recording_create(recording_writer_t *writer, const char *path, int sample_rate, pc_sample_format_e format);
+int recording_write_samples(recording_writer_t *writer, const uint16_t *samples, size_t count);
+int recording_write_frame(recording_writer_t *writer, const recording_frame_t *frame);
+int recording_close(recording_writer_t *writer);
+
+int recording_open(recording_reader_t *reader, const uint8_t *data, size_t size);
+size_t recording_read(recording_reader_t *reader, uint16_t *samples, size_t count); // 0 at the end
+int recording_seek(recording_reader_t *reader, uint64_t sample); // Past the end stops at the end
+uint64_t recording_length(const recording_reader_t *reader);
+void recording_release(recording_reader_t *reader);
+
+#endif // RECORDING_H
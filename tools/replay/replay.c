@@ -0,0 +1,955 @@
+/**
+ * @file replay.c
+ *
+ * @author Diamond42474
+ *
+ * Runs captures through the receive chain as fast as the CPU allows, with
+ * no BSP or clock in the way: samples go straight from the mapped file into
+ * the decoder's input ring. Used to decode field recordings offline, to
+ * keep compressed recordings of live sessions with the frames decoded at
+ * the time, and to check a demodulator change still decodes every frame an
+ * old recording was annotated with.
+ *
+ *   pc_replay decode capture.wav            print the frames and the decode speed
+ *   pc_replay decode --check session.pcr    exit 1 if an annotated frame is missed
+ *   arecord -f S16_LE -r 26250 -t raw | pc_replay record -o session.pcr -
+ *   pc_replay export session.pcr out.wav
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "peregrine-constellation.h"
+#include "pconfig.h"
+#include "c-logger.h"
+#include "decoding/decoder.h"
+#include "decoding/fsk_decoder.h"
+#include "decoding/byte_assembler.h"
+#include "modem.h"
+#include "recording.h"
+#include "source.h"
+
+#define REPLAY_MATCH_WINDOW_S (1) // Annotated and decoded frames this close together are the same frame
+#define REPLAY_MAX_JOBS (256)
+#define REPLAY_CHUNKS_PER_JOB (4)  // Smaller chunks than jobs keep every core busy to the end
+#define REPLAY_MIN_CHUNK_OVERLAPS (8) // Chunks are at least this many overlaps long, or settling dominates
+
+// Bits in the longest frame, with a stuffed bit after every run of ones
+#define REPLAY_MAX_FRAME_BITS ((MODEM_FRAME_HEADER_SIZE + PACKET_SIZE) * 8 * 6 / 5 + 1)
+
+typedef struct
+{
+    int sample_rate; // 0 = from the file, else pconfigSAMPLE_RATE_HZ
+    int baud_rate;
+    float freq_0;
+    float freq_1;
+    float power_threshold;
+    source_format_e format;
+    int jobs;      // Decoder threads for file captures, 0 = one per core
+    float chunk_s; // Parallel chunk length, 0 = split the capture evenly over the jobs
+    bool check;
+    bool quiet;
+    const char *output;
+    log_level_e log_level;
+} replay_options_t;
+
+typedef struct
+{
+    decoder_handle_t decoder;
+    fsk_decoder_handle_t fsk_decoder;
+    byte_assembler_handle_t byte_assembler;
+    uint16_t *input;
+    int sample_rate;
+} replay_decoder_t;
+
+typedef struct
+{
+    uint64_t samples;
+    uint64_t frames;
+    uint64_t annotated;
+    uint64_t missed;
+    uint64_t new_frames;
+    double audio_s;
+    double seconds; // Wall clock spent decoding
+} replay_totals_t;
+
+typedef struct
+{
+    uint64_t start; // Frames decoded by a sample in [start, end) belong to the chunk
+    uint64_t end;
+    recording_frame_t *frames;
+    size_t frame_count;
+    uint64_t samples; // Decoded, overlap included
+    int result;
+} replay_chunk_t;
+
+typedef struct
+{
+    const replay_options_t *options;
+    const char *path;
+    int sample_rate;
+    uint64_t length;
+    uint64_t overlap; // Decoded ahead of each chunk so the filters settle and a frame straddling the start completes
+    uint64_t margin;  // Frames this close outside a chunk are kept too, then deduplicated
+    replay_chunk_t *chunks;
+    size_t chunk_count;
+    atomic_size_t next_chunk;
+} replay_job_t;
+
+static volatile sig_atomic_t stopping;
+
+static void _usage(const char *name);
+static int _parse_options(int argc, char **argv, replay_options_t *options);
+static void _stop(int signal);
+static double _now_s(void);
+static int _decoder_init(replay_decoder_t *replay, const replay_options_t *options, int sample_rate,
+                         pc_sample_format_e sample_format);
+static void _decoder_deinit(replay_decoder_t *replay);
+static int _decode(replay_decoder_t *replay, source_t *source, recording_writer_t *writer, uint64_t first,
+                   uint64_t limit, recording_frame_t **frames, size_t *frame_count, uint64_t *samples);
+static void *_chunk_worker(void *arg);
+static int _decode_parallel(const replay_options_t *options, const char *path, int sample_rate, uint64_t length,
+                            recording_frame_t **frames, size_t *frame_count, uint64_t *samples);
+static void _print_frame(const char *path, const recording_frame_t *frame, int sample_rate, const char *note);
+static bool _same_frame(const recording_frame_t *a, const recording_frame_t *b, uint64_t window);
+static int _compare_frames(const void *a, const void *b);
+static int _check(const char *path, const replay_options_t *options, const recording_reader_t *recording,
+                  const recording_frame_t *frames, size_t frame_count, int sample_rate, replay_totals_t *totals);
+static int _run_decode(const replay_options_t *options, int count, char **paths);
+static int _run_record(const replay_options_t *options, const char *path);
+static int _run_export(const char *input, const char *output);
+
+int main(int argc, char **argv)
+{
+    replay_options_t options = {
+        .baud_rate = pconfigBAUD_RATE,
+        .freq_0 = pconfigMODEM_FREQ_0,
+        .freq_1 = pconfigMODEM_FREQ_1,
+        .power_threshold = pconfigFSK_POWER_THRESHOLD,
+        .jobs = 1,
+        .log_level = LOG_LEVEL_WARN,
+    };
+
+    if (argc < 2)
+    {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    const char *command = argv[1];
+    if (_parse_options(argc - 1, argv + 1, &options))
+    {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    log_init(options.log_level);
+
+    signal(SIGINT, _stop);
+    signal(SIGTERM, _stop);
+
+    int remaining = argc - 1 - optind;
+    char **paths = &argv[1 + optind];
+    if (strcmp(command, "decode") == 0 && remaining >= 1)
+    {
+        return _run_decode(&options, remaining, paths);
+    }
+    if (strcmp(command, "record") == 0 && remaining == 1 && options.output)
+    {
+        return _run_record(&options, paths[0]);
+    }
+    if (strcmp(command, "export") == 0 && remaining == 2)
+    {
+        return _run_export(paths[0], paths[1]);
+    }
+
+    _usage(argv[0]);
+    return 1;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s decode [options] FILE...       decode captures as fast as possible\n"
+            "       %s record [options] -o OUT INPUT  decode INPUT and keep it as a compressed recording\n"
+            "       %s export IN OUT.wav              turn a recording back into a WAV\n"
+            "Captures are WAV, raw samples or recordings, - reads raw samples from stdin.\n"
+            "  --rate HZ         sample rate of raw captures (default %d, WAVs and recordings say)\n"
+            "  --format F        raw sample format, s16 (sound card) or u12 (ADC) (default s16)\n"
+            "  --baud N          base baud rate (default %d)\n"
+            "  --f0 HZ, --f1 HZ  tone frequencies (default %d and %d)\n"
+            "  --threshold X     FSK power threshold (default %.2f)\n"
+            "  --jobs N          decode file captures in overlapping chunks on N threads, 0 = every core (default 1)\n"
+            "  --chunk S         seconds per chunk with --jobs (default: split evenly)\n"
+            "  --check           fail if a frame a recording is annotated with doesn't decode\n"
+            "  --quiet           only the summary\n"
+            "  --verbose         library info messages, twice for debug\n",
+            name, name, name, pconfigSAMPLE_RATE_HZ, pconfigBAUD_RATE, pconfigMODEM_FREQ_0, pconfigMODEM_FREQ_1,
+            (double)pconfigFSK_POWER_THRESHOLD);
+}
+
+static int _parse_options(int argc, char **argv, replay_options_t *options)
+{
+    static const struct option long_options[] = {
+        {"rate", required_argument, NULL, 'r'},
+        {"format", required_argument, NULL, 'f'},
+        {"baud", required_argument, NULL, 'b'},
+        {"f0", required_argument, NULL, '0'},
+        {"f1", required_argument, NULL, '1'},
+        {"threshold", required_argument, NULL, 't'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"chunk", required_argument, NULL, 'C'},
+        {"check", no_argument, NULL, 'c'},
+        {"quiet", no_argument, NULL, 'q'},
+        {"output", required_argument, NULL, 'o'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "r:f:b:0:1:t:j:C:cqo:vh", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'r':
+            options->sample_rate = atoi(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "s16") == 0)
+            {
+                options->format = SOURCE_FORMAT_S16;
+            }
+            else if (strcmp(optarg, "u12") == 0)
+            {
+                options->format = SOURCE_FORMAT_U12;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown format %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'b':
+            options->baud_rate = atoi(optarg);
+            break;
+        case '0':
+            options->freq_0 = strtof(optarg, NULL);
+            break;
+        case '1':
+            options->freq_1 = strtof(optarg, NULL);
+            break;
+        case 't':
+            options->power_threshold = strtof(optarg, NULL);
+            break;
+        case 'j':
+            options->jobs = atoi(optarg);
+            break;
+        case 'C':
+            options->chunk_s = strtof(optarg, NULL);
+            break;
+        case 'c':
+            options->check = true;
+            break;
+        case 'q':
+            options->quiet = true;
+            break;
+        case 'o':
+            options->output = optarg;
+            break;
+        case 'v':
+            if (options->log_level > LOG_LEVEL_DEBUG)
+            {
+                options->log_level = (log_level_e)(options->log_level - 1);
+            }
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if (options->sample_rate < 0 || options->baud_rate <= 0 || options->freq_0 <= 0.0f || options->freq_1 <= 0.0f)
+    {
+        fprintf(stderr, "Rates and frequencies must be positive\n");
+        return -1;
+    }
+
+    if (options->jobs < 0 || options->jobs > REPLAY_MAX_JOBS || options->chunk_s < 0.0f)
+    {
+        fprintf(stderr, "Jobs must be 0 to %d, chunk length not negative\n", REPLAY_MAX_JOBS);
+        return -1;
+    }
+    if (options->jobs == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        options->jobs = cores < 1 ? 1 : (cores > REPLAY_MAX_JOBS ? REPLAY_MAX_JOBS : (int)cores);
+    }
+
+    return 0;
+}
+
+static void _stop(int signal)
+{
+    (void)signal;
+    stopping = 1;
+}
+
+static double _now_s(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// The modem's receive chain without the modem, fed straight from the capture in its own format
+static int _decoder_init(replay_decoder_t *replay, const replay_options_t *options, int sample_rate,
+                         pc_sample_format_e sample_format)
+{
+    memset(replay, 0, sizeof(*replay));
+    replay->sample_rate = sample_rate;
+
+    int symbol_sample_size = sample_rate / options->baud_rate;
+    if (symbol_sample_size < 2 || options->freq_0 * 2 >= sample_rate || options->freq_1 * 2 >= sample_rate)
+    {
+        LOG_ERROR("%d Hz sampling can't carry %d baud at %.0f Hz and %.0f Hz", sample_rate, options->baud_rate,
+                  (double)options->freq_0, (double)options->freq_1);
+        return -1;
+    }
+
+    size_t input_samples = (size_t)symbol_sample_size * pconfigDECODER_BUFFER_SYMBOL_COUNT;
+    replay->input = malloc(input_samples * sizeof(uint16_t));
+    if (!replay->input)
+    {
+        LOG_ERROR("Failed to allocate decoder input");
+        return -1;
+    }
+
+    if (decoder_init(&replay->decoder) ||
+        decoder_set_input_buffer(&replay->decoder, replay->input, input_samples) ||
+        fsk_decoder_init(&replay->fsk_decoder) ||
+        fsk_decoder_set_symbol_sample_size(&replay->fsk_decoder, symbol_sample_size, pconfigDECODER_BUFFER_SYMBOL_COUNT) ||
+        fsk_decoder_set_sample_rate(&replay->fsk_decoder, sample_rate) ||
+        fsk_decoder_set_sample_format(&replay->fsk_decoder, sample_format) ||
+        fsk_decoder_set_symbol_rate(&replay->fsk_decoder, options->baud_rate) ||
+        fsk_decoder_set_frequencies(&replay->fsk_decoder, options->freq_0, options->freq_1) ||
+        fsk_decoder_set_power_threshold(&replay->fsk_decoder, options->power_threshold) ||
+        decoder_set_bit_decoder(&replay->decoder, BIT_DECODER_FSK, &replay->fsk_decoder) ||
+        byte_assembler_init(&replay->byte_assembler) ||
+        byte_assembler_set_preamble(&replay->byte_assembler, pconfigPREAMBLE_BYTE_1 << 8 | pconfigPREAMBLE_BYTE_2) ||
+        decoder_set_byte_decoder(&replay->decoder, BYTE_DECODER_BIT_STUFFING, &replay->byte_assembler))
+    {
+        LOG_ERROR("Failed to set up the decoder");
+        _decoder_deinit(replay);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void _decoder_deinit(replay_decoder_t *replay)
+{
+    decoder_deinit(&replay->decoder);
+    free(replay->input);
+    replay->input = NULL;
+}
+
+// Decodes up to limit samples of the source, optionally recording them, collecting the frames and
+// the sample, counted from first, each had decoded by
+static int _decode(replay_decoder_t *replay, source_t *source, recording_writer_t *writer, uint64_t first,
+                   uint64_t limit, recording_frame_t **frames, size_t *frame_count, uint64_t *samples)
+{
+    block_ring_t *ring = &replay->decoder.input_ring;
+    size_t frame_capacity = 0;
+    bool done = false;
+
+    *frames = NULL;
+    *frame_count = 0;
+    *samples = 0;
+
+    while (!stopping)
+    {
+        // Fill every free block, then let the decoder drain them all
+        size_t capacity;
+        uint16_t *block;
+        while (!done && (block = block_ring_acquire(ring, &capacity)) != NULL)
+        {
+            if (capacity > limit - *samples)
+            {
+                capacity = (size_t)(limit - *samples);
+            }
+            size_t count = capacity ? source_read(source, block, capacity) : 0;
+            if (count == 0)
+            {
+                done = true;
+                break;
+            }
+            if (writer && recording_write_samples(writer, block, count))
+            {
+                return -1;
+            }
+            block_ring_commit(ring, count);
+            *samples += count;
+        }
+
+        while (decoder_busy(&replay->decoder) || !block_ring_is_empty(ring))
+        {
+            if (decoder_task(&replay->decoder))
+            {
+                LOG_ERROR("Decoder task failed");
+                return -1;
+            }
+        }
+
+        while (decoder_has_packet(&replay->decoder))
+        {
+            if (*frame_count == frame_capacity)
+            {
+                frame_capacity = frame_capacity ? frame_capacity * 2 : 64;
+                recording_frame_t *grown = realloc(*frames, frame_capacity * sizeof(recording_frame_t));
+                if (!grown)
+                {
+                    LOG_ERROR("Failed to allocate frames");
+                    return -1;
+                }
+                *frames = grown;
+            }
+
+            recording_frame_t *frame = &(*frames)[*frame_count];
+            frame->sample = first + *samples;
+            if (decoder_get_packet(&replay->decoder, &frame->packet))
+            {
+                break;
+            }
+            (*frame_count)++;
+
+            if (writer && recording_write_frame(writer, frame))
+            {
+                return -1;
+            }
+        }
+
+        if (done && block_ring_is_empty(ring))
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// Decodes chunks until none are left, each with a fresh decoder started an overlap early
+static void *_chunk_worker(void *arg)
+{
+    replay_job_t *job = arg;
+    source_t source;
+
+    if (source_open(&source, job->path, job->options->format))
+    {
+        for (size_t i = atomic_fetch_add(&job->next_chunk, 1); i < job->chunk_count; i = atomic_fetch_add(&job->next_chunk, 1))
+        {
+            job->chunks[i].result = -1;
+        }
+        return NULL;
+    }
+
+    size_t index;
+    while (!stopping && (index = atomic_fetch_add(&job->next_chunk, 1)) < job->chunk_count)
+    {
+        replay_chunk_t *chunk = &job->chunks[index];
+        uint64_t first = chunk->start > job->overlap ? chunk->start - job->overlap : 0;
+        uint64_t last = chunk->end + job->margin < job->length ? chunk->end + job->margin : job->length;
+
+        replay_decoder_t replay;
+        if (source_seek(&source, first) || _decoder_init(&replay, job->options, job->sample_rate, source.sample_format))
+        {
+            chunk->result = -1;
+            continue;
+        }
+        chunk->result = _decode(&replay, &source, NULL, first, last - first, &chunk->frames, &chunk->frame_count, &chunk->samples);
+        _decoder_deinit(&replay);
+
+        // Keep what decoded inside the chunk, plus a margin either side in case the stamps of a
+        // frame on the boundary differ between neighbours
+        size_t kept = 0;
+        for (size_t i = 0; i < chunk->frame_count; i++)
+        {
+            uint64_t sample = chunk->frames[i].sample;
+            if (sample + job->margin >= chunk->start && sample < chunk->end + job->margin)
+            {
+                chunk->frames[kept++] = chunk->frames[i];
+            }
+        }
+        chunk->frame_count = kept;
+    }
+
+    source_close(&source);
+
+    return NULL;
+}
+
+/**
+ * @brief Decodes a file capture on several threads
+ *
+ * The capture is cut into chunks at multiples of the decoder's input buffer, so every chunk
+ * fills its input ring on the same sample boundaries a single decoder would and stamps its
+ * frames with the same samples. Each chunk starts decoding an overlap early, long enough for
+ * the filters to settle and for a frame already on the air at the cut to complete, and frames
+ * near a cut that both neighbours decoded are merged by content and sample.
+ *
+ * @param options Decoder and job options
+ * @param path File capture
+ * @param sample_rate Sample rate of the capture
+ * @param length Samples in the capture
+ * @param frames Receives the frames in capture order, freed by the caller
+ * @param frame_count Receives the number of frames
+ * @param samples Receives the samples in the capture
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+static int _decode_parallel(const replay_options_t *options, const char *path, int sample_rate, uint64_t length,
+                            recording_frame_t **frames, size_t *frame_count, uint64_t *samples)
+{
+    int ret = 0;
+
+    *frames = NULL;
+    *frame_count = 0;
+    *samples = length;
+
+    uint64_t input_samples = (uint64_t)(sample_rate / options->baud_rate) * pconfigDECODER_BUFFER_SYMBOL_COUNT;
+    uint64_t frame_samples = (uint64_t)REPLAY_MAX_FRAME_BITS * (uint64_t)(sample_rate / options->baud_rate);
+
+    replay_job_t job = {
+        .options = options,
+        .path = path,
+        .sample_rate = sample_rate,
+        .length = length,
+        .overlap = (frame_samples / input_samples + 2) * input_samples,
+        .margin = input_samples,
+    };
+
+    uint64_t chunk_samples = options->chunk_s > 0.0f ? (uint64_t)(options->chunk_s * sample_rate)
+                                                     : length / ((uint64_t)options->jobs * REPLAY_CHUNKS_PER_JOB);
+    if (chunk_samples < job.overlap * REPLAY_MIN_CHUNK_OVERLAPS)
+    {
+        chunk_samples = job.overlap * REPLAY_MIN_CHUNK_OVERLAPS;
+    }
+    chunk_samples = (chunk_samples + input_samples - 1) / input_samples * input_samples;
+
+    job.chunk_count = (size_t)((length + chunk_samples - 1) / chunk_samples);
+    job.chunks = calloc(job.chunk_count, sizeof(replay_chunk_t));
+    pthread_t *threads = calloc((size_t)options->jobs, sizeof(pthread_t));
+    if (!job.chunks || !threads)
+    {
+        LOG_ERROR("Failed to allocate %zu chunks", job.chunk_count);
+        free(job.chunks);
+        free(threads);
+        return -1;
+    }
+    for (size_t i = 0; i < job.chunk_count; i++)
+    {
+        job.chunks[i].start = i * chunk_samples;
+        job.chunks[i].end = (i + 1) * chunk_samples < length ? (i + 1) * chunk_samples : length;
+    }
+    atomic_init(&job.next_chunk, 0);
+
+    int started = 0;
+    for (; started < options->jobs && (size_t)started < job.chunk_count; started++)
+    {
+        if (pthread_create(&threads[started], NULL, _chunk_worker, &job))
+        {
+            LOG_WARN("Started %d of %d decoder threads", started, options->jobs);
+            break;
+        }
+    }
+    if (started == 0)
+    {
+        _chunk_worker(&job);
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Merge in capture order, dropping frames the previous chunk already has
+    size_t total = 0;
+    for (size_t i = 0; i < job.chunk_count; i++)
+    {
+        total += job.chunks[i].frame_count;
+    }
+    *frames = malloc((total ? total : 1) * sizeof(recording_frame_t));
+    for (size_t i = 0; i < job.chunk_count; i++)
+    {
+        replay_chunk_t *chunk = &job.chunks[i];
+        size_t previous_end = *frame_count;
+        if (chunk->result || !*frames)
+        {
+            ret = -1;
+        }
+
+        for (size_t j = 0; j < chunk->frame_count && *frames; j++)
+        {
+            const recording_frame_t *frame = &chunk->frames[j];
+            bool duplicate = false;
+            for (size_t k = previous_end; k-- > 0 && (*frames)[k].sample + job.margin >= frame->sample;)
+            {
+                if (_same_frame(&(*frames)[k], frame, job.margin))
+                {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate)
+            {
+                (*frames)[(*frame_count)++] = *frame;
+            }
+        }
+        free(chunk->frames);
+    }
+    if (*frames)
+    {
+        qsort(*frames, *frame_count, sizeof(recording_frame_t), _compare_frames);
+    }
+
+    free(job.chunks);
+    free(threads);
+
+    return stopping ? -1 : ret;
+}
+
+static void _print_frame(const char *path, const recording_frame_t *frame, int sample_rate, const char *note)
+{
+    const packet_t *packet = &frame->packet;
+
+    printf("%s %10.3f s  0x%02X -> 0x%02X  type %u  id %3u  %5.1f dB  %3u bytes%s: ", path,
+           (double)frame->sample / sample_rate, packet->content.src_addr, packet->content.dest_addr,
+           packet->content.type, packet->content.id, (double)packet->metadata.snr_db,
+           packet->content.payload_length, note);
+    for (size_t i = 0; i < packet->content.payload_length; i++)
+    {
+        uint8_t byte = packet->content.payload[i];
+        putchar(byte >= 0x20 && byte < 0x7F ? byte : '.');
+    }
+    putchar('\n');
+}
+
+static bool _same_frame(const recording_frame_t *a, const recording_frame_t *b, uint64_t window)
+{
+    uint64_t distance = a->sample > b->sample ? a->sample - b->sample : b->sample - a->sample;
+
+    return distance <= window &&
+           a->packet.content.src_addr == b->packet.content.src_addr &&
+           a->packet.content.dest_addr == b->packet.content.dest_addr &&
+           a->packet.content.id == b->packet.content.id &&
+           a->packet.content.type == b->packet.content.type &&
+           a->packet.content.crc == b->packet.content.crc &&
+           a->packet.content.payload_length == b->packet.content.payload_length &&
+           memcmp(a->packet.content.payload, b->packet.content.payload, a->packet.content.payload_length) == 0;
+}
+
+static int _compare_frames(const void *a, const void *b)
+{
+    uint64_t sample_a = ((const recording_frame_t *)a)->sample;
+    uint64_t sample_b = ((const recording_frame_t *)b)->sample;
+
+    return (sample_a > sample_b) - (sample_a < sample_b);
+}
+
+// Pairs each annotated frame with a decoded one, -1 if any annotated frame went missing
+static int _check(const char *path, const replay_options_t *options, const recording_reader_t *recording,
+                  const recording_frame_t *frames, size_t frame_count, int sample_rate, replay_totals_t *totals)
+{
+    int ret = 0;
+
+    bool *matched = calloc(frame_count ? frame_count : 1, sizeof(bool));
+    if (!matched)
+    {
+        LOG_ERROR("Failed to allocate match table");
+        return -1;
+    }
+
+    for (size_t i = 0; i < recording->frame_count; i++)
+    {
+        const recording_frame_t *annotated = &recording->frames[i];
+        bool found = false;
+        for (size_t j = 0; j < frame_count && !found; j++)
+        {
+            if (!matched[j] && _same_frame(annotated, &frames[j], (uint64_t)sample_rate * REPLAY_MATCH_WINDOW_S))
+            {
+                matched[j] = true;
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            _print_frame(path, annotated, sample_rate, " MISSED");
+            totals->missed++;
+            ret = -1;
+        }
+    }
+    totals->annotated += recording->frame_count;
+
+    for (size_t j = 0; j < frame_count; j++)
+    {
+        if (!matched[j])
+        {
+            if (!options->quiet)
+            {
+                _print_frame(path, &frames[j], sample_rate, " NEW");
+            }
+            totals->new_frames++;
+        }
+    }
+
+    free(matched);
+
+    return ret;
+}
+
+static int _run_decode(const replay_options_t *options, int count, char **paths)
+{
+    replay_totals_t totals = {0};
+    int ret = 0;
+
+    for (int i = 0; i < count && !stopping; i++)
+    {
+        source_t source;
+        if (source_open(&source, paths[i], options->format))
+        {
+            ret = 1;
+            continue;
+        }
+
+        int sample_rate = source.sample_rate ? source.sample_rate
+                                             : (options->sample_rate ? options->sample_rate : pconfigSAMPLE_RATE_HZ);
+        if (options->sample_rate && source.sample_rate && source.sample_rate != options->sample_rate)
+        {
+            LOG_WARN("%s is %d Hz, ignoring --rate", paths[i], source.sample_rate);
+        }
+
+        replay_decoder_t replay;
+        if (_decoder_init(&replay, options, sample_rate, source.sample_format))
+        {
+            source_close(&source);
+            ret = 1;
+            continue;
+        }
+
+        recording_frame_t *frames;
+        size_t frame_count;
+        uint64_t samples;
+        double start_s = _now_s();
+        int result;
+        uint64_t length = source_length(&source);
+        if (options->jobs > 1 && length)
+        {
+            result = _decode_parallel(options, paths[i], sample_rate, length, &frames, &frame_count, &samples);
+
+            // Nothing was read through this source, run it to the end for the annotations
+            if (options->check && source.kind == SOURCE_KIND_RECORDING && source_seek(&source, UINT64_MAX))
+            {
+                result = -1;
+            }
+        }
+        else
+        {
+            result = _decode(&replay, &source, NULL, 0, UINT64_MAX, &frames, &frame_count, &samples);
+        }
+        totals.seconds += _now_s() - start_s;
+        totals.samples += samples;
+        totals.audio_s += (double)samples / sample_rate;
+        totals.frames += frame_count;
+        if (result)
+        {
+            ret = 1;
+        }
+
+        if (options->check && source.kind == SOURCE_KIND_RECORDING)
+        {
+            if (_check(paths[i], options, source.recording, frames, frame_count, sample_rate, &totals))
+            {
+                ret = 1;
+            }
+        }
+        else
+        {
+            if (options->check)
+            {
+                LOG_WARN("%s has no annotations to check against", paths[i]);
+            }
+            for (size_t j = 0; j < frame_count && !options->quiet; j++)
+            {
+                _print_frame(paths[i], &frames[j], sample_rate, "");
+            }
+        }
+
+        free(frames);
+        _decoder_deinit(&replay);
+        source_close(&source);
+    }
+
+    fprintf(stderr, "%llu samples (%.1f s) in %.3f s, %.2f MS/s, %.0fx real time, %llu frames",
+            (unsigned long long)totals.samples, totals.audio_s, totals.seconds,
+            totals.seconds > 0.0 ? (double)totals.samples / totals.seconds / 1e6 : 0.0,
+            totals.seconds > 0.0 ? totals.audio_s / totals.seconds : 0.0, (unsigned long long)totals.frames);
+    if (options->check)
+    {
+        fprintf(stderr, ", %llu of %llu annotated frames missed, %llu new",
+                (unsigned long long)totals.missed, (unsigned long long)totals.annotated,
+                (unsigned long long)totals.new_frames);
+    }
+    fputc('\n', stderr);
+
+    return ret;
+}
+
+static int _run_record(const replay_options_t *options, const char *path)
+{
+    int ret = 0;
+
+    source_t source;
+    if (source_open(&source, path, options->format))
+    {
+        return 1;
+    }
+    if (source.kind == SOURCE_KIND_RECORDING)
+    {
+        LOG_ERROR("%s is already a recording", path);
+        source_close(&source);
+        return 1;
+    }
+
+    int sample_rate = source.sample_rate ? source.sample_rate
+                                         : (options->sample_rate ? options->sample_rate : pconfigSAMPLE_RATE_HZ);
+
+    replay_decoder_t replay;
+    if (_decoder_init(&replay, options, sample_rate, source.sample_format))
+    {
+        source_close(&source);
+        return 1;
+    }
+
+    recording_writer_t *writer = malloc(sizeof(recording_writer_t));
+    if (!writer || recording_create(writer, options->output, sample_rate, source.sample_format))
+    {
+        free(writer);
+        _decoder_deinit(&replay);
+        source_close(&source);
+        return 1;
+    }
+
+    // Frames are printed once the input ends, a live session is stopped with Ctrl-C
+    recording_frame_t *frames;
+    size_t frame_count;
+    uint64_t samples;
+    if (_decode(&replay, &source, writer, 0, UINT64_MAX, &frames, &frame_count, &samples))
+    {
+        ret = 1;
+    }
+    for (size_t i = 0; i < frame_count && !options->quiet; i++)
+    {
+        _print_frame(options->output, &frames[i], sample_rate, "");
+    }
+
+    if (recording_close(writer))
+    {
+        ret = 1;
+    }
+    fprintf(stderr, "%llu samples, %llu frames, %llu bytes (%.1f%% of 16-bit PCM)\n",
+            (unsigned long long)samples, (unsigned long long)frame_count, (unsigned long long)writer->bytes,
+            samples ? 100.0 * (double)writer->bytes / (double)(samples * sizeof(int16_t)) : 0.0);
+
+    free(frames);
+    free(writer);
+    _decoder_deinit(&replay);
+    source_close(&source);
+
+    return ret;
+}
+
+static int _run_export(const char *input, const char *output)
+{
+    source_t source;
+    if (source_open(&source, input, SOURCE_FORMAT_AUTO))
+    {
+        return 1;
+    }
+    if (source.kind != SOURCE_KIND_RECORDING)
+    {
+        LOG_ERROR("%s is not a recording", input);
+        source_close(&source);
+        return 1;
+    }
+
+    FILE *file = fopen(output, "wb");
+    if (!file)
+    {
+        LOG_ERROR("Failed to create %s", output);
+        source_close(&source);
+        return 1;
+    }
+
+    // Plain 16-bit mono PCM, the data size is patched in once it's known
+    uint8_t header[44] = {0};
+    uint32_t rate = (uint32_t)source.sample_rate;
+    memcpy(&header[0], "RIFF", 4);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    header[16] = 16;
+    header[20] = 1;
+    header[22] = 1;
+    for (int i = 0; i < 4; i++)
+    {
+        header[24 + i] = (uint8_t)(rate >> (8 * i));
+        header[28 + i] = (uint8_t)((rate * 2) >> (8 * i));
+    }
+    header[32] = 2;
+    header[34] = 16;
+    memcpy(&header[36], "data", 4);
+    fwrite(header, 1, sizeof(header), file);
+
+    uint16_t samples[RECORDING_BLOCK_SAMPLES];
+    uint8_t bytes[RECORDING_BLOCK_SAMPLES * sizeof(int16_t)];
+    uint32_t data_bytes = 0;
+    size_t count;
+    while ((count = source_read(&source, samples, RECORDING_BLOCK_SAMPLES)) > 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            // 16-bit recordings go out as they came in, 12-bit ones are scaled to full scale
+            uint16_t value = source.recording->format == PC_SAMPLE_FORMAT_S16 ? samples[i] : (uint16_t)((samples[i] << 4) ^ 0x8000);
+            bytes[2 * i] = (uint8_t)value;
+            bytes[2 * i + 1] = (uint8_t)(value >> 8);
+        }
+        fwrite(bytes, 1, count * sizeof(int16_t), file);
+        data_bytes += (uint32_t)(count * sizeof(int16_t));
+    }
+
+    uint32_t sizes[2] = {36 + data_bytes, data_bytes};
+    for (int i = 0; i < 4; i++)
+    {
+        header[4 + i] = (uint8_t)(sizes[0] >> (8 * i));
+        header[40 + i] = (uint8_t)(sizes[1] >> (8 * i));
+    }
+    int ret = fseek(file, 0, SEEK_SET) || fwrite(header, 1, sizeof(header), file) != sizeof(header) ? 1 : 0;
+    if (fclose(file) || ret)
+    {
+        LOG_ERROR("Failed to write %s", output);
+        ret = 1;
+    }
+
+    fprintf(stderr, "%u samples, %zu annotated frames\n", data_bytes / 2, source.recording->frame_count);
+    source_close(&source);
+
+    return ret;
+}
@@ -0,0 +1,368 @@
+/**
+ * @file source.c
+ *
+ * @author Diamond42474
+ *
+ * Opens captures for replay. Files are mapped rather than read so a long
+ * capture costs no copies and the kernel can read ahead of the decoder,
+ * and samples are unpacked a block at a time as the decoder asks for them.
+ * Sound card samples keep their full 16 bits, the decoder takes them as
+ * PC_SAMPLE_FORMAT_S16 like the Linux gateway does.
+ */
+#include "source.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "c-logger.h"
+
+#define SOURCE_WAV_FORMAT_PCM (1)
+#define SOURCE_WAV_FORMAT_EXTENSIBLE (0xFFFE)
+#define SOURCE_STDIN_BLOCK (4096) // Samples per read() from stdin
+
+static int _map(source_t *source, const char *path);
+static int _open_wav(source_t *source, const char *path);
+static size_t _read_stdin(source_t *source, uint16_t *samples, size_t count);
+static uint16_t _convert(const uint8_t *bytes, source_format_e format);
+static uint32_t _le32(const uint8_t *bytes);
+static uint16_t _le16(const uint8_t *bytes);
+
+/**
+ * @brief Opens a capture
+ *
+ * @param source Pointer to the source
+ * @param path WAV, raw or recording file, "-" for raw samples on stdin
+ * @param format Sample format of raw captures, WAVs are always S16
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int source_open(source_t *source, const char *path, source_format_e format)
+{
+    if (!source || !path)
+    {
+        LOG_ERROR("Invalid parameters for source open");
+        return -1;
+    }
+
+    memset(source, 0, sizeof(*source));
+    source->fd = -1;
+    source->format = format == SOURCE_FORMAT_AUTO ? SOURCE_FORMAT_S16 : format;
+    source->sample_format = source->format == SOURCE_FORMAT_U12 ? PC_SAMPLE_FORMAT_U12 : PC_SAMPLE_FORMAT_S16;
+    source->stride = sizeof(uint16_t);
+
+    if (strcmp(path, "-") == 0)
+    {
+        source->kind = SOURCE_KIND_RAW;
+        source->fd = STDIN_FILENO;
+        return 0;
+    }
+
+    if (_map(source, path))
+    {
+        return -1;
+    }
+
+    if (recording_is_recording(source->data, source->size))
+    {
+        source->kind = SOURCE_KIND_RECORDING;
+        source->recording = malloc(sizeof(recording_reader_t));
+        if (!source->recording || recording_open(source->recording, source->data, source->size))
+        {
+            LOG_ERROR("Failed to open recording %s", path);
+            source_close(source);
+            return -1;
+        }
+        source->sample_rate = source->recording->sample_rate;
+        source->sample_format = source->recording->format;
+        return 0;
+    }
+
+    if (source->size >= 12 &&
+        memcmp(source->data, "RIFF", 4) == 0 && memcmp(&source->data[8], "WAVE", 4) == 0)
+    {
+        source->kind = SOURCE_KIND_WAV;
+        source->format = SOURCE_FORMAT_S16;
+        source->sample_format = PC_SAMPLE_FORMAT_S16;
+        if (_open_wav(source, path))
+        {
+            source_close(source);
+            return -1;
+        }
+        return 0;
+    }
+
+    source->kind = SOURCE_KIND_RAW;
+    source->samples = source->data;
+    source->frame_count = source->size / source->stride;
+
+    return 0;
+}
+
+/**
+ * @brief Reads the next samples
+ *
+ * @param source Pointer to the source
+ * @param samples Receives samples in source->sample_format
+ * @param count Samples wanted
+ *
+ * @return the samples read, 0 at the end of the capture
+ */
+size_t source_read(source_t *source, uint16_t *samples, size_t count)
+{
+    if (source->done)
+    {
+        return 0;
+    }
+
+    if (source->kind == SOURCE_KIND_RECORDING)
+    {
+        size_t read = recording_read(source->recording, samples, count);
+        source->done = read == 0;
+        return read;
+    }
+
+    if (!source->mapped)
+    {
+        return _read_stdin(source, samples, count);
+    }
+
+    size_t remaining = source->frame_count - source->position;
+    if (count > remaining)
+    {
+        count = remaining;
+    }
+
+    const uint8_t *frame = source->samples + source->position * source->stride;
+    for (size_t i = 0; i < count; i++)
+    {
+        samples[i] = _convert(frame, source->format);
+        frame += source->stride;
+    }
+    source->position += count;
+    source->done = count == 0;
+
+    return count;
+}
+
+/**
+ * @brief Moves the read position of a file capture
+ *
+ * @param source Pointer to the source
+ * @param sample Sample the next read starts at
+ *
+ * @return error code: 0 = successful, -1 = failed
+ */
+int source_seek(source_t *source, uint64_t sample)
+{
+    if (!source || !source->mapped)
+    {
+        LOG_ERROR("Only file captures can seek");
+        return -1;
+    }
+
+    source->done = false;
+    if (source->kind == SOURCE_KIND_RECORDING)
+    {
+        return recording_seek(source->recording, sample);
+    }
+
+    source->position = sample < source->frame_count ? (size_t)sample : source->frame_count;
+
+    return 0;
+}
+
+uint64_t source_length(const source_t *source)
+{
+    if (!source || !source->mapped)
+    {
+        return 0;
+    }
+
+    return source->kind == SOURCE_KIND_RECORDING ? recording_length(source->recording) : source->frame_count;
+}
+
+void source_close(source_t *source)
+{
+    if (!source)
+    {
+        return;
+    }
+
+    if (source->recording)
+    {
+        recording_release(source->recording);
+        free(source->recording);
+        source->recording = NULL;
+    }
+    if (source->mapped)
+    {
+        munmap((void *)source->data, source->size);
+        source->mapped = false;
+    }
+    if (source->fd > STDIN_FILENO)
+    {
+        close(source->fd);
+    }
+    source->fd = -1;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=
+//  PRIVATE FUNCTIONS
+// =-=-=-=-=-=-=-=-=-=-=
+
+static int _map(source_t *source, const char *path)
+{
+    source->fd = open(path, O_RDONLY);
+    if (source->fd < 0)
+    {
+        LOG_ERROR("Failed to open %s", path);
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(source->fd, &info) || info.st_size == 0)
+    {
+        LOG_ERROR("%s is empty or can't be read", path);
+        source_close(source);
+        return -1;
+    }
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, source->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR("Failed to map %s", path);
+        source_close(source);
+        return -1;
+    }
+
+    // The decoder walks the capture front to back once
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    source->data = data;
+    source->size = (size_t)info.st_size;
+    source->mapped = true;
+
+    return 0;
+}
+
+static int _open_wav(source_t *source, const char *path)
+{
+    // Chunks can come in any order and there may be others (LIST, fact), stop at the data
+    bool have_format = false;
+    size_t offset = 12;
+    while (source->size - offset >= 8)
+    {
+        const uint8_t *chunk = &source->data[offset];
+        size_t size = _le32(&chunk[4]);
+        offset += 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            if (size < 16 || source->size - offset < 16)
+            {
+                LOG_ERROR("%s has a truncated format chunk", path);
+                return -1;
+            }
+
+            const uint8_t *format = &source->data[offset];
+            uint16_t type = _le16(&format[0]);
+            uint16_t channels = _le16(&format[2]);
+            uint16_t bits = _le16(&format[14]);
+            if ((type != SOURCE_WAV_FORMAT_PCM && type != SOURCE_WAV_FORMAT_EXTENSIBLE) || bits != 16 || channels == 0)
+            {
+                LOG_ERROR("%s must be 16-bit PCM", path);
+                return -1;
+            }
+
+            source->sample_rate = (int)_le32(&format[4]);
+            source->stride = channels * sizeof(int16_t); // Only the first channel is decoded
+            have_format = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!have_format)
+            {
+                LOG_ERROR("%s has no format before its data", path);
+                return -1;
+            }
+
+            // A capture that was still being written has a size of 0 or past the end, take what's there
+            size_t available = source->size - offset;
+            if (size == 0 || size > available)
+            {
+                size = available;
+            }
+            source->samples = &source->data[offset];
+            source->frame_count = size / source->stride;
+            return 0;
+        }
+
+        // Chunks are padded to an even size
+        if (size + (size & 1) > source->size - offset)
+        {
+            break;
+        }
+        offset += size + (size & 1);
+    }
+
+    LOG_ERROR("%s has no data chunk", path);
+    return -1;
+}
+
+static size_t _read_stdin(source_t *source, uint16_t *samples, size_t count)
+{
+    uint8_t bytes[SOURCE_STDIN_BLOCK * sizeof(uint16_t)];
+    size_t have = 0;
+
+    if (count > SOURCE_STDIN_BLOCK)
+    {
+        count = SOURCE_STDIN_BLOCK;
+    }
+
+    // A pipe can hand back half a sample, keep reading until whole ones arrive
+    while (have < sizeof(uint16_t) || have % sizeof(uint16_t))
+    {
+        ssize_t got = read(source->fd, &bytes[have], count * sizeof(uint16_t) - have);
+        if (got <= 0)
+        {
+            source->done = true;
+            break;
+        }
+        have += (size_t)got;
+    }
+
+    count = have / sizeof(uint16_t);
+    for (size_t i = 0; i < count; i++)
+    {
+        samples[i] = _convert(&bytes[i * sizeof(uint16_t)], source->format);
+    }
+
+    return count;
+}
+
+static uint16_t _convert(const uint8_t *bytes, source_format_e format)
+{
+    uint16_t raw = _le16(bytes);
+
+    if (format == SOURCE_FORMAT_U12)
+    {
+        return raw > RECORDING_SAMPLE_MAX ? RECORDING_SAMPLE_MAX : raw;
+    }
+
+    // S16 goes through as is, PC_SAMPLE_FORMAT_S16 is the signed sample cast to uint16_t
+    return raw;
+}
+
+static uint32_t _le32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static uint16_t _le16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
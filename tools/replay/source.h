@@ -0,0 +1,55 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "recording.h"
+
+// A capture to replay, read in the format it was captured in: sound card samples as signed
+// 16-bit cast to uint16_t, ADC captures as 12-bit samples centered on 2048, the way the BSPs
+// deliver them. Files are mmap'd and read a block at a time, so captures larger than memory
+// stream through without a copy; "-" reads raw samples from stdin instead.
+
+typedef enum
+{
+    SOURCE_FORMAT_AUTO,      // Raw S16, WAVs and recordings are always told apart by their headers
+    SOURCE_FORMAT_S16,       // Raw signed 16-bit little endian, sound card samples
+    SOURCE_FORMAT_U12,       // Raw unsigned 16-bit little endian holding 12-bit ADC samples
+} source_format_e;
+
+typedef enum
+{
+    SOURCE_KIND_WAV,
+    SOURCE_KIND_RAW,
+    SOURCE_KIND_RECORDING,
+} source_kind_e;
+
+typedef struct
+{
+    source_kind_e kind;
+    source_format_e format;           // Sample format of WAV and raw sources
+    pc_sample_format_e sample_format; // Format source_read delivers, the decoder is set up for it
+    int sample_rate;        // From the header, 0 when the file doesn't say
+
+    int fd;           // stdin or the mapped file
+    bool mapped;
+    const uint8_t *data;
+    size_t size;
+
+    const uint8_t *samples; // First sample of a WAV or raw mapping
+    size_t stride;          // Bytes from one frame to the next
+    size_t frame_count;     // Frames in the mapping, 0 for stdin
+    size_t position;        // Frames read
+    bool done;
+
+    recording_reader_t *recording;
+} source_t;
+
+int source_open(source_t *source, const char *path, source_format_e format);
+size_t source_read(source_t *source, uint16_t *samples, size_t count); // In sample_format, 0 at the end
+int source_seek(source_t *source, uint64_t sample);                   // Files only, past the end stops at the end
+uint64_t source_length(const source_t *source);                       // Samples in the capture, 0 for stdin
+void source_close(source_t *source);
+
+#endif // SOURCE_H